@@ -26,6 +26,7 @@
 #include "messages.h"
 #include "children.h"
 #include "dnscache.h"
+#include "dnsresolver.h"
 #include "alarms.h"
 #include "stats/stats-registry.h"
 #include "metrics/metrics.h"
@@ -39,6 +40,7 @@
 #include "mainloop-call.h"
 #include "service-management.h"
 #include "crypto.h"
+#include "transport/transport-tls.h"
 #include "value-pairs/value-pairs.h"
 #include "scratch-buffers.h"
 #include "mainloop.h"
@@ -222,12 +224,14 @@ app_startup(void)
   hostname_global_init();
   dns_caching_global_init();
   dns_caching_thread_init();
+  dns_resolver_global_init();
   afinter_global_init();
   child_manager_init();
   alarm_init();
   main_loop_thread_resource_init();
   stats_init();
   metrics_global_init();
+  log_transport_tls_global_init();
   healthcheck_stats_global_init();
   tzset();
   log_msg_global_init();
@@ -281,6 +285,7 @@ app_shutdown(void)
   log_msg_global_deinit();
 
   afinter_global_deinit();
+  log_transport_tls_global_deinit();
   metrics_global_deinit();
   stats_destroy();
   child_manager_deinit();
@@ -288,6 +293,7 @@ app_shutdown(void)
   g_list_free(application_hooks);
   g_list_free_full(application_thread_init_hooks, g_free);
   g_list_free_full(application_thread_deinit_hooks, g_free);
+  dns_resolver_global_deinit();
   dns_caching_thread_deinit();
   dns_caching_global_deinit();
   hostname_global_deinit();
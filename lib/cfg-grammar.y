@@ -266,6 +266,10 @@ main_location_print (FILE *yyo, YYLTYPE const * const yylocp)
 %token KW_SYSLOG_STATS                10405
 %token KW_HEALTHCHECK_FREQ            10406
 %token KW_WORKER_PARTITION_KEY        10407
+%token KW_HTTP_LISTEN                 10408
+%token KW_DYNAMIC_METRICS_LIMIT       10409
+%token KW_DYNAMIC_METRICS_IDLE_TIMEOUT 10410
+%token KW_LATENCY_SAMPLING            10411
 
 %token KW_CHAIN_HOSTNAMES             10090
 %token KW_NORMALIZE_HOSTNAMES         10091
@@ -286,10 +290,13 @@ main_location_print (FILE *yyo, YYLTYPE const * const yylocp)
 %token KW_DNS_CACHE_EXPIRE            10130
 %token KW_DNS_CACHE_EXPIRE_FAILED     10131
 %token KW_DNS_CACHE_HOSTS             10132
+%token KW_DNS_RESOLVER_THREADS        10133
+%token KW_DNS_RESOLVER_TIMEOUT        10134
 
 %token KW_PERSIST_ONLY                10140
 %token KW_USE_RCPTID                  10141
 %token KW_USE_UNIQID                  10142
+%token KW_PERSIST_SYNC_FREQ           10143
 
 %token KW_TZ_CONVERT                  10150
 %token KW_TS_FORMAT                   10151
@@ -815,6 +822,10 @@ log_scheduler_option
           {
             last_scheduler_options->num_partitions = $3;
           }
+        | KW_PARTITIONS '(' KW_AUTO ')'
+          {
+            last_scheduler_options->num_partitions = LOGSCHEDULER_PARTITIONS_AUTO;
+          }
         | KW_PARTITION_KEY '(' template_content ')'
           {
             log_scheduler_options_set_partition_key_ref(last_scheduler_options, $3);
@@ -1109,6 +1120,7 @@ options_item
 	| KW_PASS_UNIX_CREDENTIALS '(' yesno ')' { configuration->pass_unix_credentials = $3; }
 	| KW_USE_RCPTID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_USE_UNIQID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
+	| KW_PERSIST_SYNC_FREQ '(' nonnegative_integer ')'	{ configuration->persist_sync_freq = $3; }
 	| KW_LOG_FIFO_SIZE '(' positive_integer ')'	{ configuration->log_fifo_size = $3; }
 	| KW_LOG_IW_SIZE '(' positive_integer ')'	{ msg_warning("WARNING: Support for the global log-iw-size() option was removed, please use a per-source log-iw-size()", cfg_lexer_format_location_tag(lexer, &@1)); }
 	| KW_LOG_FETCH_LIMIT '(' positive_integer ')'	{ msg_warning("WARNING: Support for the global log-fetch-limit() option was removed, please use a per-source log-fetch-limit()", cfg_lexer_format_location_tag(lexer, &@1)); }
@@ -1159,6 +1171,10 @@ stats_group_option
 	| KW_LIFETIME '(' positive_integer ')'      { last_stats_options->lifetime = $3; }
 	| KW_MAX_DYNAMIC '(' nonnegative_integer ')'   { last_stats_options->max_dynamic = $3; }
 	| KW_SYSLOG_STATS '(' yesnoauto ')'     { last_stats_options->syslog_stats = $3; }
+	| KW_HTTP_LISTEN '(' string ')'         { g_free(last_stats_options->http_listen); last_stats_options->http_listen = g_strdup($3); free($3); }
+	| KW_DYNAMIC_METRICS_LIMIT '(' nonnegative_integer ')' { last_stats_options->dynamic_metrics_limit = $3; }
+	| KW_DYNAMIC_METRICS_IDLE_TIMEOUT '(' nonnegative_integer ')' { last_stats_options->dynamic_metrics_idle_timeout = $3; }
+	| KW_LATENCY_SAMPLING '(' nonnegative_integer ')' { last_stats_options->latency_sampling = $3; }
 	| KW_HEALTHCHECK_FREQ '(' nonnegative_integer ')' { last_healthcheck_options->freq = $3; }
 	;
 
@@ -1168,6 +1184,10 @@ dns_cache_option
 	| KW_DNS_CACHE_EXPIRE_FAILED '(' positive_integer ')'
 	                                        { last_dns_cache_options->expire_failed = $3; }
 	| KW_DNS_CACHE_HOSTS '(' string ')'     { last_dns_cache_options->hosts = g_strdup($3); free($3); }
+	| KW_DNS_RESOLVER_THREADS '(' nonnegative_integer ')'
+	                                        { last_dns_cache_options->resolver_threads = $3; }
+	| KW_DNS_RESOLVER_TIMEOUT '(' nonnegative_integer ')'
+	                                        { last_dns_cache_options->resolver_timeout = $3; }
         ;
 
 
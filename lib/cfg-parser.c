@@ -104,6 +104,10 @@ static CfgLexerKeyword main_keywords[] =
   { "lifetime",           KW_LIFETIME },
   { "max_dynamics",       KW_MAX_DYNAMIC },
   { "syslog_stats",       KW_SYSLOG_STATS },
+  { "http_listen",        KW_HTTP_LISTEN },
+  { "dynamic_metrics_limit", KW_DYNAMIC_METRICS_LIMIT },
+  { "dynamic_metrics_idle_timeout", KW_DYNAMIC_METRICS_IDLE_TIMEOUT },
+  { "latency_sampling", KW_LATENCY_SAMPLING },
   { "healthcheck_freq",   KW_HEALTHCHECK_FREQ},
   { "min_iw_size_per_reader", KW_MIN_IW_SIZE_PER_READER },
   { "flush_lines",        KW_FLUSH_LINES },
@@ -169,11 +173,14 @@ static CfgLexerKeyword main_keywords[] =
   { "template_function",  KW_TEMPLATE_FUNCTION },
   { "on_error",           KW_ON_ERROR },
   { "persist_only",       KW_PERSIST_ONLY },
+  { "persist_sync_freq",  KW_PERSIST_SYNC_FREQ },
   { "dns_cache_hosts",    KW_DNS_CACHE_HOSTS },
   { "dns_cache",          KW_DNS_CACHE },
   { "dns_cache_size",     KW_DNS_CACHE_SIZE },
   { "dns_cache_expire",   KW_DNS_CACHE_EXPIRE },
   { "dns_cache_expire_failed", KW_DNS_CACHE_EXPIRE_FAILED },
+  { "dns_resolver_threads", KW_DNS_RESOLVER_THREADS },
+  { "dns_resolver_timeout", KW_DNS_RESOLVER_TIMEOUT },
   {
     "pass_unix_credentials",   KW_PASS_UNIX_CREDENTIALS, KWS_OBSOLETE,
     "The use of pass-unix-credentials() has been deprecated in " VERSION_3_35 " in favour of "
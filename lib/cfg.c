@@ -32,6 +32,7 @@
 #include "userdb.h"
 #include "logmsg/logmsg.h"
 #include "dnscache.h"
+#include "dnsresolver.h"
 #include "serialize.h"
 #include "plugin.h"
 #include "cfg-parser.h"
@@ -291,9 +292,11 @@ cfg_init(GlobalConfig *cfg)
   if (!rcptid_init(cfg->state, cfg->use_uniqid))
     return FALSE;
 
-  stats_reinit(&cfg->stats_options);
+  if (!stats_reinit(&cfg->stats_options))
+    return FALSE;
 
   dns_caching_update_options(&cfg->dns_cache_options);
+  dns_resolver_update_options(&cfg->dns_cache_options);
   hostname_reinit(cfg->custom_domain);
   host_resolve_options_init_globals(&cfg->host_resolve_options);
   log_template_options_init(&cfg->template_options, cfg);
@@ -698,6 +701,7 @@ cfg_free(GlobalConfig *self)
   g_free(self->recv_time_zone);
   g_free(self->bad_hostname_re);
   dns_cache_options_destroy(&self->dns_cache_options);
+  stats_options_destroy(&self->stats_options);
   g_free(self->custom_domain);
   plugin_context_deinit_instance(&self->plugin_context);
   cfg_tree_free_instance(&self->tree);
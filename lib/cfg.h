@@ -100,6 +100,7 @@ struct _GlobalConfig
   gboolean create_dirs;
   FilePermOptions file_perm_options;
   gboolean use_uniqid;
+  gint persist_sync_freq;
 
   gboolean keep_timestamp;
 
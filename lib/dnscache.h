@@ -34,6 +34,10 @@ typedef struct
   gint expire;
   gint expire_failed;
   gchar *hosts;
+  /* number of asynchronous resolver threads, 0 to resolve in the calling thread */
+  gint resolver_threads;
+  /* how long to wait for an asynchronous lookup in milliseconds */
+  gint resolver_timeout;
 } DNSCacheOptions;
 
 typedef struct _DNSCache DNSCache;
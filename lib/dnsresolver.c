@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "dnsresolver.h"
+#include "messages.h"
+
+#include <netinet/in.h>
+#include <netdb.h>
+#include <string.h>
+
+#include <iv_list.h>
+
+/*
+ * Asynchronous reverse DNS resolution.
+ *
+ * Reverse lookups are executed by a small pool of resolver threads, so
+ * that a slow or unreachable name server does not stall the thread
+ * reading a source.  Results are stored in a process-wide cache, which is
+ * split into shards with their own lock to keep contention among reader
+ * threads low.
+ *
+ * A caller either proceeds right away with the IP address (the hostname
+ * becomes available for later messages from the same host), or waits for
+ * an in-flight lookup up to dns-resolver-timeout() milliseconds.
+ *
+ * The per-thread DNSCache in dnscache.c stays in front of this cache,
+ * entries are only copied there once a lookup has completed.
+ *
+ * An address has at most one lookup in flight: its pending entry is never
+ * evicted from the cache until the lookup completes.  The number of lookups
+ * queued or running is capped, addresses seen beyond that are not looked
+ * up until the backlog drains.
+ */
+
+#define DNS_RESOLVER_SHARDS 16
+#define DNS_RESOLVER_MAX_PENDING_LOOKUPS 1024
+
+typedef struct _DNSResolverKey
+{
+  gint family;
+  guint8 addr[16];
+} DNSResolverKey;
+
+typedef struct _DNSResolverEntry
+{
+  struct iv_list_head list;
+  DNSResolverKey key;
+  gboolean pending;
+  gboolean positive;
+  gint64 resolved;
+  gchar *hostname;
+} DNSResolverEntry;
+
+typedef struct _DNSResolverShard
+{
+  GMutex lock;
+  GCond resolved_cond;
+  GHashTable *entries;
+  /* least recently used entries come first */
+  struct iv_list_head lru;
+} DNSResolverShard;
+
+typedef struct _DNSResolverJob
+{
+  DNSResolverKey key;
+  GSockAddr *saddr;
+} DNSResolverJob;
+
+static DNSResolverShard dns_resolver_shards[DNS_RESOLVER_SHARDS];
+static GThreadPool *dns_resolver_pool;
+static gint dns_resolver_pending_lookups;
+static DNSResolverFunc dns_resolver_resolve;
+static DNSCacheOptions dns_resolver_options;
+
+static gboolean
+_key_equal(const DNSResolverKey *k1, const DNSResolverKey *k2)
+{
+  return k1->family == k2->family && memcmp(k1->addr, k2->addr, sizeof(k1->addr)) == 0;
+}
+
+static guint
+_key_hash(const DNSResolverKey *key)
+{
+  guint32 h = key->family;
+
+  for (gsize i = 0; i < sizeof(key->addr); i++)
+    h = h * 31 + key->addr[i];
+  return h;
+}
+
+static gboolean
+_fill_key(DNSResolverKey *key, GSockAddr *saddr)
+{
+  memset(key, 0, sizeof(*key));
+  key->family = saddr->sa.sa_family;
+
+  if (saddr->sa.sa_family == AF_INET)
+    {
+      memcpy(key->addr, &((struct sockaddr_in *) &saddr->sa)->sin_addr, sizeof(struct in_addr));
+      return TRUE;
+    }
+#if SYSLOG_NG_ENABLE_IPV6
+  else if (saddr->sa.sa_family == AF_INET6)
+    {
+      memcpy(key->addr, &((struct sockaddr_in6 *) &saddr->sa)->sin6_addr, sizeof(struct in6_addr));
+      return TRUE;
+    }
+#endif
+  return FALSE;
+}
+
+static inline DNSResolverShard *
+_get_shard(const DNSResolverKey *key)
+{
+  return &dns_resolver_shards[_key_hash(key) % DNS_RESOLVER_SHARDS];
+}
+
+static void
+_entry_free(DNSResolverEntry *entry)
+{
+  iv_list_del(&entry->list);
+  g_free(entry->hostname);
+  g_free(entry);
+}
+
+static gboolean
+_entry_expired(DNSResolverEntry *entry, gint64 now)
+{
+  if (entry->pending)
+    return FALSE;
+
+  gint expire = entry->positive ? dns_resolver_options.expire : dns_resolver_options.expire_failed;
+  return entry->resolved + expire * G_USEC_PER_SEC < now;
+}
+
+static DNSResolverEntry *
+_shard_insert_entry(DNSResolverShard *shard, const DNSResolverKey *key)
+{
+  DNSResolverEntry *entry = g_new0(DNSResolverEntry, 1);
+
+  entry->key = *key;
+  INIT_IV_LIST_HEAD(&entry->list);
+  iv_list_add_tail(&entry->list, &shard->lru);
+  g_hash_table_insert(shard->entries, &entry->key, entry);
+
+  gint shard_size = dns_resolver_options.cache_size / DNS_RESOLVER_SHARDS + 1;
+  if (g_hash_table_size(shard->entries) > shard_size)
+    {
+      /* pending entries are kept, they are how in-flight lookups are deduplicated */
+      struct iv_list_head *lh;
+      iv_list_for_each(lh, &shard->lru)
+      {
+        DNSResolverEntry *oldest = iv_list_entry(lh, DNSResolverEntry, list);
+        if (!oldest->pending)
+          {
+            g_hash_table_remove(shard->entries, &oldest->key);
+            break;
+          }
+      }
+    }
+  return entry;
+}
+
+/* called for completed lookups as well as for the ones dropped from the queue */
+static void
+_job_free(DNSResolverJob *job)
+{
+  g_atomic_int_add(&dns_resolver_pending_lookups, -1);
+  g_sockaddr_unref(job->saddr);
+  g_free(job);
+}
+
+static void
+_resolve_job(gpointer data, gpointer user_data)
+{
+  DNSResolverJob *job = (DNSResolverJob *) data;
+  gchar buf[256];
+  const gchar *hostname;
+
+  hostname = dns_resolver_resolve(job->saddr, buf, sizeof(buf));
+
+  DNSResolverShard *shard = _get_shard(&job->key);
+  g_mutex_lock(&shard->lock);
+
+  DNSResolverEntry *entry = g_hash_table_lookup(shard->entries, &job->key);
+  if (!entry)
+    entry = _shard_insert_entry(shard, &job->key);
+
+  g_free(entry->hostname);
+  entry->hostname = hostname ? g_strdup(hostname) : NULL;
+  entry->positive = (hostname != NULL);
+  entry->resolved = g_get_monotonic_time();
+  entry->pending = FALSE;
+
+  g_cond_broadcast(&shard->resolved_cond);
+  g_mutex_unlock(&shard->lock);
+
+  _job_free(job);
+}
+
+static gboolean
+_reserve_pending_lookup(void)
+{
+  gint pending;
+
+  do
+    {
+      pending = g_atomic_int_get(&dns_resolver_pending_lookups);
+      if (pending >= DNS_RESOLVER_MAX_PENDING_LOOKUPS)
+        return FALSE;
+    }
+  while (!g_atomic_int_compare_and_exchange(&dns_resolver_pending_lookups, pending, pending + 1));
+
+  return TRUE;
+}
+
+/* returns NULL if the lookup cannot be started, as too many are pending */
+static DNSResolverEntry *
+_shard_start_lookup(DNSResolverShard *shard, const DNSResolverKey *key, DNSResolverEntry *entry, GSockAddr *saddr)
+{
+  if (!_reserve_pending_lookup())
+    {
+      msg_debug("Too many reverse DNS lookups pending, using the IP address",
+                evt_tag_int("pending_lookups", DNS_RESOLVER_MAX_PENDING_LOOKUPS));
+      return NULL;
+    }
+
+  DNSResolverJob *job = g_new0(DNSResolverJob, 1);
+
+  if (!entry)
+    entry = _shard_insert_entry(shard, key);
+  entry->pending = TRUE;
+
+  job->key = *key;
+  job->saddr = g_sockaddr_ref(saddr);
+  g_thread_pool_push(dns_resolver_pool, job, NULL);
+  return entry;
+}
+
+gboolean
+dns_resolver_is_enabled(void)
+{
+  return dns_resolver_pool != NULL;
+}
+
+/*
+ * Returns TRUE if a completed lookup is available for @saddr, in which
+ * case @hostname is filled (if @positive is TRUE).  Returns FALSE if the
+ * lookup is still in progress after waiting dns-resolver-timeout(), the
+ * caller should use the IP address in this case.
+ */
+gboolean
+dns_resolver_lookup(GSockAddr *saddr, gchar *hostname, gsize hostname_size, gboolean *positive)
+{
+  DNSResolverKey key;
+  gboolean found = FALSE;
+
+  if (!dns_resolver_pool || !_fill_key(&key, saddr))
+    return FALSE;
+
+  DNSResolverShard *shard = _get_shard(&key);
+  gint64 now = g_get_monotonic_time();
+  gint64 deadline = now + dns_resolver_options.resolver_timeout * G_TIME_SPAN_MILLISECOND;
+
+  g_mutex_lock(&shard->lock);
+
+  DNSResolverEntry *entry = g_hash_table_lookup(shard->entries, &key);
+  if (!entry || _entry_expired(entry, now))
+    entry = _shard_start_lookup(shard, &key, entry, saddr);
+
+  while (entry && entry->pending && dns_resolver_options.resolver_timeout > 0)
+    {
+      gboolean signalled = g_cond_wait_until(&shard->resolved_cond, &shard->lock, deadline);
+
+      entry = g_hash_table_lookup(shard->entries, &key);
+      if (!signalled)
+        break;
+    }
+
+  if (entry && !entry->pending)
+    {
+      iv_list_del(&entry->list);
+      iv_list_add_tail(&entry->list, &shard->lru);
+
+      *positive = entry->positive;
+      if (entry->positive)
+        g_strlcpy(hostname, entry->hostname, hostname_size);
+      found = TRUE;
+    }
+
+  g_mutex_unlock(&shard->lock);
+  return found;
+}
+
+static const gchar *
+_resolve_using_getnameinfo(GSockAddr *saddr, gchar *buf, gsize buf_len)
+{
+  if (getnameinfo(&saddr->sa, saddr->salen, buf, buf_len, NULL, 0, NI_NAMEREQD) == 0)
+    return buf;
+  return NULL;
+}
+
+void
+dns_resolver_set_resolve_func(DNSResolverFunc resolve)
+{
+  dns_resolver_resolve = resolve ? resolve : _resolve_using_getnameinfo;
+}
+
+static void
+_stop_pool(void)
+{
+  if (!dns_resolver_pool)
+    return;
+
+  /* queued lookups are dropped, running ones are not waited for: they may
+   * take as long as the name server timeouts, their results still land in
+   * the cache */
+  g_thread_pool_free(dns_resolver_pool, TRUE, FALSE);
+  dns_resolver_pool = NULL;
+}
+
+static void
+_clear_shards(void)
+{
+  for (gint i = 0; i < DNS_RESOLVER_SHARDS; i++)
+    {
+      g_mutex_lock(&dns_resolver_shards[i].lock);
+      g_hash_table_remove_all(dns_resolver_shards[i].entries);
+      g_cond_broadcast(&dns_resolver_shards[i].resolved_cond);
+      g_mutex_unlock(&dns_resolver_shards[i].lock);
+    }
+}
+
+void
+dns_resolver_update_options(const DNSCacheOptions *options)
+{
+  dns_resolver_options.cache_size = options->cache_size;
+  dns_resolver_options.expire = options->expire;
+  dns_resolver_options.expire_failed = options->expire_failed;
+  dns_resolver_options.resolver_timeout = options->resolver_timeout;
+
+  if (dns_resolver_options.resolver_threads == options->resolver_threads)
+    return;
+  dns_resolver_options.resolver_threads = options->resolver_threads;
+
+  if (options->resolver_threads == 0)
+    {
+      _stop_pool();
+      /* pending entries would never complete */
+      _clear_shards();
+      return;
+    }
+
+  if (dns_resolver_pool)
+    {
+      g_thread_pool_set_max_threads(dns_resolver_pool, options->resolver_threads, NULL);
+      return;
+    }
+
+  GError *error = NULL;
+#if GLIB_CHECK_VERSION(2, 70, 0)
+  dns_resolver_pool = g_thread_pool_new_full(_resolve_job, NULL, (GDestroyNotify) _job_free,
+                                             options->resolver_threads, FALSE, &error);
+#else
+  /* lookups still queued at shutdown are leaked, and keep counting as pending */
+  dns_resolver_pool = g_thread_pool_new(_resolve_job, NULL, options->resolver_threads, FALSE, &error);
+#endif
+  if (!dns_resolver_pool)
+    {
+      msg_error("Error starting DNS resolver threads, falling back to synchronous lookups",
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+      dns_resolver_options.resolver_threads = 0;
+    }
+}
+
+void
+dns_resolver_global_init(void)
+{
+  for (gint i = 0; i < DNS_RESOLVER_SHARDS; i++)
+    {
+      DNSResolverShard *shard = &dns_resolver_shards[i];
+
+      g_mutex_init(&shard->lock);
+      g_cond_init(&shard->resolved_cond);
+      INIT_IV_LIST_HEAD(&shard->lru);
+      shard->entries = g_hash_table_new_full((GHashFunc) _key_hash, (GEqualFunc) _key_equal,
+                                             NULL, (GDestroyNotify) _entry_free);
+    }
+  dns_cache_options_defaults(&dns_resolver_options);
+  dns_resolver_resolve = _resolve_using_getnameinfo;
+}
+
+void
+dns_resolver_global_deinit(void)
+{
+  _stop_pool();
+
+  /* lookups still running would store their results into the shards, so
+   * those are left alone, we are exiting anyway */
+  if (g_atomic_int_get(&dns_resolver_pending_lookups) > 0)
+    return;
+
+  for (gint i = 0; i < DNS_RESOLVER_SHARDS; i++)
+    {
+      DNSResolverShard *shard = &dns_resolver_shards[i];
+
+      g_hash_table_destroy(shard->entries);
+      shard->entries = NULL;
+      g_cond_clear(&shard->resolved_cond);
+      g_mutex_clear(&shard->lock);
+    }
+  dns_cache_options_destroy(&dns_resolver_options);
+}
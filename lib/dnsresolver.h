@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef DNSRESOLVER_H_INCLUDED
+#define DNSRESOLVER_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "gsockaddr.h"
+#include "dnscache.h"
+
+/* returns buf if the address could be resolved, NULL otherwise, called from resolver threads */
+typedef const gchar *(*DNSResolverFunc)(GSockAddr *saddr, gchar *buf, gsize buf_len);
+
+gboolean dns_resolver_is_enabled(void);
+gboolean dns_resolver_lookup(GSockAddr *saddr, gchar *hostname, gsize hostname_size, gboolean *positive);
+
+void dns_resolver_set_resolve_func(DNSResolverFunc resolve);
+void dns_resolver_update_options(const DNSCacheOptions *options);
+void dns_resolver_global_init(void);
+void dns_resolver_global_deinit(void);
+
+#endif
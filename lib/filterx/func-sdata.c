@@ -73,7 +73,7 @@ _eval(FilterXExpr *s)
 
   gboolean contains = FALSE;
   FilterXEvalContext *context = filterx_eval_get_context();
-  LogMessage *msg = context->msgs[0];
+  const LogMessage *msg = log_msg_get_parsed_sdata(context->msgs[0]);
 
   for (guint8 i = 0; i < msg->num_sdata && !contains; i++)
     {
@@ -127,7 +127,7 @@ filterx_simple_function_has_sdata(FilterXExpr *s, GPtrArray *args)
     }
 
   FilterXEvalContext *context = filterx_eval_get_context();
-  LogMessage *msg = context->msgs[0];
+  const LogMessage *msg = log_msg_get_parsed_sdata(context->msgs[0]);
   return filterx_boolean_new(msg->num_sdata != 0);
 }
 
@@ -183,7 +183,7 @@ _insert_into_dict(FilterXObject *dict, const gchar *key, gssize key_len, const g
 }
 
 static gboolean
-_insert_while_same_sd_id(LogMessage *msg, guint8 index, guint8 num_sdata, guint8 *num_insertions,
+_insert_while_same_sd_id(const LogMessage *msg, guint8 index, guint8 num_sdata, guint8 *num_insertions,
                          FilterXObject *inner_dict,
                          const gchar *current_sd_id_start, gsize current_sd_id_len)
 {
@@ -224,7 +224,7 @@ static gboolean
 _generate(FilterXExprGenerator *s, FilterXObject *fillable)
 {
   FilterXEvalContext *context = filterx_eval_get_context();
-  LogMessage *msg = context->msgs[0];
+  const LogMessage *msg = log_msg_get_parsed_sdata(context->msgs[0]);
 
   const gchar *current_sd_id_start;
   gsize current_sd_id_len;
@@ -23,6 +23,7 @@
 #include "host-resolve.h"
 #include "hostname.h"
 #include "dnscache.h"
+#include "dnsresolver.h"
 #include "messages.h"
 #include "cfg.h"
 #include "tls-support.h"
@@ -340,6 +341,27 @@ sockaddr_to_dnscache_key(GSockAddr *saddr)
     }
 }
 
+/* returns FALSE if the lookup is still in progress in the resolver threads */
+static gboolean
+resolve_address(GSockAddr *saddr, const gchar **hname, gboolean *positive)
+{
+  if (dns_resolver_is_enabled())
+    {
+      if (!dns_resolver_lookup(saddr, hostname_buffer, sizeof(hostname_buffer), positive))
+        return FALSE;
+      *hname = *positive ? hostname_buffer : NULL;
+      return TRUE;
+    }
+
+#ifdef SYSLOG_NG_HAVE_GETNAMEINFO
+  *hname = resolve_address_using_getnameinfo(saddr, hostname_buffer, sizeof(hostname_buffer));
+#else
+  *hname = resolve_address_using_gethostbyaddr(saddr, hostname_buffer, sizeof(hostname_buffer));
+#endif
+  *positive = (*hname != NULL);
+  return TRUE;
+}
+
 static const gchar *
 resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
                                            const HostResolveOptions *host_resolve_options)
@@ -347,6 +369,7 @@ resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
   const gchar *hname;
   gsize hname_len;
   gboolean positive;
+  gboolean completed = TRUE;
   void *dnscache_key;
 
   dnscache_key = sockaddr_to_dnscache_key(saddr);
@@ -361,21 +384,16 @@ resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
     }
 
   if (!hname && host_resolve_options->use_dns && host_resolve_options->use_dns != 2)
-    {
-#ifdef SYSLOG_NG_HAVE_GETNAMEINFO
-      hname = resolve_address_using_getnameinfo(saddr, hostname_buffer, sizeof(hostname_buffer));
-#else
-      hname = resolve_address_using_gethostbyaddr(saddr, hostname_buffer, sizeof(hostname_buffer));
-#endif
-      positive = (hname != NULL);
-    }
+    completed = resolve_address(saddr, &hname, &positive);
 
   if (!hname)
     {
       hname = g_sockaddr_format(saddr, hostname_buffer, sizeof(hostname_buffer), GSA_ADDRESS_ONLY);
       positive = FALSE;
     }
-  if (host_resolve_options->use_dns_cache)
+
+  /* an in-progress lookup must not be cached as a failed one */
+  if (host_resolve_options->use_dns_cache && completed)
     dns_caching_store(saddr->sa.sa_family, dnscache_key, hname, positive);
 
   return hostname_apply_options_fqdn(-1, result_len, hname, positive, host_resolve_options);
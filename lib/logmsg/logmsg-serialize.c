@@ -29,6 +29,7 @@
 #include "logmsg/gsockaddr-serialize.h"
 #include "logmsg/timestamp-serialize.h"
 #include "logmsg/tags-serialize.h"
+#include "logpipe.h"
 #include "messages.h"
 
 #include <stdlib.h>
@@ -79,7 +80,8 @@ _serialize_message(LogMessageSerializationState *state)
   serialize_write_uint8(sa, msg->alloc_sdata);
   serialize_write_uint32_array(sa, (guint32 *) msg->sdata, msg->num_sdata);
 
-  if (state->flags & LMSF_COMPACTION)
+  /* an overlay is written merged with its base */
+  if ((state->flags & LMSF_COMPACTION) || nv_table_has_base(msg->payload))
     nv_table_serialize_with_compaction(state, msg->payload);
   else
     nv_table_serialize(state, msg->payload);
@@ -90,13 +92,32 @@ gboolean
 log_msg_serialize_with_ts_processed(LogMessage *self, SerializeArchive *sa, const UnixTime *processed, guint32 flags)
 {
   LogMessageSerializationState state = { 0 };
+  LogMessage *materialized = NULL;
 
-  state.version = LGM_V26;
+  if (self->flags & LF_STATE_LAZY_SDATA)
+    {
+      /* the serialized form always carries the parsed .SDATA.* values, so
+       * that it does not depend on the parser that produced the message */
+      if (log_msg_is_write_protected(self))
+        {
+          LogPathOptions path_options = LOG_PATH_OPTIONS_INIT_NOACK;
+
+          materialized = log_msg_clone_cow(self, &path_options);
+          self = materialized;
+        }
+      log_msg_parse_lazy_sdata(self);
+    }
+
+  state.version = LGM_V27;
   state.msg = self;
   state.sa = sa;
   state.processed = processed;
   state.flags = flags;
-  return _serialize_message(&state);
+
+  gboolean result = _serialize_message(&state);
+  if (materialized)
+    log_msg_unref(materialized);
+  return result;
 }
 
 gboolean
@@ -126,7 +147,7 @@ _deserialize_sdata(LogMessageSerializationState *state)
   if ((state->version < LGM_V26) && !serialize_read_uint16_array(sa, (guint32 *) self->sdata, self->num_sdata))
     return FALSE;
 
-  if ((state->version == LGM_V26) && !serialize_read_uint32_array(sa, (guint32 *) self->sdata, self->num_sdata))
+  if ((state->version >= LGM_V26) && !serialize_read_uint32_array(sa, (guint32 *) self->sdata, self->num_sdata))
     return FALSE;
 
   return TRUE;
@@ -148,6 +169,10 @@ _nv_table_deserialize_selector(LogMessageSerializationState *state)
       return state->nvtable;
     }
   else if (state->version == LGM_V26)
+    {
+      return nv_table_deserialize_26(state);
+    }
+  else if (state->version == LGM_V27)
     {
       return nv_table_deserialize(state);
     }
@@ -499,7 +524,7 @@ _check_msg_version(LogMessageSerializationState *state)
   if (!serialize_read_uint8(state->sa, &state->version))
     return FALSE;
 
-  if (state->version < LGM_V10 || state->version > LGM_V26)
+  if (state->version < LGM_V10 || state->version > LGM_V27)
     {
       msg_error("Error deserializing log message, unsupported version",
                 evt_tag_int("version", state->version));
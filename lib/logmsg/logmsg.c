@@ -295,6 +295,8 @@ __free_macro_value(void *val)
 }
 
 static NVHandle match_handles[256];
+static NVHandle lazy_sdata_handle;
+static LogMessageSDataParser sdata_parser;
 NVRegistry *logmsg_registry;
 const char logmsg_sd_prefix[] = ".SDATA.";
 const gint logmsg_sd_prefix_len = sizeof(logmsg_sd_prefix) - 1;
@@ -511,6 +513,7 @@ log_msg_init_queue_node(LogMessage *msg, LogMessageQueueNode *node, const LogPat
   INIT_IV_LIST_HEAD(&node->list);
   node->ack_needed = path_options->ack_needed;
   node->flow_control_requested = path_options->flow_control_requested;
+  node->enqueued_at = 0;
   node->msg = log_msg_ref(msg);
 }
 
@@ -617,6 +620,9 @@ log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
   if (handle == LM_V_NONE)
     return;
 
+  if (G_UNLIKELY(log_msg_chk_flag(self, LF_STATE_LAZY_SDATA)) && log_msg_is_handle_sdata(handle))
+    log_msg_parse_lazy_sdata(self);
+
   name_len = 0;
   name = log_msg_get_value_name(handle, &name_len);
 
@@ -634,7 +640,7 @@ log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
 
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     {
-      self->payload = nv_table_clone(self->payload, name_len + value_len + 2);
+      self->payload = nv_table_new_overlay(self->payload, name_len + value_len + 2);
       log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
       self->allocated_bytes += self->payload->size;
       stats_counter_add(count_allocated_bytes, self->payload->size);
@@ -681,6 +687,9 @@ log_msg_unset_value(LogMessage *self, NVHandle handle)
 {
   g_assert(!log_msg_is_write_protected(self));
 
+  if (G_UNLIKELY(log_msg_chk_flag(self, LF_STATE_LAZY_SDATA)) && log_msg_is_handle_sdata(handle))
+    log_msg_parse_lazy_sdata(self);
+
   if (_log_name_value_updates(self))
     {
       msg_trace("Unsetting value",
@@ -690,7 +699,7 @@ log_msg_unset_value(LogMessage *self, NVHandle handle)
 
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     {
-      self->payload = nv_table_clone(self->payload, 0);
+      self->payload = nv_table_new_overlay(self->payload, 0);
       log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
     }
 
@@ -739,6 +748,10 @@ log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
 
   g_assert(handle >= LM_V_MAX);
 
+  if (G_UNLIKELY(log_msg_chk_flag(self, LF_STATE_LAZY_SDATA)) &&
+      (log_msg_is_handle_sdata(handle) || log_msg_is_handle_sdata(ref_handle)))
+    log_msg_parse_lazy_sdata(self);
+
   name_len = 0;
   name = log_msg_get_value_name(handle, &name_len);
 
@@ -755,7 +768,7 @@ log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
 
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     {
-      self->payload = nv_table_clone(self->payload, name_len + 1);
+      self->payload = nv_table_new_overlay(self->payload, name_len + 1);
       log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
     }
 
@@ -792,10 +805,30 @@ log_msg_set_value_indirect(LogMessage *self, NVHandle handle, NVHandle ref_handl
   log_msg_set_value_indirect_with_type(self, handle, ref_handle, ofs, len, LM_VT_STRING);
 }
 
+static gboolean
+_foreach_skip_lazy_sdata(NVHandle handle, const gchar *name,
+                         const gchar *value, gssize value_len,
+                         LogMessageValueType type, gpointer user_data)
+{
+  gpointer *args = (gpointer *) user_data;
+  NVTableForeachFunc func = (NVTableForeachFunc) args[0];
+
+  if (handle == lazy_sdata_handle)
+    return FALSE;
+  return func(handle, name, value, value_len, type, args[1]);
+}
+
 gboolean
 log_msg_values_foreach(const LogMessage *self, NVTableForeachFunc func, gpointer user_data)
 {
-  return nv_table_foreach(self->payload, logmsg_registry, func, user_data);
+  if (!log_msg_chk_flag(self, LF_STATE_LAZY_SDATA))
+    return nv_table_foreach(self->payload, logmsg_registry, func, user_data);
+
+  /* the unparsed SDATA string is replaced by the values parsed from it */
+  gpointer args[] = { func, user_data };
+  if (nv_table_foreach(self->payload, logmsg_registry, _foreach_skip_lazy_sdata, args))
+    return TRUE;
+  return nv_table_foreach(log_msg_get_parsed_sdata(self)->payload, logmsg_registry, func, user_data);
 }
 
 NVHandle
@@ -1137,6 +1170,8 @@ log_msg_append_format_sdata(const LogMessage *self, GString *result,  guint32 se
   if (!meta_seqid)
     meta_seqid = log_msg_get_value_handle(".SDATA.meta.sequenceId");
 
+  self = log_msg_get_parsed_sdata(self);
+
   seqid = log_msg_get_value(self, meta_seqid, &seqid_length);
   APPEND_ZERO(seqid, seqid, seqid_length);
   if (seqid[0])
@@ -1270,9 +1305,26 @@ log_msg_format_sdata(const LogMessage *self, GString *result,  guint32 seq_num)
   log_msg_append_format_sdata(self, result, seq_num);
 }
 
+static void
+_drop_parsed_sdata(LogMessage *self)
+{
+  if (self->parsed_sdata)
+    {
+      log_msg_unref(self->parsed_sdata);
+      self->parsed_sdata = NULL;
+    }
+}
+
 void
 log_msg_clear_sdata(LogMessage *self)
 {
+  if (log_msg_chk_flag(self, LF_STATE_LAZY_SDATA))
+    {
+      self->flags &= ~LF_STATE_LAZY_SDATA;
+      log_msg_unset_value(self, lazy_sdata_handle);
+    }
+  _drop_parsed_sdata(self);
+
   for (gint i = 0; i < self->num_sdata; i++)
     log_msg_unset_value(self, self->sdata[i]);
   if (!log_msg_chk_flag(self, LF_STATE_OWN_SDATA))
@@ -1491,6 +1543,10 @@ log_msg_clone_ack(LogMessage *msg, AckType ack_type)
  * log_msg_clone_cow:
  *
  * Clone a copy-on-write (cow) copy of a log message.
+ *
+ * The clone shares the payload of the original, the first change puts an
+ * overlay on top of it, which only holds the changed values.  The shared
+ * payload is kept alive by the reference to the original message.
  */
 LogMessage *
 log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
@@ -1518,6 +1574,11 @@ log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
   self->cur_node = 0;
   self->write_protected = FALSE;
 
+  /* immutable once published, the clone may use it too */
+  self->parsed_sdata = g_atomic_pointer_get(&msg->parsed_sdata);
+  if (self->parsed_sdata)
+    log_msg_ref(self->parsed_sdata);
+
   log_msg_add_ack(self, path_options);
   if (!path_options->ack_needed)
     {
@@ -1550,6 +1611,107 @@ log_msg_new_empty(void)
   return log_msg_sized_new(256);
 }
 
+/*
+ * Lazy SDATA
+ *
+ * A syslog parser may store the structured data part of a message as a
+ * single, unparsed string (see the lazy-sdata flag of the syslog parser),
+ * instead of creating a .SDATA.* value for each SD-PARAM.  The string is
+ * only parsed if an .SDATA.* value is accessed.
+ *
+ * Reads may happen on write protected messages shared between threads,
+ * so they never touch the message payload: the values are parsed into a
+ * separate LogMessage (parsed_sdata), which is published atomically and
+ * is immutable afterwards.  Changing an .SDATA.* value needs a writable
+ * message anyway, in which case the string is parsed into the payload and
+ * the message stops being lazy.
+ */
+
+void
+log_msg_register_sdata_parser(LogMessageSDataParser parser)
+{
+  sdata_parser = parser;
+}
+
+void
+log_msg_set_lazy_sdata(LogMessage *self, const gchar *sdata, gssize sdata_len)
+{
+  g_assert(sdata_parser);
+
+  if (log_msg_chk_flag(self, LF_STATE_LAZY_SDATA) || self->num_sdata > 0)
+    {
+      /* mixing a lazy string with already parsed values would make the
+       * latter invisible, parse the string right away */
+      log_msg_parse_lazy_sdata(self);
+      sdata_parser(self, sdata, sdata_len);
+      return;
+    }
+
+  log_msg_set_value(self, lazy_sdata_handle, sdata, sdata_len);
+  log_msg_set_flag(self, LF_STATE_LAZY_SDATA);
+}
+
+void
+log_msg_parse_lazy_sdata(LogMessage *self)
+{
+  gssize sdata_len;
+
+  if (!log_msg_chk_flag(self, LF_STATE_LAZY_SDATA))
+    return;
+
+  g_assert(!log_msg_is_write_protected(self));
+
+  self->flags &= ~LF_STATE_LAZY_SDATA;
+  _drop_parsed_sdata(self);
+
+  const gchar *sdata = nv_table_get_value(self->payload, lazy_sdata_handle, &sdata_len, NULL);
+  if (!sdata)
+    return;
+
+  /* the payload may be reallocated while the values are added */
+  gchar *sdata_copy = g_strndup(sdata, sdata_len);
+  log_msg_unset_value(self, lazy_sdata_handle);
+  sdata_parser(self, sdata_copy, sdata_len);
+  g_free(sdata_copy);
+}
+
+/* does not consume a receipt id unlike log_msg_new_empty() */
+static LogMessage *
+_new_parsed_sdata_message(void)
+{
+  LogMessage *self = log_msg_alloc(256);
+
+  self->ack_and_ref_and_abort_and_suspended = LOGMSG_REFCACHE_REF_TO_VALUE(1);
+  self->flags |= LF_STATE_OWN_MASK;
+  return self;
+}
+
+const LogMessage *
+log_msg_get_parsed_sdata(const LogMessage *self)
+{
+  if (!log_msg_chk_flag(self, LF_STATE_LAZY_SDATA))
+    return self;
+
+  LogMessage *parsed_sdata = g_atomic_pointer_get(&self->parsed_sdata);
+  if (parsed_sdata)
+    return parsed_sdata;
+
+  gssize sdata_len;
+  const gchar *sdata = nv_table_get_value(self->payload, lazy_sdata_handle, &sdata_len, NULL);
+
+  parsed_sdata = _new_parsed_sdata_message();
+  if (sdata)
+    sdata_parser(parsed_sdata, sdata, sdata_len);
+
+  /* another thread may have been faster */
+  if (!g_atomic_pointer_compare_and_exchange((LogMessage **) &self->parsed_sdata, NULL, parsed_sdata))
+    {
+      log_msg_unref(parsed_sdata);
+      parsed_sdata = g_atomic_pointer_get(&self->parsed_sdata);
+    }
+  return parsed_sdata;
+}
+
 /* This function creates a new log message that should be considered local */
 LogMessage *
 log_msg_new_local(void)
@@ -1629,6 +1791,8 @@ log_msg_free(LogMessage *self)
 
   if (self->original)
     log_msg_unref(self->original);
+  if (self->parsed_sdata)
+    log_msg_unref(self->parsed_sdata);
 
   stats_counter_sub(count_allocated_bytes, self->allocated_bytes);
 
@@ -2073,6 +2237,8 @@ log_msg_registry_init(void)
       match_handles[i] = nv_registry_alloc_handle(logmsg_registry, buf);
       nv_registry_set_handle_flags(logmsg_registry, match_handles[i], (i << 8) + LM_VF_MATCH);
     }
+
+  lazy_sdata_handle = nv_registry_alloc_handle(logmsg_registry, "._lazy_sdata");
 }
 
 void
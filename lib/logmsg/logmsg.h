@@ -170,6 +170,8 @@ enum
   /* part of the state that is kept across clones */
   LF_STATE_CLONED_MASK = 0xFE00,
   LF_STATE_TRACING     = 0x0200,
+  /* SDATA is stored as an unparsed string, see log_msg_set_lazy_sdata() */
+  LF_STATE_LAZY_SDATA  = 0x0400,
 
   LF_CHAINED_HOSTNAME  = 0x00010000,
 
@@ -226,6 +228,8 @@ typedef struct _LogMessageQueueNode
   struct iv_list_head list;
   LogMessage *msg;
   guint ack_needed:1, embedded:1, flow_control_requested:1;
+  /* monotonic time of enqueueing, only set if the queue measures residency */
+  gint64 enqueued_at;
 } LogMessageQueueNode;
 
 
@@ -261,6 +265,8 @@ struct _LogMessage
   AckRecord *ack_record;
   LMAckFunc ack_func;
   LogMessage *original;
+  /* SDATA parsed from the lazily stored string, set on first access */
+  LogMessage *parsed_sdata;
 
   /* message parts */
 
@@ -366,6 +372,7 @@ log_msg_is_handle_settable_with_an_indirect_value(NVHandle handle)
 }
 
 const gchar *log_msg_get_macro_value(const LogMessage *self, gint id, gssize *value_len, LogMessageValueType *type);
+const LogMessage *log_msg_get_parsed_sdata(const LogMessage *self);
 const gchar *log_msg_get_match_with_type(const LogMessage *self, gint index_,
                                          gssize *value_len, LogMessageValueType *type);
 const gchar *log_msg_get_match_if_set_with_type(const LogMessage *self, gint index_,
@@ -383,8 +390,9 @@ log_msg_get_value_if_set_with_type(const LogMessage *self, NVHandle handle,
   flags = nv_registry_get_handle_flags(logmsg_registry, handle);
   if (G_UNLIKELY((flags & LM_VF_MACRO)))
     return log_msg_get_macro_value(self, flags >> 8, value_len, type);
-  else
-    return nv_table_get_value(self->payload, handle, value_len, type);
+  if (G_UNLIKELY((flags & LM_VF_SDATA) && (self->flags & LF_STATE_LAZY_SDATA)))
+    self = log_msg_get_parsed_sdata(self);
+  return nv_table_get_value(self->payload, handle, value_len, type);
 }
 
 gboolean log_msg_is_value_from_macro(const gchar *value);
@@ -392,6 +400,8 @@ gboolean log_msg_is_value_from_macro(const gchar *value);
 static inline gboolean
 log_msg_is_value_set(const LogMessage *self, NVHandle handle)
 {
+  if (G_UNLIKELY(self->flags & LF_STATE_LAZY_SDATA) && log_msg_is_handle_sdata(handle))
+    self = log_msg_get_parsed_sdata(self);
   return nv_table_is_value_set(self->payload, handle);
 }
 
@@ -501,6 +511,12 @@ void log_msg_append_format_sdata(const LogMessage *self, GString *result, guint3
 void log_msg_format_sdata(const LogMessage *self, GString *result, guint32 seq_num);
 void log_msg_clear_sdata(LogMessage *self);
 
+typedef void (*LogMessageSDataParser)(LogMessage *self, const gchar *sdata, gssize sdata_len);
+
+void log_msg_register_sdata_parser(LogMessageSDataParser parser);
+void log_msg_set_lazy_sdata(LogMessage *self, const gchar *sdata, gssize sdata_len);
+void log_msg_parse_lazy_sdata(LogMessage *self);
+
 void log_msg_set_tag_by_id_onoff(LogMessage *self, LogTagId id, gboolean on);
 void log_msg_set_tag_by_id(LogMessage *self, LogTagId id);
 void log_msg_set_tag_by_name(LogMessage *self, const gchar *name);
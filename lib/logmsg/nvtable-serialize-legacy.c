@@ -32,7 +32,8 @@
 
 #define NV_TABLE_OLD_SCALE 2
 #define NV_TABLE_MAGIC_V2  "NVT2"
-static const int NV_TABLE_HEADER_DIFF_V22_V26 = 4;
+/* the header of OldNVTable below is 8 bytes long */
+static const int NV_TABLE_HEADER_DIFF_V22_V26 = sizeof(NVTable) - 8;
 static const int NV_TABLE_DYNVALUE_DIFF_V22_V26 = 4;
 static const int NV_TABLE_HANDLE_DIFF_V22_V26 = 2;
 static const int SIZE_DIFF_OF_OLD_NVENTRY_AND_NEW_NVENTRY = 12;
@@ -332,6 +333,7 @@ nv_table_deserialize_22(SerializeArchive *sa)
 
   res->ref_cnt = 1;
   res->borrowed = FALSE;
+  res->base = NULL;
 
   if (!_deserialize_struct_22(sa, res))
     {
@@ -468,6 +470,7 @@ nv_table_deserialize_legacy(SerializeArchive *sa)
 
   res->borrowed = FALSE;
   res->ref_cnt = 1;
+  res->base = NULL;
 
   if (!_deserialize_blob_v22(sa, res, nv_table_get_top(res), swap_bytes))
     {
@@ -87,7 +87,7 @@ _read_flags(SerializeArchive *sa, guint8 *flags)
 }
 
 static inline gboolean
-_read_metadata(SerializeArchive *sa, NVTableMetaData *meta_data)
+_read_metadata(SerializeArchive *sa, NVTableMetaData *meta_data, const gchar *expected_magic)
 {
   if (!_read_magic(sa, &meta_data->magic))
     {
@@ -104,7 +104,7 @@ _read_metadata(SerializeArchive *sa, NVTableMetaData *meta_data)
       meta_data->magic = GUINT32_SWAP_LE_BE(meta_data->magic);
     }
 
-  if (memcmp((void *)&meta_data->magic, (const void *)NV_TABLE_MAGIC_V2, 4) != 0)
+  if (memcmp((void *)&meta_data->magic, (const void *)expected_magic, 4) != 0)
     {
       return FALSE;
     }
@@ -151,6 +151,7 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
 
   res->borrowed = FALSE;
   res->ref_cnt = 1;
+  res->base = NULL;
   *nvtable = res;
   return TRUE;
 
@@ -167,13 +168,13 @@ _read_payload(SerializeArchive *sa, NVTable *res)
 }
 
 NVTable *
-nv_table_deserialize(LogMessageSerializationState *state)
+nv_table_deserialize_26(LogMessageSerializationState *state)
 {
   SerializeArchive *sa = state->sa;
   NVTableMetaData meta_data;
   NVTable *res = NULL;
 
-  if (!_read_metadata(sa, &meta_data))
+  if (!_read_metadata(sa, &meta_data, NV_TABLE_MAGIC_V2))
     goto error;
 
   if (!_read_header(sa, &res))
@@ -200,20 +201,158 @@ error:
 }
 
 /**********************************************************************
- * serialize an NVTable
+ * deserialize an NVTable image (NVT3)
+ *
+ * The image consists of a small relocation header followed by two blocks
+ * copied verbatim from the in-memory layout of the table, in the byte
+ * order of the writer:
+ *
+ *   - the static entries and the index (index block)
+ *   - the payload, e.g. the last "used" bytes of the table
+ *
+ * Entries are addressed relative to the top of the table, so the image can
+ * be placed into an allocation of any size, the free space between the
+ * index and the payload is not stored.
  **********************************************************************/
 
+typedef struct _NVTableRelocationHeader
+{
+  guint32 used;
+  guint16 index_size;
+  guint8 num_static_entries;
+} NVTableRelocationHeader;
+
+static inline gsize
+_get_index_block_size(guint16 index_size, guint8 num_static_entries)
+{
+  return num_static_entries * sizeof(guint32) + index_size * sizeof(NVIndexEntry);
+}
+
+static gboolean
+_read_relocation_header(SerializeArchive *sa, NVTableRelocationHeader *header)
+{
+  if (!serialize_read_uint32(sa, &header->used) ||
+      !serialize_read_uint16(sa, &header->index_size) ||
+      !serialize_read_uint8(sa, &header->num_static_entries))
+    return FALSE;
+
+  /* see the comment in _read_header() about static entries */
+  if (header->num_static_entries > LM_V_MAX)
+    return FALSE;
+
+  if ((header->used & 0x3) != 0)
+    return FALSE;
+
+  if (sizeof(NVTable) + _get_index_block_size(header->index_size, header->num_static_entries) + header->used >
+      NV_TABLE_MAX_BYTES)
+    return FALSE;
+  return TRUE;
+}
+
+static NVTable *
+_alloc_table_for_image(NVTableRelocationHeader *header)
+{
+  gsize size = NV_TABLE_BOUND(sizeof(NVTable) + _get_index_block_size(header->index_size,
+                              header->num_static_entries)) + header->used;
+  NVTable *res;
+
+  if (size < NV_TABLE_MIN_BYTES)
+    size = NV_TABLE_MIN_BYTES;
+
+  res = (NVTable *) g_malloc(size);
+  res->size = size;
+  res->used = header->used;
+  res->index_size = header->index_size;
+  res->num_static_entries = header->num_static_entries;
+  res->ref_cnt = 1;
+  res->borrowed = FALSE;
+  res->base = NULL;
+  return res;
+}
+
 static void
-_write_struct(SerializeArchive *sa, NVTable *self)
+_index_block_swap_bytes(NVTable *self)
 {
-  serialize_write_uint32(sa, self->size);
-  serialize_write_uint32(sa, self->used);
-  serialize_write_uint16(sa, self->index_size);
-  serialize_write_uint8(sa, self->num_static_entries);
-  serialize_write_uint32_array(sa, self->static_entries, self->num_static_entries);
-  serialize_write_uint32_array(sa, (guint32 *) nv_table_get_index(self), self->index_size * 2);
+  guint32 *values = self->static_entries;
+  gsize count = self->num_static_entries + self->index_size * 2;
+
+  for (gsize i = 0; i < count; i++)
+    values[i] = GUINT32_SWAP_LE_BE(values[i]);
+}
+
+static inline gboolean
+_is_offset_valid(NVTable *self, guint32 ofs)
+{
+  return ofs == 0 || (ofs >= NV_ENTRY_DIRECT_HDR && ofs <= self->used);
 }
 
+/* entries are dereferenced right away (when swapping bytes and fixing up
+ * handles), so their offsets must point into the payload */
+static gboolean
+_validate_offsets(NVTable *self)
+{
+  NVIndexEntry *index_table = nv_table_get_index(self);
+
+  for (gint i = 0; i < self->num_static_entries; i++)
+    {
+      if (!_is_offset_valid(self, self->static_entries[i]))
+        return FALSE;
+    }
+
+  for (gint i = 0; i < self->index_size; i++)
+    {
+      if (!_is_offset_valid(self, index_table[i].ofs))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+NVTable *
+nv_table_deserialize(LogMessageSerializationState *state)
+{
+  SerializeArchive *sa = state->sa;
+  NVTableMetaData meta_data;
+  NVTableRelocationHeader header;
+  NVTable *res = NULL;
+
+  if (!_read_metadata(sa, &meta_data, NV_TABLE_MAGIC_V3))
+    goto error;
+
+  if (!_read_relocation_header(sa, &header))
+    goto error;
+
+  res = _alloc_table_for_image(&header);
+  state->nvtable_flags = meta_data.flags;
+  state->nvtable = res;
+
+  if (!serialize_read_blob(sa, res->static_entries, _get_index_block_size(res->index_size, res->num_static_entries)))
+    goto error;
+
+  if (!serialize_read_blob(sa, nv_table_get_bottom(res), res->used))
+    goto error;
+
+  if (_has_to_swap_bytes(meta_data.flags))
+    _index_block_swap_bytes(res);
+
+  if (!_validate_offsets(res))
+    goto error;
+
+  if (_has_to_swap_bytes(meta_data.flags))
+    nv_table_data_swap_bytes(res);
+
+  return res;
+
+error:
+  if (res)
+    g_free(res);
+  state->nvtable = NULL;
+  return NULL;
+}
+
+/**********************************************************************
+ * serialize an NVTable
+ **********************************************************************/
+
 static void
 _write_meta_data(SerializeArchive *sa, NVTableMetaData *meta_data)
 {
@@ -224,16 +363,52 @@ _write_meta_data(SerializeArchive *sa, NVTableMetaData *meta_data)
 static void
 _fill_meta_data(NVTable *self, NVTableMetaData *meta_data)
 {
-  memcpy((void *)&meta_data->magic, (const void *) NV_TABLE_MAGIC_V2, 4);
+  memcpy((void *)&meta_data->magic, (const void *) NV_TABLE_MAGIC_V3, 4);
   if (G_BYTE_ORDER == G_BIG_ENDIAN)
     meta_data->flags |= NVT_SF_BE;
   meta_data->flags |= NVT_SUPPORTS_UNSET;
 }
 
 static void
-_write_payload(SerializeArchive *sa, NVTable *self)
+_write_relocation_header(SerializeArchive *sa, NVTable *self)
+{
+  serialize_write_uint32(sa, self->used);
+  serialize_write_uint16(sa, self->index_size);
+  serialize_write_uint8(sa, self->num_static_entries);
+}
+
+/* NVTable reference counts are not atomic, so a table that belongs to a
+ * message (and can be shared with its clones on other threads) is kept
+ * alive through a reference to the message instead */
+static gpointer
+_ref_owner(LogMessageSerializationState *state, NVTable *self, GDestroyNotify *release_owner)
+{
+  if (state->msg && state->msg->payload == self)
+    {
+      *release_owner = (GDestroyNotify) log_msg_unref;
+      return log_msg_ref(state->msg);
+    }
+
+  *release_owner = (GDestroyNotify) nv_table_unref;
+  return nv_table_ref(self);
+}
+
+/* the blocks are written as they are in memory, archives that support it
+ * (e.g. the iovec archive) reference them instead of taking a copy */
+static void
+_write_blocks(LogMessageSerializationState *state, NVTable *self)
 {
-  serialize_write_blob(sa, NV_TABLE_ADDR(self, self->size - self->used), self->used);
+  SerializeArchive *sa = state->sa;
+  GDestroyNotify release_owner;
+  gpointer owner;
+
+  owner = _ref_owner(state, self, &release_owner);
+  serialize_write_blob_borrowed(sa, self->static_entries,
+                                _get_index_block_size(self->index_size, self->num_static_entries),
+                                owner, release_owner);
+
+  owner = _ref_owner(state, self, &release_owner);
+  serialize_write_blob_borrowed(sa, nv_table_get_bottom(self), self->used, owner, release_owner);
 }
 
 gboolean
@@ -245,8 +420,7 @@ nv_table_serialize(LogMessageSerializationState *state, NVTable *self)
   _fill_meta_data(self, &meta_data);
   _write_meta_data(sa, &meta_data);
 
-  _write_struct(sa, self);
-
-  _write_payload(sa, self);
+  _write_relocation_header(sa, self);
+  _write_blocks(state, self);
   return TRUE;
 }
@@ -31,12 +31,14 @@
 #include "logmsg/serialization.h"
 
 #define NV_TABLE_MAGIC_V2  "NVT2"
+#define NV_TABLE_MAGIC_V3  "NVT3"
 #define NVT_SF_BE           0x1
 #define NVT_SUPPORTS_UNSET  0x2
 
 #define NVENTRY_FLAGS_DEFINED_IN_LEGACY_FORMATS 0x3
 
 NVTable *nv_table_deserialize(LogMessageSerializationState *state);
+NVTable *nv_table_deserialize_26(LogMessageSerializationState *state);
 gboolean nv_table_serialize(LogMessageSerializationState *state, NVTable *self);
 gboolean nv_table_fixup_handles(LogMessageSerializationState *state);
 
@@ -192,6 +192,13 @@ nv_table_alloc_value(NVTable *self, gsize alloc_size)
   return entry;
 }
 
+/* entries found via the base of an overlay are read-only */
+static inline gboolean
+_is_entry_local(NVTable *self, NVEntry *entry)
+{
+  return (gchar *) entry > (gchar *) self && (gchar *) entry < nv_table_get_top(self);
+}
+
 /* we only support single indirection */
 const gchar *
 nv_table_resolve_indirect(NVTable *self, NVEntry *entry, gssize *length)
@@ -370,7 +377,9 @@ _make_entry_direct(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, g
   NVTable *self = (NVTable *) (((gpointer *) user_data)[0]);
   NVHandle ref_handle = GPOINTER_TO_UINT(((gpointer *) user_data)[1]);
 
-  if (entry->indirect && entry->vindirect.handle == ref_handle)
+  /* skip base entries that the overlay has already replaced */
+  if (entry->indirect && entry->vindirect.handle == ref_handle &&
+      nv_table_get_entry(self, handle, NULL, NULL) == entry)
     {
       const gchar *value;
       gssize value_len;
@@ -388,6 +397,8 @@ _make_entry_direct(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, g
   return FALSE;
 }
 
+static gboolean _foreach_local_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data);
+
 static inline gboolean
 nv_table_break_references_to_entry(NVTable *self, NVHandle handle, NVEntry *entry)
 {
@@ -395,7 +406,12 @@ nv_table_break_references_to_entry(NVTable *self, NVHandle handle, NVEntry *entr
     {
       gpointer data[2] = { self, GUINT_TO_POINTER((glong) handle) };
 
-      if (nv_table_foreach_entry(self, _make_entry_direct, data))
+      /* entries of the base may only reference entries of the base, while
+       * local ones are never referenced from the base: those were copied
+       * into the overlay when the referenced entry was first changed */
+      NVTable *referencing_table = _is_entry_local(self, entry) ? self : self->base;
+
+      if (_foreach_local_entry(referencing_table, _make_entry_direct, data))
         {
           /* we had to stop iteration, which means that we were unable
            * to allocate enough space for making indirect entries
@@ -465,7 +481,12 @@ nv_table_add_value(NVTable *self, NVHandle handle,
   if (!nv_table_break_references_to_entry(self, handle, entry))
     return FALSE;
 
-  if (entry && entry->alloc_len >= NV_ENTRY_DIRECT_SIZE(entry->name_len, value_len))
+  /* copying the values referencing an entry of the base into the overlay
+   * changes its index */
+  if (entry && !_is_entry_local(self, entry))
+    entry = nv_table_get_entry(self, handle, &index_entry, &index_slot);
+
+  if (entry && _is_entry_local(self, entry) && entry->alloc_len >= NV_ENTRY_DIRECT_SIZE(entry->name_len, value_len))
     {
       _overwrite_with_a_direct_entry(self, handle, entry, name, name_len, value, value_len, type);
       return TRUE;
@@ -503,6 +524,20 @@ nv_table_add_value(NVTable *self, NVHandle handle,
   return TRUE;
 }
 
+/* the entry of the base is hidden by an unset entry in the overlay */
+static gboolean
+_shadow_with_unset_entry(NVTable *self, NVHandle handle, NVEntry *base_entry)
+{
+  if (base_entry->unset)
+    return TRUE;
+
+  if (!nv_table_add_value(self, handle, nv_entry_get_name(base_entry), base_entry->name_len, null_string, 0, 0, NULL))
+    return FALSE;
+
+  nv_table_get_entry(self, handle, NULL, NULL)->unset = TRUE;
+  return TRUE;
+}
+
 gboolean
 nv_table_unset_value(NVTable *self, NVHandle handle)
 {
@@ -512,6 +547,9 @@ nv_table_unset_value(NVTable *self, NVHandle handle)
   if (!entry)
     return TRUE;
 
+  if (!_is_entry_local(self, entry))
+    return _shadow_with_unset_entry(self, handle, entry);
+
   if (!nv_table_break_references_to_entry(self, handle, entry))
     return FALSE;
 
@@ -612,10 +650,17 @@ nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, g
       return TRUE;
     }
 
+  /* values in the base of an overlay can't be marked as referenced, copy them */
+  if (!_is_entry_local(self, ref_entry))
+    return nv_table_copy_referenced_value(self, ref_entry, handle, name, name_len, referenced_slice, type, new_entry);
+
   if (!nv_table_break_references_to_entry(self, handle, entry))
     return FALSE;
 
-  if (entry && (entry->alloc_len >= NV_ENTRY_INDIRECT_SIZE(name_len)))
+  if (entry && !_is_entry_local(self, entry))
+    entry = nv_table_get_entry(self, handle, &index_entry, &index_slot);
+
+  if (entry && _is_entry_local(self, entry) && (entry->alloc_len >= NV_ENTRY_INDIRECT_SIZE(name_len)))
     {
       /* this value already exists and the new reference fits in the old space */
       nv_table_set_indirect_entry(self, handle, entry, name, name_len, referenced_slice, type);
@@ -671,8 +716,8 @@ nv_table_foreach(NVTable *self, NVRegistry *registry, NVTableForeachFunc func, g
   return nv_table_foreach_entry(self, nv_table_call_foreach, data);
 }
 
-gboolean
-nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data)
+static gboolean
+_foreach_local_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data)
 {
   NVIndexEntry *index_table;
   NVEntry *entry;
@@ -703,6 +748,79 @@ nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer use
   return FALSE;
 }
 
+/* iterates over the merged view of an overlay and its base in the same
+ * order as a single table would, e.g. static entries first, then the
+ * dynamic ones sorted by handle */
+static gboolean
+_foreach_entry_with_base(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data)
+{
+  NVTable *base = self->base;
+  NVIndexEntry *index_table, *base_index_table;
+  NVIndexEntry *index_entry;
+  NVEntry *entry;
+  NVHandle handle;
+  gint i, j;
+
+  for (i = 0; i < self->num_static_entries; i++)
+    {
+      entry = nv_table_get_entry_at_ofs(self, self->static_entries[i]);
+      if (!entry)
+        entry = nv_table_get_entry_at_ofs(base, base->static_entries[i]);
+      if (!entry)
+        continue;
+
+      if (func(i + 1, entry, NULL, user_data))
+        return TRUE;
+    }
+
+  index_table = nv_table_get_index(self);
+  base_index_table = nv_table_get_index(base);
+  i = j = 0;
+  while (i < self->index_size || j < base->index_size)
+    {
+      if (i < self->index_size && (j >= base->index_size || index_table[i].handle <= base_index_table[j].handle))
+        {
+          handle = index_table[i].handle;
+          index_entry = &index_table[i];
+          entry = nv_table_get_entry_at_ofs(self, index_table[i].ofs);
+          i++;
+
+          if (j < base->index_size && base_index_table[j].handle == handle)
+            {
+              if (!entry)
+                {
+                  index_entry = &base_index_table[j];
+                  entry = nv_table_get_entry_at_ofs(base, base_index_table[j].ofs);
+                }
+              j++;
+            }
+        }
+      else
+        {
+          handle = base_index_table[j].handle;
+          index_entry = &base_index_table[j];
+          entry = nv_table_get_entry_at_ofs(base, base_index_table[j].ofs);
+          j++;
+        }
+
+      if (!entry)
+        continue;
+
+      if (func(handle, entry, index_entry, user_data))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+gboolean
+nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data)
+{
+  if (self->base)
+    return _foreach_entry_with_base(self, func, user_data);
+  return _foreach_local_entry(self, func, user_data);
+}
+
 void
 nv_table_init(NVTable *self, gsize alloc_length, gint num_static_entries)
 {
@@ -713,6 +831,7 @@ nv_table_init(NVTable *self, gsize alloc_length, gint num_static_entries)
   self->num_static_entries = num_static_entries;
   self->ref_cnt = 1;
   self->borrowed = FALSE;
+  self->base = NULL;
   memset(&self->static_entries[0], 0, self->num_static_entries * sizeof(self->static_entries[0]));
 }
 
@@ -741,6 +860,64 @@ nv_table_init_borrowed(gpointer space, gsize space_len, gint num_static_entries)
   return self;
 }
 
+/* the size of a table that can hold the entries of an overlay and its base */
+static gsize
+_get_flattened_size(NVTable *self)
+{
+  NVTable *base = self->base;
+
+  return NV_TABLE_BOUND(sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) +
+                        (self->index_size + base->index_size) * sizeof(NVIndexEntry)) +
+         self->used + base->used;
+}
+
+/* once the overlay would grow to half the size of its base, it saves
+ * little memory and costs an extra lookup for every value that is not in
+ * it */
+static gboolean
+_should_flatten(NVTable *self, gsize new_size)
+{
+  return self->base && new_size * 2 >= self->base->size &&
+         _get_flattened_size(self) + new_size <= NV_TABLE_MAX_BYTES;
+}
+
+static gboolean
+_flatten_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  NVTable *new = (NVTable *) user_data;
+  NVEntry *new_entry;
+  NVIndexEntry *new_index_entry;
+
+  new_entry = nv_table_alloc_value(new, entry->alloc_len);
+  g_assert(new_entry);
+  memcpy(new_entry, entry, entry->alloc_len);
+
+  /* entries are visited in index order, so we can simply append */
+  if (!nv_table_is_handle_static(new, handle))
+    {
+      new_index_entry = &nv_table_get_index(new)[new->index_size++];
+      new_index_entry->handle = handle;
+    }
+  else
+    {
+      new_index_entry = NULL;
+    }
+  nv_table_set_table_entry(new, handle, nv_table_get_ofs_for_an_entry(new, new_entry), new_index_entry);
+  return FALSE;
+}
+
+/* merges an overlay with its base, entries are copied as they are
+ * (including unset ones and references) */
+static NVTable *
+_flatten(NVTable *self, gsize new_size)
+{
+  NVTable *new = g_malloc(new_size);
+
+  nv_table_init(new, new_size, self->num_static_entries);
+  nv_table_foreach_entry(self, _flatten_foreach_entry, new);
+  return new;
+}
+
 /* returns TRUE if successfully realloced, FALSE means that we're unable to grow */
 gboolean
 nv_table_realloc(NVTable *self, NVTable **new_nv_table)
@@ -755,6 +932,14 @@ nv_table_realloc(NVTable *self, NVTable **new_nv_table)
   if (new_size == old_size)
     return FALSE;
 
+  if (_should_flatten(self, new_size))
+    {
+      /* leave as much free space as the grown overlay would have */
+      *new_nv_table = _flatten(self, _get_flattened_size(self) + new_size);
+      nv_table_unref(self);
+      return TRUE;
+    }
+
   if (self->ref_cnt == 1 && !self->borrowed)
     {
       *new_nv_table = self = g_realloc(self, new_size);
@@ -836,6 +1021,29 @@ nv_table_clone(NVTable *self, gint additional_space)
   return new;
 }
 
+/**
+ * nv_table_new_overlay:
+ * @base: read-only table to put the new one on top of
+ * @additional_space: specifies how much space is needed in the overlay
+ *                    right away
+ *
+ * Creates an empty overlay that shares all the values of @base until they
+ * are changed.  @base has to outlive the overlay, its reference count is
+ * not taken.
+ **/
+NVTable *
+nv_table_new_overlay(NVTable *base, gint additional_space)
+{
+  NVTable *self;
+
+  if (base->base)
+    return nv_table_clone(base, additional_space);
+
+  /* leave room for a few more changes on top of the first one */
+  self = nv_table_new(base->num_static_entries, 4, NV_TABLE_BOUND(additional_space) + 256);
+  self->base = base;
+  return self;
+}
 
 static gboolean
 _compact_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
@@ -897,7 +1105,8 @@ _compact_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entr
 NVTable *
 nv_table_compact(NVTable *self)
 {
-  gint new_size = self->size;
+  /* an overlay is merged with its base */
+  gint new_size = self->base ? MIN(MAX(_get_flattened_size(self), self->size), NV_TABLE_MAX_BYTES) : self->size;
   NVTable *new = g_malloc(new_size);
   gpointer args[2] = { self, new };
 
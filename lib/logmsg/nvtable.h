@@ -251,6 +251,24 @@ nv_entry_get_name(NVEntry *self)
  *   - It is possible to clone an NVTable, which basically copies the
  *     underlying memory contents.
  *
+ * Overlays
+ * ========
+ *   - an NVTable may be layered on top of a read-only base table (see
+ *     nv_table_new_overlay()), in which case it only stores the entries
+ *     that were changed (or unset) since the overlay was created, lookups
+ *     of everything else fall through to the base.
+ *
+ *   - the base is never modified via the overlay and its reference count
+ *     is not touched either (it may be shared between threads), the
+ *     caller has to make sure that it outlives the overlay.  LogMessage
+ *     does this by holding a reference to the original message.
+ *
+ *   - overlays are only one level deep: cloning an overlay (or putting an
+ *     overlay on top of one) creates a copy that shares the same base.
+ *
+ *   - once an overlay has to grow beyond half the size of its base,
+ *     nv_table_realloc() flattens the two into a single table.
+ *
  * Limits
  * ======
  * There might be various assumptions here and there in the code that fields
@@ -277,6 +295,9 @@ struct _NVTable
   guint8 ref_cnt:7,
          borrowed:1; /* specifies if the memory used by NVTable was borrowed from the container struct */
 
+  /* read-only table this one is layered on top of, see "Overlays" above */
+  NVTable *base;
+
   /* variable data, see memory layout in the comment above */
   union
   {
@@ -315,6 +336,7 @@ NVTable *nv_table_init_borrowed(gpointer space, gsize space_len, gint num_static
 gboolean nv_table_realloc(NVTable *self, NVTable **new_nv_table);
 NVTable *nv_table_compact(NVTable *self);
 NVTable *nv_table_clone(NVTable *self, gint additional_space);
+NVTable *nv_table_new_overlay(NVTable *base, gint additional_space);
 NVTable *nv_table_ref(NVTable *self);
 void nv_table_unref(NVTable *self);
 
@@ -324,6 +346,12 @@ nv_table_is_handle_static(NVTable *self, NVHandle handle)
   return (handle <= self->num_static_entries);
 }
 
+static inline gboolean
+nv_table_has_base(NVTable *self)
+{
+  return self->base != NULL;
+}
+
 static inline gsize
 nv_table_get_alloc_size(gint num_static_entries, gint index_size_hint, gint init_length)
 {
@@ -405,10 +433,16 @@ __nv_table_get_entry(NVTable *self, NVHandle handle, guint16 num_static_entries,
     }
 }
 
+/* index_entry and index_slot always refer to the index of @self, so an
+ * entry found in the base of an overlay has a NULL index_entry */
 static inline NVEntry *
 nv_table_get_entry(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, NVIndexEntry **index_slot)
 {
-  return __nv_table_get_entry(self, handle, self->num_static_entries, index_entry, index_slot);
+  NVEntry *entry = __nv_table_get_entry(self, handle, self->num_static_entries, index_entry, index_slot);
+
+  if (G_UNLIKELY(!entry && self->base))
+    return __nv_table_get_entry(self->base, handle, self->base->num_static_entries, NULL, NULL);
+  return entry;
 }
 
 static inline gboolean
@@ -946,3 +946,27 @@ Test(log_message, test_cow_unset_value)
   log_msg_unref(orig_msg);
   log_msg_unref(msg);
 }
+
+Test(log_message, test_cow_clone_stores_only_the_changed_values)
+{
+  LogMessage *msg = _construct_log_message();
+  log_msg_set_value_by_name(msg, "orig_name", "orig_value", -1);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+
+  log_msg_set_value_by_name(cloned, "cloned_name", "cloned_value", -1);
+  log_msg_unset_value(cloned, LM_V_HOST);
+
+  cr_assert(nv_table_has_base(cloned->payload));
+  cr_assert_eq(cloned->payload->base, msg->payload);
+
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned, "orig_name", NULL), "orig_value");
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned, "cloned_name", NULL), "cloned_value");
+  gssize value_length;
+  cr_assert_null(log_msg_get_value_if_set(cloned, LM_V_HOST, &value_length));
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_HOST, NULL), "foo");
+
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
@@ -176,6 +176,105 @@ Test(logmsg_serialize, serialize)
   g_string_free(stream, TRUE);
 }
 
+static GString *
+_serialize_message_into_iovec_archive(LogMessage *msg, guint32 flags)
+{
+  GString *buffer = g_string_new("");
+  SerializeArchive *sa = serialize_iovec_archive_new(buffer);
+
+  cr_assert(log_msg_serialize(msg, sa, flags));
+
+  gint iovcnt;
+  const struct iovec *iov = serialize_iovec_archive_get_iovec(sa, &iovcnt);
+  cr_assert_gt(iovcnt, 1, "the NVTable is expected to be referenced, not copied");
+  cr_assert_lt(buffer->len, serialize_iovec_archive_get_length(sa));
+
+  GString *flattened = g_string_sized_new(serialize_iovec_archive_get_length(sa));
+  for (gint i = 0; i < iovcnt; i++)
+    g_string_append_len(flattened, iov[i].iov_base, iov[i].iov_len);
+
+  serialize_archive_free(sa);
+  g_string_free(buffer, TRUE);
+  return flattened;
+}
+
+static void
+_assert_serialization_into_iovec_archive(guint32 flags)
+{
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  GString *stream = _serialize_message_into_iovec_archive(msg, flags);
+  log_msg_unref(msg);
+
+  msg = _deserialize_message_from_string((const guint8 *) stream->str, stream->len);
+  _check_deserialized_message_all_fields(msg);
+
+  log_msg_unref(msg);
+  g_string_free(stream, TRUE);
+}
+
+Test(logmsg_serialize, serialize_into_iovec_archive)
+{
+  _assert_serialization_into_iovec_archive(0);
+}
+
+Test(logmsg_serialize, serialize_into_iovec_archive_with_compaction)
+{
+  _assert_serialization_into_iovec_archive(LMSF_COMPACTION);
+}
+
+Test(logmsg_serialize, truncated_nvtable_image_is_rejected)
+{
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  GString *stream = _serialize_message_into_iovec_archive(msg, 0);
+  log_msg_unref(msg);
+
+  for (gsize truncate_by = 1; truncate_by < 64; truncate_by++)
+    {
+      GString truncated = { .str = stream->str, .len = stream->len - truncate_by, .allocated_len = 0 };
+      SerializeArchive *sa = serialize_string_archive_new(&truncated);
+      sa->silent = TRUE;
+
+      msg = log_msg_new_empty();
+      cr_assert_not(log_msg_deserialize(msg, sa), "deserialization succeeded with %" G_GSIZE_FORMAT " bytes missing",
+                    truncate_by);
+      log_msg_unref(msg);
+      serialize_archive_free(sa);
+    }
+
+  g_string_free(stream, TRUE);
+}
+
+Test(logmsg_serialize, serialize_modified_clone)
+{
+  GString *stream = g_string_new("");
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  LogMessage *orig = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  LogMessage *clone = log_msg_clone_cow(orig, &path_options);
+  log_msg_set_value_by_name(clone, "clone_value", "foobar", -1);
+  log_msg_set_value(clone, LM_V_PROGRAM, "clonedprog", -1);
+  cr_assert(nv_table_has_base(clone->payload));
+
+  log_msg_serialize(clone, sa, 0);
+  log_msg_unref(clone);
+  log_msg_unref(orig);
+
+  _reset_log_msg_registry();
+  LogMessage *msg = log_msg_new_empty();
+  cr_assert(log_msg_deserialize(msg, sa), ERROR_MSG);
+
+  cr_assert_not(nv_table_has_base(msg->payload));
+  assert_log_message_value(msg, log_msg_get_value_handle("clone_value"), "foobar");
+  assert_log_message_value(msg, LM_V_PROGRAM, "clonedprog");
+  assert_log_message_value(msg, LM_V_MESSAGE, "An application event log entry...");
+  assert_log_message_value(msg, log_msg_get_value_handle("indirect_1"), "val");
+
+  log_msg_unref(msg);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+}
+
 static LogMessage *
 _create_message_to_be_serialized_with_ts_processed(const gchar *raw_msg, const int raw_msg_len, UnixTime *processed)
 {
@@ -393,6 +492,27 @@ Test(logmsg_serialize, serialization_with_compaction_performance)
   g_string_free(stream, TRUE);
 }
 
+Test(logmsg_serialize, serialization_into_iovec_archive_performance)
+{
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  GString *buffer = g_string_sized_new(512);
+  const int iterations = 100000;
+  gint iovcnt;
+
+  start_stopwatch();
+  for (int i = 0; i < iterations; i++)
+    {
+      g_string_truncate(buffer, 0);
+      SerializeArchive *sa = serialize_iovec_archive_new(buffer);
+      log_msg_serialize(msg, sa, 0);
+      serialize_iovec_archive_get_iovec(sa, &iovcnt);
+      serialize_archive_free(sa);
+    }
+  stop_stopwatch_and_display_result(iterations, "serializing (into iovecs) %d times took", iterations);
+  log_msg_unref(msg);
+  g_string_free(buffer, TRUE);
+}
+
 Test(logmsg_serialize, deserialization_performance)
 {
   GString *stream = g_string_sized_new(512);
@@ -413,6 +533,25 @@ Test(logmsg_serialize, deserialization_performance)
   g_string_free(stream, TRUE);
 }
 
+Test(logmsg_serialize, deserialization_of_v26_performance)
+{
+  GString stream = { .str = (gchar *) serialized_message_3_30_1, .len = sizeof(serialized_message_3_30_1) };
+  SerializeArchive *sa = serialize_string_archive_new(&stream);
+  const int iterations = 100000;
+  LogMessage *msg;
+
+  start_stopwatch();
+  for (int i = 0; i < iterations; i++)
+    {
+      serialize_string_archive_reset(sa);
+      msg = log_msg_new_empty();
+      log_msg_deserialize(msg, sa);
+      log_msg_unref(msg);
+    }
+  stop_stopwatch_and_display_result(iterations, "deserializing (version 26) %d times took", iterations);
+  serialize_archive_free(sa);
+}
+
 static void
 setup(void)
 {
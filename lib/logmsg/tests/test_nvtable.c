@@ -1166,3 +1166,170 @@ Test(nvtable, test_nvtable_compact_skips_unset_values)
 
   nv_table_unref(tab2);
 }
+
+static NVTable *
+_construct_overlay_base(void)
+{
+  NVTable *base;
+  const gchar *indirect_nv_name = "indirect-name";
+
+  base = nv_table_new(STATIC_VALUES, STATIC_VALUES, 1024);
+  nv_table_add_value(base, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "static-foo", 10, 0, NULL);
+  nv_table_add_value(base, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "dyn-foo", 7, 0, NULL);
+  nv_table_add_value_indirect(base, DYN_HANDLE+1, indirect_nv_name, strlen(indirect_nv_name),
+                              &(NVReferencedSlice)
+  {
+    STATIC_HANDLE, 1, 5
+  }, 0, NULL);
+  return base;
+}
+
+Test(nvtable, test_nvtable_overlay_falls_back_to_the_base)
+{
+  NVTable *base = _construct_overlay_base();
+  NVTable *overlay = nv_table_new_overlay(base, 0);
+
+  cr_assert(nv_table_has_base(overlay));
+  cr_assert_lt(overlay->size, base->size);
+  assert_nvtable(overlay, STATIC_HANDLE, "static-foo", 10);
+  assert_nvtable(overlay, DYN_HANDLE, "dyn-foo", 7);
+  assert_nvtable(overlay, DYN_HANDLE+1, "tatic", 5);
+
+  cr_assert(nv_table_add_value(overlay, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "dyn-bar", 7, 0, NULL));
+  cr_assert(nv_table_add_value(overlay, DYN_HANDLE+2, "VAL19", 5, "new-value", 9, 0, NULL));
+
+  assert_nvtable(overlay, DYN_HANDLE, "dyn-bar", 7);
+  assert_nvtable(overlay, DYN_HANDLE+2, "new-value", 9);
+  assert_nvtable(overlay, STATIC_HANDLE, "static-foo", 10);
+
+  /* the base is left intact */
+  assert_nvtable(base, DYN_HANDLE, "dyn-foo", 7);
+  cr_assert_not(nv_table_is_value_set(base, DYN_HANDLE+2));
+
+  nv_table_unref(overlay);
+  nv_table_unref(base);
+}
+
+Test(nvtable, test_nvtable_overlay_unset_hides_the_value_of_the_base)
+{
+  NVTable *base = _construct_overlay_base();
+  NVTable *overlay = nv_table_new_overlay(base, 0);
+  gssize size = 9999;
+
+  cr_assert(nv_table_unset_value(overlay, DYN_HANDLE));
+  cr_assert_null(nv_table_get_value(overlay, DYN_HANDLE, &size, NULL));
+  cr_assert_eq(size, 0);
+
+  assert_nvtable(base, DYN_HANDLE, "dyn-foo", 7);
+
+  nv_table_unref(overlay);
+  nv_table_unref(base);
+}
+
+Test(nvtable, test_nvtable_overlay_changing_a_referenced_value_keeps_indirect_values_of_the_base)
+{
+  NVTable *base = _construct_overlay_base();
+  NVTable *overlay = nv_table_new_overlay(base, 0);
+
+  cr_assert(nv_table_add_value(overlay, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "changed", 7, 0, NULL));
+  assert_nvtable(overlay, STATIC_HANDLE, "changed", 7);
+  assert_nvtable(overlay, DYN_HANDLE+1, "tatic", 5);
+
+  cr_assert(nv_table_unset_value(overlay, STATIC_HANDLE));
+  assert_nvtable(overlay, DYN_HANDLE+1, "tatic", 5);
+
+  assert_nvtable(base, STATIC_HANDLE, "static-foo", 10);
+
+  nv_table_unref(overlay);
+  nv_table_unref(base);
+}
+
+Test(nvtable, test_nvtable_overlay_indirect_value_referencing_the_base_is_copied)
+{
+  NVTable *base = _construct_overlay_base();
+  NVTable *overlay = nv_table_new_overlay(base, 0);
+  const gchar *indirect_nv_name = "indirect-name2";
+
+  cr_assert(nv_table_add_value_indirect(overlay, DYN_HANDLE+2, indirect_nv_name, strlen(indirect_nv_name),
+                                        &(NVReferencedSlice)
+  {
+    DYN_HANDLE, 4, 3
+  }, 0, NULL));
+
+  assert_nvtable(overlay, DYN_HANDLE+2, "foo", 3);
+  cr_assert_not(nv_table_get_entry(overlay, DYN_HANDLE+2, NULL, NULL)->indirect);
+  cr_assert_not(nv_table_get_entry(base, DYN_HANDLE, NULL, NULL)->referenced);
+
+  nv_table_unref(overlay);
+  nv_table_unref(base);
+}
+
+static gboolean
+_collect_handles(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  GArray *handles = (GArray *) user_data;
+
+  if (!entry->unset)
+    g_array_append_val(handles, handle);
+  return FALSE;
+}
+
+Test(nvtable, test_nvtable_overlay_foreach_iterates_over_the_merged_values_in_handle_order)
+{
+  NVTable *base = _construct_overlay_base();
+  NVTable *overlay = nv_table_new_overlay(base, 0);
+  GArray *handles = g_array_new(FALSE, FALSE, sizeof(NVHandle));
+  NVHandle expected[] = { STATIC_HANDLE, STATIC_HANDLE+1, DYN_HANDLE+1, DYN_HANDLE+2 };
+
+  nv_table_add_value(overlay, STATIC_HANDLE+1, "VAL2", 4, "static-bar", 10, 0, NULL);
+  nv_table_add_value(overlay, DYN_HANDLE+2, "VAL19", 5, "dyn-baz", 7, 0, NULL);
+  nv_table_add_value(overlay, DYN_HANDLE+1, "indirect-name", 13, "direct", 6, 0, NULL);
+  nv_table_unset_value(overlay, DYN_HANDLE);
+
+  nv_table_foreach_entry(overlay, _collect_handles, handles);
+  cr_assert_eq(handles->len, G_N_ELEMENTS(expected));
+  cr_assert_arr_eq((NVHandle *) handles->data, expected, sizeof(expected));
+
+  g_array_free(handles, TRUE);
+  nv_table_unref(overlay);
+  nv_table_unref(base);
+}
+
+Test(nvtable, test_nvtable_overlay_is_flattened_when_it_grows_large)
+{
+  NVTable *base = _construct_overlay_base();
+  NVTable *overlay = nv_table_new_overlay(base, 0);
+  gchar value[1024];
+
+  memset(value, 'x', sizeof(value));
+  while (!nv_table_add_value(overlay, DYN_HANDLE+2, "VAL19", 5, value, sizeof(value), 0, NULL))
+    cr_assert(nv_table_realloc(overlay, &overlay));
+
+  cr_assert_not(nv_table_has_base(overlay));
+  assert_nvtable(overlay, STATIC_HANDLE, "static-foo", 10);
+  assert_nvtable(overlay, DYN_HANDLE, "dyn-foo", 7);
+  assert_nvtable(overlay, DYN_HANDLE+1, "tatic", 5);
+  assert_nvtable(overlay, DYN_HANDLE+2, value, sizeof(value));
+
+  nv_table_unref(overlay);
+  nv_table_unref(base);
+}
+
+Test(nvtable, test_nvtable_compact_merges_the_overlay_with_its_base)
+{
+  NVTable *base = _construct_overlay_base();
+  NVTable *overlay = nv_table_new_overlay(base, 0);
+  NVTable *compacted;
+
+  nv_table_add_value(overlay, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "dyn-bar", 7, 0, NULL);
+  compacted = nv_table_compact(overlay);
+  nv_table_unref(overlay);
+  nv_table_unref(base);
+
+  cr_assert_not(nv_table_has_base(compacted));
+  assert_nvtable(compacted, STATIC_HANDLE, "static-foo", 10);
+  assert_nvtable(compacted, DYN_HANDLE, "dyn-bar", 7);
+  assert_nvtable(compacted, DYN_HANDLE+1, "tatic", 5);
+
+  nv_table_unref(compacted);
+}
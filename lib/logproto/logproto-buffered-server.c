@@ -83,7 +83,11 @@ log_proto_buffered_server_convert_from_raw(LogProtoBufferedServer *self, const g
       avail_out = state->buffer_size - state->pending_buffer_end;
       out = (gchar *) self->buffer + state->pending_buffer_end;
 
-      gint ret = g_iconv(self->convert, (gchar **) &raw_buffer, &avail_in, (gchar **) &out, &avail_out);
+      gsize ret;
+      if (self->utf8_converter)
+        ret = utf8_converter_convert(self->utf8_converter, &raw_buffer, &avail_in, (guchar **) &out, &avail_out);
+      else
+        ret = g_iconv(self->convert, (gchar **) &raw_buffer, &avail_in, (gchar **) &out, &avail_out);
       if (ret == (gsize) -1)
         {
           switch (errno)
@@ -1069,6 +1073,8 @@ log_proto_buffered_server_free_method(LogProtoServer *s)
     }
   if (self->convert != (GIConv) -1)
     g_iconv_close(self->convert);
+  if (self->utf8_converter)
+    utf8_converter_free(self->utf8_converter);
   log_proto_server_free_method(s);
 }
 
@@ -1088,7 +1094,10 @@ log_proto_buffered_server_init(LogProtoBufferedServer *self, LogTransport *trans
   self->read_data = log_proto_buffered_server_read_data_method;
   self->io_status = G_IO_STATUS_NORMAL;
   if (options->encoding)
-    self->convert = g_iconv_open("utf-8", options->encoding);
+    {
+      self->convert = g_iconv_open("utf-8", options->encoding);
+      self->utf8_converter = utf8_converter_new(options->encoding);
+    }
   else
     self->convert = (GIConv) -1;
   self->stream_based = TRUE;
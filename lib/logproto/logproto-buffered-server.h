@@ -26,6 +26,7 @@
 
 #include "logproto-server.h"
 #include "persistable-state-header.h"
+#include "utf8-converter.h"
 
 enum
 {
@@ -90,6 +91,8 @@ struct _LogProtoBufferedServer
   PersistState *persist_state;
   PersistEntryHandle persist_handle;
   GIConv convert;
+  /* fast path in front of convert, NULL if the encoding has none */
+  UTF8Converter *utf8_converter;
   guchar *buffer;
 
   GIConv reverse_convert;
@@ -46,6 +46,7 @@ log_proto_prefix_garbage_multiline_server_new(LogTransport *transport,
     multi_line_options_set_prefix(&multi_line_options, prefix, NULL);
   if (garbage)
     multi_line_options_set_garbage(&multi_line_options, garbage, NULL);
+  multi_line_options_init(&multi_line_options);
 
   LogProtoServer *server = log_proto_multiline_server_new(transport, get_inited_proto_server_options(),
                                                           multi_line_factory_construct(&multi_line_options));
@@ -66,6 +67,7 @@ log_proto_prefix_suffix_multiline_server_new(LogTransport *transport,
     multi_line_options_set_prefix(&multi_line_options, prefix, NULL);
   if (suffix)
     multi_line_options_set_garbage(&multi_line_options, suffix, NULL);
+  multi_line_options_init(&multi_line_options);
 
   LogProtoServer *server = log_proto_multiline_server_new(transport, get_inited_proto_server_options(),
                                                           multi_line_factory_construct(&multi_line_options));
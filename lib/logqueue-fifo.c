@@ -29,6 +29,7 @@
 #include "stats/stats-registry.h"
 #include "stats/stats-counter.h"
 #include "stats/stats-cluster-single.h"
+#include "stats/stats-cluster-histogram.h"
 #include "mainloop-worker.h"
 
 #include <sys/types.h>
@@ -103,7 +104,9 @@ typedef struct _LogQueueFifo
   struct
   {
     StatsClusterKey *capacity_sc_key;
+    StatsClusterKey *residency_sc_key;
     StatsCounterItem *capacity;
+    StatsHistogram *residency;
   } metrics;
 
   gint num_input_queues;
@@ -131,6 +134,26 @@ iv_list_update_msg_size(LogQueueFifo *self, struct iv_list_head *head)
   }
 }
 
+/* Residency is the time a message spends in the queue, from push_tail() to
+ * pop_head().  The clock is only read if the histogram is enabled. */
+static inline void
+_residency_start(LogQueueFifo *self, LogMessageQueueNode *node)
+{
+  if (self->metrics.residency)
+    node->enqueued_at = g_get_monotonic_time();
+}
+
+static inline void
+_residency_end(LogQueueFifo *self, LogMessageQueueNode *node)
+{
+  if (!self->metrics.residency || !node->enqueued_at)
+    return;
+
+  stats_histogram_observe(self->metrics.residency, g_get_monotonic_time() - node->enqueued_at);
+  /* rewound messages are not measured again */
+  node->enqueued_at = 0;
+}
+
 static gint64
 log_queue_fifo_get_length(LogQueue *s)
 {
@@ -354,6 +377,7 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
 
       log_msg_write_protect(msg);
       node = log_msg_alloc_queue_node(msg, path_options);
+      _residency_start(self, node);
       iv_list_add_tail(&node->list, &self->input_queues[thread_index].items);
       self->input_queues[thread_index].len++;
 
@@ -384,6 +408,7 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
 
   log_msg_write_protect(msg);
   node = log_msg_alloc_queue_node(msg, path_options);
+  _residency_start(self, node);
 
   iv_list_add_tail(&node->list, &self->wait_queue.items);
   self->wait_queue.len++;
@@ -465,6 +490,7 @@ log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
         self->output_queue.non_flow_controlled_len--;
 
       iv_list_del_init(&node->list);
+      _residency_end(self, node);
     }
   else
     {
@@ -614,6 +640,10 @@ _register_counters(LogQueueFifo *self, gint stats_level, StatsClusterKeyBuilder
     stats_cluster_key_builder_set_name(builder, "capacity");
     self->metrics.capacity_sc_key = stats_cluster_key_builder_build_single(builder);
 
+    stats_cluster_key_builder_set_name(builder, "residency_seconds");
+    stats_cluster_key_builder_set_unit(builder, SCU_MICROSECONDS);
+    self->metrics.residency_sc_key = stats_cluster_key_builder_build_histogram(builder);
+
     stats_cluster_key_builder_pop(builder);
   }
 
@@ -621,6 +651,11 @@ _register_counters(LogQueueFifo *self, gint stats_level, StatsClusterKeyBuilder
     stats_lock();
     stats_register_counter(stats_level, self->metrics.capacity_sc_key, SC_TYPE_SINGLE_VALUE,
                            &self->metrics.capacity);
+    /* measuring residency costs two clock reads per message, it is only
+     * enabled on stats(level(2)), or as the queue-wait component of
+     * stats(latency-sampling()) */
+    gint residency_level = stats_latency_sampling() > 0 ? stats_level : MAX(stats_level, STATS_LEVEL2);
+    stats_register_histogram(residency_level, self->metrics.residency_sc_key, &self->metrics.residency);
     stats_unlock();
   }
 }
@@ -637,6 +672,13 @@ _unregister_counters(LogQueueFifo *self)
 
         stats_cluster_key_free(self->metrics.capacity_sc_key);
       }
+
+    if (self->metrics.residency_sc_key)
+      {
+        stats_unregister_histogram(self->metrics.residency_sc_key, &self->metrics.residency);
+
+        stats_cluster_key_free(self->metrics.residency_sc_key);
+      }
     stats_unlock();
   }
 }
@@ -21,6 +21,7 @@
  *
  */
 #include "logscheduler-pipe.h"
+#include "cfg-tree.h"
 
 LogSchedulerOptions *
 log_scheduler_pipe_get_scheduler_options(LogPipe *s)
@@ -41,7 +42,9 @@ _init(LogPipe *s)
   if (!self->scheduler)
     self->scheduler = log_scheduler_new(&self->scheduler_options, self->super.pipe_next);
 
-  log_scheduler_init(self->scheduler);
+  gchar location[256];
+  log_expr_node_format_location(self->super.expr_node, location, sizeof(location));
+  log_scheduler_init(self->scheduler, location);
 
   return TRUE;
 }
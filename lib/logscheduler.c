@@ -23,6 +23,7 @@
 
 #include "logscheduler.h"
 #include "template/eval.h"
+#include "stats/stats-cluster-single.h"
 
 static void
 _reinject_message(LogPipe *front_pipe, LogMessage *msg, const LogPathOptions *path_options)
@@ -38,13 +39,14 @@ _reinject_message(LogPipe *front_pipe, LogMessage *msg, const LogPathOptions *pa
 /* LogSchedulerBatch */
 
 LogSchedulerBatch *
-_batch_new(struct iv_list_head *elements)
+_batch_new(struct iv_list_head *elements, gint num_messages)
 {
   LogSchedulerBatch *batch = g_new0(LogSchedulerBatch, 1);
 
   INIT_IV_LIST_HEAD(&batch->elements);
   INIT_IV_LIST_HEAD(&batch->list);
   iv_list_splice_tail(elements, &batch->elements);
+  batch->num_messages = num_messages;
   return batch;
 }
 
@@ -54,14 +56,83 @@ _batch_free(LogSchedulerBatch *batch)
   g_free(batch);
 }
 
+static void
+_batch_process(LogSchedulerBatch *batch, LogPipe *front_pipe)
+{
+  struct iv_list_head *ilh, *next;
+
+  iv_list_for_each_safe(ilh, next, &batch->elements)
+  {
+    LogMessageQueueNode *node = iv_list_entry(ilh, LogMessageQueueNode, list);
+
+    iv_list_del(&node->list);
+
+    LogMessage *msg = log_msg_ref(node->msg);
+
+    LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+    path_options.ack_needed = node->ack_needed;
+    path_options.flow_control_requested = node->flow_control_requested;
+
+    log_msg_free_queue_node(node);
+
+    log_msg_refcache_start_consumer(msg, &path_options);
+    _reinject_message(front_pipe, msg, &path_options);
+    log_msg_unref(msg);
+    log_msg_refcache_stop();
+  }
+  _batch_free(batch);
+}
+
 /* LogSchedulerPartition */
 
+/* take the oldest batch of a partition that is waiting for its worker */
+static LogSchedulerBatch *
+_partition_steal_batch(LogSchedulerPartition *victim)
+{
+  LogSchedulerBatch *batch = NULL;
+
+  /* unlocked peek, so that idle workers do not contend on busy locks */
+  if (g_atomic_int_get(&victim->num_batches) == 0)
+    return NULL;
+
+  g_mutex_lock(&victim->batches_lock);
+  if (!iv_list_empty(&victim->batches))
+    {
+      batch = iv_list_entry(victim->batches.next, LogSchedulerBatch, list);
+      iv_list_del(&batch->list);
+      g_atomic_int_add(&victim->num_batches, -1);
+    }
+  g_mutex_unlock(&victim->batches_lock);
+
+  if (batch)
+    stats_counter_sub(victim->metrics.queued_messages, batch->num_messages);
+  return batch;
+}
+
+static gboolean
+_steal_work(LogSchedulerPartition *partition)
+{
+  LogScheduler *self = partition->scheduler;
+
+  for (gint i = 1; i < self->num_partitions; i++)
+    {
+      LogSchedulerPartition *victim = &self->partitions[(partition->index + i) % self->num_partitions];
+      LogSchedulerBatch *batch = _partition_steal_batch(victim);
+
+      if (batch)
+        {
+          stats_counter_inc(partition->metrics.stolen_batches);
+          _batch_process(batch, partition->front_pipe);
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
 static void
-_work(gpointer s, gpointer arg)
+_drain_own_batches(LogSchedulerPartition *partition)
 {
-  LogSchedulerPartition *partition = (LogSchedulerPartition *) s;
   struct iv_list_head *ilh, *next;
-  struct iv_list_head *ilh2, *next2;
 
   /* batches_lock protects the batches list itself.  We take off partitions
    * one-by-one under the protection of the lock */
@@ -71,6 +142,7 @@ _work(gpointer s, gpointer arg)
     {
       struct iv_list_head batches = IV_LIST_HEAD_INIT(batches);
       iv_list_splice_init(&partition->batches, &batches);
+      g_atomic_int_set(&partition->num_batches, 0);
 
       g_mutex_unlock(&partition->batches_lock);
 
@@ -80,32 +152,26 @@ _work(gpointer s, gpointer arg)
         LogSchedulerBatch *batch = iv_list_entry(ilh, LogSchedulerBatch, list);
         iv_list_del(&batch->list);
 
-        iv_list_for_each_safe(ilh2, next2, &batch->elements)
-        {
-          LogMessageQueueNode *node = iv_list_entry(ilh2, LogMessageQueueNode, list);
-
-          iv_list_del(&node->list);
-
-          LogMessage *msg = log_msg_ref(node->msg);
-
-          LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
-          path_options.ack_needed = node->ack_needed;
-          path_options.flow_control_requested = node->flow_control_requested;
-
-          log_msg_free_queue_node(node);
-
-          log_msg_refcache_start_consumer(msg, &path_options);
-          _reinject_message(partition->front_pipe, msg, &path_options);
-          log_msg_unref(msg);
-          log_msg_refcache_stop();
-        }
-        _batch_free(batch);
+        stats_counter_sub(partition->metrics.queued_messages, batch->num_messages);
+        _batch_process(batch, partition->front_pipe);
       }
       g_mutex_lock(&partition->batches_lock);
     }
   g_mutex_unlock(&partition->batches_lock);
 }
 
+static void
+_work(gpointer s, gpointer arg)
+{
+  LogSchedulerPartition *partition = (LogSchedulerPartition *) s;
+
+  do
+    {
+      _drain_own_batches(partition);
+    }
+  while (partition->scheduler->work_stealing && _steal_work(partition));
+}
+
 static void
 _complete(gpointer s, gpointer arg)
 {
@@ -133,6 +199,8 @@ _partition_add_batch(LogSchedulerPartition *partition, LogSchedulerBatch *batch)
 {
   gboolean trigger_flush = FALSE;
 
+  stats_counter_add(partition->metrics.queued_messages, batch->num_messages);
+
   g_mutex_lock(&partition->batches_lock);
   if (!partition->flush_running &&
       iv_list_empty(&partition->batches))
@@ -141,6 +209,7 @@ _partition_add_batch(LogSchedulerPartition *partition, LogSchedulerBatch *batch)
       partition->flush_running = TRUE;
     }
   iv_list_add_tail(&batch->list, &partition->batches);
+  g_atomic_int_inc(&partition->num_batches);
   g_mutex_unlock(&partition->batches_lock);
 
   if (trigger_flush)
@@ -151,7 +220,7 @@ _partition_add_batch(LogSchedulerPartition *partition, LogSchedulerBatch *batch)
 }
 
 static void
-_partition_init(LogSchedulerPartition *partition, LogPipe *front_pipe)
+_partition_init(LogSchedulerPartition *partition, LogScheduler *scheduler, gint index)
 {
   main_loop_io_worker_job_init(&partition->io_job);
   partition->io_job.user_data = partition;
@@ -160,7 +229,9 @@ _partition_init(LogSchedulerPartition *partition, LogPipe *front_pipe)
   partition->io_job.engage = NULL;
   partition->io_job.release = NULL;
 
-  partition->front_pipe = front_pipe;
+  partition->front_pipe = scheduler->front_pipe;
+  partition->scheduler = scheduler;
+  partition->index = index;
 
   INIT_IV_LIST_HEAD(&partition->batches);
   g_mutex_init(&partition->batches_lock);
@@ -172,6 +243,52 @@ _partition_clear(LogSchedulerPartition *partition)
   g_mutex_clear(&partition->batches_lock);
 }
 
+static void
+_partition_register_metrics(LogSchedulerPartition *partition, const gchar *stats_id)
+{
+  gchar partition_index[16];
+  StatsClusterKey sc_key;
+
+  g_snprintf(partition_index, sizeof(partition_index), "%d", partition->index);
+
+  StatsClusterLabel labels[] =
+  {
+    stats_cluster_label("id", stats_id),
+    stats_cluster_label("partition", partition_index),
+  };
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "parallelize_queued_messages", labels, G_N_ELEMENTS(labels));
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &partition->metrics.queued_messages);
+
+  stats_cluster_single_key_set(&sc_key, "parallelize_stolen_batches_total", labels, G_N_ELEMENTS(labels));
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &partition->metrics.stolen_batches);
+  stats_unlock();
+}
+
+static void
+_partition_unregister_metrics(LogSchedulerPartition *partition, const gchar *stats_id)
+{
+  gchar partition_index[16];
+  StatsClusterKey sc_key;
+
+  g_snprintf(partition_index, sizeof(partition_index), "%d", partition->index);
+
+  StatsClusterLabel labels[] =
+  {
+    stats_cluster_label("id", stats_id),
+    stats_cluster_label("partition", partition_index),
+  };
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "parallelize_queued_messages", labels, G_N_ELEMENTS(labels));
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &partition->metrics.queued_messages);
+
+  stats_cluster_single_key_set(&sc_key, "parallelize_stolen_batches_total", labels, G_N_ELEMENTS(labels));
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &partition->metrics.stolen_batches);
+  stats_unlock();
+}
+
 /* LogSchedulerThreadState */
 
 static guint
@@ -180,13 +297,13 @@ _get_partition_index(LogScheduler *self, LogSchedulerThreadState *thread_state,
   if (!self->options->partition_key)
     {
       gint partition_index = thread_state->last_partition;
-      thread_state->last_partition = (thread_state->last_partition + 1) % self->options->num_partitions;
+      thread_state->last_partition = (thread_state->last_partition + 1) % self->num_partitions;
       return partition_index;
     }
   else
     {
       LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
-      return log_template_hash(self->options->partition_key, msg, &options) % self->options->num_partitions;
+      return log_template_hash(self->options->partition_key, msg, &options) % self->num_partitions;
     }
 }
 
@@ -200,14 +317,23 @@ _flush_batch(gpointer s)
 
   LogSchedulerThreadState *thread_state = &self->thread_states[thread_index];
 
-  for (gint partition_index = 0; partition_index < self->options->num_partitions; partition_index++)
+  for (gint partition_index = 0; partition_index < self->num_partitions; partition_index++)
     {
-      if (iv_list_empty(&thread_state->batch_by_partition[partition_index]))
+      struct iv_list_head *elements = &thread_state->batch_by_partition[partition_index];
+      struct iv_list_head *ilh;
+      gint num_messages = 0;
+
+      if (iv_list_empty(elements))
         continue;
 
+      iv_list_for_each(ilh, elements)
+      {
+        num_messages++;
+      }
+
       /* form the new batch, hand over the accumulated elements in batch_by_partition */
-      LogSchedulerBatch *batch = _batch_new(&thread_state->batch_by_partition[partition_index]);
-      INIT_IV_LIST_HEAD(&thread_state->batch_by_partition[partition_index]);
+      LogSchedulerBatch *batch = _batch_new(elements, num_messages);
+      INIT_IV_LIST_HEAD(elements);
 
       /* add the new batch to the target partition */
 
@@ -245,10 +371,17 @@ _thread_state_init(LogScheduler *self, LogSchedulerThreadState *state)
   state->batch_callback.func = _flush_batch;
   state->batch_callback.user_data = self;
 
-  for (gint i = 0; i < self->options->num_partitions; i++)
+  state->batch_by_partition = g_new(struct iv_list_head, MAX(self->num_partitions, 1));
+  for (gint i = 0; i < self->num_partitions; i++)
     INIT_IV_LIST_HEAD(&state->batch_by_partition[i]);
 }
 
+static void
+_thread_state_clear(LogSchedulerThreadState *state)
+{
+  g_free(state->batch_by_partition);
+}
+
 static void
 _init_thread_states(LogScheduler *self)
 {
@@ -258,33 +391,51 @@ _init_thread_states(LogScheduler *self)
     }
 }
 
+static void
+_free_thread_states(LogScheduler *self)
+{
+  for (gint i = 0; i < self->num_threads; i++)
+    {
+      _thread_state_clear(&self->thread_states[i]);
+    }
+}
+
 static void
 _init_partitions(LogScheduler *self)
 {
-  for (gint i = 0; i < self->options->num_partitions; i++)
+  self->partitions = g_new0(LogSchedulerPartition, MAX(self->num_partitions, 1));
+  for (gint i = 0; i < self->num_partitions; i++)
     {
-      _partition_init(&self->partitions[i], self->front_pipe);
+      _partition_init(&self->partitions[i], self, i);
     }
 }
 
 static void
 _free_partitions(LogScheduler *self)
 {
-  for (gint i = 0; i < self->options->num_partitions; i++)
+  for (gint i = 0; i < self->num_partitions; i++)
     {
       _partition_clear(&self->partitions[i]);
     }
+  g_free(self->partitions);
 }
 
 gboolean
-log_scheduler_init(LogScheduler *self)
+log_scheduler_init(LogScheduler *self, const gchar *stats_id)
 {
+  g_free(self->stats_id);
+  self->stats_id = g_strdup(stats_id);
+
+  for (gint i = 0; i < self->num_partitions; i++)
+    _partition_register_metrics(&self->partitions[i], self->stats_id);
   return TRUE;
 }
 
 void
 log_scheduler_deinit(LogScheduler *self)
 {
+  for (gint i = 0; i < self->num_partitions; i++)
+    _partition_unregister_metrics(&self->partitions[i], self->stats_id);
 }
 
 void
@@ -293,7 +444,7 @@ log_scheduler_push(LogScheduler *self, LogMessage *msg, const LogPathOptions *pa
   gint thread_index = main_loop_worker_get_thread_index();
 
   if (!self->front_pipe ||
-      self->options->num_partitions == 0 ||
+      self->num_partitions == 0 ||
       thread_index < 0 ||
       thread_index >= self->num_threads)
     {
@@ -312,6 +463,10 @@ log_scheduler_new(LogSchedulerOptions *options, LogPipe *front_pipe)
   LogScheduler *self = g_malloc0(sizeof(LogScheduler) + max_threads * sizeof(LogSchedulerThreadState));
   self->num_threads = max_threads;
   self->options = options;
+  self->num_partitions = options->num_partitions;
+  /* without a partition key messages are distributed in a round robin
+   * fashion, their order is not kept anyway */
+  self->work_stealing = (options->partition_key == NULL);
   self->front_pipe = log_pipe_ref(front_pipe);
 
   _init_thread_states(self);
@@ -323,14 +478,16 @@ void
 log_scheduler_free(LogScheduler *self)
 {
   log_pipe_unref(self->front_pipe);
+  _free_thread_states(self);
   _free_partitions(self);
+  g_free(self->stats_id);
   g_free(self);
 }
 
 #else
 
 gboolean
-log_scheduler_init(LogScheduler *self)
+log_scheduler_init(LogScheduler *self, const gchar *stats_id)
 {
   if (self->options->num_partitions > 0)
     {
@@ -391,7 +548,9 @@ log_scheduler_options_init(LogSchedulerOptions *options, GlobalConfig *cfg)
 {
   if (options->num_partitions == -1)
     options->num_partitions = 0;
-  if (options->num_partitions > LOGSCHEDULER_MAX_PARTITIONS)
+  else if (options->num_partitions == LOGSCHEDULER_PARTITIONS_AUTO)
+    options->num_partitions = main_loop_io_worker_get_max_number_of_threads();
+  else if (options->num_partitions > LOGSCHEDULER_MAX_PARTITIONS)
     options->num_partitions = LOGSCHEDULER_MAX_PARTITIONS;
   return TRUE;
 }
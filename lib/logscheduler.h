@@ -27,31 +27,46 @@
 #include "logpipe.h"
 #include "mainloop-io-worker.h"
 #include "template/templates.h"
+#include "stats/stats-registry.h"
 
 #include <iv_list.h>
 #include <iv_event.h>
 
 #define LOGSCHEDULER_MAX_PARTITIONS 16
+/* partitions(auto): one partition per I/O worker thread */
+#define LOGSCHEDULER_PARTITIONS_AUTO -2
+
+typedef struct _LogScheduler LogScheduler;
 
 typedef struct _LogSchedulerBatch
 {
   struct iv_list_head elements;
   struct iv_list_head list;
+  gint num_messages;
 } LogSchedulerBatch;
 
 typedef struct _LogSchedulerPartition
 {
   GMutex batches_lock;
   struct iv_list_head batches;
+  gint num_batches;
   gboolean flush_running;
   MainLoopIOWorkerJob io_job;
   LogPipe *front_pipe;
+  LogScheduler *scheduler;
+  gint index;
+
+  struct
+  {
+    StatsCounterItem *queued_messages;
+    StatsCounterItem *stolen_batches;
+  } metrics;
 } LogSchedulerPartition;
 
 typedef struct _LogSchedulerThreadState
 {
   WorkerBatchCallback batch_callback;
-  struct iv_list_head batch_by_partition[LOGSCHEDULER_MAX_PARTITIONS];
+  struct iv_list_head *batch_by_partition;
 
   guint64 num_messages;
   gint last_partition;
@@ -63,16 +78,21 @@ typedef struct _LogSchedulerOptions
   LogTemplate *partition_key;
 } LogSchedulerOptions;
 
-typedef struct _LogScheduler
+struct _LogScheduler
 {
   LogPipe *front_pipe;
   LogSchedulerOptions *options;
+  gint num_partitions;
+  /* idle partitions take over batches of the others, only possible if
+   * messages do not need to stay in order within a partition */
+  gboolean work_stealing;
+  gchar *stats_id;
   gint num_threads;
-  LogSchedulerPartition partitions[LOGSCHEDULER_MAX_PARTITIONS];
+  LogSchedulerPartition *partitions;
   LogSchedulerThreadState thread_states[];
-} LogScheduler;
+};
 
-gboolean log_scheduler_init(LogScheduler *self);
+gboolean log_scheduler_init(LogScheduler *self, const gchar *stats_id);
 void log_scheduler_deinit(LogScheduler *self);
 
 void log_scheduler_push(LogScheduler *self, LogMessage *msg, const LogPathOptions *path_options);
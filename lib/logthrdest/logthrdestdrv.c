@@ -103,6 +103,7 @@ void
 log_threaded_dest_worker_ack_messages(LogThreadedDestWorker *self, gint batch_size)
 {
   log_queue_ack_backlog(self->queue, batch_size);
+  stats_latency_tracker_ack(&self->metrics.latency, batch_size);
   stats_counter_add(self->owner->metrics.written_messages, batch_size);
   self->retries_on_error_counter = 0;
   self->batch_size -= batch_size;
@@ -112,6 +113,7 @@ void
 log_threaded_dest_worker_drop_messages(LogThreadedDestWorker *self, gint batch_size)
 {
   log_queue_ack_backlog(self->queue, batch_size);
+  stats_latency_tracker_drop(&self->metrics.latency, batch_size);
   stats_counter_add(self->owner->metrics.dropped_messages, batch_size);
   self->retries_on_error_counter = 0;
   self->batch_size -= batch_size;
@@ -121,6 +123,7 @@ void
 log_threaded_dest_worker_rewind_messages(LogThreadedDestWorker *self, gint batch_size)
 {
   log_queue_rewind_backlog(self->queue, batch_size);
+  stats_latency_tracker_rewind(&self->metrics.latency, batch_size);
   self->rewound_batch_size = self->batch_size;
   self->batch_size -= batch_size;
 }
@@ -490,6 +493,8 @@ _perform_inserts(LogThreadedDestWorker *self)
       self->batch_size++;
       result = log_threaded_dest_worker_insert(self, msg);
 
+      stats_latency_tracker_track(&self->metrics.latency, &msg->timestamps[LM_TS_RECVD],
+                                  result == LTR_SUCCESS || result == LTR_QUEUED || result == LTR_EXPLICIT_ACK_MGMT);
       _process_result(self, result);
 
       if (self->enable_batching && self->batch_size >= self->owner->batch_lines)
@@ -735,6 +740,7 @@ _perform_final_flush(LogThreadedDestWorker *self)
   result = log_threaded_dest_worker_flush(self, mode);
   _process_result(self, result);
   log_queue_rewind_backlog_all(self->queue);
+  stats_latency_tracker_rewind_all(&self->metrics.latency);
 }
 
 static gboolean
@@ -773,6 +779,7 @@ _worker_thread(MainLoopThreadedWorker *s)
    * not-flushed batch.  Rewind it, so we start with that */
 
   log_queue_rewind_backlog_all(self->queue);
+  stats_latency_tracker_rewind_all(&self->metrics.latency);
 
   _schedule_restart(self);
   iv_main();
@@ -904,6 +911,15 @@ _register_worker_stats(LogThreadedDestWorker *self)
       self->metrics.message_delay_sample_age_key = stats_cluster_key_builder_build_single(kb);
       stats_register_counter(level, self->metrics.message_delay_sample_age_key, SC_TYPE_SINGLE_VALUE,
                              &self->metrics.message_delay_sample_age);
+
+      stats_cluster_key_builder_set_name(kb, "output_flush_duration_seconds");
+      stats_cluster_key_builder_set_unit(kb, SCU_MICROSECONDS);
+      self->metrics.flush_duration_key = stats_cluster_key_builder_build_histogram(kb);
+      stats_register_histogram(MAX(level, STATS_LEVEL2), self->metrics.flush_duration_key,
+                               &self->metrics.flush_duration);
+
+      stats_latency_tracker_set_keys(&self->metrics.latency, kb);
+      stats_latency_tracker_register(&self->metrics.latency, level);
     }
     stats_unlock();
   }
@@ -952,6 +968,16 @@ _unregister_worker_stats(LogThreadedDestWorker *self)
         stats_cluster_key_free(self->metrics.message_delay_sample_age_key);
         self->metrics.message_delay_sample_age_key = NULL;
       }
+
+    if (self->metrics.flush_duration_key)
+      {
+        stats_unregister_histogram(self->metrics.flush_duration_key, &self->metrics.flush_duration);
+        stats_cluster_key_free(self->metrics.flush_duration_key);
+        self->metrics.flush_duration_key = NULL;
+      }
+
+    stats_latency_tracker_unregister(&self->metrics.latency);
+    stats_latency_tracker_clear(&self->metrics.latency);
   }
   stats_unlock();
 
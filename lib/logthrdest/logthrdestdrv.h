@@ -31,6 +31,8 @@
 #include "stats/aggregator/stats-aggregator.h"
 #include "stats/stats-compat.h"
 #include "stats/stats-cluster-key-builder.h"
+#include "stats/stats-cluster-histogram.h"
+#include "stats/stats-latency.h"
 #include "logqueue.h"
 #include "seqnum.h"
 #include "mainloop-threaded-worker.h"
@@ -110,11 +112,14 @@ struct _LogThreadedDestWorker
     StatsClusterKey *output_unreachable_key;
     StatsClusterKey *message_delay_sample_key;
     StatsClusterKey *message_delay_sample_age_key;
+    StatsClusterKey *flush_duration_key;
 
     StatsByteCounter written_bytes;
     StatsCounterItem *output_unreachable;
     StatsCounterItem *message_delay_sample;
     StatsCounterItem *message_delay_sample_age;
+    StatsHistogram *flush_duration;
+    StatsLatencyTracker latency;
 
     gint64 last_delay_update;
   } metrics;
@@ -276,7 +281,19 @@ log_threaded_dest_worker_flush(LogThreadedDestWorker *self, LogThreadedFlushMode
   LogThreadedResult result = LTR_SUCCESS;
 
   if (self->flush)
-    result = self->flush(self, mode);
+    {
+      /* empty flushes are not measured, they would skew the distribution */
+      if (self->metrics.flush_duration && self->batch_size > 0)
+        {
+          gint64 start = g_get_monotonic_time();
+          result = self->flush(self, mode);
+          stats_histogram_observe(self->metrics.flush_duration, g_get_monotonic_time() - start);
+        }
+      else
+        {
+          result = self->flush(self, mode);
+        }
+    }
   iv_validate_now();
   self->last_flush_time = iv_now;
   return result;
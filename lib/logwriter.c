@@ -27,6 +27,8 @@
 #include "stats/stats-registry.h"
 #include "stats/aggregator/stats-aggregator-registry.h"
 #include "stats/stats-cluster-single.h"
+#include "stats/stats-cluster-histogram.h"
+#include "stats/stats-latency.h"
 #include "stats/aggregator/stats-aggregator.h"
 #include "stats/stats-compat.h"
 #include "hostname.h"
@@ -91,6 +93,9 @@ struct _LogWriter
     StatsCounterItem *message_delay;
     StatsClusterKey *message_delay_sample_age_key;
     StatsCounterItem *message_delay_sample_age;
+    StatsClusterKey *flush_duration_key;
+    StatsHistogram *flush_duration;
+    StatsLatencyTracker latency;
 
     struct
     {
@@ -168,12 +173,14 @@ log_writer_msg_ack(gint num_msg_acked, gpointer user_data)
 {
   LogWriter *self = (LogWriter *)user_data;
   log_queue_ack_backlog(self->queue, num_msg_acked);
+  stats_latency_tracker_ack(&self->metrics.latency, num_msg_acked);
 }
 
 void
 log_writer_msg_rewind(LogWriter *self)
 {
   log_queue_rewind_backlog_all(self->queue);
+  stats_latency_tracker_rewind_all(&self->metrics.latency);
 }
 
 static void
@@ -1229,6 +1236,7 @@ log_writer_write_message(LogWriter *self, LogMessage *msg, LogPathOptions *path_
     }
 
   gsize msg_len = 0;
+  gboolean posted = FALSE;
   if (self->line_buffer->len)
     {
       msg_len = self->line_buffer->len;
@@ -1238,8 +1246,15 @@ log_writer_write_message(LogWriter *self, LogMessage *msg, LogPathOptions *path_
 
       self->partial_write = (status == LPS_PARTIAL);
 
-      if (consumed)
-        log_writer_realloc_line_buffer(self);
+      /* the proto acknowledges exactly the messages it has consumed, the
+       * latency tracker has to see the same sequence: messages skipped or
+       * dropped here are never acknowledged */
+      posted = consumed;
+      if (posted)
+        {
+          stats_latency_tracker_track(&self->metrics.latency, &msg->timestamps[LM_TS_RECVD], status != LPS_ERROR);
+          log_writer_realloc_line_buffer(self);
+        }
 
       if (status == LPS_ERROR)
         {
@@ -1284,6 +1299,8 @@ log_writer_write_message(LogWriter *self, LogMessage *msg, LogPathOptions *path_
                 evt_tag_printf("message", "%s", self->line_buffer->str));
 
       log_queue_rewind_backlog(self->queue, 1);
+      if (posted)
+        stats_latency_tracker_rewind(&self->metrics.latency, 1);
 
       log_msg_unref(msg);
       msg_set_context(NULL);
@@ -1326,7 +1343,7 @@ log_writer_process_handshake(LogWriter *self)
  *
  */
 static gboolean
-log_writer_flush(LogWriter *self, LogWriterFlushMode flush_mode)
+_flush(LogWriter *self, LogWriterFlushMode flush_mode)
 {
   gboolean write_error = FALSE;
 
@@ -1368,6 +1385,21 @@ log_writer_flush(LogWriter *self, LogWriterFlushMode flush_mode)
   return log_writer_flush_finalize(self);
 }
 
+/* only flushes with something to write are measured, idle wakeups would
+ * skew the distribution */
+static gboolean
+log_writer_flush(LogWriter *self, LogWriterFlushMode flush_mode)
+{
+  if (!self->metrics.flush_duration || log_queue_is_empty_racy(self->queue))
+    return _flush(self, flush_mode);
+
+  gint64 start = g_get_monotonic_time();
+  gboolean result = _flush(self, flush_mode);
+  stats_histogram_observe(self->metrics.flush_duration, g_get_monotonic_time() - start);
+
+  return result;
+}
+
 static gboolean
 log_writer_forced_flush(LogWriter *self)
 {
@@ -1546,6 +1578,10 @@ _register_counters(LogWriter *self)
   unix_time_set_now(&now);
   stats_counter_set_time(self->metrics.message_delay_sample_age, now.ut_sec);
 
+  stats_register_histogram(MAX(level, STATS_LEVEL2), self->metrics.flush_duration_key,
+                           &self->metrics.flush_duration);
+  stats_latency_tracker_register(&self->metrics.latency, level);
+
   stats_unlock();
   _register_aggregated_stats(self, self->metrics.output_events_key, level, SC_TYPE_WRITTEN);
 
@@ -1610,6 +1646,8 @@ _unregister_counters(LogWriter *self)
     stats_unregister_counter(self->metrics.message_delay_key, SC_TYPE_SINGLE_VALUE, &self->metrics.message_delay);
     stats_unregister_counter(self->metrics.message_delay_sample_age_key, SC_TYPE_SINGLE_VALUE,
                              &self->metrics.message_delay_sample_age);
+    stats_unregister_histogram(self->metrics.flush_duration_key, &self->metrics.flush_duration);
+    stats_latency_tracker_unregister(&self->metrics.latency);
   }
   stats_unlock();
   _unregister_aggregated_stats(self);
@@ -1674,6 +1712,11 @@ log_writer_free(LogPipe *s)
   if (self->metrics.message_delay_sample_age_key)
     stats_cluster_key_free(self->metrics.message_delay_sample_age_key);
 
+  if (self->metrics.flush_duration_key)
+    stats_cluster_key_free(self->metrics.flush_duration_key);
+
+  stats_latency_tracker_clear(&self->metrics.latency);
+
   ml_batched_timer_free(&self->mark_timer);
   ml_batched_timer_free(&self->suppress_timer);
   g_mutex_clear(&self->suppress_lock);
@@ -1779,7 +1822,7 @@ log_writer_reopen_deferred(gpointer s)
 
   if (self->partial_write)
     {
-      log_queue_rewind_backlog_all(self->queue);
+      log_writer_msg_rewind(self);
     }
   log_writer_free_proto(self);
   log_writer_set_proto(self, proto);
@@ -1895,6 +1938,21 @@ _set_metric_options(LogWriter *self, const gchar *stats_id, StatsClusterKeyBuild
     self->metrics.message_delay_sample_age_key = stats_cluster_key_builder_build_single(self->metrics.stats_kb);
   }
   stats_cluster_key_builder_pop(self->metrics.stats_kb);
+
+  stats_cluster_key_builder_push(self->metrics.stats_kb);
+  {
+    stats_cluster_key_builder_add_label(self->metrics.stats_kb, stats_cluster_label("id", self->stats_id));
+
+    if (self->metrics.flush_duration_key)
+      stats_cluster_key_free(self->metrics.flush_duration_key);
+
+    stats_cluster_key_builder_set_name(self->metrics.stats_kb, "output_flush_duration_seconds");
+    stats_cluster_key_builder_set_unit(self->metrics.stats_kb, SCU_MICROSECONDS);
+    self->metrics.flush_duration_key = stats_cluster_key_builder_build_histogram(self->metrics.stats_kb);
+
+    stats_latency_tracker_set_keys(&self->metrics.latency, self->metrics.stats_kb);
+  }
+  stats_cluster_key_builder_pop(self->metrics.stats_kb);
 }
 
 void
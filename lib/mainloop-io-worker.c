@@ -138,6 +138,12 @@ __pre_pre_init_hook(gint type, gpointer user_data)
   main_loop_worker_allocate_thread_space(main_loop_io_workers.max_threads);
 }
 
+gint
+main_loop_io_worker_get_max_number_of_threads(void)
+{
+  return main_loop_io_workers.max_threads;
+}
+
 void
 main_loop_io_worker_init(void)
 {
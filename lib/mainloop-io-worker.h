@@ -47,6 +47,7 @@ gboolean main_loop_io_worker_job_submit(MainLoopIOWorkerJob *self, gpointer arg)
 void main_loop_io_worker_job_submit_continuation(MainLoopIOWorkerJob *self, gpointer arg);
 #endif
 
+gint main_loop_io_worker_get_max_number_of_threads(void);
 void main_loop_io_worker_add_options(GOptionContext *ctx);
 
 void main_loop_io_worker_init(void);
@@ -150,6 +150,8 @@ struct _MainLoop
   struct iv_event exit_requested;
 
   struct iv_timer exit_timer;
+  struct iv_timer persist_sync_timer;
+  MainLoopIOWorkerJob persist_sync_job;
 
   /* Currently running configuration, should not be used outside the mainloop
    * logic. If anything needs access to the GlobalConfig instance at runtime,
@@ -186,6 +188,50 @@ main_loop_get_instance(void)
   return &main_loop;
 }
 
+static void
+_stop_persist_sync_timer(MainLoop *self)
+{
+  if (iv_timer_registered(&self->persist_sync_timer))
+    iv_timer_unregister(&self->persist_sync_timer);
+}
+
+static void
+_restart_persist_sync_timer(MainLoop *self)
+{
+  _stop_persist_sync_timer(self);
+
+  if (self->current_configuration->persist_sync_freq <= 0)
+    return;
+
+  iv_validate_now();
+  self->persist_sync_timer.expires = iv_now;
+  timespec_add_msec(&self->persist_sync_timer.expires, self->current_configuration->persist_sync_freq * 1000);
+  iv_timer_register(&self->persist_sync_timer);
+}
+
+/* NOTE: runs in an I/O worker thread, msync() blocks until the pages are
+ * written */
+static void
+_persist_sync_work(gpointer user_data, gpointer arg)
+{
+  persist_state_sync((PersistState *) arg);
+}
+
+/* persist state changes are flushed to disk in batches, every
+ * persist-sync-freq() seconds */
+static void
+_persist_sync_timer_elapsed(gpointer user_data)
+{
+  MainLoop *self = (MainLoop *) user_data;
+  GlobalConfig *cfg = self->current_configuration;
+
+  /* a sync still running covers this interval too */
+  if (cfg->state && !self->persist_sync_job.working)
+    main_loop_io_worker_job_submit(&self->persist_sync_job, cfg->state);
+
+  _restart_persist_sync_timer(self);
+}
+
 /* called when syslog-ng first starts up */
 gboolean
 main_loop_initialize_state(GlobalConfig *cfg, const gchar *persist_filename)
@@ -298,6 +344,7 @@ main_loop_reload_config_apply(gpointer user_data)
   self->new_config->persist = NULL;
   cfg_free(self->old_config);
   self->current_configuration = self->new_config;
+  _restart_persist_sync_timer(self);
   service_management_clear_status();
   msg_notice("Configuration reload request received, reloading configuration");
 
@@ -444,6 +491,7 @@ main_loop_exit_finish(gpointer user_data)
    * threads are running.  This will unregister ivykis tasks and timers
    * that could fire while the configuration is being destructed */
   cfg_deinit(self->current_configuration);
+  _stop_persist_sync_timer(self);
   iv_quit();
 }
 
@@ -651,6 +699,13 @@ main_loop_init(MainLoop *self, MainLoopOptions *options)
   main_loop_init_events(self);
   setup_signals(self);
 
+  IV_TIMER_INIT(&self->persist_sync_timer);
+  self->persist_sync_timer.handler = _persist_sync_timer_elapsed;
+  self->persist_sync_timer.cookie = self;
+  main_loop_io_worker_job_init(&self->persist_sync_job);
+  self->persist_sync_job.work = _persist_sync_work;
+  self->persist_sync_job.user_data = self;
+
   self->current_configuration = cfg_new(0);
 
   if (self->options->disable_module_discovery)
@@ -701,6 +756,7 @@ main_loop_read_and_init_config(MainLoop *self)
     {
       return 2;
     }
+  _restart_persist_sync_timer(self);
 
   self->control_server = control_init(resolved_configurable_paths.ctlfilename);
 
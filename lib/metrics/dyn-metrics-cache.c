@@ -61,7 +61,7 @@ _init_tls_cache(gpointer user_data)
 {
   g_assert(!metrics_cache);
 
-  metrics_cache = dyn_metrics_store_new();
+  metrics_cache = dyn_metrics_store_new_bounded();
 }
 
 static void
@@ -82,7 +82,7 @@ dyn_metrics_cache_global_init(void)
 {
   g_assert(!global_metrics_cache);
   g_mutex_init(&global_metrics_cache_lock);
-  global_metrics_cache = dyn_metrics_store_new();
+  global_metrics_cache = dyn_metrics_store_new_bounded();
 
   register_application_thread_init_hook(_init_tls_cache, NULL);
   register_application_thread_deinit_hook(_deinit_tls_cache, NULL);
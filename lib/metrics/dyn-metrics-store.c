@@ -29,36 +29,182 @@
 
 #include <string.h>
 
+typedef struct _DynMetricsStoreEntry
+{
+  StatsCluster *cluster;
+  /* link in the LRU list of the store, the most recently used is the head */
+  GList lru_link;
+  gint64 last_used;
+} DynMetricsStoreEntry;
+
 struct _DynMetricsStore
 {
   GHashTable *clusters;
+  GQueue lru;
+  /* metric name -> counter of the series that collects the samples
+   * refused by max-dynamics() */
+  GHashTable *overflow_counters;
   GArray *label_buffers;
+  /* whether dynamic-metrics-limit() and dynamic-metrics-idle-timeout() apply */
+  gboolean bounded;
 };
 
+static atomic_gssize dyn_metrics_evictions;
+
+/* registration only locks the shard of the key, not the whole registry */
 static StatsCluster *
-_register_single_cluster_locked(StatsClusterKey *key, gint stats_level)
+_register_single_cluster(StatsClusterKey *key, gint stats_level)
 {
-  StatsCluster *cluster;
+  StatsCounterItem *counter;
+
+  return stats_register_dynamic_counter(stats_level, key, SC_TYPE_SINGLE_VALUE, &counter);
+}
+
+static void
+_unregister_single_cluster(StatsCluster *cluster)
+{
+  StatsCounterItem *counter = stats_cluster_single_get_counter(cluster);
+  stats_unregister_dynamic_counter(cluster, SC_TYPE_SINGLE_VALUE, &counter);
+}
+
+static void
+_overflow_key_set(StatsClusterKey *key, const gchar *name, StatsClusterLabel *overflow_label)
+{
+  *overflow_label = stats_cluster_label("overflow", "true");
+  stats_cluster_single_key_set(key, name, overflow_label, 1);
+}
+
+static void
+_unregister_overflow_counter(gpointer name, gpointer counter, gpointer user_data)
+{
+  StatsClusterKey sc_key;
+  StatsClusterLabel overflow_label;
+  StatsCounterItem *overflow_counter = counter;
+
+  _overflow_key_set(&sc_key, name, &overflow_label);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &overflow_counter);
+}
+
+static void
+_unregister_overflow_counters(DynMetricsStore *self)
+{
+  g_hash_table_foreach(self->overflow_counters, _unregister_overflow_counter, NULL);
+  g_hash_table_remove_all(self->overflow_counters);
+}
+
+/*
+ * Once max-dynamics() is reached, new series are refused by the registry.
+ * Instead of silently dropping them, their samples are collected into a
+ * static series of the same name, labeled with overflow="true", so the
+ * lost cardinality remains visible.
+ */
+static StatsCounterItem *
+_retrieve_overflow_counter(DynMetricsStore *self, StatsClusterKey *key, gint level)
+{
+  if (!key->name)
+    return NULL;
+
+  StatsCounterItem *counter = g_hash_table_lookup(self->overflow_counters, key->name);
+  if (counter)
+    return counter;
+
+  StatsClusterKey sc_key;
+  StatsClusterLabel overflow_label;
+  _overflow_key_set(&sc_key, key->name, &overflow_label);
+
+  stats_register_counter(level, &sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+
+  if (counter)
+    g_hash_table_insert(self->overflow_counters, g_strdup(key->name), counter);
+  return counter;
+}
+
+static void
+_entry_free(DynMetricsStoreEntry *entry)
+{
+  _unregister_single_cluster(entry->cluster);
+  g_free(entry);
+}
+
+static gint
+_idle_timeout(DynMetricsStore *self)
+{
+  return self->bounded ? stats_dynamic_metrics_idle_timeout() : 0;
+}
+
+static gint
+_limit(DynMetricsStore *self)
+{
+  return self->bounded ? stats_dynamic_metrics_limit() : 0;
+}
+
+static gint64
+_now(DynMetricsStore *self)
+{
+  /* last_used is only maintained if idle eviction is enabled */
+  if (_idle_timeout(self) <= 0)
+    return 0;
+  return g_get_monotonic_time();
+}
 
-  stats_lock();
-  {
-    StatsCounterItem *counter;
-    cluster = stats_register_dynamic_counter(stats_level, key, SC_TYPE_SINGLE_VALUE, &counter);
-  }
-  stats_unlock();
+static void
+_touch_entry(DynMetricsStore *self, DynMetricsStoreEntry *entry, gint64 now)
+{
+  entry->last_used = now;
+  if (self->lru.head == &entry->lru_link)
+    return;
+
+  g_queue_unlink(&self->lru, &entry->lru_link);
+  g_queue_push_head_link(&self->lru, &entry->lru_link);
+}
+
+static void
+_insert_entry(DynMetricsStore *self, StatsCluster *cluster, gint64 now)
+{
+  DynMetricsStoreEntry *entry = g_new0(DynMetricsStoreEntry, 1);
+
+  entry->cluster = cluster;
+  entry->lru_link.data = entry;
+  entry->last_used = now;
+  g_queue_push_head_link(&self->lru, &entry->lru_link);
+  g_hash_table_insert(self->clusters, &cluster->key, entry);
+}
+
+/* the cluster becomes orphaned and is pruned once its lifetime() expires */
+static void
+_evict_entry(DynMetricsStore *self, DynMetricsStoreEntry *entry)
+{
+  g_queue_unlink(&self->lru, &entry->lru_link);
+  g_hash_table_remove(self->clusters, &entry->cluster->key);
+  atomic_gssize_inc(&dyn_metrics_evictions);
+}
+
+static void
+_evict_idle_entries(DynMetricsStore *self, gint64 now)
+{
+  gint idle_timeout = _idle_timeout(self);
+  if (idle_timeout <= 0)
+    return;
 
-  return cluster;
+  gint64 idle_since = now - (gint64) idle_timeout * G_USEC_PER_SEC;
+  while (self->lru.tail)
+    {
+      DynMetricsStoreEntry *entry = self->lru.tail->data;
+      if (entry->last_used > idle_since)
+        break;
+      _evict_entry(self, entry);
+    }
 }
 
 static void
-_unregister_single_cluster_locked(StatsCluster *cluster)
+_evict_to_make_room(DynMetricsStore *self)
 {
-  stats_lock();
-  {
-    StatsCounterItem *counter = stats_cluster_single_get_counter(cluster);
-    stats_unregister_dynamic_counter(cluster, SC_TYPE_SINGLE_VALUE, &counter);
-  }
-  stats_unlock();
+  gint limit = _limit(self);
+  if (limit <= 0)
+    return;
+
+  while (self->lru.tail && self->lru.length >= limit)
+    _evict_entry(self, self->lru.tail->data);
 }
 
 DynMetricsStore *
@@ -69,16 +215,30 @@ dyn_metrics_store_new(void)
   self->clusters = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
                                          (GEqualFunc) stats_cluster_key_equal,
                                          NULL,
-                                         (GDestroyNotify) _unregister_single_cluster_locked);
+                                         (GDestroyNotify) _entry_free);
+  g_queue_init(&self->lru);
+  self->overflow_counters = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
   self->label_buffers = g_array_new(FALSE, FALSE, sizeof(StatsClusterLabel));
 
   return self;
 }
 
+DynMetricsStore *
+dyn_metrics_store_new_bounded(void)
+{
+  DynMetricsStore *self = dyn_metrics_store_new();
+
+  self->bounded = TRUE;
+  return self;
+}
+
 void
 dyn_metrics_store_free(DynMetricsStore *self)
 {
+  g_queue_init(&self->lru);
   g_hash_table_destroy(self->clusters);
+  _unregister_overflow_counters(self);
+  g_hash_table_destroy(self->overflow_counters);
   g_array_free(self->label_buffers, TRUE);
   g_free(self);
 }
@@ -86,43 +246,98 @@ dyn_metrics_store_free(DynMetricsStore *self)
 StatsCounterItem *
 dyn_metrics_store_retrieve_counter(DynMetricsStore *self, StatsClusterKey *key, gint level)
 {
-  StatsCluster *cluster = g_hash_table_lookup(self->clusters, key);
-  if (!cluster)
+  gint64 now = _now(self);
+  _evict_idle_entries(self, now);
+
+  DynMetricsStoreEntry *entry = g_hash_table_lookup(self->clusters, key);
+  if (entry)
     {
-      cluster = _register_single_cluster_locked(key, level);
-      if (cluster)
-        g_hash_table_insert(self->clusters, &cluster->key, cluster);
+      _touch_entry(self, entry, now);
+      return stats_cluster_single_get_counter(entry->cluster);
     }
 
+  if (!stats_check_level(level))
+    return NULL;
+
+  _evict_to_make_room(self);
+
+  StatsCluster *cluster = _register_single_cluster(key, level);
+  if (!cluster)
+    return _retrieve_overflow_counter(self, key, level);
+
+  _insert_entry(self, cluster, now);
   return stats_cluster_single_get_counter(cluster);
 }
 
 gboolean
 dyn_metrics_store_remove_counter(DynMetricsStore *self, StatsClusterKey *key)
 {
+  DynMetricsStoreEntry *entry = g_hash_table_lookup(self->clusters, key);
+  if (!entry)
+    return FALSE;
+
+  g_queue_unlink(&self->lru, &entry->lru_link);
   return g_hash_table_remove(self->clusters, key);
 }
 
 void
 dyn_metrics_store_reset(DynMetricsStore *self)
 {
+  g_queue_init(&self->lru);
   g_hash_table_remove_all(self->clusters);
+  _unregister_overflow_counters(self);
+}
+
+guint
+dyn_metrics_store_get_size(DynMetricsStore *self)
+{
+  return self->lru.length;
 }
 
 void
 dyn_metrics_store_merge(DynMetricsStore *self, DynMetricsStore *other)
 {
-  GHashTableIter iter;
-  g_hash_table_iter_init(&iter, other->clusters);
+  gint64 now = _now(self);
 
-  gpointer key, value;
-  while (g_hash_table_iter_next(&iter, &key, &value))
+  /* oldest first, so that the recency order of other is preserved */
+  for (GList *l = other->lru.tail; l; l = l->prev)
     {
-      stats_cluster_track_counter(value, SC_TYPE_SINGLE_VALUE);
-      g_hash_table_insert(self->clusters, key, value);
+      DynMetricsStoreEntry *other_entry = l->data;
+      DynMetricsStoreEntry *entry = g_hash_table_lookup(self->clusters, &other_entry->cluster->key);
+      if (entry)
+        {
+          _touch_entry(self, entry, now);
+          continue;
+        }
+
+      _evict_to_make_room(self);
+
+      StatsCluster *cluster = other_entry->cluster;
+      stats_lock_cluster(cluster);
+      stats_cluster_track_counter(cluster, SC_TYPE_SINGLE_VALUE);
+      stats_unlock_cluster(cluster);
+      _insert_entry(self, cluster, now);
     }
 }
 
+void
+dyn_metrics_store_global_init(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_cluster_single_key_set(&sc_key, "dynamic_metrics_evictions_total", NULL, 0);
+  stats_register_external_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &dyn_metrics_evictions);
+}
+
+void
+dyn_metrics_store_global_deinit(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_cluster_single_key_set(&sc_key, "dynamic_metrics_evictions_total", NULL, 0);
+  stats_unregister_external_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &dyn_metrics_evictions);
+}
+
 void
 dyn_metrics_store_reset_labels_cache(DynMetricsStore *self)
 {
@@ -44,6 +44,20 @@
  *
  * It also grants a label cache for performance optimization needs.
  *
+ * The cardinality of a bounded store (dyn_metrics_store_new_bounded(),
+ * used for the user-facing metrics of metrics-probe and update_metric()) is
+ * limited by stats(dynamic-metrics-limit()), the least recently used
+ * counters are evicted to make room for new ones. Counters not used for
+ * stats(dynamic-metrics-idle-timeout()) seconds are evicted as well. Both
+ * are disabled when set to 0. Evicted counters become orphaned, they are
+ * removed once their lifetime() expires, or are picked up again if they are
+ * retrieved again before that. As any retrieval may evict, a counter
+ * obtained from a bounded store must not be kept beyond the processing of
+ * the current message. Stores created by dyn_metrics_store_new() never
+ * evict, their counters stay valid until removed or until the store is
+ * reset. Counters refused by max-dynamics() are collected into a series of
+ * the same name with an overflow="true" label.
+ *
  * Note: The store is NOT thread safe, make sure to eliminate
  * concurrency on the call site. If you need a cache that is purged only
  * during reload, use metrics/dyn-metrics-cache.h.
@@ -52,12 +66,17 @@
 
 typedef struct _DynMetricsStore DynMetricsStore;
 
+void dyn_metrics_store_global_init(void);
+void dyn_metrics_store_global_deinit(void);
+
 DynMetricsStore *dyn_metrics_store_new(void);
+DynMetricsStore *dyn_metrics_store_new_bounded(void);
 void dyn_metrics_store_free(DynMetricsStore *self);
 
 StatsCounterItem *dyn_metrics_store_retrieve_counter(DynMetricsStore *self, StatsClusterKey *key, gint level);
 gboolean dyn_metrics_store_remove_counter(DynMetricsStore *self, StatsClusterKey *key);
 void dyn_metrics_store_reset(DynMetricsStore *self);
+guint dyn_metrics_store_get_size(DynMetricsStore *self);
 void dyn_metrics_store_merge(DynMetricsStore *self, DynMetricsStore *other);
 
 void dyn_metrics_store_reset_labels_cache(DynMetricsStore *self);
@@ -24,10 +24,12 @@
 
 #include "metrics.h"
 #include "dyn-metrics-cache.h"
+#include "dyn-metrics-store.h"
 
 void
 metrics_global_init(void)
 {
+  dyn_metrics_store_global_init();
   dyn_metrics_cache_global_init();
 }
 
@@ -35,4 +37,5 @@ void
 metrics_global_deinit(void)
 {
   dyn_metrics_cache_global_deinit();
+  dyn_metrics_store_global_deinit();
 }
@@ -40,9 +40,11 @@ multi_line_factory_construct(const MultiLineOptions *options)
     case MLM_INDENTED:
       return indented_multi_line_new();
     case MLM_REGEXP_PREFIX_GARBAGE:
-      return regexp_multi_line_new(RML_PREFIX_GARBAGE, options->regexp.prefix, options->regexp.garbage);
+      return regexp_multi_line_new(RML_PREFIX_GARBAGE, options->regexp.prefix, options->regexp.garbage,
+                                   options->regexp.garbage_or_prefix);
     case MLM_REGEXP_PREFIX_SUFFIX:
-      return regexp_multi_line_new(RML_PREFIX_SUFFIX, options->regexp.prefix, options->regexp.garbage);
+      return regexp_multi_line_new(RML_PREFIX_SUFFIX, options->regexp.prefix, options->regexp.garbage,
+                                   options->regexp.garbage_or_prefix);
     case MLM_SMART:
       return smart_multi_line_new();
     case MLM_NONE:
@@ -123,14 +125,34 @@ multi_line_options_copy(MultiLineOptions *dest, MultiLineOptions *source)
     {
       dest->regexp.prefix = multi_line_pattern_ref(source->regexp.prefix);
       dest->regexp.garbage = multi_line_pattern_ref(source->regexp.garbage);
+      dest->regexp.garbage_or_prefix = multi_line_pattern_ref(source->regexp.garbage_or_prefix);
     }
 }
 
+/* continuation lines are checked against both garbage and prefix, do it in a
+ * single match if both are anchored */
+static void
+_combine_garbage_and_prefix(MultiLineOptions *options)
+{
+  multi_line_pattern_unref(options->regexp.garbage_or_prefix);
+  options->regexp.garbage_or_prefix = NULL;
+
+  if (!options->regexp.prefix || !options->regexp.garbage)
+    return;
+
+  MultiLinePattern *alternatives[] = { options->regexp.garbage, options->regexp.prefix };
+  options->regexp.garbage_or_prefix = multi_line_pattern_compile_alternatives(alternatives,
+                                      G_N_ELEMENTS(alternatives));
+}
+
 gboolean
 multi_line_options_init(MultiLineOptions *options)
 {
   if (!multi_line_options_validate(options))
     return FALSE;
+
+  if (options->mode == MLM_REGEXP_PREFIX_GARBAGE || options->mode == MLM_REGEXP_PREFIX_SUFFIX)
+    _combine_garbage_and_prefix(options);
   return TRUE;
 }
 
@@ -139,6 +161,7 @@ multi_line_options_destroy(MultiLineOptions *options)
 {
   multi_line_pattern_unref(options->regexp.prefix);
   multi_line_pattern_unref(options->regexp.garbage);
+  multi_line_pattern_unref(options->regexp.garbage_or_prefix);
 }
 
 void
@@ -46,6 +46,7 @@ typedef struct _MultiLineOptions
     {
       MultiLinePattern *prefix;
       MultiLinePattern *garbage;
+      MultiLinePattern *garbage_or_prefix;
     } regexp;
   };
 } MultiLineOptions;
@@ -24,8 +24,10 @@
 #include "multi-line/multi-line-pattern.h"
 #include "messages.h"
 
-MultiLinePattern *
-multi_line_pattern_compile(const gchar *regexp, GError **error)
+#include <stdlib.h>
+
+static MultiLinePattern *
+_compile(const gchar *regexp, guint32 options, GError **error)
 {
   MultiLinePattern *self = g_new0(MultiLinePattern, 1);
   gint rc;
@@ -35,7 +37,7 @@ multi_line_pattern_compile(const gchar *regexp, GError **error)
   self->ref_cnt = 1;
 
   /* compile the regexp */
-  self->pattern = pcre2_compile((PCRE2_SPTR) regexp, PCRE2_ZERO_TERMINATED, 0, &rc, &erroffset, NULL);
+  self->pattern = pcre2_compile((PCRE2_SPTR) regexp, PCRE2_ZERO_TERMINATED, options, &rc, &erroffset, NULL);
   if (!self->pattern)
     {
       PCRE2_UCHAR error_message[128];
@@ -46,6 +48,7 @@ multi_line_pattern_compile(const gchar *regexp, GError **error)
                   (gchar *) error_message, erroffset);
       goto error;
     }
+  self->regexp = g_strdup(regexp);
 
   /* optimize regexp */
   rc = pcre2_jit_compile(self->pattern, PCRE2_JIT_COMPLETE);
@@ -67,59 +70,147 @@ error:
   return NULL;
 }
 
+MultiLinePattern *
+multi_line_pattern_compile(const gchar *regexp, GError **error)
+{
+  return _compile(regexp, 0, error);
+}
+
+static gboolean
+_can_be_combined(MultiLinePattern *re)
+{
+  guint32 backref_max = 0;
+
+  /* numbered back references would point to the wrong group in the combined pattern */
+  pcre2_pattern_info(re->pattern, PCRE2_INFO_BACKREFMAX, &backref_max);
+  return backref_max == 0 && multi_line_pattern_is_anchored(re);
+}
+
+/* TRUE if the pattern can only match at the start of the subject (^, \A) */
+gboolean
+multi_line_pattern_is_anchored(MultiLinePattern *re)
+{
+  guint32 options = 0;
+
+  pcre2_pattern_info(re->pattern, PCRE2_INFO_ALLOPTIONS, &options);
+  return (options & PCRE2_ANCHORED) != 0;
+}
+
+/* Combine anchored @patterns into a single one that is evaluated by one
+ * pcre2_match() call.  As every alternative can only match at the start
+ * of the subject, they are tried in order at that single position, so the
+ * first pattern in order that matches wins, just as if they were matched
+ * one by one.  The index of the winning pattern is reported via (*MARK).
+ *
+ * Unanchored patterns are not combined: they would need a leading .*? to
+ * be able to match anywhere while keeping the order of the alternatives,
+ * which would defeat the start-of-match optimizations of PCRE2 (first code
+ * unit, start bitmap) that make matching them one by one cheap.
+ *
+ * Returns NULL if the patterns cannot be combined, the caller is expected
+ * to fall back to matching them one by one. */
+MultiLinePattern *
+multi_line_pattern_compile_alternatives(MultiLinePattern **patterns, gint num_patterns)
+{
+  GString *combined = g_string_new("");
+
+  for (gint i = 0; i < num_patterns; i++)
+    {
+      if (!patterns[i] || !_can_be_combined(patterns[i]))
+        {
+          g_string_free(combined, TRUE);
+          return NULL;
+        }
+
+      if (i > 0)
+        g_string_append_c(combined, '|');
+      g_string_append_printf(combined, "(*MARK:%d)(?:%s)", i, patterns[i]->regexp);
+    }
+
+  GError *error = NULL;
+  MultiLinePattern *self = _compile(combined->str, PCRE2_ANCHORED, &error);
+  if (!self)
+    {
+      msg_debug("multi-line-pattern: unable to combine patterns, matching them one by one",
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+    }
+
+  g_string_free(combined, TRUE);
+  return self;
+}
+
 gint
 multi_line_pattern_eval(MultiLinePattern *re, const guchar *str, gsize len, pcre2_match_data *match_data)
 {
   return pcre2_match(re->pattern, (PCRE2_SPTR) str, (PCRE2_SIZE) len, 0, 0, match_data, NULL);
 }
 
+/* Returns the index of the first alternative that matches or -1 */
+gint
+multi_line_pattern_find_alternative(MultiLinePattern *re, pcre2_match_data *match_data,
+                                    const guchar *str, gsize len, gint *start, gint *end)
+{
+  if (multi_line_pattern_eval(re, str, len, match_data) < 0)
+    return -1;
+
+  PCRE2_SPTR mark = pcre2_get_mark(match_data);
+  g_assert(mark);
+
+  if (start || end)
+    {
+      PCRE2_SIZE *matches = pcre2_get_ovector_pointer(match_data);
+
+      if (start)
+        *start = matches[0];
+      if (end)
+        *end = matches[1];
+    }
+  return strtol((const gchar *) mark, NULL, 10);
+}
+
 gboolean
-multi_line_pattern_find(MultiLinePattern *re, const guchar *str, gsize len, gint *start, gint *end)
+multi_line_pattern_find(MultiLinePattern *re, pcre2_match_data *match_data, const guchar *str, gsize len,
+                        gint *start, gint *end)
 {
   if (!re)
     return FALSE;
 
-  gboolean result = FALSE;
-  pcre2_match_data *match_data = pcre2_match_data_create_from_pattern(re->pattern, NULL);
-
-
   if (multi_line_pattern_eval(re, str, len, match_data) < 0)
-    goto exit;
+    return FALSE;
 
   guint32 num_matches = pcre2_get_ovector_count(match_data);
   PCRE2_SIZE *matches = pcre2_get_ovector_pointer(match_data);
 
   if (num_matches == 0)
-    goto exit;
+    return FALSE;
 
   *start = matches[0];
   *end = matches[1];
-  result = TRUE;
-exit:
-  pcre2_match_data_free(match_data);
-  return result;
+  return TRUE;
 }
 
 gboolean
-multi_line_pattern_match(MultiLinePattern *re, const guchar *str, gsize len)
+multi_line_pattern_match(MultiLinePattern *re, pcre2_match_data *match_data, const guchar *str, gsize len)
 {
   if (!re)
     return FALSE;
 
-  gboolean result = FALSE;
-  pcre2_match_data *match_data = pcre2_match_data_create_from_pattern(re->pattern, NULL);
-
   if (multi_line_pattern_eval(re, str, len, match_data) < 0)
-    goto exit;
+    return FALSE;
 
   guint32 num_matches = pcre2_get_ovector_count(match_data);
   PCRE2_SIZE *matches = pcre2_get_ovector_pointer(match_data);
 
-  result = num_matches > 0 && matches[0] >= 0;
+  return num_matches > 0 && matches[0] >= 0;
+}
 
-exit:
-  pcre2_match_data_free(match_data);
-  return result;
+/* only the overall match is used, a single ovector pair is enough for
+ * any pattern, allocate it once per user instead of once per line */
+pcre2_match_data *
+multi_line_pattern_match_data_new(void)
+{
+  return pcre2_match_data_create(1, NULL);
 }
 
 MultiLinePattern *
@@ -137,6 +228,7 @@ multi_line_pattern_unref(MultiLinePattern *self)
     {
       if (self->pattern)
         pcre2_code_free(self->pattern);
+      g_free(self->regexp);
       g_free(self);
     }
 }
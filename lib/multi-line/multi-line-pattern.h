@@ -34,11 +34,18 @@ struct _MultiLinePattern
 {
   gint ref_cnt;
   pcre2_code *pattern;
+  gchar *regexp;
 };
 
-gboolean multi_line_pattern_find(MultiLinePattern *re, const guchar *str, gsize len, gint *start, gint *end);
-gboolean multi_line_pattern_match(MultiLinePattern *re, const guchar *str, gsize len);
+gboolean multi_line_pattern_find(MultiLinePattern *re, pcre2_match_data *match_data, const guchar *str, gsize len,
+                                 gint *start, gint *end);
+gboolean multi_line_pattern_match(MultiLinePattern *re, pcre2_match_data *match_data, const guchar *str, gsize len);
+pcre2_match_data *multi_line_pattern_match_data_new(void);
+gboolean multi_line_pattern_is_anchored(MultiLinePattern *re);
 MultiLinePattern *multi_line_pattern_compile(const gchar *regexp, GError **error);
+MultiLinePattern *multi_line_pattern_compile_alternatives(MultiLinePattern **patterns, gint num_patterns);
+gint multi_line_pattern_find_alternative(MultiLinePattern *re, pcre2_match_data *match_data,
+                                         const guchar *str, gsize len, gint *start, gint *end);
 MultiLinePattern *multi_line_pattern_ref(MultiLinePattern *self);
 void multi_line_pattern_unref(MultiLinePattern *self);
 
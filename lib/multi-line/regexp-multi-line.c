@@ -29,7 +29,7 @@ _prefix_garbage_get_offset_of_garbage(RegexpMultiLine *self, const guchar *line,
 {
   gint start, end;
 
-  if (!multi_line_pattern_find(self->garbage, line, line_len, &start, &end))
+  if (!multi_line_pattern_find(self->garbage, self->match_data, line, line_len, &start, &end))
     return -1;
   return start;
 }
@@ -39,7 +39,7 @@ _prefix_suffix_get_offset_of_garbage(RegexpMultiLine *self, const guchar *line,
 {
   gint start, end;
 
-  if (!multi_line_pattern_find(self->garbage, line, line_len, &start, &end))
+  if (!multi_line_pattern_find(self->garbage, self->match_data, line, line_len, &start, &end))
     return -1;
   return end;
 }
@@ -66,15 +66,36 @@ _accumulate_initial_line(RegexpMultiLine *self,
 
 }
 
+static gint
+_accumulate_continuation_line_combined(RegexpMultiLine *self,
+                                       const guchar *line,
+                                       gsize line_len)
+{
+  gint start, end;
+
+  switch (multi_line_pattern_find_alternative(self->garbage_or_prefix, self->match_data, line, line_len, &start, &end))
+    {
+    case 0:
+      return MLL_CONSUME_PARTIALLY(line_len - (self->mode == RML_PREFIX_GARBAGE ? start : end)) | MLL_EXTRACTED;
+    case 1:
+      return MLL_REWIND_SEGMENT | MLL_EXTRACTED;
+    default:
+      return MLL_CONSUME_SEGMENT | MLL_WAITING;
+    }
+}
+
 static gint
 _accumulate_continuation_line(RegexpMultiLine *self,
                               const guchar *line,
                               gsize line_len)
 {
+  if (self->garbage_or_prefix)
+    return _accumulate_continuation_line_combined(self, line, line_len);
+
   gint offset_of_garbage = _get_offset_of_garbage(self, line, line_len);
   if (offset_of_garbage >= 0)
     return MLL_CONSUME_PARTIALLY(line_len - offset_of_garbage) | MLL_EXTRACTED;
-  else if (multi_line_pattern_match(self->prefix, line, line_len))
+  else if (multi_line_pattern_match(self->prefix, self->match_data, line, line_len))
     return MLL_REWIND_SEGMENT | MLL_EXTRACTED;
   else
     return MLL_CONSUME_SEGMENT | MLL_WAITING;
@@ -105,11 +126,14 @@ regexp_multi_line_free(MultiLineLogic *s)
 
   multi_line_pattern_unref(self->prefix);
   multi_line_pattern_unref(self->garbage);
+  multi_line_pattern_unref(self->garbage_or_prefix);
+  pcre2_match_data_free(self->match_data);
   multi_line_logic_free_method(s);
 }
 
 MultiLineLogic *
-regexp_multi_line_new(gint mode, MultiLinePattern *prefix, MultiLinePattern *garbage_or_suffix)
+regexp_multi_line_new(gint mode, MultiLinePattern *prefix, MultiLinePattern *garbage_or_suffix,
+                      MultiLinePattern *garbage_or_prefix)
 {
   RegexpMultiLine *self = g_new0(RegexpMultiLine, 1);
 
@@ -119,5 +143,7 @@ regexp_multi_line_new(gint mode, MultiLinePattern *prefix, MultiLinePattern *gar
   self->mode = mode;
   self->prefix = multi_line_pattern_ref(prefix);
   self->garbage = multi_line_pattern_ref(garbage_or_suffix);
+  self->garbage_or_prefix = multi_line_pattern_ref(garbage_or_prefix);
+  self->match_data = multi_line_pattern_match_data_new();
   return &self->super;
 }
@@ -39,8 +39,12 @@ typedef struct _RegexpMultiLine
   } mode;
   MultiLinePattern *prefix;
   MultiLinePattern *garbage;
+  /* garbage and prefix combined, so a continuation line is matched only once */
+  MultiLinePattern *garbage_or_prefix;
+  pcre2_match_data *match_data;
 } RegexpMultiLine;
 
-MultiLineLogic *regexp_multi_line_new(gint mode, MultiLinePattern *prefix, MultiLinePattern *garbage_or_suffix);
+MultiLineLogic *regexp_multi_line_new(gint mode, MultiLinePattern *prefix, MultiLinePattern *garbage_or_suffix,
+                                      MultiLinePattern *garbage_or_prefix);
 
 #endif
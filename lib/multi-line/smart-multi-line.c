@@ -50,6 +50,7 @@ typedef struct _SmartMultiLine
   gboolean last_segment_rewound;
   gboolean rewound_segment_is_trace;
   gboolean consumed_message_is_trace;
+  pcre2_match_data *match_data;
 } SmartMultiLine;
 
 GHashTable *state_map;
@@ -57,6 +58,85 @@ gint last_state_id = SMLS_START_STATE;
 GArray *rules;
 GPtrArray *rules_by_from_state[64];
 
+/* Consecutive anchored rules of a state are combined into a single regexp
+ * (num_rules > 1), the rest are matched one by one (num_rules == 1) with
+ * their own pattern, see multi_line_pattern_compile_alternatives() */
+typedef struct _SmartMultiLineRuleGroup
+{
+  MultiLinePattern *pattern;
+  gint first_rule;
+  gint num_rules;
+} SmartMultiLineRuleGroup;
+
+GArray *rule_groups_by_from_state[G_N_ELEMENTS(rules_by_from_state)];
+
+static void
+_add_single_rule_groups(GArray *rule_groups, GPtrArray *applicable_rules, gint first_rule, gint num_rules)
+{
+  for (gint i = first_rule; i < first_rule + num_rules; i++)
+    {
+      SmartMultiLineRule *rule = g_ptr_array_index(applicable_rules, i);
+      SmartMultiLineRuleGroup group = { multi_line_pattern_ref(rule->compiled_regexp), i, 1 };
+
+      g_array_append_val(rule_groups, group);
+    }
+}
+
+static void
+_add_rule_group(GArray *rule_groups, GPtrArray *applicable_rules, gint first_rule, gint num_rules)
+{
+  if (num_rules < 2)
+    {
+      _add_single_rule_groups(rule_groups, applicable_rules, first_rule, num_rules);
+      return;
+    }
+
+  MultiLinePattern **patterns = g_new(MultiLinePattern *, num_rules);
+  for (gint i = 0; i < num_rules; i++)
+    {
+      SmartMultiLineRule *rule = g_ptr_array_index(applicable_rules, first_rule + i);
+      patterns[i] = rule->compiled_regexp;
+    }
+
+  SmartMultiLineRuleGroup group = { multi_line_pattern_compile_alternatives(patterns, num_rules), first_rule, num_rules };
+  g_free(patterns);
+
+  if (group.pattern)
+    g_array_append_val(rule_groups, group);
+  else
+    _add_single_rule_groups(rule_groups, applicable_rules, first_rule, num_rules);
+}
+
+static void
+_combine_rules_by_from_state(void)
+{
+  for (gint state_ndx = 0; state_ndx < G_N_ELEMENTS(rules_by_from_state); state_ndx++)
+    {
+      GPtrArray *applicable_rules = rules_by_from_state[state_ndx];
+
+      if (!applicable_rules)
+        continue;
+
+      GArray *rule_groups = g_array_new(FALSE, TRUE, sizeof(SmartMultiLineRuleGroup));
+      gint first_anchored = 0;
+
+      for (gint i = 0; i < applicable_rules->len; i++)
+        {
+          SmartMultiLineRule *rule = g_ptr_array_index(applicable_rules, i);
+
+          if (multi_line_pattern_is_anchored(rule->compiled_regexp))
+            continue;
+
+          _add_rule_group(rule_groups, applicable_rules, first_anchored, i - first_anchored);
+          _add_single_rule_groups(rule_groups, applicable_rules, i, 1);
+          first_anchored = i + 1;
+        }
+      _add_rule_group(rule_groups, applicable_rules, first_anchored, applicable_rules->len - first_anchored);
+
+      rule_groups_by_from_state[state_ndx] = rule_groups;
+    }
+}
+
 static void
 _reshuffle_rules_by_from_state(void)
 {
@@ -203,6 +283,7 @@ _load_rules(const gchar *sml_file_name)
   rules = g_array_new(FALSE, TRUE, sizeof(SmartMultiLineRule));
   _load_tsv_file(sml_file_name);
   _reshuffle_rules_by_from_state();
+  _combine_rules_by_from_state();
   if (state_map)
     {
       g_hash_table_unref(state_map);
@@ -222,6 +303,16 @@ _free_rules(void)
 {
   for (gint state_ndx = 0; state_ndx < G_N_ELEMENTS(rules_by_from_state); state_ndx++)
     {
+      if (rule_groups_by_from_state[state_ndx])
+        {
+          GArray *rule_groups = rule_groups_by_from_state[state_ndx];
+
+          for (gint i = 0; i < rule_groups->len; i++)
+            multi_line_pattern_unref(g_array_index(rule_groups, SmartMultiLineRuleGroup, i).pattern);
+          g_array_free(rule_groups, TRUE);
+          rule_groups_by_from_state[state_ndx] = NULL;
+        }
+
       if (rules_by_from_state[state_ndx])
         {
           g_ptr_array_free(rules_by_from_state[state_ndx], TRUE);
@@ -240,19 +331,43 @@ _free_rules(void)
   rules = NULL;
 }
 
+static SmartMultiLineRule *
+_find_matching_rule(SmartMultiLine *self, SmartMultiLineRuleGroup *group, GPtrArray *applicable_rules,
+                    const gchar *segment, gsize segment_len)
+{
+  if (group->num_rules == 1)
+    {
+      SmartMultiLineRule *rule = g_ptr_array_index(applicable_rules, group->first_rule);
+      gboolean match = multi_line_pattern_match(group->pattern, self->match_data, (const guchar *) segment, segment_len);
+
+      msg_trace_printf("smart-multi-line: Matching against pattern: %s in state %d, matched %d", rule->regexp,
+                       self->current_state, match);
+      return match ? rule : NULL;
+    }
+
+  gint rule_ndx = multi_line_pattern_find_alternative(group->pattern, self->match_data,
+                                                      (const guchar *) segment, segment_len, NULL, NULL);
+
+  msg_trace_printf("smart-multi-line: Matching against rules %d-%d combined in state %d, matched rule %d",
+                   group->first_rule, group->first_rule + group->num_rules - 1, self->current_state,
+                   rule_ndx < 0 ? rule_ndx : group->first_rule + rule_ndx);
+  if (rule_ndx < 0)
+    return NULL;
+  return g_ptr_array_index(applicable_rules, group->first_rule + rule_ndx);
+}
+
 gboolean
 _fsm_transition(SmartMultiLine *self, const gchar *segment, gsize segment_len)
 {
   GPtrArray *applicable_rules = rules_by_from_state[self->current_state];
+  GArray *rule_groups = rule_groups_by_from_state[self->current_state];
 
-  for (gint i = 0; applicable_rules && i < applicable_rules->len; i++)
+  for (gint i = 0; rule_groups && i < rule_groups->len; i++)
     {
-      SmartMultiLineRule *rule = g_ptr_array_index(applicable_rules, i);
-      gboolean match = multi_line_pattern_match(rule->compiled_regexp, (const guchar *) segment, segment_len);
+      SmartMultiLineRuleGroup *group = &g_array_index(rule_groups, SmartMultiLineRuleGroup, i);
+      SmartMultiLineRule *rule = _find_matching_rule(self, group, applicable_rules, segment, segment_len);
 
-      msg_trace_printf("smart-multi-line: Matching against pattern: %s in state %d, matched %d", rule->regexp,
-                       self->current_state, match);
-      if (match)
+      if (rule)
         {
           self->current_state = rule->to_state;
           /* the current segment is part of a sequence */
@@ -421,6 +536,7 @@ static void
 _free(MultiLineLogic *s)
 {
   SmartMultiLine *self = (SmartMultiLine *) s;
+  pcre2_match_data_free(self->match_data);
   g_mutex_clear(&self->lock);
   multi_line_logic_free_method(s);
 }
@@ -435,6 +551,7 @@ smart_multi_line_new(void)
   self->super.accumulate_line = _accumulate_line;
   self->last_segment_rewound = FALSE;
   self->current_state = SMLS_START_STATE;
+  self->match_data = multi_line_pattern_match_data_new();
   g_mutex_init(&self->lock);
 
   return &self->super;
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "multi-line/multi-line-pattern.h"
+#include "apphook.h"
+
+#define N_PATTERNS 8
+
+static MultiLinePattern *patterns[N_PATTERNS];
+static pcre2_match_data *match_data;
+
+static MultiLinePattern *
+_combine(const gchar *regexps[], gint num_regexps)
+{
+  cr_assert(num_regexps <= N_PATTERNS);
+  for (gint i = 0; i < num_regexps; i++)
+    {
+      patterns[i] = multi_line_pattern_compile(regexps[i], NULL);
+      cr_assert(patterns[i], "failed to compile: %s", regexps[i]);
+    }
+  return multi_line_pattern_compile_alternatives(patterns, num_regexps);
+}
+
+static gint
+_find(MultiLinePattern *combined, const gchar *line, gint *start, gint *end)
+{
+  return multi_line_pattern_find_alternative(combined, match_data, (const guchar *) line, strlen(line), start, end);
+}
+
+Test(multi_line_pattern, first_matching_alternative_wins)
+{
+  const gchar *regexps[] = { "^hello world", "^hello", "\\Afoo", "^hello there" };
+  MultiLinePattern *combined = _combine(regexps, G_N_ELEMENTS(regexps));
+  gint start, end;
+
+  cr_assert(combined);
+  cr_assert(multi_line_pattern_is_anchored(combined));
+
+  cr_assert_eq(_find(combined, "hello world", &start, &end), 0);
+  cr_assert_eq(start, 0);
+  cr_assert_eq(end, 11);
+
+  /* the longer match of a later alternative does not win */
+  cr_assert_eq(_find(combined, "hello there", &start, &end), 1);
+  cr_assert_eq(start, 0);
+  cr_assert_eq(end, 5);
+
+  cr_assert_eq(_find(combined, "foo bar", &start, &end), 2);
+  cr_assert_eq(_find(combined, "bar foo", &start, &end), -1);
+  cr_assert_eq(_find(combined, "say hello", &start, &end), -1);
+
+  multi_line_pattern_unref(combined);
+}
+
+Test(multi_line_pattern, top_level_alternations_are_kept_within_their_pattern)
+{
+  const gchar *regexps[] = { "^a|^b", "^c" };
+  MultiLinePattern *combined = _combine(regexps, G_N_ELEMENTS(regexps));
+
+  cr_assert(combined);
+  cr_assert_eq(_find(combined, "bxx", NULL, NULL), 0);
+  cr_assert_eq(_find(combined, "cab", NULL, NULL), 1);
+  cr_assert_eq(_find(combined, "xab", NULL, NULL), -1);
+
+  multi_line_pattern_unref(combined);
+}
+
+Test(multi_line_pattern, unanchored_patterns_are_not_combined)
+{
+  const gchar *regexps[] = { "^hello", "world" };
+
+  cr_assert_null(_combine(regexps, G_N_ELEMENTS(regexps)));
+}
+
+Test(multi_line_pattern, partially_anchored_alternations_are_not_combined)
+{
+  const gchar *regexps[] = { "^a|b", "^c" };
+
+  cr_assert_null(_combine(regexps, G_N_ELEMENTS(regexps)));
+}
+
+Test(multi_line_pattern, patterns_with_back_references_are_not_combined)
+{
+  const gchar *regexps[] = { "^(a)\\1", "^b" };
+
+  cr_assert_null(_combine(regexps, G_N_ELEMENTS(regexps)));
+}
+
+Test(multi_line_pattern, match_and_find_use_the_match_data_of_the_caller)
+{
+  MultiLinePattern *pattern = multi_line_pattern_compile("wor+ld", NULL);
+  gint start, end;
+
+  cr_assert(pattern);
+
+  cr_assert(multi_line_pattern_match(pattern, match_data, (const guchar *) "hello world", 11));
+  cr_assert(multi_line_pattern_find(pattern, match_data, (const guchar *) "hello world", 11, &start, &end));
+  cr_assert_eq(start, 6);
+  cr_assert_eq(end, 11);
+  cr_assert_not(multi_line_pattern_match(pattern, match_data, (const guchar *) "hello", 5));
+
+  multi_line_pattern_unref(pattern);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  match_data = multi_line_pattern_match_data_new();
+}
+
+static void
+teardown(void)
+{
+  for (gint i = 0; i < N_PATTERNS; i++)
+    {
+      multi_line_pattern_unref(patterns[i]);
+      patterns[i] = NULL;
+    }
+  pcre2_match_data_free(match_data);
+  app_shutdown();
+}
+
+TestSuite(multi_line_pattern, .init = setup, .fini = teardown);
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "multi-line/smart-multi-line.h"
+#include "multi-line/multi-line-pattern.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "reloc.h"
+#include "timeutils/misc.h"
+
+#include <stdio.h>
+
+#define NUM_ITERATIONS 2000
+
+/* excerpts of real-world application logs, stack traces interleaved with regular lines */
+static const gchar *corpus[] =
+{
+  "2024-03-11 12:01:22.001 INFO  [main] c.e.s.Application - Started Application in 4.123 seconds",
+  "2024-03-11 12:01:23.417 ERROR [http-nio-8080-exec-3] o.a.c.c.C.[.[.[/].[dispatcherServlet] - Servlet.service() threw exception",
+  "java.lang.IllegalStateException: Failed to execute CommandLineRunner",
+  "\tat org.springframework.boot.SpringApplication.callRunner(SpringApplication.java:787)",
+  "\tat org.springframework.boot.SpringApplication.callRunners(SpringApplication.java:768)",
+  "\tat org.springframework.boot.SpringApplication.run(SpringApplication.java:322)",
+  "Caused by: java.lang.NullPointerException: Cannot invoke \"String.length()\" because \"s\" is null",
+  "\tat com.example.service.Parser.parse(Parser.java:42)",
+  "\tat com.example.service.Runner.run(Runner.java:17)",
+  "\t... 5 common frames omitted",
+  "2024-03-11 12:01:24.002 INFO  [main] c.e.s.Application - Shutting down",
+  "Traceback (most recent call last):",
+  "  File \"/usr/lib/python3.11/site-packages/flask/app.py\", line 1455, in wsgi_app",
+  "    response = self.full_dispatch_request()",
+  "  File \"/srv/app/views.py\", line 87, in index",
+  "    return render(items[0])",
+  "IndexError: list index out of range",
+  "192.168.1.10 - - [11/Mar/2024:12:01:25 +0000] \"GET /index.html HTTP/1.1\" 200 1043",
+  "panic: runtime error: invalid memory address or nil pointer dereference",
+  "[signal SIGSEGV: segmentation violation code=0x1 addr=0x0 pc=0x4a1f2b]",
+  "",
+  "goroutine 1 [running]:",
+  "main.(*Server).handle(0x0, 0xc0000a6000)",
+  "\t/go/src/app/server.go:56 +0x2b",
+  "main.main()",
+  "\t/go/src/app/main.go:21 +0x85",
+  "192.168.1.11 - - [11/Mar/2024:12:01:26 +0000] \"POST /api/v1/items HTTP/1.1\" 201 87",
+  "Mar 11 12:01:27 host sshd[1234]: Accepted publickey for user from 10.0.0.1 port 51234 ssh2",
+};
+
+static gint
+_feed_corpus(MultiLineLogic *mll)
+{
+  gsize msg_len = 0;
+  gint extracted = 0;
+
+  for (gint i = 0; i < G_N_ELEMENTS(corpus); i++)
+    {
+      const guchar *line = (const guchar *) corpus[i];
+      gsize line_len = strlen(corpus[i]);
+      gboolean repeat;
+
+      do
+        {
+          gint verdict = multi_line_logic_accumulate_line(mll, line, msg_len, line, line_len);
+
+          repeat = FALSE;
+          if (verdict & MLL_REWIND_SEGMENT)
+            {
+              msg_len = 0;
+              repeat = TRUE;
+            }
+          else
+            {
+              msg_len += line_len + 1;
+            }
+
+          if (verdict & MLL_EXTRACTED)
+            {
+              msg_len = 0;
+              extracted++;
+            }
+        }
+      while (repeat);
+    }
+  return extracted;
+}
+
+Test(smart_multi_line_perf, test_smart_multi_line_throughput)
+{
+  MultiLineLogic *mll = smart_multi_line_new();
+  struct timespec start_ts, end_ts;
+
+  /* the first pass starts from a clean state, the others after the last
+   * line of the corpus, only those are expected to be identical */
+  _feed_corpus(mll);
+
+  /* traces are grouped into single messages, the rest are extracted line by line */
+  gint extracted = _feed_corpus(mll);
+  cr_assert_gt(extracted, 0);
+  cr_assert_lt(extracted, G_N_ELEMENTS(corpus));
+
+  clock_gettime(CLOCK_MONOTONIC, &start_ts);
+  for (gint i = 0; i < NUM_ITERATIONS; i++)
+    cr_assert_eq(_feed_corpus(mll), extracted, "iteration %d extracted a different number of messages", i);
+  clock_gettime(CLOCK_MONOTONIC, &end_ts);
+
+  gdouble elapsed_usec = timespec_diff_usec(&end_ts, &start_ts);
+  printf("      smart-multi-line, speed: %12.3f lines/sec\n",
+         NUM_ITERATIONS * G_N_ELEMENTS(corpus) * 1e6 / elapsed_usec);
+
+  multi_line_logic_free(mll);
+}
+
+/* the java_after_exception rules of smart-multi-line.fsm, all of them
+ * anchored, these are tried on every line of a Java stack trace */
+static const gchar *java_rules[] =
+{
+  "^[\\t ]*nested exception is:[\\t ]*",
+  "^[\\r\\n]*$",
+  "^[\\t ]+(?:eval )?at ",
+  "^[\\t ]+--- End of inner exception stack trace ---$",
+  "^--- End of stack trace from previous location where exception was thrown ---$",
+  "^[\\t ]*(?:Caused by|Suppressed):",
+  "^[\\t ]*... \\d+ (?:more|common frames omitted)",
+};
+
+static gint
+_match_sequential(MultiLinePattern **patterns, gint num_patterns, pcre2_match_data *match_data, const gchar *line)
+{
+  for (gint p = 0; p < num_patterns; p++)
+    {
+      if (multi_line_pattern_match(patterns[p], match_data, (const guchar *) line, strlen(line)))
+        return p;
+    }
+  return -1;
+}
+
+static gint
+_match_combined(MultiLinePattern *combined, pcre2_match_data *match_data, const gchar *line)
+{
+  return multi_line_pattern_find_alternative(combined, match_data, (const guchar *) line, strlen(line), NULL, NULL);
+}
+
+static gdouble
+_lines_per_sec(struct timespec *start_ts, struct timespec *end_ts)
+{
+  return NUM_ITERATIONS * G_N_ELEMENTS(corpus) * 1e6 / timespec_diff_usec(end_ts, start_ts);
+}
+
+Test(smart_multi_line_perf, test_combined_rules_match_the_same_rule_as_sequential_matching)
+{
+  MultiLinePattern *patterns[G_N_ELEMENTS(java_rules)];
+  pcre2_match_data *match_data = multi_line_pattern_match_data_new();
+  struct timespec start_ts, end_ts;
+  gint matches = 0;
+
+  for (gint i = 0; i < G_N_ELEMENTS(java_rules); i++)
+    {
+      patterns[i] = multi_line_pattern_compile(java_rules[i], NULL);
+      cr_assert(patterns[i]);
+      cr_assert(multi_line_pattern_is_anchored(patterns[i]), "rule is not anchored: %s", java_rules[i]);
+    }
+  MultiLinePattern *combined = multi_line_pattern_compile_alternatives(patterns, G_N_ELEMENTS(patterns));
+  cr_assert(combined);
+
+  for (gint line = 0; line < G_N_ELEMENTS(corpus); line++)
+    {
+      gint expected = _match_sequential(patterns, G_N_ELEMENTS(patterns), match_data, corpus[line]);
+
+      cr_assert_eq(_match_combined(combined, match_data, corpus[line]), expected,
+                   "combined rules disagree with sequential matching on line: %s", corpus[line]);
+      if (expected >= 0)
+        matches++;
+    }
+  /* at frames, Caused by, ... common frames omitted, empty line */
+  cr_assert_geq(matches, 4);
+
+  clock_gettime(CLOCK_MONOTONIC, &start_ts);
+  for (gint i = 0; i < NUM_ITERATIONS; i++)
+    for (gint line = 0; line < G_N_ELEMENTS(corpus); line++)
+      _match_sequential(patterns, G_N_ELEMENTS(patterns), match_data, corpus[line]);
+  clock_gettime(CLOCK_MONOTONIC, &end_ts);
+  printf("      java_after_exception rules, sequential: %12.3f lines/sec\n", _lines_per_sec(&start_ts, &end_ts));
+
+  clock_gettime(CLOCK_MONOTONIC, &start_ts);
+  for (gint i = 0; i < NUM_ITERATIONS; i++)
+    for (gint line = 0; line < G_N_ELEMENTS(corpus); line++)
+      _match_combined(combined, match_data, corpus[line]);
+  clock_gettime(CLOCK_MONOTONIC, &end_ts);
+  printf("      java_after_exception rules, combined:   %12.3f lines/sec\n", _lines_per_sec(&start_ts, &end_ts));
+
+  pcre2_match_data_free(match_data);
+  multi_line_pattern_unref(combined);
+  for (gint i = 0; i < G_N_ELEMENTS(patterns); i++)
+    multi_line_pattern_unref(patterns[i]);
+}
+
+static void
+setup(void)
+{
+  override_installation_path_for("${pkgdatadir}/smart-multi-line.fsm", TOP_SRCDIR "/lib/multi-line/smart-multi-line.fsm");
+  app_startup();
+  configuration = cfg_new_snippet();
+}
+
+static void
+teardown(void)
+{
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(smart_multi_line_perf, .init = setup, .fini = teardown);
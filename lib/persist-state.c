@@ -96,6 +96,20 @@
  * This way unused entries in the persist file are reaped when
  * syslog-ng restarts.
  *
+ * Durability:
+ * -----------
+ *
+ * Values are updated in place through the shared mapping, without any
+ * system call, the kernel writes the dirty pages back at its own pace.
+ * persist_state_sync() flushes them explicitly, it is called periodically
+ * by the main loop (see the persist-sync-freq() global option), so the
+ * cost is proportional to the pages changed in the interval, however many
+ * entries were updated.
+ *
+ * The file rewritten on startup is only renamed over the committed one
+ * once its contents reached the disk, so a crash during the rewrite
+ * leaves the previous, complete file in place.
+ *
  * Trusts:
  * -------
  *
@@ -200,11 +214,80 @@ _create_store(PersistState *self)
   return _grow_store(self, PERSIST_FILE_INITIAL_SIZE);
 }
 
+static void
+_release_mapping(PersistState *self)
+{
+  g_mutex_lock(&self->mapped_lock);
+  g_assert(self->mapped_counter >= 1);
+  self->mapped_counter--;
+  if (self->mapped_counter == 0)
+    {
+      g_cond_signal(&self->mapped_release_cond);
+    }
+  g_mutex_unlock(&self->mapped_lock);
+}
+
+/*
+ * The mapping is pinned the same way persist_state_map_entry() pins it,
+ * so _grow_store() waits for msync() to finish instead of remapping the
+ * file under it, while map_entry() callers are not held up by the sync.
+ */
+static gboolean
+_sync_store(PersistState *self)
+{
+  g_mutex_lock(&self->mapped_lock);
+  gpointer map = self->current_map;
+  guint32 size = self->current_size;
+  self->mapped_counter++;
+  g_mutex_unlock(&self->mapped_lock);
+
+  gboolean result = TRUE;
+  if (map && msync(map, size, MS_SYNC) < 0)
+    {
+      msg_error("Error syncing persistent state file",
+                evt_tag_str("filename", self->committed ? self->committed_filename : self->temp_filename),
+                evt_tag_error("error"));
+      result = FALSE;
+    }
+
+  _release_mapping(self);
+  return result;
+}
+
+/* make the rename() itself durable */
+static void
+_sync_directory_of(const gchar *filename)
+{
+  gchar *dirname = g_path_get_dirname(filename);
+  gint dir_fd = open(dirname, O_RDONLY);
+
+  if (dir_fd < 0 || fsync(dir_fd) < 0)
+    {
+      msg_warning("Error syncing the directory of the persistent state file",
+                  evt_tag_str("filename", filename),
+                  evt_tag_error("error"));
+    }
+
+  if (dir_fd >= 0)
+    close(dir_fd);
+  g_free(dirname);
+}
+
 static gboolean
 _commit_store(PersistState *self)
 {
+  /* the temp file must be complete on disk before it replaces the
+   * committed one, otherwise a crash could leave a torn file behind */
+  if (!_sync_store(self))
+    return FALSE;
+
   /* NOTE: we don't need to remap the file in case it is renamed */
-  return rename(self->temp_filename, self->committed_filename) >= 0;
+  if (rename(self->temp_filename, self->committed_filename) < 0)
+    return FALSE;
+
+  self->committed = TRUE;
+  _sync_directory_of(self->committed_filename);
+  return TRUE;
 }
 
 static gboolean
@@ -766,14 +849,7 @@ persist_state_map_entry(PersistState *self, PersistEntryHandle handle)
 void
 persist_state_unmap_entry(PersistState *self, PersistEntryHandle handle)
 {
-  g_mutex_lock(&self->mapped_lock);
-  g_assert(self->mapped_counter >= 1);
-  self->mapped_counter--;
-  if (self->mapped_counter == 0)
-    {
-      g_cond_signal(&self->mapped_release_cond);
-    }
-  g_mutex_unlock(&self->mapped_lock);
+  _release_mapping(self);
 }
 
 static PersistValueHeader *
@@ -994,6 +1070,20 @@ persist_state_commit(PersistState *self)
   return TRUE;
 }
 
+/*
+ * Flushes the changes made to the persistent state to disk.  Only the
+ * pages dirtied since the last sync are written.
+ *
+ * Threading NOTE: this can be called from any kind of threads, it blocks
+ * until the pages are written, so the main loop calls it from an I/O
+ * worker.
+ */
+gboolean
+persist_state_sync(PersistState *self)
+{
+  return _sync_store(self);
+}
+
 static void
 _destroy(PersistState *self)
 {
@@ -1057,6 +1147,8 @@ persist_state_new(const gchar *filename)
 void
 persist_state_free(PersistState *self)
 {
+  if (self->committed)
+    _sync_store(self);
   _destroy(self);
   g_free(self);
 }
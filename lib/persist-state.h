@@ -68,6 +68,7 @@ struct _PersistState
   gint version;
   gchar *committed_filename;
   gchar *temp_filename;
+  gboolean committed;
   gint fd;
   gint mapped_counter;
   GMutex mapped_lock;
@@ -114,6 +115,7 @@ gboolean persist_state_start_dump(PersistState *self);
 const gchar *persist_state_get_filename(PersistState *self);
 
 gboolean persist_state_commit(PersistState *self);
+gboolean persist_state_sync(PersistState *self);
 void persist_state_cancel(PersistState *self);
 
 PersistState *persist_state_new(const gchar *filename);
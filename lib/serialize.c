@@ -50,6 +50,27 @@ typedef struct _SerializeBufferArchive
   gchar *buff;
 } SerializeBufferArchive;
 
+/* a segment is either a range of the buffer or a borrowed block of memory */
+typedef struct _SerializeIOVecSegment
+{
+  const gchar *borrowed;
+  gsize ofs;
+  gsize len;
+  gpointer owner;
+  GDestroyNotify release_owner;
+} SerializeIOVecSegment;
+
+typedef struct _SerializeIOVecArchive
+{
+  SerializeArchive super;
+  GString *buffer;
+  /* the start of the buffer range that is not yet covered by a segment */
+  gsize buffer_mark;
+  gsize length;
+  GArray *segments;
+  GArray *iov;
+} SerializeIOVecArchive;
+
 void
 _serialize_handle_errors(SerializeArchive *self, const gchar *error_desc, GError *error)
 {
@@ -68,6 +89,8 @@ void
 serialize_archive_free(SerializeArchive *self)
 {
   g_clear_error(&self->error);
+  if (self->free_fn)
+    self->free_fn(self);
   g_slice_free1(self->len, self);
 }
 
@@ -232,3 +255,132 @@ serialize_buffer_archive_new(gchar *buff, gsize len)
   self->len = len;
   return &self->super;
 }
+
+static void
+_iovec_archive_close_buffer_segment(SerializeIOVecArchive *self)
+{
+  if (self->buffer->len == self->buffer_mark)
+    return;
+
+  SerializeIOVecSegment segment =
+  {
+    .ofs = self->buffer_mark,
+    .len = self->buffer->len - self->buffer_mark,
+  };
+  g_array_append_val(self->segments, segment);
+  self->buffer_mark = self->buffer->len;
+}
+
+static gboolean
+serialize_iovec_archive_read_bytes(SerializeArchive *s, gchar *buf, gsize buflen, GError **error)
+{
+  g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "Reading from an iovec archive is not supported");
+  return FALSE;
+}
+
+static gboolean
+serialize_iovec_archive_write_bytes(SerializeArchive *s, const gchar *buf, gsize buflen, GError **error)
+{
+  SerializeIOVecArchive *self = (SerializeIOVecArchive *) s;
+
+  g_return_val_if_fail(error == NULL || (*error) == NULL, FALSE);
+
+  g_string_append_len(self->buffer, buf, buflen);
+  self->length += buflen;
+  return TRUE;
+}
+
+static gboolean
+serialize_iovec_archive_write_bytes_borrowed(SerializeArchive *s, const gchar *buf, gsize buflen,
+                                             gpointer owner, GDestroyNotify release_owner, GError **error)
+{
+  SerializeIOVecArchive *self = (SerializeIOVecArchive *) s;
+
+  g_return_val_if_fail(error == NULL || (*error) == NULL, FALSE);
+
+  _iovec_archive_close_buffer_segment(self);
+
+  SerializeIOVecSegment segment =
+  {
+    .borrowed = buf,
+    .len = buflen,
+    .owner = owner,
+    .release_owner = release_owner,
+  };
+  g_array_append_val(self->segments, segment);
+  self->length += buflen;
+  return TRUE;
+}
+
+static void
+serialize_iovec_archive_free(SerializeArchive *s)
+{
+  SerializeIOVecArchive *self = (SerializeIOVecArchive *) s;
+
+  for (guint i = 0; i < self->segments->len; i++)
+    {
+      SerializeIOVecSegment *segment = &g_array_index(self->segments, SerializeIOVecSegment, i);
+
+      if (segment->release_owner)
+        segment->release_owner(segment->owner);
+    }
+  g_array_free(self->segments, TRUE);
+  g_array_free(self->iov, TRUE);
+}
+
+/*
+ * Returns the serialized data as an array of iovecs, suitable for
+ * writev().  The returned array points into the buffer and the borrowed
+ * blocks, so it is only valid until the next write to the archive or until
+ * the archive is freed.
+ */
+const struct iovec *
+serialize_iovec_archive_get_iovec(SerializeArchive *s, gint *iovcnt)
+{
+  SerializeIOVecArchive *self = (SerializeIOVecArchive *) s;
+
+  _iovec_archive_close_buffer_segment(self);
+
+  g_array_set_size(self->iov, self->segments->len);
+  for (guint i = 0; i < self->segments->len; i++)
+    {
+      SerializeIOVecSegment *segment = &g_array_index(self->segments, SerializeIOVecSegment, i);
+      struct iovec *iov = &g_array_index(self->iov, struct iovec, i);
+
+      iov->iov_base = (gpointer) (segment->borrowed ? segment->borrowed : self->buffer->str + segment->ofs);
+      iov->iov_len = segment->len;
+    }
+  *iovcnt = self->iov->len;
+  return (const struct iovec *) self->iov->data;
+}
+
+gsize
+serialize_iovec_archive_get_length(SerializeArchive *s)
+{
+  SerializeIOVecArchive *self = (SerializeIOVecArchive *) s;
+
+  return self->length;
+}
+
+/*
+ * An archive that accumulates small writes in @buffer, while blocks written
+ * using serialize_write_blob_borrowed() are referenced instead of copied.
+ * @buffer must be empty and must not be modified by the caller, except for
+ * overwriting already serialized bytes in place.
+ */
+SerializeArchive *
+serialize_iovec_archive_new(GString *buffer)
+{
+  SerializeIOVecArchive *self = g_slice_new0(SerializeIOVecArchive);
+
+  self->super.read_bytes = serialize_iovec_archive_read_bytes;
+  self->super.write_bytes = serialize_iovec_archive_write_bytes;
+  self->super.write_bytes_borrowed = serialize_iovec_archive_write_bytes_borrowed;
+  self->super.free_fn = serialize_iovec_archive_free;
+  self->super.len = sizeof(SerializeIOVecArchive);
+  self->buffer = buffer;
+  self->buffer_mark = buffer->len;
+  self->segments = g_array_sized_new(FALSE, FALSE, sizeof(SerializeIOVecSegment), 4);
+  self->iov = g_array_sized_new(FALSE, FALSE, sizeof(struct iovec), 4);
+  return &self->super;
+}
@@ -29,6 +29,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/uio.h>
 
 typedef struct _SerializeArchive SerializeArchive;
 
@@ -40,6 +41,12 @@ struct _SerializeArchive
 
   gboolean (*read_bytes)(SerializeArchive *archive, gchar *buf, gsize count, GError **error);
   gboolean (*write_bytes)(SerializeArchive *archive, const gchar *buf, gsize count, GError **error);
+
+  /* optional: reference @buf instead of copying it, @owner is released
+   * with @release_owner once the archive no longer needs @buf */
+  gboolean (*write_bytes_borrowed)(SerializeArchive *archive, const gchar *buf, gsize count,
+                                   gpointer owner, GDestroyNotify release_owner, GError **error);
+  void (*free_fn)(SerializeArchive *archive);
 };
 
 /* this is private and is only published so that the inline functions below can invoke it */
@@ -65,6 +72,30 @@ serialize_archive_write_bytes(SerializeArchive *self, const gchar *buf, gsize bu
   return self->error == NULL;
 }
 
+/*
+ * Write a block of memory that the archive may reference instead of
+ * copying.  The caller passes a reference to the object that keeps @buf
+ * alive in @owner, which is always consumed: either right away (archives
+ * that copy) or when the archive is freed.
+ */
+static inline gboolean
+serialize_archive_write_bytes_borrowed(SerializeArchive *self, const gchar *buf, gsize buflen,
+                                       gpointer owner, GDestroyNotify release_owner)
+{
+  GError *error = NULL;
+
+  if (!self->write_bytes_borrowed || self->error != NULL)
+    {
+      serialize_archive_write_bytes(self, buf, buflen);
+      release_owner(owner);
+      return self->error == NULL;
+    }
+
+  if (!self->write_bytes_borrowed(self, buf, buflen, owner, release_owner, &error))
+    _serialize_handle_errors(self, "Error writing serialized data", error);
+  return self->error == NULL;
+}
+
 static inline gboolean
 serialize_write_uint32(SerializeArchive *archive, guint32 value)
 {
@@ -211,6 +242,13 @@ serialize_write_blob(SerializeArchive *archive, const void *blob, gsize len)
   return serialize_archive_write_bytes(archive, (const gchar *) blob, len);
 }
 
+static inline gboolean
+serialize_write_blob_borrowed(SerializeArchive *archive, const void *blob, gsize len,
+                              gpointer owner, GDestroyNotify release_owner)
+{
+  return serialize_archive_write_bytes_borrowed(archive, (const gchar *) blob, len, owner, release_owner);
+}
+
 static inline gboolean
 serialize_read_blob(SerializeArchive *archive, void *blob, gsize len)
 {
@@ -285,6 +323,9 @@ SerializeArchive *serialize_string_archive_new(GString *str);
 void serialize_string_archive_reset(SerializeArchive *sa);
 SerializeArchive *serialize_buffer_archive_new(gchar *buff, gsize len);
 gsize serialize_buffer_archive_get_pos(SerializeArchive *self);
+SerializeArchive *serialize_iovec_archive_new(GString *buffer);
+const struct iovec *serialize_iovec_archive_get_iovec(SerializeArchive *self, gint *iovcnt);
+gsize serialize_iovec_archive_get_length(SerializeArchive *self);
 void serialize_archive_free(SerializeArchive *self);
 
 #endif
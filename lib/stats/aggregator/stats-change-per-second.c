@@ -76,17 +76,21 @@ _reset_CPS_logic_values(CPSLogic *self)
 static void
 _track_input_counter(StatsAggregatorCPS *self)
 {
+  stats_lock_cluster(self->sc_input);
   StatsCounterItem *input_counter = stats_cluster_get_counter(self->sc_input, self->stats_type_input);
   self->input_counter = input_counter;
   g_assert(self->input_counter != NULL);
 
   stats_cluster_track_counter(self->sc_input, self->stats_type_input);
+  stats_unlock_cluster(self->sc_input);
 }
 
 static void
 _untrack_input_counter(StatsAggregatorCPS *self)
 {
+  stats_lock_cluster(self->sc_input);
   stats_cluster_untrack_counter(self->sc_input, self->stats_type_input, &self->input_counter);
+  stats_unlock_cluster(self->sc_input);
   self->input_counter = NULL;
 }
 
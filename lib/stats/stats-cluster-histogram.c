@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "stats/stats-cluster-histogram.h"
+#include "stats/stats-registry.h"
+
+static const gchar *tag_names[SC_TYPE_HISTOGRAM_MAX] =
+{
+  /* [SC_TYPE_HISTOGRAM]   = */ "histogram",
+};
+
+/* The histogram is allocated right after the counter, so that the usual
+ * counter registration can be used to get hold of it. */
+typedef struct _StatsHistogramCounters
+{
+  StatsCounterItem counters[SC_TYPE_HISTOGRAM_MAX];
+  StatsHistogram histogram;
+} StatsHistogramCounters;
+
+static inline StatsHistogram *
+_counter_get_histogram(StatsCounterItem *counter)
+{
+  return &((StatsHistogramCounters *) (counter - SC_TYPE_HISTOGRAM))->histogram;
+}
+
+static inline StatsCounterItem *
+_histogram_get_counter(StatsHistogram *histogram)
+{
+  return &((StatsHistogramCounters *) ((gchar *) histogram - G_STRUCT_OFFSET(StatsHistogramCounters,
+                                         histogram)))->counters[SC_TYPE_HISTOGRAM];
+}
+
+static void
+_counter_group_free(StatsCounterGroup *counter_group)
+{
+  g_free(counter_group->counters);
+}
+
+static void
+_counter_group_init(StatsCounterGroupInit *self, StatsCounterGroup *counter_group)
+{
+  StatsHistogramCounters *histogram_counters = g_new0(StatsHistogramCounters, 1);
+
+  counter_group->counters = histogram_counters->counters;
+  counter_group->capacity = SC_TYPE_HISTOGRAM_MAX;
+  counter_group->counter_names = self->counter.names;
+  counter_group->free_fn = _counter_group_free;
+}
+
+void
+stats_cluster_histogram_key_set(StatsClusterKey *key, const gchar *name, StatsClusterLabel *labels, gsize labels_len)
+{
+  stats_cluster_key_set(key, name, labels, labels_len, (StatsCounterGroupInit)
+  {
+    .counter.names = tag_names, .init = _counter_group_init, .equals = NULL
+  });
+}
+
+void
+stats_cluster_histogram_key_add_unit(StatsClusterKey *key, StatsClusterUnit stored_unit)
+{
+  key->formatting.stored_unit = stored_unit;
+}
+
+gboolean
+stats_cluster_is_histogram(StatsCluster *self)
+{
+  return self->key.counter_group_init.init == _counter_group_init;
+}
+
+StatsHistogram *
+stats_cluster_histogram_get_histogram(StatsCluster *self)
+{
+  g_assert(stats_cluster_is_histogram(self));
+
+  return _counter_get_histogram(&self->counter_group.counters[SC_TYPE_HISTOGRAM]);
+}
+
+StatsCluster *
+stats_register_histogram(gint level, const StatsClusterKey *sc_key, StatsHistogram **histogram)
+{
+  StatsCounterItem *counter;
+  StatsCluster *sc = stats_register_counter(level, sc_key, SC_TYPE_HISTOGRAM, &counter);
+
+  *histogram = counter ? _counter_get_histogram(counter) : NULL;
+  return sc;
+}
+
+void
+stats_unregister_histogram(const StatsClusterKey *sc_key, StatsHistogram **histogram)
+{
+  if (!*histogram)
+    return;
+
+  StatsCounterItem *counter = _histogram_get_counter(*histogram);
+  stats_unregister_counter(sc_key, SC_TYPE_HISTOGRAM, &counter);
+  *histogram = NULL;
+}
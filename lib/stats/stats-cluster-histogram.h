@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef STATS_CLUSTER_HISTOGRAM_H_INCLUDED
+#define STATS_CLUSTER_HISTOGRAM_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "stats-cluster.h"
+#include "stats-histogram.h"
+
+typedef enum
+{
+  SC_TYPE_HISTOGRAM,
+  SC_TYPE_HISTOGRAM_MAX
+} StatsCounterGroupHistogram;
+
+/* Histograms have no legacy representation, they are only exposed via the
+ * prometheus output, see stats-prometheus.c */
+void stats_cluster_histogram_key_set(StatsClusterKey *key, const gchar *name, StatsClusterLabel *labels,
+                                     gsize labels_len);
+void stats_cluster_histogram_key_add_unit(StatsClusterKey *key, StatsClusterUnit stored_unit);
+
+gboolean stats_cluster_is_histogram(StatsCluster *self);
+StatsHistogram *stats_cluster_histogram_get_histogram(StatsCluster *self);
+
+StatsCluster *stats_register_histogram(gint level, const StatsClusterKey *sc_key, StatsHistogram **histogram);
+void stats_unregister_histogram(const StatsClusterKey *sc_key, StatsHistogram **histogram);
+
+#endif
@@ -24,6 +24,7 @@
 #include "stats/stats-cluster-key-builder.h"
 #include "stats/stats-cluster-single.h"
 #include "stats/stats-cluster-logpipe.h"
+#include "stats/stats-cluster-histogram.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -472,6 +473,28 @@ stats_cluster_key_builder_build_logpipe(const StatsClusterKeyBuilder *self)
   return sc_key;
 }
 
+/* histograms have no legacy representation, legacy options are ignored */
+StatsClusterKey *
+stats_cluster_key_builder_build_histogram(const StatsClusterKeyBuilder *self)
+{
+  g_assert(_has_new_style_values(self));
+
+  StatsClusterKey *sc_key = g_new0(StatsClusterKey, 1);
+  StatsClusterKey temp_key;
+
+  GArray *merged_labels = _construct_merged_labels(self);
+  gchar *name = _format_name(self);
+
+  stats_cluster_histogram_key_set(&temp_key, name, (StatsClusterLabel *) merged_labels->data, merged_labels->len);
+  stats_cluster_histogram_key_add_unit(&temp_key, _get_unit(self));
+  stats_cluster_key_clone(sc_key, &temp_key);
+
+  g_array_free(merged_labels, TRUE);
+  g_free(name);
+
+  return sc_key;
+}
+
 void
 stats_cluster_key_builder_add_legacy_label(StatsClusterKeyBuilder *self, const StatsClusterLabel label)
 {
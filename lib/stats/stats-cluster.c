@@ -358,6 +358,8 @@ stats_cluster_untrack_counter(StatsCluster *self, gint type, StatsCounterItem **
 
   if (self->use_count == 0 && (*counter)->external)
     {
+      if ((*counter)->name)
+        stats_cluster_account_memory(self, -(gssize) (strlen((*counter)->name) + 1));
       stats_counter_clear(*counter);
       gint type_mask = 1 << type;
       self->live_mask &= ~type_mask;
@@ -416,16 +418,59 @@ stats_cluster_is_alive(StatsCluster *self, gint type)
   return !!((1<<type) & self->live_mask);
 }
 
+/* the memory used by all the clusters in existence */
+static atomic_gssize stats_clusters_memory_usage;
+
+static inline gsize
+_string_memory_usage(const gchar *str)
+{
+  return str ? strlen(str) + 1 : 0;
+}
+
+static gsize
+_key_memory_usage(const StatsClusterKey *key)
+{
+  gsize size = _string_memory_usage(key->name)
+               + _string_memory_usage(key->legacy.id)
+               + _string_memory_usage(key->legacy.instance)
+               + key->labels_len * sizeof(StatsClusterLabel);
+
+  for (gsize i = 0; i < key->labels_len; i++)
+    size += _string_memory_usage(key->labels[i].name) + _string_memory_usage(key->labels[i].value);
+
+  return size;
+}
+
+void
+stats_cluster_account_memory(StatsCluster *self, gssize bytes)
+{
+  self->memory_usage += bytes;
+  atomic_gssize_add(&stats_clusters_memory_usage, bytes);
+}
+
+atomic_gssize *
+stats_cluster_get_total_memory_usage(void)
+{
+  return &stats_clusters_memory_usage;
+}
+
 StatsCluster *
 stats_cluster_new(const StatsClusterKey *key)
 {
   StatsCluster *self = g_new0(StatsCluster, 1);
 
   stats_cluster_key_clone(&self->key, key);
+  self->key_hash = stats_cluster_key_hash(&self->key);
   self->use_count = 0;
+  self->ref_cnt = 1;
   self->query_key = _stats_build_query_key(self);
   key->counter_group_init.init(&self->key.counter_group_init, &self->counter_group);
   g_assert(self->counter_group.capacity <= sizeof(self->live_mask)*8);
+
+  stats_cluster_account_memory(self, sizeof(StatsCluster)
+                               + _key_memory_usage(&self->key)
+                               + _string_memory_usage(self->query_key)
+                               + self->counter_group.capacity * sizeof(StatsCounterItem));
   return self;
 }
 
@@ -452,12 +497,42 @@ stats_cluster_free_counter(StatsCluster *self, gint type, StatsCounterItem *item
   stats_counter_clear(item);
 }
 
+static void
+stats_cluster_free_prometheus_series(StatsCluster *self)
+{
+  if (!self->prometheus_series)
+    return;
+
+  for (gint type = 0; type < self->counter_group.capacity; type++)
+    g_free(self->prometheus_series[type]);
+  g_free(self->prometheus_series);
+}
+
 void
 stats_cluster_free(StatsCluster *self)
 {
   stats_cluster_foreach_counter(self, stats_cluster_free_counter, NULL);
+  stats_cluster_free_prometheus_series(self);
+  atomic_gssize_sub(&stats_clusters_memory_usage, self->memory_usage);
   stats_cluster_key_cloned_free(&self->key);
   g_free(self->query_key);
   stats_counter_group_free(&self->counter_group);
   g_free(self);
 }
+
+/* The registry holds a reference to each cluster, others may pin clusters
+ * to access them without holding the stats lock, while they could be
+ * removed from the registry concurrently. */
+StatsCluster *
+stats_cluster_ref(StatsCluster *self)
+{
+  g_atomic_int_inc(&self->ref_cnt);
+  return self;
+}
+
+void
+stats_cluster_unref(StatsCluster *self)
+{
+  if (g_atomic_int_dec_and_test(&self->ref_cnt))
+    stats_cluster_free(self);
+}
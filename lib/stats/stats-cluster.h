@@ -55,6 +55,7 @@ typedef enum _StatsClusterUnit
   SCU_HOURS,
   SCU_MILLISECONDS,
   SCU_NANOSECONDS,
+  SCU_MICROSECONDS,
 
   SCU_BYTES,
   SCU_KIB,
@@ -159,6 +160,14 @@ typedef struct _StatsCluster
   guint16 live_mask;
   guint16 dynamic:1;
   gchar *query_key;
+  guint key_hash;
+  gint ref_cnt;
+  /* bytes allocated for the cluster, its key, labels and counter names */
+  gsize memory_usage;
+
+  /* series name and labels per counter type, escaped and ready to be
+   * exposed, rendered on the first scrape. See stats-prometheus.c */
+  gchar **prometheus_series;
 } StatsCluster;
 
 typedef void (*StatsForeachCounterFunc)(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data);
@@ -201,6 +210,10 @@ stats_cluster_get_type_label(StatsCluster *self, gint type, StatsClusterLabel *l
 
 StatsCluster *stats_cluster_new(const StatsClusterKey *key);
 StatsCluster *stats_cluster_dynamic_new(const StatsClusterKey *key);
+StatsCluster *stats_cluster_ref(StatsCluster *self);
+void stats_cluster_account_memory(StatsCluster *self, gssize bytes);
+atomic_gssize *stats_cluster_get_total_memory_usage(void);
+void stats_cluster_unref(StatsCluster *self);
 void stats_cluster_free(StatsCluster *self);
 
 void stats_cluster_key_set(StatsClusterKey *self, const gchar *name, StatsClusterLabel *labels, gsize labels_len,
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "stats/stats-histogram.h"
+#include "tls-support.h"
+
+#include <string.h>
+
+TLS_BLOCK_START
+{
+  /* 1-based, 0 means that the thread has not been assigned a shard yet */
+  gint stats_histogram_shard;
+}
+TLS_BLOCK_END;
+
+#define stats_histogram_shard __tls_deref(stats_histogram_shard)
+
+static gint stats_histogram_next_shard;
+
+static inline StatsHistogramShard *
+_get_shard(StatsHistogram *self)
+{
+  if (G_UNLIKELY(!stats_histogram_shard))
+    stats_histogram_shard = (g_atomic_int_add(&stats_histogram_next_shard, 1) % STATS_HISTOGRAM_SHARDS) + 1;
+
+  return &self->shards[stats_histogram_shard - 1];
+}
+
+gsize
+stats_histogram_get_bucket_bound(gint index)
+{
+  g_assert(index >= 0 && index < STATS_HISTOGRAM_BOUNDS);
+
+  gsize octave = (gsize) 1 << (STATS_HISTOGRAM_MIN_SHIFT + index / 2);
+
+  /* even indices are powers of two, odd ones are halfway to the next one */
+  if (index % 2 == 0)
+    return octave;
+  return octave + octave / 2;
+}
+
+void
+stats_histogram_observe(StatsHistogram *self, gsize value)
+{
+  if (!self)
+    return;
+
+  StatsHistogramShard *shard = _get_shard(self);
+  atomic_gssize_inc(&shard->buckets[stats_histogram_get_bucket_index(value)]);
+  /* glib has no 64 bit atomics */
+  __atomic_fetch_add(&shard->sum, (guint64) value, __ATOMIC_RELAXED);
+}
+
+/* The shards are read one by one, so the snapshot is not atomic, but
+ * each bucket only grows, which is what consumers of histograms expect. */
+void
+stats_histogram_snapshot(StatsHistogram *self, StatsHistogramSnapshot *snapshot)
+{
+  memset(snapshot, 0, sizeof(*snapshot));
+
+  for (gint i = 0; i < STATS_HISTOGRAM_SHARDS; i++)
+    {
+      StatsHistogramShard *shard = &self->shards[i];
+
+      for (gint bucket = 0; bucket < STATS_HISTOGRAM_BUCKETS; bucket++)
+        snapshot->buckets[bucket] += atomic_gssize_get_unsigned(&shard->buckets[bucket]);
+      snapshot->sum += __atomic_load_n(&shard->sum, __ATOMIC_RELAXED);
+    }
+
+  for (gint bucket = 0; bucket < STATS_HISTOGRAM_BUCKETS; bucket++)
+    snapshot->count += snapshot->buckets[bucket];
+}
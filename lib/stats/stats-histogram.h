@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef STATS_HISTOGRAM_H_INCLUDED
+#define STATS_HISTOGRAM_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "atomic-gssize.h"
+
+/*
+ * StatsHistogram records the distribution of integer observations (e.g.
+ * latencies in microseconds) into a fixed set of log-linear buckets: each
+ * power of two between 2^STATS_HISTOGRAM_MIN_SHIFT and
+ * 2^(STATS_HISTOGRAM_MIN_SHIFT + STATS_HISTOGRAM_OCTAVES) is split into two
+ * linear halves, the last bucket collects everything above that.
+ *
+ * Observations are lock-free: every thread updates its own shard with
+ * relaxed atomic additions, the shards are only summed up when the
+ * histogram is read.
+ */
+
+#define STATS_HISTOGRAM_MIN_SHIFT 7
+#define STATS_HISTOGRAM_OCTAVES 18
+/* number of finite upper bounds, the last bucket is +Inf */
+#define STATS_HISTOGRAM_BOUNDS (2 * STATS_HISTOGRAM_OCTAVES + 1)
+#define STATS_HISTOGRAM_BUCKETS (STATS_HISTOGRAM_BOUNDS + 1)
+#define STATS_HISTOGRAM_SHARDS 8
+#define STATS_HISTOGRAM_CACHE_LINE_SIZE 64
+
+typedef struct _StatsHistogramShard
+{
+  atomic_gssize buckets[STATS_HISTOGRAM_BUCKETS];
+  /* 64 bits even on 32 bit platforms, a sum of microseconds would wrap
+   * around in about an hour there */
+  guint64 sum;
+  /* shards are updated by different threads: a full cache line between
+   * them keeps them apart regardless of the alignment of the allocation */
+  gchar padding[STATS_HISTOGRAM_CACHE_LINE_SIZE];
+} StatsHistogramShard;
+
+typedef struct _StatsHistogram
+{
+  StatsHistogramShard shards[STATS_HISTOGRAM_SHARDS];
+} StatsHistogram;
+
+typedef struct _StatsHistogramSnapshot
+{
+  /* per bucket, not cumulative */
+  gsize buckets[STATS_HISTOGRAM_BUCKETS];
+  guint64 sum;
+  gsize count;
+} StatsHistogramSnapshot;
+
+static inline gint
+stats_histogram_get_bucket_index(gsize value)
+{
+  if (value <= ((gsize) 1 << STATS_HISTOGRAM_MIN_SHIFT))
+    return 0;
+
+  /* value is in (2^msb, 2^(msb+1)], the bit below msb tells which half */
+  gsize x = value - 1;
+  gint msb = g_bit_storage(x) - 1;
+  gint upper_half = (x >> (msb - 1)) & 1;
+  gint index = 2 * (msb - STATS_HISTOGRAM_MIN_SHIFT) + 1 + upper_half;
+
+  return MIN(index, STATS_HISTOGRAM_BUCKETS - 1);
+}
+
+gsize stats_histogram_get_bucket_bound(gint index);
+
+void stats_histogram_observe(StatsHistogram *self, gsize value);
+void stats_histogram_snapshot(StatsHistogram *self, StatsHistogramSnapshot *snapshot);
+
+#endif
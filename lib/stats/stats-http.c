@@ -0,0 +1,736 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "stats/stats-http.h"
+#include "stats/stats-prometheus.h"
+#include "timeutils/cache.h"
+#include "scratch-buffers.h"
+#include "fdhelpers.h"
+#include "messages.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#if SYSLOG_NG_HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+#define STATS_HTTP_MAX_REQUEST_SIZE 8192
+#define STATS_HTTP_IO_TIMEOUT_SEC 10
+#define STATS_HTTP_MAX_CONNECTIONS 64
+#define STATS_HTTP_CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+struct _StatsHttpServer
+{
+  gchar *listen_address;
+  gint listen_fd;
+  gint wakeup_fds[2];
+  GThread *thread;
+  gboolean cancelled;
+
+  /* The last exposition served, along with its compressed form.  Both are
+   * only touched by the server thread and are kept for as long as the
+   * rendered metrics do not change, so idle counters cost neither a
+   * recompression nor, with If-None-Match, a transfer. */
+  GString *body;
+  guint64 body_hash;
+  GString *gzipped_body;
+};
+
+typedef struct _StatsHttpRequest
+{
+  gchar *method;
+  gchar *path;
+  gboolean accepts_gzip;
+  gchar *if_none_match;
+} StatsHttpRequest;
+
+static guint64
+_hash_body(const GString *body)
+{
+  /* FNV-1a */
+  guint64 hash = G_GUINT64_CONSTANT(14695981039346656037);
+
+  for (gsize i = 0; i < body->len; i++)
+    {
+      hash ^= (guchar) body->str[i];
+      hash *= G_GUINT64_CONSTANT(1099511628211);
+    }
+  return hash;
+}
+
+#if SYSLOG_NG_HAVE_LIBZ
+
+static GString *
+_gzip(const GString *input)
+{
+  z_stream stream = {0};
+
+  if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return NULL;
+
+  GString *output = g_string_sized_new(0);
+  g_string_set_size(output, deflateBound(&stream, input->len));
+
+  stream.next_in = (Bytef *) input->str;
+  stream.avail_in = input->len;
+  stream.next_out = (Bytef *) output->str;
+  stream.avail_out = output->len;
+
+  gint result = deflate(&stream, Z_FINISH);
+  deflateEnd(&stream);
+
+  if (result != Z_STREAM_END)
+    {
+      msg_error("Error compressing metrics for the stats HTTP endpoint",
+                evt_tag_int("zlib_error", result));
+      g_string_free(output, TRUE);
+      return NULL;
+    }
+
+  g_string_set_size(output, stream.total_out);
+  return output;
+}
+
+#endif
+
+static void
+_append_record(const gchar *record, gpointer user_data)
+{
+  GString *body = (GString *) user_data;
+
+  g_string_append(body, record);
+}
+
+static void
+_render_metrics(StatsHttpServer *self)
+{
+  GString *body = g_string_sized_new(self->body ? self->body->len + 1024 : 4096);
+  stats_generate_prometheus(_append_record, body, FALSE, &self->cancelled);
+
+  guint64 hash = _hash_body(body);
+  if (self->body && hash == self->body_hash && g_string_equal(body, self->body))
+    {
+      g_string_free(body, TRUE);
+      return;
+    }
+
+  if (self->body)
+    g_string_free(self->body, TRUE);
+  if (self->gzipped_body)
+    g_string_free(self->gzipped_body, TRUE);
+
+  self->body = body;
+  self->body_hash = hash;
+  self->gzipped_body = NULL;
+}
+
+static gboolean
+_is_zero_qvalue(const gchar *param)
+{
+  while (g_ascii_isspace(*param))
+    param++;
+
+  if (param[0] != 'q' || param[1] != '=')
+    return FALSE;
+
+  return g_ascii_strtod(&param[2], NULL) == 0.0;
+}
+
+static gboolean
+_accepts_gzip(const gchar *accept_encoding)
+{
+  gboolean result = FALSE;
+  gchar **codings = g_strsplit(accept_encoding, ",", -1);
+
+  for (gint i = 0; codings[i]; i++)
+    {
+      gchar **params = g_strsplit(codings[i], ";", 2);
+      const gchar *coding = g_strstrip(params[0]);
+      gboolean acceptable = !params[1] || !_is_zero_qvalue(params[1]);
+
+      if (g_ascii_strcasecmp(coding, "gzip") == 0)
+        {
+          result = acceptable;
+          g_strfreev(params);
+          break;
+        }
+
+      if (strcmp(coding, "*") == 0)
+        result = acceptable;
+
+      g_strfreev(params);
+    }
+
+  g_strfreev(codings);
+  return result;
+}
+
+static gboolean
+_etag_matches(const gchar *if_none_match, const gchar *etag)
+{
+  gboolean result = FALSE;
+  gchar **tags = g_strsplit(if_none_match, ",", -1);
+
+  for (gint i = 0; tags[i] && !result; i++)
+    {
+      const gchar *tag = g_strstrip(tags[i]);
+
+      /* If-None-Match uses the weak comparison */
+      if (g_str_has_prefix(tag, "W/"))
+        tag += 2;
+
+      result = strcmp(tag, "*") == 0 || strcmp(tag, etag) == 0;
+    }
+
+  g_strfreev(tags);
+  return result;
+}
+
+static gboolean
+_parse_request(const gchar *request, StatsHttpRequest *parsed)
+{
+  gboolean result = FALSE;
+  gchar **lines = g_strsplit(request, "\n", -1);
+
+  for (gint i = 0; lines[i]; i++)
+    g_strchomp(lines[i]);
+
+  gchar **request_line = g_strsplit(lines[0] ? lines[0] : "", " ", 3);
+  if (g_strv_length(request_line) != 3 || !g_str_has_prefix(request_line[2], "HTTP/1."))
+    goto exit;
+
+  parsed->method = g_strdup(request_line[0]);
+  parsed->path = g_strndup(request_line[1], strcspn(request_line[1], "?"));
+
+  for (gint i = 1; lines[i] && lines[i][0]; i++)
+    {
+      gchar *colon = strchr(lines[i], ':');
+      if (!colon)
+        continue;
+
+      *colon = '\0';
+      const gchar *name = lines[i];
+      gchar *value = g_strstrip(colon + 1);
+
+      if (g_ascii_strcasecmp(name, "Accept-Encoding") == 0)
+        {
+          parsed->accepts_gzip = _accepts_gzip(value);
+        }
+      else if (g_ascii_strcasecmp(name, "If-None-Match") == 0)
+        {
+          g_free(parsed->if_none_match);
+          parsed->if_none_match = g_strdup(value);
+        }
+    }
+  result = TRUE;
+
+exit:
+  g_strfreev(request_line);
+  g_strfreev(lines);
+  return result;
+}
+
+static void
+_request_clear(StatsHttpRequest *parsed)
+{
+  g_free(parsed->method);
+  g_free(parsed->path);
+  g_free(parsed->if_none_match);
+}
+
+static void
+_format_error(GString *response, const gchar *status, const gchar *extra_headers)
+{
+  g_string_append_printf(response,
+                         "HTTP/1.1 %s\r\n"
+                         "Content-Type: text/plain; charset=utf-8\r\n"
+                         "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+                         "%s"
+                         "Connection: close\r\n"
+                         "\r\n"
+                         "%s\n",
+                         status, strlen(status) + 1, extra_headers ? extra_headers : "", status);
+}
+
+void
+stats_http_server_format_response(StatsHttpServer *self, const gchar *request, GString *response)
+{
+  StatsHttpRequest parsed = {0};
+
+  if (!_parse_request(request, &parsed))
+    {
+      _format_error(response, "400 Bad Request", NULL);
+      goto exit;
+    }
+
+  gboolean head = strcmp(parsed.method, "HEAD") == 0;
+  if (!head && strcmp(parsed.method, "GET") != 0)
+    {
+      _format_error(response, "405 Method Not Allowed", "Allow: GET, HEAD\r\n");
+      goto exit;
+    }
+
+  if (strcmp(parsed.path, "/metrics") != 0 && strcmp(parsed.path, "/") != 0)
+    {
+      _format_error(response, "404 Not Found", NULL);
+      goto exit;
+    }
+
+  _render_metrics(self);
+
+  const GString *body = self->body;
+  const gchar *content_encoding = NULL;
+
+#if SYSLOG_NG_HAVE_LIBZ
+  if (parsed.accepts_gzip)
+    {
+      if (!self->gzipped_body)
+        self->gzipped_body = _gzip(self->body);
+
+      if (self->gzipped_body)
+        {
+          body = self->gzipped_body;
+          content_encoding = "gzip";
+        }
+    }
+#endif
+
+  /* each representation needs its own strong validator */
+  gchar etag[64];
+  g_snprintf(etag, sizeof(etag), "\"%016" G_GINT64_MODIFIER "x%s\"", self->body_hash,
+             content_encoding ? "-gzip" : "");
+
+  if (parsed.if_none_match && _etag_matches(parsed.if_none_match, etag))
+    {
+      g_string_append_printf(response,
+                             "HTTP/1.1 304 Not Modified\r\n"
+                             "ETag: %s\r\n"
+                             "Vary: Accept-Encoding\r\n"
+                             "Connection: close\r\n"
+                             "\r\n",
+                             etag);
+      goto exit;
+    }
+
+  g_string_append_printf(response,
+                         "HTTP/1.1 200 OK\r\n"
+                         "Content-Type: " STATS_HTTP_CONTENT_TYPE "\r\n"
+                         "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+                         "ETag: %s\r\n"
+                         "Vary: Accept-Encoding\r\n",
+                         body->len, etag);
+  if (content_encoding)
+    g_string_append_printf(response, "Content-Encoding: %s\r\n", content_encoding);
+  g_string_append(response, "Connection: close\r\n\r\n");
+
+  if (!head)
+    g_string_append_len(response, body->str, body->len);
+
+exit:
+  _request_clear(&parsed);
+}
+
+/*
+ * Connections are served by a non-blocking poll() loop, so a slow or idle
+ * client does not hold up the others: each of them gets
+ * STATS_HTTP_IO_TIMEOUT_SEC to send its request and to receive the
+ * response, and is dropped afterwards.
+ */
+typedef struct _StatsHttpConnection
+{
+  gint fd;
+  GString *request;
+  GString *response;
+  gsize written;
+  gint64 deadline;
+} StatsHttpConnection;
+
+static StatsHttpConnection *
+_connection_new(gint fd)
+{
+  StatsHttpConnection *self = g_new0(StatsHttpConnection, 1);
+
+  self->fd = fd;
+  self->request = g_string_sized_new(512);
+  self->deadline = g_get_monotonic_time() + STATS_HTTP_IO_TIMEOUT_SEC * G_USEC_PER_SEC;
+  return self;
+}
+
+static void
+_connection_free(StatsHttpConnection *self)
+{
+  close(self->fd);
+  g_string_free(self->request, TRUE);
+  if (self->response)
+    g_string_free(self->response, TRUE);
+  g_free(self);
+}
+
+static gboolean
+_is_request_complete(const GString *request)
+{
+  return strstr(request->str, "\r\n\r\n") || strstr(request->str, "\n\n");
+}
+
+/* returns FALSE if the connection is to be closed */
+static gboolean
+_connection_write(StatsHttpConnection *self)
+{
+  while (self->written < self->response->len)
+    {
+      gssize rc = write(self->fd, self->response->str + self->written, self->response->len - self->written);
+      if (rc < 0 && errno == EINTR)
+        continue;
+      if (rc < 0 && errno == EAGAIN)
+        return TRUE;
+      if (rc <= 0)
+        {
+          msg_debug("Error sending metrics over HTTP",
+                    evt_tag_error("error"));
+          return FALSE;
+        }
+
+      self->written += rc;
+    }
+  return FALSE;
+}
+
+/* returns FALSE if the connection is to be closed */
+static gboolean
+_connection_read(StatsHttpServer *self, StatsHttpConnection *connection)
+{
+  gchar buffer[1024];
+
+  while (!_is_request_complete(connection->request))
+    {
+      if (connection->request->len >= STATS_HTTP_MAX_REQUEST_SIZE)
+        return FALSE;
+
+      gssize rc = read(connection->fd, buffer, sizeof(buffer));
+      if (rc < 0 && errno == EINTR)
+        continue;
+      if (rc < 0 && errno == EAGAIN)
+        return TRUE;
+      if (rc <= 0)
+        return FALSE;
+
+      g_string_append_len(connection->request, buffer, rc);
+    }
+
+  connection->response = g_string_sized_new(self->body ? self->body->len + 512 : 4096);
+  stats_http_server_format_response(self, connection->request->str, connection->response);
+  scratch_buffers_explicit_gc();
+
+  return _connection_write(connection);
+}
+
+static gboolean
+_connection_process(StatsHttpServer *self, StatsHttpConnection *connection, gshort revents)
+{
+  if (revents & POLLNVAL)
+    return FALSE;
+
+  if (connection->response)
+    return (revents & (POLLOUT | POLLERR | POLLHUP)) ? _connection_write(connection) : TRUE;
+
+  return (revents & (POLLIN | POLLERR | POLLHUP)) ? _connection_read(self, connection) : TRUE;
+}
+
+static void
+_accept_connections(StatsHttpServer *self, GPtrArray *connections)
+{
+  while (connections->len < STATS_HTTP_MAX_CONNECTIONS)
+    {
+      gint fd = accept(self->listen_fd, NULL, NULL);
+      if (fd < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return;
+        }
+
+      g_fd_set_nonblock(fd, TRUE);
+      g_fd_set_cloexec(fd, TRUE);
+      g_ptr_array_add(connections, _connection_new(fd));
+    }
+}
+
+static gint
+_poll_timeout(GPtrArray *connections, gint64 now)
+{
+  if (connections->len == 0)
+    return -1;
+
+  gint64 first_deadline = G_MAXINT64;
+  for (guint i = 0; i < connections->len; i++)
+    {
+      StatsHttpConnection *connection = g_ptr_array_index(connections, i);
+      first_deadline = MIN(first_deadline, connection->deadline);
+    }
+
+  /* round up, so that we do not wake up right before the deadline */
+  return first_deadline <= now ? 0 : (gint) ((first_deadline - now + 999) / 1000);
+}
+
+enum
+{
+  STATS_HTTP_POLL_WAKEUP,
+  STATS_HTTP_POLL_LISTEN,
+  STATS_HTTP_POLL_CONNECTIONS
+};
+
+static gboolean
+_poll_and_serve(StatsHttpServer *self, GPtrArray *connections, struct pollfd *fds)
+{
+  fds[STATS_HTTP_POLL_WAKEUP] = (struct pollfd)
+  {
+    .fd = self->wakeup_fds[0], .events = POLLIN
+  };
+  /* stop accepting while all the connection slots are in use */
+  fds[STATS_HTTP_POLL_LISTEN] = (struct pollfd)
+  {
+    .fd = connections->len < STATS_HTTP_MAX_CONNECTIONS ? self->listen_fd : -1, .events = POLLIN
+  };
+  for (guint i = 0; i < connections->len; i++)
+    {
+      StatsHttpConnection *connection = g_ptr_array_index(connections, i);
+      fds[STATS_HTTP_POLL_CONNECTIONS + i] = (struct pollfd)
+      {
+        .fd = connection->fd, .events = connection->response ? POLLOUT : POLLIN
+      };
+    }
+
+  gint nfds = STATS_HTTP_POLL_CONNECTIONS + connections->len;
+  if (poll(fds, nfds, _poll_timeout(connections, g_get_monotonic_time())) < 0)
+    {
+      if (errno == EINTR)
+        return TRUE;
+
+      msg_error("Error waiting for HTTP requests, stats HTTP endpoint stopped",
+                evt_tag_str("listen", self->listen_address),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+
+  if (fds[STATS_HTTP_POLL_WAKEUP].revents)
+    return FALSE;
+
+  gint64 now = g_get_monotonic_time();
+  guint connections_polled = connections->len;
+  for (guint i = connections_polled; i > 0; i--)
+    {
+      StatsHttpConnection *connection = g_ptr_array_index(connections, i - 1);
+      gshort revents = fds[STATS_HTTP_POLL_CONNECTIONS + i - 1].revents;
+
+      if (!_connection_process(self, connection, revents) || connection->deadline <= now)
+        g_ptr_array_remove_index_fast(connections, i - 1);
+    }
+
+  if (fds[STATS_HTTP_POLL_LISTEN].revents & POLLIN)
+    _accept_connections(self, connections);
+
+  return TRUE;
+}
+
+static gpointer
+_server_thread(gpointer user_data)
+{
+  StatsHttpServer *self = (StatsHttpServer *) user_data;
+  GPtrArray *connections = g_ptr_array_new_with_free_func((GDestroyNotify) _connection_free);
+  struct pollfd fds[STATS_HTTP_POLL_CONNECTIONS + STATS_HTTP_MAX_CONNECTIONS];
+
+  scratch_buffers_allocator_init();
+
+  while (_poll_and_serve(self, connections, fds))
+    ;
+
+  g_ptr_array_free(connections, TRUE);
+  scratch_buffers_allocator_deinit();
+  timeutils_cache_deinit();
+  return NULL;
+}
+
+/* host:port, [ipv6]:port or a bare port to listen on all interfaces */
+static gboolean
+_split_listen_address(const gchar *listen_address, gchar **host, gchar **port)
+{
+  const gchar *colon = strrchr(listen_address, ':');
+
+  if (!colon)
+    {
+      *host = NULL;
+      *port = g_strdup(listen_address);
+      return TRUE;
+    }
+
+  const gchar *host_start = listen_address;
+  const gchar *host_end = colon;
+  if (*host_start == '[')
+    {
+      if (host_end - host_start < 2 || *(host_end - 1) != ']')
+        return FALSE;
+      host_start++;
+      host_end--;
+    }
+
+  *host = host_end > host_start ? g_strndup(host_start, host_end - host_start) : NULL;
+  *port = g_strdup(colon + 1);
+  return TRUE;
+}
+
+static gint
+_open_listener(const gchar *listen_address)
+{
+  gchar *host, *port;
+
+  if (!_split_listen_address(listen_address, &host, &port))
+    {
+      msg_error("Invalid stats HTTP listen address, expecting host:port, [ipv6]:port or port",
+                evt_tag_str("listen", listen_address));
+      return -1;
+    }
+
+  struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = AI_PASSIVE };
+  struct addrinfo *addresses;
+  gint fd = -1;
+
+  gint gai_result = getaddrinfo(host, port, &hints, &addresses);
+  if (gai_result != 0)
+    {
+      msg_error("Error resolving stats HTTP listen address",
+                evt_tag_str("listen", listen_address),
+                evt_tag_str("error", gai_strerror(gai_result)));
+      goto exit;
+    }
+
+  for (struct addrinfo *addr = addresses; addr; addr = addr->ai_next)
+    {
+      fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+      if (fd < 0)
+        continue;
+
+      gint on = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      g_fd_set_cloexec(fd, TRUE);
+      g_fd_set_nonblock(fd, TRUE);
+
+      if (bind(fd, addr->ai_addr, addr->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0)
+        break;
+
+      msg_error("Error binding stats HTTP listener",
+                evt_tag_str("listen", listen_address),
+                evt_tag_error("error"));
+      close(fd);
+      fd = -1;
+    }
+  freeaddrinfo(addresses);
+
+exit:
+  g_free(host);
+  g_free(port);
+  return fd;
+}
+
+gboolean
+stats_http_server_start(StatsHttpServer *self)
+{
+  g_assert(!self->thread);
+
+  self->listen_fd = _open_listener(self->listen_address);
+  if (self->listen_fd < 0)
+    return FALSE;
+
+  if (pipe(self->wakeup_fds) < 0)
+    {
+      msg_error("Error creating wakeup pipe for the stats HTTP endpoint",
+                evt_tag_error("error"));
+      close(self->listen_fd);
+      self->listen_fd = -1;
+      return FALSE;
+    }
+  g_fd_set_cloexec(self->wakeup_fds[0], TRUE);
+  g_fd_set_cloexec(self->wakeup_fds[1], TRUE);
+
+  self->cancelled = FALSE;
+  self->thread = g_thread_new("stats-http", _server_thread, self);
+
+  msg_verbose("Serving metrics over HTTP",
+              evt_tag_str("listen", self->listen_address));
+  return TRUE;
+}
+
+void
+stats_http_server_stop(StatsHttpServer *self)
+{
+  if (!self->thread)
+    return;
+
+  self->cancelled = TRUE;
+  while (write(self->wakeup_fds[1], "x", 1) < 0 && errno == EINTR)
+    ;
+
+  g_thread_join(self->thread);
+  self->thread = NULL;
+
+  close(self->wakeup_fds[0]);
+  close(self->wakeup_fds[1]);
+  close(self->listen_fd);
+  self->wakeup_fds[0] = self->wakeup_fds[1] = -1;
+  self->listen_fd = -1;
+}
+
+const gchar *
+stats_http_server_get_listen_address(StatsHttpServer *self)
+{
+  return self->listen_address;
+}
+
+StatsHttpServer *
+stats_http_server_new(const gchar *listen_address)
+{
+  StatsHttpServer *self = g_new0(StatsHttpServer, 1);
+
+  self->listen_address = g_strdup(listen_address);
+  self->listen_fd = -1;
+  self->wakeup_fds[0] = self->wakeup_fds[1] = -1;
+  return self;
+}
+
+void
+stats_http_server_free(StatsHttpServer *self)
+{
+  stats_http_server_stop(self);
+
+  if (self->body)
+    g_string_free(self->body, TRUE);
+  if (self->gzipped_body)
+    g_string_free(self->gzipped_body, TRUE);
+  g_free(self->listen_address);
+  g_free(self);
+}
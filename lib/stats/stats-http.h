@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef STATS_HTTP_H_INCLUDED
+#define STATS_HTTP_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/*
+ * A minimal HTTP/1.1 server that exposes the metrics in the Prometheus text
+ * format on its own thread, so that scrapers neither have to go through the
+ * control socket nor do they interfere with the main loop.
+ */
+typedef struct _StatsHttpServer StatsHttpServer;
+
+StatsHttpServer *stats_http_server_new(const gchar *listen_address);
+gboolean stats_http_server_start(StatsHttpServer *self);
+void stats_http_server_stop(StatsHttpServer *self);
+void stats_http_server_free(StatsHttpServer *self);
+
+const gchar *stats_http_server_get_listen_address(StatsHttpServer *self);
+
+/* processes a single, complete request header, exposed for testing */
+void stats_http_server_format_response(StatsHttpServer *self, const gchar *request, GString *response);
+
+#endif
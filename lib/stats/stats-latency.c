@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "stats-latency.h"
+#include "stats-cluster-histogram.h"
+#include "stats-registry.h"
+
+/* protects against unbounded growth if a transport never acknowledges */
+#define STATS_LATENCY_MAX_PENDING_SAMPLES 1024
+
+typedef struct _StatsLatencySample
+{
+  guint64 seq;
+  UnixTime received;
+} StatsLatencySample;
+
+static gint64
+_elapsed_usec(const UnixTime *received)
+{
+  UnixTime now;
+
+  unix_time_set_now(&now);
+  gint64 diff = (now.ut_sec - received->ut_sec) * G_USEC_PER_SEC + (now.ut_usec - received->ut_usec);
+
+  /* the receive timestamp may come from a clock that is slightly ahead */
+  return MAX(diff, 0);
+}
+
+static void
+_drop_pending_samples(StatsLatencyTracker *self)
+{
+  StatsLatencySample *sample;
+
+  while ((sample = g_queue_pop_head(&self->pending)))
+    g_free(sample);
+}
+
+void
+stats_latency_tracker_set_keys(StatsLatencyTracker *self, StatsClusterKeyBuilder *builder)
+{
+  if (self->write_latency_key)
+    stats_cluster_key_free(self->write_latency_key);
+  if (self->ack_latency_key)
+    stats_cluster_key_free(self->ack_latency_key);
+
+  stats_cluster_key_builder_push(builder);
+  {
+    stats_cluster_key_builder_set_unit(builder, SCU_MICROSECONDS);
+
+    stats_cluster_key_builder_set_name(builder, "output_write_latency_seconds");
+    self->write_latency_key = stats_cluster_key_builder_build_histogram(builder);
+
+    stats_cluster_key_builder_set_name(builder, "output_ack_latency_seconds");
+    self->ack_latency_key = stats_cluster_key_builder_build_histogram(builder);
+  }
+  stats_cluster_key_builder_pop(builder);
+}
+
+/* must be called with stats_lock() held */
+void
+stats_latency_tracker_register(StatsLatencyTracker *self, gint level)
+{
+  g_assert(self->write_latency_key && self->ack_latency_key);
+
+  gint sampling = stats_latency_sampling();
+  if (sampling <= 0)
+    return;
+
+  stats_register_histogram(level, self->write_latency_key, &self->write_latency);
+  stats_register_histogram(level, self->ack_latency_key, &self->ack_latency);
+
+  if (self->write_latency || self->ack_latency)
+    self->sampling = sampling;
+}
+
+/* must be called with stats_lock() held */
+void
+stats_latency_tracker_unregister(StatsLatencyTracker *self)
+{
+  if (self->write_latency_key)
+    stats_unregister_histogram(self->write_latency_key, &self->write_latency);
+  if (self->ack_latency_key)
+    stats_unregister_histogram(self->ack_latency_key, &self->ack_latency);
+
+  self->sampling = 0;
+  self->written = 0;
+  self->acked = 0;
+  _drop_pending_samples(self);
+}
+
+void
+stats_latency_tracker_clear(StatsLatencyTracker *self)
+{
+  _drop_pending_samples(self);
+
+  if (self->write_latency_key)
+    stats_cluster_key_free(self->write_latency_key);
+  self->write_latency_key = NULL;
+
+  if (self->ack_latency_key)
+    stats_cluster_key_free(self->ack_latency_key);
+  self->ack_latency_key = NULL;
+}
+
+void
+stats_latency_tracker_track_sample(StatsLatencyTracker *self, const UnixTime *received, gboolean written)
+{
+  if (written)
+    stats_histogram_observe(self->write_latency, _elapsed_usec(received));
+
+  if (!self->ack_latency)
+    return;
+
+  if (self->pending.length >= STATS_LATENCY_MAX_PENDING_SAMPLES)
+    g_free(g_queue_pop_head(&self->pending));
+
+  StatsLatencySample *sample = g_new(StatsLatencySample, 1);
+  sample->seq = self->written;
+  sample->received = *received;
+  g_queue_push_tail(&self->pending, sample);
+}
+
+static void
+_advance_acked(StatsLatencyTracker *self, gint num_msgs, gboolean observe)
+{
+  if (!stats_latency_tracker_is_enabled(self))
+    return;
+
+  /* acks of messages written before the tracker was registered */
+  self->acked = MIN(self->acked + num_msgs, self->written);
+
+  StatsLatencySample *sample;
+  while ((sample = g_queue_peek_head(&self->pending)) && sample->seq < self->acked)
+    {
+      if (observe)
+        stats_histogram_observe(self->ack_latency, _elapsed_usec(&sample->received));
+      g_free(g_queue_pop_head(&self->pending));
+    }
+}
+
+void
+stats_latency_tracker_ack(StatsLatencyTracker *self, gint num_msgs)
+{
+  _advance_acked(self, num_msgs, TRUE);
+}
+
+void
+stats_latency_tracker_drop(StatsLatencyTracker *self, gint num_msgs)
+{
+  _advance_acked(self, num_msgs, FALSE);
+}
+
+/* rewinds the last @num_msgs written messages, they will be written (and
+ * possibly sampled) again */
+void
+stats_latency_tracker_rewind(StatsLatencyTracker *self, gint num_msgs)
+{
+  if (!stats_latency_tracker_is_enabled(self))
+    return;
+
+  self->written = MAX(self->written - MIN((guint64) num_msgs, self->written), self->acked);
+
+  StatsLatencySample *sample;
+  while ((sample = g_queue_peek_tail(&self->pending)) && sample->seq >= self->written)
+    g_free(g_queue_pop_tail(&self->pending));
+}
+
+void
+stats_latency_tracker_rewind_all(StatsLatencyTracker *self)
+{
+  if (!stats_latency_tracker_is_enabled(self))
+    return;
+
+  self->written = self->acked;
+  _drop_pending_samples(self);
+}
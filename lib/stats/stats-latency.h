@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef STATS_LATENCY_H_INCLUDED
+#define STATS_LATENCY_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "stats-cluster-key-builder.h"
+#include "stats-histogram.h"
+#include "timeutils/unixtime.h"
+
+/*
+ * StatsLatencyTracker measures how long it takes for a message to get from
+ * the source (its receive timestamp) to the destination:
+ *
+ *   - receive-to-write: until the message is handed over to the transport,
+ *   - receive-to-ack: until the destination confirms the delivery.
+ *
+ * Only every Nth message is sampled, as configured by
+ * stats(latency-sampling()), so the clock is not read on the fast path.
+ *
+ * Acknowledgements arrive as counts, in the same order as the messages
+ * were written, so the tracker numbers written messages and keeps the
+ * receive timestamps of the sampled ones until the acknowledgement counter
+ * passes them.  This is the same protocol LogQueue uses for its backlog,
+ * the tracker has to be notified about acks, drops and rewinds the same
+ * way the backlog is.
+ *
+ * A tracker is owned by a single thread (a LogWriter or a threaded
+ * destination worker), it is not thread safe.
+ */
+typedef struct _StatsLatencyTracker
+{
+  gint sampling;
+  guint64 written;
+  guint64 acked;
+  GQueue pending;
+
+  StatsClusterKey *write_latency_key;
+  StatsClusterKey *ack_latency_key;
+  StatsHistogram *write_latency;
+  StatsHistogram *ack_latency;
+} StatsLatencyTracker;
+
+void stats_latency_tracker_set_keys(StatsLatencyTracker *self, StatsClusterKeyBuilder *builder);
+void stats_latency_tracker_register(StatsLatencyTracker *self, gint level);
+void stats_latency_tracker_unregister(StatsLatencyTracker *self);
+void stats_latency_tracker_clear(StatsLatencyTracker *self);
+
+void stats_latency_tracker_track_sample(StatsLatencyTracker *self, const UnixTime *received, gboolean written);
+void stats_latency_tracker_ack(StatsLatencyTracker *self, gint num_msgs);
+void stats_latency_tracker_drop(StatsLatencyTracker *self, gint num_msgs);
+void stats_latency_tracker_rewind(StatsLatencyTracker *self, gint num_msgs);
+void stats_latency_tracker_rewind_all(StatsLatencyTracker *self);
+
+static inline gboolean
+stats_latency_tracker_is_enabled(StatsLatencyTracker *self)
+{
+  return self->sampling > 0;
+}
+
+/* @written is FALSE if the message went to the backlog without being
+ * accepted by the transport (e.g. an insert() that is going to be retried),
+ * in which case only its position is accounted for. */
+static inline void
+stats_latency_tracker_track(StatsLatencyTracker *self, const UnixTime *received, gboolean written)
+{
+  if (!stats_latency_tracker_is_enabled(self))
+    return;
+
+  if (self->written % self->sampling == 0)
+    stats_latency_tracker_track_sample(self, received, written);
+  self->written++;
+}
+
+#endif
@@ -25,6 +25,7 @@
 #include "stats/stats-registry.h"
 #include "stats/stats-cluster.h"
 #include "stats/stats-counter.h"
+#include "stats/stats-cluster-histogram.h"
 #include "timeutils/unixtime.h"
 #include "str-utils.h"
 #include "scratch-buffers.h"
@@ -109,13 +110,11 @@ stats_format_prometheus_sanitize_name(const gchar *name)
   return sanitized_name->str;
 }
 
-gchar *
-stats_format_prometheus_format_value(const StatsClusterKey *key, StatsCounterItem *counter)
+static gchar *
+_format_stored_value(const StatsClusterKey *key, guint64 stored_value)
 {
   GString *value = scratch_buffers_alloc();
 
-  gsize stored_value = stats_counter_get(counter);
-
   guint64 converted_int = stored_value;
   gdouble converted_double = stored_value;
   gchar double_buf[G_ASCII_DTOSTR_BUF_SIZE];
@@ -150,6 +149,11 @@ stats_format_prometheus_format_value(const StatsClusterKey *key, StatsCounterIte
       g_string_assign(value, g_ascii_dtostr(double_buf, G_N_ELEMENTS(double_buf), converted_double));
       break;
 
+    case SCU_MICROSECONDS:
+      converted_double /= 1e6;
+      g_string_assign(value, g_ascii_dtostr(double_buf, G_N_ELEMENTS(double_buf), converted_double));
+      break;
+
     case SCU_MILLISECONDS:
       converted_double /= 1e3;
       g_string_assign(value, g_ascii_dtostr(double_buf, G_N_ELEMENTS(double_buf), converted_double));
@@ -157,13 +161,19 @@ stats_format_prometheus_format_value(const StatsClusterKey *key, StatsCounterIte
 
     default:
       /* no conversion */
-      g_string_printf(value, "%"G_GSIZE_FORMAT, stored_value);
+      g_string_printf(value, "%"G_GUINT64_FORMAT, stored_value);
       break;
     }
 
   return value->str;
 }
 
+gchar *
+stats_format_prometheus_format_value(const StatsClusterKey *key, StatsCounterItem *counter)
+{
+  return _format_stored_value(key, stats_counter_get(counter));
+}
+
 static inline void
 _append_formatted_label(GString *serialized_labels, const StatsClusterLabel *label)
 {
@@ -221,21 +231,20 @@ _format_labels(StatsCluster *sc, gint type)
   return serialized_labels->str;
 }
 
-static GString *
-_format_legacy(StatsCluster *sc, gint type, StatsCounterItem *counter)
+static void
+_render_legacy_series(StatsCluster *sc, gint type, GString *series)
 {
-  GString *record = scratch_buffers_alloc();
   GString *labels = scratch_buffers_alloc();
 
   gchar component[64];
 
-  g_string_append_printf(record, PROMETHEUS_METRIC_PREFIX "%s",
+  g_string_append_printf(series, PROMETHEUS_METRIC_PREFIX "%s",
                          stats_format_prometheus_sanitize_name(stats_cluster_get_component_name(sc, component, sizeof(component))));
 
   if (!sc->key.legacy.component || sc->key.legacy.component == SCS_GLOBAL)
     {
       if (!_is_str_empty(sc->key.legacy.id))
-        g_string_append_printf(record, "_%s", stats_format_prometheus_sanitize_name(sc->key.legacy.id));
+        g_string_append_printf(series, "_%s", stats_format_prometheus_sanitize_name(sc->key.legacy.id));
     }
   else
     {
@@ -254,35 +263,136 @@ _format_legacy(StatsCluster *sc, gint type, StatsCounterItem *counter)
 
   const gchar *type_name = stats_cluster_get_type_name(sc, type);
   if (g_strcmp0(type_name, "value") != 0)
-    g_string_append_printf(record, "_%s", stats_format_prometheus_sanitize_name(type_name));
+    g_string_append_printf(series, "_%s", stats_format_prometheus_sanitize_name(type_name));
 
   if (labels->len != 0)
-    g_string_append_printf(record, "{%s}", labels->str);
+    g_string_append_printf(series, "{%s}", labels->str);
+}
 
-  const gchar *metric_value = stats_format_prometheus_format_value(&sc->key, &sc->counter_group.counters[type]);
-  g_string_append_printf(record, " %s\n", metric_value);
+static void
+_render_series(StatsCluster *sc, gint type, GString *series)
+{
+  g_string_append_printf(series, PROMETHEUS_METRIC_PREFIX "%s", stats_format_prometheus_sanitize_name(sc->key.name));
 
-  return record;
+  const gchar *labels = _format_labels(sc, type);
+  if (labels)
+    g_string_append_printf(series, "{%s}", labels);
 }
 
-GString *
-stats_prometheus_format_counter(StatsCluster *sc, gint type, StatsCounterItem *counter)
+/* The name and the labels of a series never change, so they are sanitized
+ * and rendered only once, a scrape only formats the values.  An empty
+ * string marks counters that are not exposed. */
+static const gchar *
+_get_series(StatsCluster *sc, gint type)
 {
+  if (!sc->prometheus_series)
+    {
+      sc->prometheus_series = g_new0(gchar *, sc->counter_group.capacity);
+      stats_cluster_account_memory(sc, sc->counter_group.capacity * sizeof(gchar *));
+    }
+
+  if (sc->prometheus_series[type])
+    return sc->prometheus_series[type];
+
   if (_is_timestamp(sc, type))
-    return NULL;
+    {
+      sc->prometheus_series[type] = g_strdup("");
+      return sc->prometheus_series[type];
+    }
+
+  ScratchBuffersMarker marker;
+  GString *series = scratch_buffers_alloc_and_mark(&marker);
 
   if (!sc->key.name)
-    return _format_legacy(sc, type, counter);
+    _render_legacy_series(sc, type, series);
+  else
+    _render_series(sc, type, series);
 
+  sc->prometheus_series[type] = g_strndup(series->str, series->len);
+  stats_cluster_account_memory(sc, series->len + 1);
+  scratch_buffers_reclaim_marked(marker);
+  return sc->prometheus_series[type];
+}
+
+static gboolean
+_append_record(GString *output, StatsCluster *sc, gint type)
+{
+  const gchar *series = _get_series(sc, type);
+
+  if (!series[0])
+    return FALSE;
+
+  g_string_append(output, series);
+  g_string_append_c(output, ' ');
+  g_string_append(output, stats_format_prometheus_format_value(&sc->key, &sc->counter_group.counters[type]));
+  g_string_append_c(output, '\n');
+  return TRUE;
+}
+
+static void
+_append_histogram_series(GString *output, const gchar *name, const gchar *suffix, const gchar *labels,
+                         const gchar *le, const gchar *value)
+{
+  g_string_append_printf(output, PROMETHEUS_METRIC_PREFIX "%s%s", name, suffix);
+
+  if (labels || le)
+    {
+      g_string_append_c(output, '{');
+      if (labels)
+        g_string_append(output, labels);
+      if (labels && le)
+        g_string_append_c(output, ',');
+      if (le)
+        g_string_append_printf(output, "le=\"%s\"", le);
+      g_string_append_c(output, '}');
+    }
+
+  g_string_append_printf(output, " %s\n", value);
+}
+
+/* Histograms are exposed in the classic text format: a cumulative _bucket
+ * series per upper bound, followed by _sum and _count.  The bounds and the
+ * sum are converted according to the unit of the cluster. */
+static void
+_append_histogram(GString *output, StatsCluster *sc)
+{
+  StatsHistogramSnapshot snapshot;
+  stats_histogram_snapshot(stats_cluster_histogram_get_histogram(sc), &snapshot);
+
+  const gchar *name = stats_format_prometheus_sanitize_name(sc->key.name);
+  const gchar *labels = _format_labels(sc, SC_TYPE_HISTOGRAM);
+  GString *value = scratch_buffers_alloc();
+
+  gsize cumulative_count = 0;
+  for (gint i = 0; i < STATS_HISTOGRAM_BUCKETS; i++)
+    {
+      cumulative_count += snapshot.buckets[i];
+      g_string_printf(value, "%" G_GSIZE_FORMAT, cumulative_count);
+
+      const gchar *le = (i < STATS_HISTOGRAM_BOUNDS)
+                        ? _format_stored_value(&sc->key, stats_histogram_get_bucket_bound(i))
+                        : "+Inf";
+      _append_histogram_series(output, name, "_bucket", labels, le, value->str);
+    }
+
+  _append_histogram_series(output, name, "_sum", labels, NULL, _format_stored_value(&sc->key, snapshot.sum));
+  g_string_printf(value, "%" G_GSIZE_FORMAT, snapshot.count);
+  _append_histogram_series(output, name, "_count", labels, NULL, value->str);
+}
+
+GString *
+stats_prometheus_format_counter(StatsCluster *sc, gint type, StatsCounterItem *counter)
+{
   GString *record = scratch_buffers_alloc();
-  g_string_append_printf(record, PROMETHEUS_METRIC_PREFIX "%s", stats_format_prometheus_sanitize_name(sc->key.name));
 
-  const gchar *labels = _format_labels(sc, type);
-  if (labels)
-    g_string_append_printf(record, "{%s}", labels);
+  if (stats_cluster_is_histogram(sc))
+    {
+      _append_histogram(record, sc);
+      return record;
+    }
 
-  const gchar *metric_value = stats_format_prometheus_format_value(&sc->key, &sc->counter_group.counters[type]);
-  g_string_append_printf(record, " %s\n", metric_value);
+  if (!_append_record(record, sc, type))
+    return NULL;
 
   return record;
 }
@@ -290,34 +400,65 @@ stats_prometheus_format_counter(StatsCluster *sc, gint type, StatsCounterItem *c
 static void
 stats_format_prometheus(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data)
 {
-  gpointer *args = (gpointer *) user_data;
-  StatsPrometheusRecordFunc process_record = (StatsPrometheusRecordFunc) args[0];
-  gpointer process_record_arg = args[1];
-  gboolean with_legacy = GPOINTER_TO_INT(args[2]);
-
-  if (!sc->key.name && !with_legacy)
-    return;
-
-  if (stats_cluster_is_orphaned(sc))
-    return;
+  GString *batch = (GString *) user_data;
 
   ScratchBuffersMarker marker;
   scratch_buffers_mark(&marker);
+  if (stats_cluster_is_histogram(sc))
+    _append_histogram(batch, sc);
+  else
+    _append_record(batch, sc, type);
+  scratch_buffers_reclaim_marked(marker);
+}
 
-  GString *record = stats_prometheus_format_counter(sc, type, counter);
-  if (!record)
-    return;
+/* number of clusters formatted between two process_record() calls */
+#define STATS_PROMETHEUS_BATCH_SIZE 1024
 
-  process_record(record->str, process_record_arg);
-  scratch_buffers_reclaim_marked(marker);
+static void
+_format_batch(GPtrArray *clusters, guint from, guint to, gboolean with_legacy, GString *batch)
+{
+  stats_lock();
+  for (guint i = from; i < to; i++)
+    {
+      StatsCluster *sc = g_ptr_array_index(clusters, i);
+
+      if (!sc->key.name && !with_legacy)
+        continue;
+
+      stats_lock_cluster(sc);
+      /* orphaned clusters may have been removed since the snapshot was taken */
+      if (!stats_cluster_is_orphaned(sc))
+        stats_cluster_foreach_counter(sc, stats_format_prometheus, batch);
+      stats_unlock_cluster(sc);
+    }
+  stats_unlock();
 }
 
+/* The cluster list is snapshotted first, the clusters are then formatted in
+ * batches, each cluster under the lock of its registry shard, so that
+ * registrations can proceed during a scrape of a large registry.
+ * process_record() is called outside of the lock, with one or more
+ * complete records. */
 void
 stats_generate_prometheus(StatsPrometheusRecordFunc process_record, gpointer user_data, gboolean with_legacy,
                           gboolean *cancelled)
 {
-  gpointer format_prometheus_args[] = {process_record, user_data, GINT_TO_POINTER(with_legacy)};
   stats_lock();
-  stats_foreach_counter(stats_format_prometheus, format_prometheus_args, cancelled);
+  GPtrArray *clusters = stats_get_clusters_snapshot();
   stats_unlock();
+
+  GString *batch = g_string_sized_new(4096);
+  for (guint from = 0; from < clusters->len; from += STATS_PROMETHEUS_BATCH_SIZE)
+    {
+      if (cancelled && *cancelled)
+        break;
+
+      _format_batch(clusters, from, MIN(from + STATS_PROMETHEUS_BATCH_SIZE, clusters->len), with_legacy, batch);
+      if (batch->len > 0)
+        process_record(batch->str, user_data);
+      g_string_truncate(batch, 0);
+    }
+  g_string_free(batch, TRUE);
+
+  g_ptr_array_free(clusters, TRUE);
 }
@@ -24,32 +24,95 @@
 #include "stats/stats-registry.h"
 #include "stats/stats-query.h"
 #include "cfg.h"
+#include "tls-support.h"
 #include <string.h>
 
-typedef struct _StatsClusterContainer
+/*
+ * Clusters are distributed into shards by the hash of their key, each shard
+ * with its own lock protecting its hash tables and the counters of its
+ * clusters.
+ *
+ * Operations on a single key (registration, lookup, unregistration and
+ * removal) only lock the shard of their key, so dynamic counters registered
+ * from different threads (metrics-probe, per-host stats) only contend when
+ * they hit the same shard.
+ *
+ * stats_lock() is the global registry lock, it is only required by the
+ * operations that walk the whole registry (foreach, snapshot, pruning), so
+ * that they are serialized against each other.  It may still be held while
+ * registering counters: the lock order is always the global lock first,
+ * then a shard lock.
+ *
+ * The dynamic cluster limit is checked against an atomic counter before
+ * the insertion, concurrent registrations in different shards may exceed
+ * it by a few clusters.
+ */
+#define STATS_REGISTRY_SHARDS 16
+
+typedef struct _StatsClusterShard
 {
+  GMutex lock;
   GHashTable *static_clusters;
   GHashTable *dynamic_clusters;
+} StatsClusterShard;
+
+typedef struct _StatsClusterContainer
+{
+  StatsClusterShard shards[STATS_REGISTRY_SHARDS];
+  gint number_of_dynamic_clusters;
 } StatsClusterContainer;
 
 static StatsClusterContainer stats_cluster_container;
 
+static GMutex stats_mutex;
+
+TLS_BLOCK_START
+{
+  gboolean stats_locked;
+}
+TLS_BLOCK_END;
+
+#define stats_locked __tls_deref(stats_locked)
+
+static inline StatsClusterShard *
+_get_shard(guint key_hash)
+{
+  return &stats_cluster_container.shards[key_hash % STATS_REGISTRY_SHARDS];
+}
+
+static inline StatsClusterShard *
+_lock_shard(guint key_hash)
+{
+  StatsClusterShard *shard = _get_shard(key_hash);
+
+  g_mutex_lock(&shard->lock);
+  return shard;
+}
+
+static inline void
+_unlock_shard(StatsClusterShard *shard)
+{
+  g_mutex_unlock(&shard->lock);
+}
+
 static guint
 _number_of_dynamic_clusters(void)
 {
-  return g_hash_table_size(stats_cluster_container.dynamic_clusters);
+  return g_atomic_int_get(&stats_cluster_container.number_of_dynamic_clusters);
 }
 
-static GMutex stats_mutex;
-gboolean stats_locked;
-
 static void
-_insert_cluster(StatsCluster *sc)
+_insert_cluster(StatsClusterShard *shard, StatsCluster *sc)
 {
   if (sc->dynamic)
-    g_hash_table_insert(stats_cluster_container.dynamic_clusters, &sc->key, sc);
+    {
+      g_hash_table_insert(shard->dynamic_clusters, &sc->key, sc);
+      g_atomic_int_inc(&stats_cluster_container.number_of_dynamic_clusters);
+    }
   else
-    g_hash_table_insert(stats_cluster_container.static_clusters, &sc->key, sc);
+    {
+      g_hash_table_insert(shard->static_clusters, &sc->key, sc);
+    }
 }
 
 void
@@ -62,22 +125,44 @@ stats_lock(void)
 void
 stats_unlock(void)
 {
+  g_assert(stats_locked);
   stats_locked = FALSE;
   g_mutex_unlock(&stats_mutex);
 }
 
+/* whether the calling thread holds stats_lock() */
+gboolean
+stats_is_locked(void)
+{
+  return stats_locked;
+}
+
+/* Protects the counters of a cluster obtained earlier from the registry
+ * (e.g. a dynamic counter handle) against concurrent registrations. */
+void
+stats_lock_cluster(StatsCluster *sc)
+{
+  _lock_shard(sc->key_hash);
+}
+
+void
+stats_unlock_cluster(StatsCluster *sc)
+{
+  _unlock_shard(_get_shard(sc->key_hash));
+}
+
 static StatsCluster *
-_grab_dynamic_cluster(const StatsClusterKey *sc_key)
+_grab_dynamic_cluster(StatsClusterShard *shard, const StatsClusterKey *sc_key)
 {
   StatsCluster *sc;
 
-  sc = g_hash_table_lookup(stats_cluster_container.dynamic_clusters, sc_key);
+  sc = g_hash_table_lookup(shard->dynamic_clusters, sc_key);
   if (!sc)
     {
       if (!stats_check_dynamic_clusters_limit(_number_of_dynamic_clusters()))
         return NULL;
       sc = stats_cluster_dynamic_new(sc_key);
-      _insert_cluster(sc);
+      _insert_cluster(shard, sc);
       if ( !stats_check_dynamic_clusters_limit(_number_of_dynamic_clusters()))
         {
           msg_warning("Number of dynamic cluster limit has been reached.",
@@ -90,32 +175,29 @@ _grab_dynamic_cluster(const StatsClusterKey *sc_key)
 }
 
 static StatsCluster *
-_grab_static_cluster(const StatsClusterKey *sc_key)
+_grab_static_cluster(StatsClusterShard *shard, const StatsClusterKey *sc_key)
 {
   StatsCluster *sc;
 
-  sc = g_hash_table_lookup(stats_cluster_container.static_clusters, sc_key);
+  sc = g_hash_table_lookup(shard->static_clusters, sc_key);
   if (!sc)
     {
       sc = stats_cluster_new(sc_key);
-      _insert_cluster(sc);
+      _insert_cluster(shard, sc);
     }
 
   return sc;
 }
 
 static StatsCluster *
-_grab_cluster(gint stats_level, const StatsClusterKey *sc_key, gboolean dynamic)
+_grab_cluster(StatsClusterShard *shard, const StatsClusterKey *sc_key, gboolean dynamic)
 {
-  if (!stats_check_level(stats_level))
-    return NULL;
-
   StatsCluster *sc = NULL;
 
   if (dynamic)
-    sc = _grab_dynamic_cluster(sc_key);
+    sc = _grab_dynamic_cluster(shard, sc_key);
   else
-    sc = _grab_static_cluster(sc_key);
+    sc = _grab_static_cluster(shard, sc_key);
 
   if (!sc)
     return NULL;
@@ -139,7 +221,26 @@ static void
 _update_counter_name_if_needed(StatsCounterItem *counter, StatsCluster *sc, gint type)
 {
   if (counter->name == NULL)
-    counter->name = _construct_counter_item_name(sc, type);
+    {
+      counter->name = _construct_counter_item_name(sc, type);
+      stats_cluster_account_memory(sc, strlen(counter->name) + 1);
+    }
+}
+
+/* must be called with the lock of the cluster's shard held */
+static StatsCounterItem *
+_track_counter(StatsCluster *sc, gint type)
+{
+  StatsCounterItem *ctr = stats_cluster_get_counter(sc, type);
+  StatsCounterItem *counter = stats_cluster_track_counter(sc, type);
+
+  if (!ctr || !ctr->external)
+    {
+      counter->external = FALSE;
+      counter->type = type;
+      _update_counter_name_if_needed(counter, sc, type);
+    }
+  return counter;
 }
 
 static StatsCluster *
@@ -148,23 +249,16 @@ _register_counter(gint stats_level, const StatsClusterKey *sc_key, gint type,
 {
   StatsCluster *sc;
 
-  g_assert(stats_locked);
+  *counter = NULL;
+  if (!stats_check_level(stats_level))
+    return NULL;
 
-  sc = _grab_cluster(stats_level, sc_key, dynamic);
+  StatsClusterShard *shard = _lock_shard(stats_cluster_key_hash(sc_key));
+  sc = _grab_cluster(shard, sc_key, dynamic);
   if (sc)
-    {
-      StatsCounterItem *ctr = stats_cluster_get_counter(sc, type);
-      *counter = stats_cluster_track_counter(sc, type);
-      if (ctr && ctr->external)
-        return sc;
-      (*counter)->external = FALSE;
-      (*counter)->type = type;
-      _update_counter_name_if_needed(*counter, sc, type);
-    }
-  else
-    {
-      *counter = NULL;
-    }
+    *counter = _track_counter(sc, type);
+  _unlock_shard(shard);
+
   return sc;
 }
 
@@ -187,9 +281,11 @@ _register_external_counter(gint stats_level, const StatsClusterKey *sc_key, gint
   if (!external_counter)
     return NULL;
 
-  g_assert(stats_locked);
+  if (!stats_check_level(stats_level))
+    return NULL;
 
-  sc = _grab_cluster(stats_level, sc_key, dynamic);
+  StatsClusterShard *shard = _lock_shard(stats_cluster_key_hash(sc_key));
+  sc = _grab_cluster(shard, sc_key, dynamic);
   if (sc)
     {
       _assert_when_internal_or_stores_different_ref(sc, type, external_counter);
@@ -199,6 +295,7 @@ _register_external_counter(gint stats_level, const StatsClusterKey *sc_key, gint
       ctr->type = type;
       _update_counter_name_if_needed(ctr, sc, type);
     }
+  _unlock_shard(shard);
 
   return sc;
 }
@@ -253,26 +350,36 @@ stats_register_dynamic_counter(gint stats_level, const StatsClusterKey *sc_key,
  * @timestamp: if non-negative, an associated timestamp will be created and set
  *
  * Instantly create (if not exists) and increment a dynamic counter.
+ *
+ * This is called for each message (per-host stats), so it does not need
+ * stats_lock(): the whole register-increment-unregister sequence runs under
+ * the lock of the key's shard, thus the cluster is never seen half-updated
+ * by others.
  */
 void
 stats_register_and_increment_dynamic_counter(gint stats_level, const StatsClusterKey *sc_key,
                                              time_t timestamp)
 {
   StatsCounterItem *counter, *stamp;
-  StatsCluster *handle;
 
-  g_assert(stats_locked);
-  handle = stats_register_dynamic_counter(stats_level, sc_key, SC_TYPE_PROCESSED, &counter);
-  if (!handle)
+  if (!stats_check_level(stats_level))
     return;
-  stats_counter_inc(counter);
-  if (timestamp >= 0)
+
+  StatsClusterShard *shard = _lock_shard(stats_cluster_key_hash(sc_key));
+  StatsCluster *sc = _grab_cluster(shard, sc_key, TRUE);
+  if (sc)
     {
-      stats_register_associated_counter(handle, SC_TYPE_STAMP, &stamp);
-      stats_counter_set(stamp, timestamp);
-      stats_unregister_dynamic_counter(handle, SC_TYPE_STAMP, &stamp);
+      counter = _track_counter(sc, SC_TYPE_PROCESSED);
+      stats_counter_inc(counter);
+      if (timestamp >= 0)
+        {
+          stamp = _track_counter(sc, SC_TYPE_STAMP);
+          stats_counter_set(stamp, timestamp);
+          stats_cluster_untrack_counter(sc, SC_TYPE_STAMP, &stamp);
+        }
+      stats_cluster_untrack_counter(sc, SC_TYPE_PROCESSED, &counter);
     }
-  stats_unregister_dynamic_counter(handle, SC_TYPE_PROCESSED, &counter);
+  _unlock_shard(shard);
 }
 
 /**
@@ -287,15 +394,15 @@ stats_register_and_increment_dynamic_counter(gint stats_level, const StatsCluste
 void
 stats_register_associated_counter(StatsCluster *sc, gint type, StatsCounterItem **counter)
 {
-  g_assert(stats_locked);
-
   *counter = NULL;
   if (!sc)
     return;
   g_assert(sc->dynamic);
 
+  stats_lock_cluster(sc);
   *counter = stats_cluster_track_counter(sc, type);
   _update_counter_name_if_needed(*counter, sc, type);
+  stats_unlock_cluster(sc);
 }
 
 void
@@ -304,14 +411,13 @@ stats_unregister_counter(const StatsClusterKey *sc_key, gint type,
 {
   StatsCluster *sc;
 
-  g_assert(stats_locked);
-
   if (*counter == NULL)
     return;
 
-  sc = g_hash_table_lookup(stats_cluster_container.static_clusters, sc_key);
-
+  StatsClusterShard *shard = _lock_shard(stats_cluster_key_hash(sc_key));
+  sc = g_hash_table_lookup(shard->static_clusters, sc_key);
   stats_cluster_untrack_counter(sc, type, counter);
+  _unlock_shard(shard);
 }
 
 void
@@ -323,13 +429,13 @@ stats_unregister_external_counter(const StatsClusterKey *sc_key, gint type,
   if (!external_counter)
     return;
 
-  g_assert(stats_locked);
-
-  sc = g_hash_table_lookup(stats_cluster_container.static_clusters, sc_key);
+  StatsClusterShard *shard = _lock_shard(stats_cluster_key_hash(sc_key));
+  sc = g_hash_table_lookup(shard->static_clusters, sc_key);
   StatsCounterItem *ctr = stats_cluster_get_counter(sc, type);
   g_assert(ctr->value_ref == external_counter);
 
   stats_cluster_untrack_counter(sc, type, &ctr);
+  _unlock_shard(shard);
 }
 
 void
@@ -341,44 +447,57 @@ stats_unregister_alias_counter(const StatsClusterKey *sc_key, gint type, StatsCo
 void
 stats_unregister_dynamic_counter(StatsCluster *sc, gint type, StatsCounterItem **counter)
 {
-  g_assert(stats_locked);
   if (!sc)
     return;
+
+  stats_lock_cluster(sc);
   stats_cluster_untrack_counter(sc, type, counter);
+  stats_unlock_cluster(sc);
 }
 
-StatsCluster *
-stats_get_cluster(const StatsClusterKey *sc_key)
+static StatsCluster *
+_lookup_cluster(StatsClusterShard *shard, const StatsClusterKey *sc_key)
 {
-  g_assert(stats_locked);
-
-  StatsCluster *sc = g_hash_table_lookup(stats_cluster_container.static_clusters, sc_key);
+  StatsCluster *sc = g_hash_table_lookup(shard->static_clusters, sc_key);
 
   if (!sc)
-    sc = g_hash_table_lookup(stats_cluster_container.dynamic_clusters, sc_key);
+    sc = g_hash_table_lookup(shard->dynamic_clusters, sc_key);
 
   return sc;
 }
 
-gboolean
-stats_remove_cluster(const StatsClusterKey *sc_key)
+/* The returned cluster is only guaranteed to stay in the registry as long
+ * as it has live counters, see stats_remove_cluster() */
+StatsCluster *
+stats_get_cluster(const StatsClusterKey *sc_key)
+{
+  StatsClusterShard *shard = _lock_shard(stats_cluster_key_hash(sc_key));
+  StatsCluster *sc = _lookup_cluster(shard, sc_key);
+  _unlock_shard(shard);
+
+  return sc;
+}
+
+static gboolean
+_remove_cluster(StatsClusterShard *shard, const StatsClusterKey *sc_key)
 {
-  g_assert(stats_locked);
   StatsCluster *sc;
 
-  sc = g_hash_table_lookup(stats_cluster_container.dynamic_clusters, sc_key);
+  sc = g_hash_table_lookup(shard->dynamic_clusters, sc_key);
   if (sc)
     {
-      if (stats_cluster_is_orphaned(sc))
-        return g_hash_table_remove(stats_cluster_container.dynamic_clusters, sc_key);
-      return FALSE;
+      if (!stats_cluster_is_orphaned(sc))
+        return FALSE;
+
+      g_atomic_int_add(&stats_cluster_container.number_of_dynamic_clusters, -1);
+      return g_hash_table_remove(shard->dynamic_clusters, sc_key);
     }
 
-  sc = g_hash_table_lookup(stats_cluster_container.static_clusters, sc_key);
+  sc = g_hash_table_lookup(shard->static_clusters, sc_key);
   if (sc)
     {
       if (stats_cluster_is_orphaned(sc))
-        return g_hash_table_remove(stats_cluster_container.static_clusters, sc_key);
+        return g_hash_table_remove(shard->static_clusters, sc_key);
       return FALSE;
     }
 
@@ -386,65 +505,77 @@ stats_remove_cluster(const StatsClusterKey *sc_key)
 }
 
 gboolean
-stats_contains_counter(const StatsClusterKey *sc_key, gint type)
+stats_remove_cluster(const StatsClusterKey *sc_key)
 {
-  g_assert(stats_locked);
+  StatsClusterShard *shard = _lock_shard(stats_cluster_key_hash(sc_key));
+  gboolean result = _remove_cluster(shard, sc_key);
+  _unlock_shard(shard);
 
-  StatsCluster *sc = stats_get_cluster(sc_key);
-  if (!sc)
-    {
-      return FALSE;
-    }
+  return result;
+}
+
+gboolean
+stats_contains_counter(const StatsClusterKey *sc_key, gint type)
+{
+  StatsClusterShard *shard = _lock_shard(stats_cluster_key_hash(sc_key));
+  StatsCluster *sc = _lookup_cluster(shard, sc_key);
+  gboolean result = sc && stats_cluster_is_alive(sc, type);
+  _unlock_shard(shard);
 
-  return stats_cluster_is_alive(sc, type);
+  return result;
 }
 
 StatsCounterItem *
 stats_get_counter(const StatsClusterKey *sc_key, gint type)
 {
-  g_assert(stats_locked);
-  StatsCluster *sc = stats_get_cluster(sc_key);
+  StatsClusterShard *shard = _lock_shard(stats_cluster_key_hash(sc_key));
+  StatsCluster *sc = _lookup_cluster(shard, sc_key);
+  StatsCounterItem *counter = sc ? stats_cluster_get_counter(sc, type) : NULL;
+  _unlock_shard(shard);
 
-  if (!sc)
-    return NULL;
-
-  return stats_cluster_get_counter(sc, type);
+  return counter;
 }
 
 static void
-_foreach_cluster_helper(gpointer key, gpointer value, gpointer user_data)
+_snapshot_cluster(gpointer key, gpointer value, gpointer user_data)
 {
-  gpointer *args = (gpointer *) user_data;
-  StatsForeachClusterFunc func = args[0];
-  gpointer func_data = args[1];
-  StatsCluster *sc = (StatsCluster *) value;
+  GPtrArray *snapshot = (GPtrArray *) user_data;
 
-  func(sc, func_data);
+  g_ptr_array_add(snapshot, stats_cluster_ref((StatsCluster *) value));
 }
 
-static void
-_foreach_cluster(GHashTable *clusters, gpointer *args, gboolean *cancelled)
+static GPtrArray *
+_snapshot_clusters(void)
 {
-  GHashTableIter iter;
-  g_hash_table_iter_init(&iter, clusters);
-  gpointer key, value;
+  GPtrArray *snapshot = g_ptr_array_new_with_free_func((GDestroyNotify) stats_cluster_unref);
 
-  while (g_hash_table_iter_next(&iter, &key, &value))
+  for (gint i = 0; i < STATS_REGISTRY_SHARDS; i++)
     {
-      if (cancelled && *cancelled)
-        break;
-      _foreach_cluster_helper(key, value, args);
+      StatsClusterShard *shard = &stats_cluster_container.shards[i];
+      g_mutex_lock(&shard->lock);
+      g_hash_table_foreach(shard->static_clusters, _snapshot_cluster, snapshot);
+      g_hash_table_foreach(shard->dynamic_clusters, _snapshot_cluster, snapshot);
+      g_mutex_unlock(&shard->lock);
     }
+  return snapshot;
 }
 
+/* The clusters are collected first and func is called without any of the
+ * shard locks held, so it may register and unregister counters. */
 void
 stats_foreach_cluster(StatsForeachClusterFunc func, gpointer user_data, gboolean *cancelled)
 {
-  gpointer args[] = { func, user_data };
+  g_assert(stats_is_locked());
 
-  g_assert(stats_locked);
-  _foreach_cluster(stats_cluster_container.static_clusters, args, cancelled);
-  _foreach_cluster(stats_cluster_container.dynamic_clusters, args, cancelled);
+  GPtrArray *snapshot = _snapshot_clusters();
+  for (guint i = 0; i < snapshot->len; i++)
+    {
+      if (cancelled && *cancelled)
+        break;
+
+      func(g_ptr_array_index(snapshot, i), user_data);
+    }
+  g_ptr_array_free(snapshot, TRUE);
 }
 
 static gboolean
@@ -459,12 +590,35 @@ _foreach_cluster_remove_helper(gpointer key, gpointer value, gpointer user_data)
   return should_be_removed;
 }
 
+/* func is called with the lock of the cluster's shard held, it is meant to
+ * be a predicate and must not call back into the registry. */
 void
 stats_foreach_cluster_remove(StatsForeachClusterRemoveFunc func, gpointer user_data)
 {
   gpointer args[] = { func, user_data };
-  g_hash_table_foreach_remove(stats_cluster_container.static_clusters, _foreach_cluster_remove_helper, args);
-  g_hash_table_foreach_remove(stats_cluster_container.dynamic_clusters, _foreach_cluster_remove_helper, args);
+
+  g_assert(stats_is_locked());
+  for (gint i = 0; i < STATS_REGISTRY_SHARDS; i++)
+    {
+      StatsClusterShard *shard = &stats_cluster_container.shards[i];
+      g_mutex_lock(&shard->lock);
+      g_hash_table_foreach_remove(shard->static_clusters, _foreach_cluster_remove_helper, args);
+      guint removed = g_hash_table_foreach_remove(shard->dynamic_clusters, _foreach_cluster_remove_helper, args);
+      g_atomic_int_add(&stats_cluster_container.number_of_dynamic_clusters, -(gint) removed);
+      g_mutex_unlock(&shard->lock);
+    }
+}
+
+/* Returns the clusters registered at the time of the call, each of them
+ * referenced, so the caller can process them without holding the stats
+ * lock.  Clusters removed in the meantime stay valid (but orphaned) until
+ * the snapshot is freed. */
+GPtrArray *
+stats_get_clusters_snapshot(void)
+{
+  g_assert(stats_is_locked());
+
+  return _snapshot_clusters();
 }
 
 static void
@@ -489,7 +643,7 @@ stats_foreach_counter(StatsForeachCounterFunc func, gpointer user_data, gboolean
 {
   gpointer args[] = { func, user_data };
 
-  g_assert(stats_locked);
+  g_assert(stats_is_locked());
   stats_foreach_cluster(_foreach_counter_helper, args, cancelled);
 }
 
@@ -498,29 +652,39 @@ stats_foreach_legacy_counter(StatsForeachCounterFunc func, gpointer user_data, g
 {
   gpointer args[] = { func, user_data };
 
-  g_assert(stats_locked);
+  g_assert(stats_is_locked());
   stats_foreach_cluster(_foreach_legacy_counter_helper, args, cancelled);
 }
 
 void
 stats_registry_init(void)
 {
-  stats_cluster_container.static_clusters = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
-                                            (GEqualFunc) stats_cluster_key_equal, NULL,
-                                            (GDestroyNotify) stats_cluster_free);
-  stats_cluster_container.dynamic_clusters = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
-                                             (GEqualFunc) stats_cluster_key_equal, NULL,
-                                             (GDestroyNotify) stats_cluster_free);
-
-  g_mutex_init(&stats_mutex);
+  for (gint i = 0; i < STATS_REGISTRY_SHARDS; i++)
+    {
+      StatsClusterShard *shard = &stats_cluster_container.shards[i];
+
+      shard->static_clusters = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
+                                                     (GEqualFunc) stats_cluster_key_equal, NULL,
+                                                     (GDestroyNotify) stats_cluster_unref);
+      shard->dynamic_clusters = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
+                                                      (GEqualFunc) stats_cluster_key_equal, NULL,
+                                                      (GDestroyNotify) stats_cluster_unref);
+      g_mutex_init(&shard->lock);
+    }
+  stats_cluster_container.number_of_dynamic_clusters = 0;
 }
 
 void
 stats_registry_deinit(void)
 {
-  g_hash_table_destroy(stats_cluster_container.static_clusters);
-  g_hash_table_destroy(stats_cluster_container.dynamic_clusters);
-  stats_cluster_container.static_clusters = NULL;
-  stats_cluster_container.dynamic_clusters = NULL;
-  g_mutex_clear(&stats_mutex);
+  for (gint i = 0; i < STATS_REGISTRY_SHARDS; i++)
+    {
+      StatsClusterShard *shard = &stats_cluster_container.shards[i];
+
+      g_hash_table_destroy(shard->static_clusters);
+      g_hash_table_destroy(shard->dynamic_clusters);
+      shard->static_clusters = NULL;
+      shard->dynamic_clusters = NULL;
+      g_mutex_clear(&shard->lock);
+    }
 }
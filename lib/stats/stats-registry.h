@@ -32,6 +32,9 @@ typedef gboolean (*StatsForeachClusterRemoveFunc)(StatsCluster *sc, gpointer use
 
 void stats_lock(void);
 void stats_unlock(void);
+gboolean stats_is_locked(void);
+void stats_lock_cluster(StatsCluster *sc);
+void stats_unlock_cluster(StatsCluster *sc);
 gboolean stats_check_level(gint level);
 StatsCluster *stats_register_counter(gint level, const StatsClusterKey *sc_key, gint type, StatsCounterItem **counter);
 
@@ -62,12 +65,16 @@ void stats_foreach_counter(StatsForeachCounterFunc func, gpointer user_data, gbo
 void stats_foreach_legacy_counter(StatsForeachCounterFunc func, gpointer user_data, gboolean *cancelled);
 void stats_foreach_cluster(StatsForeachClusterFunc func, gpointer user_data, gboolean *cancelled);
 void stats_foreach_cluster_remove(StatsForeachClusterRemoveFunc func, gpointer user_data);
+GPtrArray *stats_get_clusters_snapshot(void);
 
 void stats_registry_init(void);
 void stats_registry_deinit(void);
 
 gboolean stats_check_dynamic_clusters_limit(guint number_of_clusters);
 gint stats_number_of_dynamic_clusters_limit(void);
+gint stats_dynamic_metrics_limit(void);
+gint stats_dynamic_metrics_idle_timeout(void);
+gint stats_latency_sampling(void);
 CfgYesNoAuto stats_syslog_stats(void);
 
 #endif
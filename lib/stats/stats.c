@@ -23,9 +23,11 @@
  */
 
 #include "stats/stats-control.h"
+#include "stats/stats-http.h"
 #include "stats/stats-log.h"
 #include "stats/stats-query.h"
 #include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
 #include "stats/aggregator/stats-aggregator-registry.h"
 #include "stats/stats.h"
 #include "timeutils/cache.h"
@@ -75,9 +77,16 @@
  *
  * Threading
  *
- * Registration and unregistration must be protected expicitly by invoking
- * stats_lock()/unlock().  Once registered, counters can be manipulated
- * without acquiring stats_lock().
+ * The registry is sharded by the hash of the cluster keys, each shard
+ * having its own lock.  Registration, lookup and unregistration of a
+ * counter only take the lock of its shard internally, so dynamic counters
+ * (metrics-probe, per-host stats) registered from different threads only
+ * contend if their keys fall into the same shard.  Walking the whole
+ * registry (stats_foreach_*(), pruning) must be protected explicitly by
+ * invoking stats_lock()/unlock().  Clusters obtained earlier (e.g. dynamic
+ * counter handles) are protected by stats_lock_cluster()/stats_unlock_cluster().
+ * Once registered, counters can be manipulated without acquiring any of
+ * these locks.
  *
  * Counters are updated atomically by the use of the stats_counter_inc/dec()
  * methods.
@@ -228,13 +237,69 @@ stats_timer_reinit(StatsOptions *options)
   stats_timer_rearm(options, &stats_timer);
 }
 
+static StatsHttpServer *stats_http_server;
+
+static void
+stats_http_server_deinit(void)
+{
+  if (!stats_http_server)
+    return;
+
+  stats_http_server_free(stats_http_server);
+  stats_http_server = NULL;
+}
+
+/* the endpoint keeps serving across reloads, unless its address changes */
+static gboolean
+stats_http_server_reinit(StatsOptions *options)
+{
+  if (stats_http_server &&
+      g_strcmp0(stats_http_server_get_listen_address(stats_http_server), options->http_listen) == 0)
+    return TRUE;
+
+  stats_http_server_deinit();
+  if (!options->http_listen)
+    return TRUE;
+
+  stats_http_server = stats_http_server_new(options->http_listen);
+  if (!stats_http_server_start(stats_http_server))
+    {
+      stats_http_server_deinit();
+      return FALSE;
+    }
+  return TRUE;
+}
+
 static StatsOptions *stats_options;
 
-void
+gboolean
 stats_reinit(StatsOptions *options)
 {
   stats_options = options;
   stats_timer_reinit(options);
+  return stats_http_server_reinit(options);
+}
+
+static void
+_register_memory_usage_counter(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "stats_clusters_memory_bytes", NULL, 0);
+  stats_register_external_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, stats_cluster_get_total_memory_usage());
+  stats_unlock();
+}
+
+static void
+_unregister_memory_usage_counter(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "stats_clusters_memory_bytes", NULL, 0);
+  stats_unregister_external_counter(&sc_key, SC_TYPE_SINGLE_VALUE, stats_cluster_get_total_memory_usage());
+  stats_unlock();
 }
 
 void
@@ -243,11 +308,14 @@ stats_init(void)
   stats_cluster_init();
   stats_registry_init();
   stats_aggregator_registry_init();
+  _register_memory_usage_counter();
 }
 
 void
 stats_destroy(void)
 {
+  stats_http_server_deinit();
+  _unregister_memory_usage_counter();
   stats_aggregator_registry_deinit();
   stats_registry_deinit();
   stats_cluster_deinit();
@@ -261,6 +329,17 @@ stats_options_defaults(StatsOptions *options)
   options->lifetime = 600;
   options->max_dynamic = -1;
   options->syslog_stats = CYNA_AUTO;
+  options->http_listen = NULL;
+  options->dynamic_metrics_limit = 0;
+  options->dynamic_metrics_idle_timeout = 0;
+  options->latency_sampling = 0;
+}
+
+void
+stats_options_destroy(StatsOptions *options)
+{
+  g_free(options->http_listen);
+  options->http_listen = NULL;
 }
 
 gboolean
@@ -290,6 +369,30 @@ stats_number_of_dynamic_clusters_limit(void)
   return stats_options->max_dynamic;
 }
 
+gint
+stats_dynamic_metrics_limit(void)
+{
+  if (!stats_options)
+    return 0;
+  return stats_options->dynamic_metrics_limit;
+}
+
+gint
+stats_dynamic_metrics_idle_timeout(void)
+{
+  if (!stats_options)
+    return 0;
+  return stats_options->dynamic_metrics_idle_timeout;
+}
+
+gint
+stats_latency_sampling(void)
+{
+  if (!stats_options)
+    return 0;
+  return stats_options->latency_sampling;
+}
+
 CfgYesNoAuto
 stats_syslog_stats(void)
 {
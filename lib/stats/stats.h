@@ -36,6 +36,11 @@ typedef struct _StatsOptions
   gint lifetime;
   gint max_dynamic;
   CfgYesNoAuto syslog_stats;
+  gchar *http_listen;
+  /* both only apply to user-facing dynamic metrics, 0 means disabled */
+  gint dynamic_metrics_limit;
+  gint dynamic_metrics_idle_timeout;
+  gint latency_sampling;
 } StatsOptions;
 
 enum
@@ -46,11 +51,12 @@ enum
   STATS_LEVEL3
 };
 
-void stats_reinit(StatsOptions *options);
+gboolean stats_reinit(StatsOptions *options);
 void stats_init(void);
 void stats_destroy(void);
 
 void stats_options_defaults(StatsOptions *options);
+void stats_options_destroy(StatsOptions *options);
 
 #endif
 
@@ -83,3 +83,43 @@ Test(stats_dynamic_clusters, register_limited)
   stats_unlock();
 }
 
+
+static void
+_register_sender_of_cluster(StatsCluster *sc, gpointer user_data)
+{
+  gint *registered = (gint *) user_data;
+
+  if (!sc->dynamic)
+    return;
+
+  StatsClusterKey sc_key;
+  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SOURCE, NULL, sc->key.legacy.instance);
+  stats_register_and_increment_dynamic_counter(0, &sc_key, -1);
+  (*registered)++;
+}
+
+Test(stats_dynamic_clusters, foreach_callback_may_register_counters)
+{
+  StatsOptions stats_opts;
+  stats_options_defaults(&stats_opts);
+  stats_opts.level = 3;
+  stats_reinit(&stats_opts);
+
+  StatsClusterKey sc_key;
+  gchar host[16];
+  for (gint i = 0; i < 32; i++)
+    {
+      g_snprintf(host, sizeof(host), "testhost%d", i);
+      stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SENDER, NULL, host);
+      stats_register_and_increment_dynamic_counter(0, &sc_key, -1);
+    }
+
+  gint registered = 0;
+  stats_lock();
+  stats_foreach_cluster(_register_sender_of_cluster, &registered, NULL);
+
+  cr_assert_eq(registered, 32, "clusters registered by the callback must not be visited");
+  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SOURCE, NULL, "testhost0");
+  cr_assert_eq(stats_counter_get(stats_get_counter(&sc_key, SC_TYPE_PROCESSED)), 1);
+  stats_unlock();
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "stats/stats-histogram.h"
+
+#define NUM_THREADS 8
+#define NUM_OBSERVATIONS 100000
+
+Test(stats_histogram, test_bucket_bounds_are_log_linear)
+{
+  cr_assert_eq(stats_histogram_get_bucket_bound(0), 128);
+  cr_assert_eq(stats_histogram_get_bucket_bound(1), 192);
+  cr_assert_eq(stats_histogram_get_bucket_bound(2), 256);
+  cr_assert_eq(stats_histogram_get_bucket_bound(3), 384);
+  cr_assert_eq(stats_histogram_get_bucket_bound(STATS_HISTOGRAM_BOUNDS - 1),
+               (gsize) 1 << (STATS_HISTOGRAM_MIN_SHIFT + STATS_HISTOGRAM_OCTAVES));
+
+  for (gint i = 1; i < STATS_HISTOGRAM_BOUNDS; i++)
+    cr_assert_gt(stats_histogram_get_bucket_bound(i), stats_histogram_get_bucket_bound(i - 1));
+}
+
+Test(stats_histogram, test_bucket_index_matches_upper_bounds)
+{
+  cr_assert_eq(stats_histogram_get_bucket_index(0), 0);
+  cr_assert_eq(stats_histogram_get_bucket_index(1), 0);
+
+  /* upper bounds are inclusive */
+  for (gint i = 0; i < STATS_HISTOGRAM_BOUNDS; i++)
+    {
+      gsize bound = stats_histogram_get_bucket_bound(i);
+
+      cr_assert_eq(stats_histogram_get_bucket_index(bound), i, "bound: %" G_GSIZE_FORMAT, bound);
+      cr_assert_eq(stats_histogram_get_bucket_index(bound + 1), i + 1, "bound: %" G_GSIZE_FORMAT, bound);
+    }
+
+  cr_assert_eq(stats_histogram_get_bucket_index(G_MAXSIZE), STATS_HISTOGRAM_BUCKETS - 1);
+}
+
+static gpointer
+_observe(gpointer user_data)
+{
+  StatsHistogram *histogram = user_data;
+
+  for (gint i = 0; i < NUM_OBSERVATIONS; i++)
+    stats_histogram_observe(histogram, i % 1000);
+
+  return NULL;
+}
+
+Test(stats_histogram, test_concurrent_observations_are_not_lost)
+{
+  StatsHistogram *histogram = g_new0(StatsHistogram, 1);
+  GThread *threads[NUM_THREADS];
+
+  for (gint i = 0; i < NUM_THREADS; i++)
+    threads[i] = g_thread_new(NULL, _observe, histogram);
+
+  for (gint i = 0; i < NUM_THREADS; i++)
+    g_thread_join(threads[i]);
+
+  StatsHistogramSnapshot snapshot;
+  stats_histogram_snapshot(histogram, &snapshot);
+
+  cr_assert_eq(snapshot.count, NUM_THREADS * NUM_OBSERVATIONS);
+  /* 0..999 repeated 100 times per thread */
+  cr_assert_eq(snapshot.sum, (guint64) NUM_THREADS * (NUM_OBSERVATIONS / 1000) * (999 * 1000 / 2));
+  /* 0..128 */
+  cr_assert_eq(snapshot.buckets[0], NUM_THREADS * (NUM_OBSERVATIONS / 1000) * 129);
+
+  g_free(histogram);
+}
+
+Test(stats_histogram, test_sum_does_not_wrap_around_at_32_bits)
+{
+  StatsHistogram *histogram = g_new0(StatsHistogram, 1);
+
+  for (gint i = 0; i < 4; i++)
+    stats_histogram_observe(histogram, G_MAXUINT32);
+
+  StatsHistogramSnapshot snapshot;
+  stats_histogram_snapshot(histogram, &snapshot);
+
+  cr_assert_eq(snapshot.count, 4);
+  cr_assert_eq(snapshot.sum, (guint64) 4 * G_MAXUINT32);
+
+  g_free(histogram);
+}
+
+Test(stats_histogram, test_observing_null_histogram_is_a_noop)
+{
+  stats_histogram_observe(NULL, 42);
+}
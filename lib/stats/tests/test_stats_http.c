@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "stats/stats-http.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "scratch-buffers.h"
+#include "apphook.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static StatsHttpServer *server;
+static StatsCounterItem *counter;
+
+static void
+_register_counter(void)
+{
+  StatsClusterKey key;
+  stats_cluster_single_key_set(&key, "test_http_counter", NULL, 0);
+
+  stats_lock();
+  stats_register_counter(0, &key, SC_TYPE_SINGLE_VALUE, &counter);
+  stats_unlock();
+}
+
+static void
+_unregister_counter(void)
+{
+  StatsClusterKey key;
+  stats_cluster_single_key_set(&key, "test_http_counter", NULL, 0);
+
+  stats_lock();
+  stats_unregister_counter(&key, SC_TYPE_SINGLE_VALUE, &counter);
+  stats_unlock();
+}
+
+static GString *
+_request(const gchar *request)
+{
+  GString *response = g_string_new("");
+  stats_http_server_format_response(server, request, response);
+  return response;
+}
+
+static gchar *
+_get_header(GString *response, const gchar *name)
+{
+  gchar *needle = g_strdup_printf("\r\n%s: ", name);
+  gchar *header = strstr(response->str, needle);
+  gchar *value = NULL;
+
+  if (header)
+    {
+      header += strlen(needle);
+      value = g_strndup(header, strcspn(header, "\r"));
+    }
+  g_free(needle);
+  return value;
+}
+
+static const gchar *
+_get_body(GString *response)
+{
+  const gchar *body = strstr(response->str, "\r\n\r\n");
+  cr_assert(body);
+  return body + 4;
+}
+
+Test(stats_http, test_metrics_are_served)
+{
+  stats_counter_set(counter, 42);
+
+  GString *response = _request("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  cr_assert(g_str_has_prefix(response->str, "HTTP/1.1 200 OK\r\n"), "%s", response->str);
+  cr_assert(strstr(_get_body(response), "syslogng_test_http_counter 42\n"), "%s", response->str);
+
+  gchar *content_length = _get_header(response, "Content-Length");
+  cr_assert_eq(atoi(content_length), strlen(_get_body(response)));
+  g_free(content_length);
+
+  g_string_free(response, TRUE);
+}
+
+Test(stats_http, test_head_request_has_no_body)
+{
+  GString *response = _request("HEAD / HTTP/1.1\r\n\r\n");
+  cr_assert(g_str_has_prefix(response->str, "HTTP/1.1 200 OK\r\n"), "%s", response->str);
+  cr_assert_str_eq(_get_body(response), "");
+  g_string_free(response, TRUE);
+}
+
+Test(stats_http, test_conditional_request)
+{
+  GString *response = _request("GET /metrics HTTP/1.1\r\n\r\n");
+  gchar *etag = _get_header(response, "ETag");
+  cr_assert(etag);
+  g_string_free(response, TRUE);
+
+  gchar *conditional_request = g_strdup_printf("GET /metrics HTTP/1.1\r\nIf-None-Match: W/\"x\", %s\r\n\r\n", etag);
+  response = _request(conditional_request);
+  cr_assert(g_str_has_prefix(response->str, "HTTP/1.1 304 Not Modified\r\n"), "%s", response->str);
+  cr_assert_str_eq(_get_body(response), "");
+  g_string_free(response, TRUE);
+
+  stats_counter_inc(counter);
+
+  response = _request(conditional_request);
+  cr_assert(g_str_has_prefix(response->str, "HTTP/1.1 200 OK\r\n"), "%s", response->str);
+  gchar *new_etag = _get_header(response, "ETag");
+  cr_assert_str_neq(new_etag, etag);
+  g_string_free(response, TRUE);
+
+  g_free(new_etag);
+  g_free(conditional_request);
+  g_free(etag);
+}
+
+Test(stats_http, test_gzip_content_encoding)
+{
+  GString *response = _request("GET /metrics HTTP/1.1\r\nAccept-Encoding: deflate, gzip;q=0.5\r\n\r\n");
+  gchar *content_encoding = _get_header(response, "Content-Encoding");
+
+#if SYSLOG_NG_HAVE_LIBZ
+  cr_assert_str_eq(content_encoding, "gzip");
+
+  const guchar *body = (const guchar *) _get_body(response);
+  cr_assert(body[0] == 0x1f && body[1] == 0x8b, "gzip magic expected");
+#else
+  cr_assert_null(content_encoding);
+#endif
+
+  g_free(content_encoding);
+  g_string_free(response, TRUE);
+
+  response = _request("GET /metrics HTTP/1.1\r\nAccept-Encoding: gzip;q=0\r\n\r\n");
+  content_encoding = _get_header(response, "Content-Encoding");
+  cr_assert_null(content_encoding);
+  g_string_free(response, TRUE);
+}
+
+Test(stats_http, test_errors)
+{
+  GString *response = _request("GET /foo HTTP/1.1\r\n\r\n");
+  cr_assert(g_str_has_prefix(response->str, "HTTP/1.1 404 Not Found\r\n"), "%s", response->str);
+  g_string_free(response, TRUE);
+
+  response = _request("POST /metrics HTTP/1.1\r\n\r\n");
+  cr_assert(g_str_has_prefix(response->str, "HTTP/1.1 405 Method Not Allowed\r\n"), "%s", response->str);
+  g_string_free(response, TRUE);
+
+  response = _request("garbage\r\n\r\n");
+  cr_assert(g_str_has_prefix(response->str, "HTTP/1.1 400 Bad Request\r\n"), "%s", response->str);
+  g_string_free(response, TRUE);
+}
+
+static gint
+_listen_on_free_port(gint *port)
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t addrlen = sizeof(addr);
+  gint fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  cr_assert(fd >= 0);
+  cr_assert_eq(bind(fd, (struct sockaddr *) &addr, sizeof(addr)), 0);
+  cr_assert_eq(listen(fd, 1), 0);
+  cr_assert_eq(getsockname(fd, (struct sockaddr *) &addr, &addrlen), 0);
+
+  *port = ntohs(addr.sin_port);
+  return fd;
+}
+
+static StatsHttpServer *
+_start_server_on_free_port(gint *port)
+{
+  close(_listen_on_free_port(port));
+
+  gchar *listen_address = g_strdup_printf("127.0.0.1:%d", *port);
+  StatsHttpServer *running_server = stats_http_server_new(listen_address);
+  g_free(listen_address);
+
+  cr_assert(stats_http_server_start(running_server));
+  return running_server;
+}
+
+static gint
+_connect(gint port)
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  gint fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  addr.sin_port = htons(port);
+  cr_assert(fd >= 0);
+  cr_assert_eq(connect(fd, (struct sockaddr *) &addr, sizeof(addr)), 0);
+  return fd;
+}
+
+static GString *
+_read_response(gint fd, gint timeout_msec)
+{
+  GString *response = g_string_new("");
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  gchar buffer[1024];
+
+  while (poll(&pfd, 1, timeout_msec) > 0)
+    {
+      gssize rc = read(fd, buffer, sizeof(buffer));
+      if (rc <= 0)
+        break;
+      g_string_append_len(response, buffer, rc);
+    }
+  return response;
+}
+
+Test(stats_http, test_bind_failure_is_reported)
+{
+  gint port;
+  gint fd = _listen_on_free_port(&port);
+
+  gchar *listen_address = g_strdup_printf("127.0.0.1:%d", port);
+  StatsHttpServer *conflicting_server = stats_http_server_new(listen_address);
+  cr_assert_not(stats_http_server_start(conflicting_server));
+  stats_http_server_free(conflicting_server);
+
+  g_free(listen_address);
+  close(fd);
+}
+
+Test(stats_http, test_idle_client_does_not_block_others)
+{
+  gint port;
+  StatsHttpServer *running_server = _start_server_on_free_port(&port);
+
+  gint idle_fd = _connect(port);
+  gint fd = _connect(port);
+  const gchar *request = "GET /metrics HTTP/1.1\r\n\r\n";
+  cr_assert_eq(write(fd, request, strlen(request)), (gssize) strlen(request));
+
+  /* well within the I/O timeout the idle client is allowed */
+  GString *response = _read_response(fd, 2000);
+  cr_assert(g_str_has_prefix(response->str, "HTTP/1.1 200 OK\r\n"), "%s", response->str);
+  g_string_free(response, TRUE);
+  close(fd);
+
+  /* stopping does not wait for the idle client either */
+  gint64 stop_start = g_get_monotonic_time();
+  stats_http_server_free(running_server);
+  cr_assert_lt(g_get_monotonic_time() - stop_start, G_USEC_PER_SEC);
+
+  close(idle_fd);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  _register_counter();
+  server = stats_http_server_new("127.0.0.1:0");
+}
+
+static void
+teardown(void)
+{
+  stats_http_server_free(server);
+  _unregister_counter();
+  scratch_buffers_explicit_gc();
+  app_shutdown();
+}
+
+TestSuite(stats_http, .init = setup, .fini = teardown);
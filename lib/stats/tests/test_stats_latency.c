@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "apphook.h"
+#include "stats/stats.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-latency.h"
+
+#include <string.h>
+
+static StatsLatencyTracker tracker;
+
+static void
+_register_tracker(gint latency_sampling)
+{
+  StatsOptions stats_opts;
+  stats_options_defaults(&stats_opts);
+  stats_opts.latency_sampling = latency_sampling;
+  stats_reinit(&stats_opts);
+
+  StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("id", "test"));
+  stats_latency_tracker_set_keys(&tracker, kb);
+  stats_cluster_key_builder_free(kb);
+
+  stats_lock();
+  stats_latency_tracker_register(&tracker, STATS_LEVEL0);
+  stats_unlock();
+}
+
+static gsize
+_count(StatsHistogram *histogram)
+{
+  StatsHistogramSnapshot snapshot;
+
+  stats_histogram_snapshot(histogram, &snapshot);
+  return snapshot.count;
+}
+
+static void
+_track(gint num_msgs, gboolean written)
+{
+  UnixTime received;
+
+  unix_time_set_now(&received);
+  for (gint i = 0; i < num_msgs; i++)
+    stats_latency_tracker_track(&tracker, &received, written);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  memset(&tracker, 0, sizeof(tracker));
+}
+
+static void
+teardown(void)
+{
+  stats_lock();
+  stats_latency_tracker_unregister(&tracker);
+  stats_unlock();
+  stats_latency_tracker_clear(&tracker);
+  app_shutdown();
+}
+
+TestSuite(stats_latency, .init = setup, .fini = teardown);
+
+Test(stats_latency, test_disabled_by_default)
+{
+  _register_tracker(0);
+
+  cr_assert_not(stats_latency_tracker_is_enabled(&tracker));
+  cr_assert_null(tracker.write_latency);
+  cr_assert_null(tracker.ack_latency);
+
+  _track(10, TRUE);
+  stats_latency_tracker_ack(&tracker, 10);
+  cr_assert_eq(tracker.written, 0);
+}
+
+Test(stats_latency, test_acks_observe_samples_in_order)
+{
+  _register_tracker(1);
+
+  _track(3, TRUE);
+  cr_assert_eq(_count(tracker.write_latency), 3);
+  cr_assert_eq(_count(tracker.ack_latency), 0);
+
+  stats_latency_tracker_ack(&tracker, 2);
+  cr_assert_eq(_count(tracker.ack_latency), 2);
+
+  stats_latency_tracker_ack(&tracker, 1);
+  cr_assert_eq(_count(tracker.ack_latency), 3);
+  cr_assert_eq(tracker.pending.length, 0);
+}
+
+Test(stats_latency, test_only_every_nth_message_is_sampled)
+{
+  _register_tracker(4);
+
+  _track(10, TRUE);
+  cr_assert_eq(_count(tracker.write_latency), 3);
+
+  stats_latency_tracker_ack(&tracker, 10);
+  cr_assert_eq(_count(tracker.ack_latency), 3);
+}
+
+Test(stats_latency, test_dropped_messages_are_not_observed_as_acked)
+{
+  _register_tracker(1);
+
+  _track(2, TRUE);
+  stats_latency_tracker_drop(&tracker, 1);
+  stats_latency_tracker_ack(&tracker, 1);
+
+  cr_assert_eq(_count(tracker.ack_latency), 1);
+  cr_assert_eq(tracker.pending.length, 0);
+}
+
+Test(stats_latency, test_rewound_messages_are_sampled_again)
+{
+  _register_tracker(1);
+
+  _track(3, TRUE);
+  stats_latency_tracker_rewind(&tracker, 2);
+  cr_assert_eq(tracker.written, 1);
+  cr_assert_eq(tracker.pending.length, 1);
+
+  /* the two rewound messages fail to be inserted, then succeed */
+  _track(2, FALSE);
+  stats_latency_tracker_rewind(&tracker, 2);
+  _track(2, TRUE);
+  stats_latency_tracker_ack(&tracker, 3);
+
+  cr_assert_eq(_count(tracker.write_latency), 5);
+  cr_assert_eq(_count(tracker.ack_latency), 3);
+
+  _track(2, TRUE);
+  stats_latency_tracker_rewind_all(&tracker);
+  cr_assert_eq(tracker.written, 3);
+  cr_assert_eq(tracker.pending.length, 0);
+}
+
+Test(stats_latency, test_acks_of_untracked_messages_are_ignored)
+{
+  _register_tracker(1);
+
+  /* written before the tracker was registered */
+  stats_latency_tracker_ack(&tracker, 5);
+  cr_assert_eq(tracker.acked, 0);
+
+  _track(1, TRUE);
+  stats_latency_tracker_ack(&tracker, 1);
+  cr_assert_eq(_count(tracker.ack_latency), 1);
+}
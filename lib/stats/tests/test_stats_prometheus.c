@@ -28,6 +28,7 @@
 #include "stats/stats-cluster.h"
 #include "stats/stats-cluster-single.h"
 #include "stats/stats-cluster-logpipe.h"
+#include "stats/stats-cluster-histogram.h"
 #include "stats/stats-prometheus.h"
 #include "timeutils/unixtime.h"
 #include "scratch-buffers.h"
@@ -100,6 +101,23 @@ Test(stats_prometheus, test_prometheus_format_single)
   stats_cluster_free(cluster);
 }
 
+Test(stats_prometheus, test_prometheus_series_is_rendered_once)
+{
+  StatsClusterLabel labels[] = { stats_cluster_label("app", "cisco") };
+  StatsCluster *cluster = test_single_cluster("test_name", labels, G_N_ELEMENTS(labels));
+  StatsCounterItem *counter = stats_cluster_track_counter(cluster, SC_TYPE_SINGLE_VALUE);
+
+  assert_prometheus_format(cluster, SC_TYPE_SINGLE_VALUE, "syslogng_test_name{app=\"cisco\"} 0\n");
+  const gchar *series = cluster->prometheus_series[SC_TYPE_SINGLE_VALUE];
+  cr_assert_str_eq(series, "syslogng_test_name{app=\"cisco\"}");
+
+  stats_counter_add(counter, 42);
+  assert_prometheus_format(cluster, SC_TYPE_SINGLE_VALUE, "syslogng_test_name{app=\"cisco\"} 42\n");
+  cr_assert(cluster->prometheus_series[SC_TYPE_SINGLE_VALUE] == series, "cached series should be reused");
+
+  stats_cluster_free(cluster);
+}
+
 Test(stats_prometheus, test_prometheus_format_logpipe)
 {
   StatsCluster *cluster = test_logpipe_cluster("test_name", NULL, 0);
@@ -229,6 +247,10 @@ Test(stats_prometheus, test_prometheus_format_value)
   actual = g_ascii_strtod(stats_format_prometheus_format_value(&key, &counter), NULL);
   cr_assert_float_eq(actual, 9e-9, DBL_EPSILON);
 
+  stats_cluster_single_key_add_unit(&key, SCU_MICROSECONDS);
+  actual = g_ascii_strtod(stats_format_prometheus_format_value(&key, &counter), NULL);
+  cr_assert_float_eq(actual, 9e-6, DBL_EPSILON);
+
   /* Relative to time of query */
   stats_cluster_single_key_add_frame_of_reference(&key, SCFOR_RELATIVE_TO_TIME_OF_QUERY);
 
@@ -266,6 +288,37 @@ Test(stats_prometheus, test_prometheus_format_value)
 }
 
 
+Test(stats_prometheus, test_prometheus_format_histogram)
+{
+  StatsClusterLabel labels[] = { stats_cluster_label("app", "cisco") };
+  StatsClusterKey key;
+  stats_cluster_histogram_key_set(&key, "test_latency", labels, G_N_ELEMENTS(labels));
+  StatsCluster *cluster = stats_cluster_new(&key);
+  stats_cluster_track_counter(cluster, SC_TYPE_HISTOGRAM);
+
+  StatsHistogram *histogram = stats_cluster_histogram_get_histogram(cluster);
+  stats_histogram_observe(histogram, 100);
+  stats_histogram_observe(histogram, 200);
+  stats_histogram_observe(histogram, 1000000000);
+
+  const gchar *record = stats_prometheus_format_counter(cluster, SC_TYPE_HISTOGRAM,
+                                                        stats_cluster_get_counter(cluster, SC_TYPE_HISTOGRAM))->str;
+
+  /* buckets are cumulative */
+  cr_assert(g_str_has_prefix(record,
+                             "syslogng_test_latency_bucket{app=\"cisco\",le=\"128\"} 1\n"
+                             "syslogng_test_latency_bucket{app=\"cisco\",le=\"192\"} 1\n"
+                             "syslogng_test_latency_bucket{app=\"cisco\",le=\"256\"} 2\n"
+                             "syslogng_test_latency_bucket{app=\"cisco\",le=\"384\"} 2\n"), "%s", record);
+  cr_assert(g_str_has_suffix(record,
+                             "syslogng_test_latency_bucket{app=\"cisco\",le=\"33554432\"} 2\n"
+                             "syslogng_test_latency_bucket{app=\"cisco\",le=\"+Inf\"} 3\n"
+                             "syslogng_test_latency_sum{app=\"cisco\"} 1000000300\n"
+                             "syslogng_test_latency_count{app=\"cisco\"} 3\n"), "%s", record);
+
+  stats_cluster_free(cluster);
+}
+
 Test(stats_prometheus, test_prometheus_format_legacy)
 {
   StatsClusterKey key;
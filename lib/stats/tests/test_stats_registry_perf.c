@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "stats/stats-cluster-logpipe.h"
+#include "timeutils/misc.h"
+#include "apphook.h"
+
+#include <stdio.h>
+
+#define NUM_THREADS 8
+#define NUM_ITERATIONS 50000
+#define NUM_HOSTS 1024
+
+typedef struct _StormThread
+{
+  gint id;
+  GThread *thread;
+} StormThread;
+
+static GMutex start_lock;
+static GCond start_cond;
+static gboolean started;
+
+static void
+_wait_for_start(void)
+{
+  g_mutex_lock(&start_lock);
+  while (!started)
+    g_cond_wait(&start_cond, &start_lock);
+  g_mutex_unlock(&start_lock);
+}
+
+static void
+_start_threads(void)
+{
+  g_mutex_lock(&start_lock);
+  started = TRUE;
+  g_cond_broadcast(&start_cond);
+  g_mutex_unlock(&start_lock);
+}
+
+/* what per-host stats do for each message: a dynamic counter with a stamp */
+static gpointer
+_dynamic_storm(gpointer user_data)
+{
+  StormThread *self = (StormThread *) user_data;
+  gchar host[32];
+
+  _wait_for_start();
+  for (gint i = 0; i < NUM_ITERATIONS; i++)
+    {
+      g_snprintf(host, sizeof(host), "host-%d", (self->id * NUM_ITERATIONS + i) % NUM_HOSTS);
+
+      StatsClusterLabel labels[] = { stats_cluster_label("host", host) };
+      StatsClusterKey sc_key;
+      stats_cluster_logpipe_key_set(&sc_key, "perf_host_messages", labels, G_N_ELEMENTS(labels));
+
+      stats_register_and_increment_dynamic_counter(0, &sc_key, i);
+    }
+  return NULL;
+}
+
+/* what metrics-probe does when a new label set shows up or an idle one is
+ * evicted: register a dynamic cluster, then unregister it, without
+ * stats_lock() */
+static gpointer
+_dynamic_cluster_storm(gpointer user_data)
+{
+  StormThread *self = (StormThread *) user_data;
+  gchar label[32];
+
+  _wait_for_start();
+  for (gint i = 0; i < NUM_ITERATIONS; i++)
+    {
+      g_snprintf(label, sizeof(label), "label-%d", (self->id * NUM_ITERATIONS + i) % NUM_HOSTS);
+
+      StatsClusterLabel labels[] = { stats_cluster_label("label", label) };
+      StatsClusterKey sc_key;
+      stats_cluster_single_key_set(&sc_key, "perf_dynamic_metric", labels, G_N_ELEMENTS(labels));
+
+      StatsCounterItem *counter = NULL;
+      StatsCluster *sc = stats_register_dynamic_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+      cr_assert_not_null(sc);
+      stats_counter_inc(counter);
+      stats_unregister_dynamic_counter(sc, SC_TYPE_SINGLE_VALUE, &counter);
+    }
+  return NULL;
+}
+
+static void
+_run_storm(const gchar *name, GThreadFunc storm_func)
+{
+  StormThread threads[NUM_THREADS];
+  struct timespec start_ts, end_ts;
+
+  started = FALSE;
+  for (gint i = 0; i < NUM_THREADS; i++)
+    {
+      threads[i].id = i;
+      threads[i].thread = g_thread_new(name, storm_func, &threads[i]);
+    }
+
+  clock_gettime(CLOCK_MONOTONIC, &start_ts);
+  _start_threads();
+  for (gint i = 0; i < NUM_THREADS; i++)
+    g_thread_join(threads[i].thread);
+  clock_gettime(CLOCK_MONOTONIC, &end_ts);
+
+  gdouble elapsed_usec = timespec_diff_usec(&end_ts, &start_ts);
+  printf("      %-24s threads: %d, speed: %12.3f registrations/sec\n",
+         name, NUM_THREADS, NUM_THREADS * NUM_ITERATIONS * 1e6 / elapsed_usec);
+}
+
+static gsize
+_get_processed(const gchar *host)
+{
+  StatsClusterLabel labels[] = { stats_cluster_label("host", host) };
+  StatsClusterKey sc_key;
+  stats_cluster_logpipe_key_set(&sc_key, "perf_host_messages", labels, G_N_ELEMENTS(labels));
+
+  return stats_counter_get(stats_get_counter(&sc_key, SC_TYPE_PROCESSED));
+}
+
+static gsize
+_get_metric(const gchar *label)
+{
+  StatsClusterLabel labels[] = { stats_cluster_label("label", label) };
+  StatsClusterKey sc_key;
+  stats_cluster_single_key_set(&sc_key, "perf_dynamic_metric", labels, G_N_ELEMENTS(labels));
+
+  return stats_counter_get(stats_get_counter(&sc_key, SC_TYPE_SINGLE_VALUE));
+}
+
+Test(stats_registry_perf, test_dynamic_registration_storm)
+{
+  _run_storm("dynamic-storm", _dynamic_storm);
+
+  gsize total = 0;
+  gchar host[32];
+  for (gint i = 0; i < NUM_HOSTS; i++)
+    {
+      g_snprintf(host, sizeof(host), "host-%d", i);
+      total += _get_processed(host);
+    }
+  cr_assert_eq(total, NUM_THREADS * NUM_ITERATIONS, "no increments should be lost");
+}
+
+Test(stats_registry_perf, test_dynamic_cluster_registration_storm)
+{
+  _run_storm("dynamic-cluster-storm", _dynamic_cluster_storm);
+
+  /* the clusters are orphaned, but not pruned, they keep their values */
+  gsize total = 0;
+  gchar label[32];
+  for (gint i = 0; i < NUM_HOSTS; i++)
+    {
+      g_snprintf(label, sizeof(label), "label-%d", i);
+      total += _get_metric(label);
+    }
+  cr_assert_eq(total, NUM_THREADS * NUM_ITERATIONS, "no increments should be lost");
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(stats_registry_perf, .init = setup, .fini = teardown);
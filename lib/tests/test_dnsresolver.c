@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "dnsresolver.h"
+#include "host-resolve.h"
+#include "apphook.h"
+
+/* Stands in for the name server: lookups block until the test releases
+ * them, addresses in 10.0.0.0/8 do not resolve. */
+static GMutex stub_lock;
+static GCond stub_cond;
+static gboolean stub_released;
+static gint stub_queries;
+
+static const gchar *
+_stub_resolve(GSockAddr *saddr, gchar *buf, gsize buf_len)
+{
+  gchar addr[64];
+
+  g_mutex_lock(&stub_lock);
+  stub_queries++;
+  while (!stub_released)
+    g_cond_wait(&stub_cond, &stub_lock);
+  g_mutex_unlock(&stub_lock);
+
+  g_sockaddr_format(saddr, addr, sizeof(addr), GSA_ADDRESS_ONLY);
+  if (g_str_has_prefix(addr, "10."))
+    return NULL;
+
+  g_strlcpy(buf, "stub.example.com", buf_len);
+  return buf;
+}
+
+static void
+_release_stub(void)
+{
+  g_mutex_lock(&stub_lock);
+  stub_released = TRUE;
+  g_cond_broadcast(&stub_cond);
+  g_mutex_unlock(&stub_lock);
+}
+
+static gint
+_get_stub_queries(void)
+{
+  g_mutex_lock(&stub_lock);
+  gint queries = stub_queries;
+  g_mutex_unlock(&stub_lock);
+  return queries;
+}
+
+static void
+_configure_resolver_with_cache_size(gint threads, gint timeout, gint cache_size)
+{
+  DNSCacheOptions options;
+
+  dns_cache_options_defaults(&options);
+  options.resolver_threads = threads;
+  options.resolver_timeout = timeout;
+  if (cache_size > 0)
+    options.cache_size = cache_size;
+  dns_resolver_update_options(&options);
+  dns_cache_options_destroy(&options);
+}
+
+static void
+_configure_resolver(gint threads, gint timeout)
+{
+  _configure_resolver_with_cache_size(threads, timeout, 0);
+}
+
+static void
+_format_ip(gchar *ip, gsize ip_size, gint i)
+{
+  g_snprintf(ip, ip_size, "192.168.%d.%d", i / 256, i % 256);
+}
+
+static gboolean
+_lookup(const gchar *ip, gchar *hostname, gsize hostname_size, gboolean *positive)
+{
+  GSockAddr *saddr = g_sockaddr_inet_new(ip, 0);
+  gboolean result = dns_resolver_lookup(saddr, hostname, hostname_size, positive);
+
+  g_sockaddr_unref(saddr);
+  return result;
+}
+
+Test(dnsresolver, test_resolver_is_disabled_without_threads)
+{
+  cr_assert_not(dns_resolver_is_enabled());
+
+  _configure_resolver(2, 0);
+  cr_assert(dns_resolver_is_enabled());
+
+  _configure_resolver(0, 0);
+  cr_assert_not(dns_resolver_is_enabled());
+}
+
+Test(dnsresolver, test_lookup_proceeds_without_waiting_and_completes_later)
+{
+  gchar hostname[256];
+  gboolean positive;
+
+  _configure_resolver(2, 0);
+  cr_assert_not(_lookup("192.168.1.1", hostname, sizeof(hostname), &positive),
+                "lookup should be pending while the name server does not answer");
+
+  _release_stub();
+  _configure_resolver(2, 5000);
+  cr_assert(_lookup("192.168.1.1", hostname, sizeof(hostname), &positive));
+  cr_assert(positive);
+  cr_assert_str_eq(hostname, "stub.example.com");
+  cr_assert_eq(_get_stub_queries(), 1);
+}
+
+Test(dnsresolver, test_lookup_waits_with_bounded_timeout)
+{
+  gchar hostname[256];
+  gboolean positive;
+
+  _configure_resolver(2, 100);
+
+  gint64 start = g_get_monotonic_time();
+  cr_assert_not(_lookup("192.168.1.1", hostname, sizeof(hostname), &positive));
+  gint64 elapsed = g_get_monotonic_time() - start;
+
+  cr_assert_geq(elapsed, 100 * G_TIME_SPAN_MILLISECOND, "lookup returned before the timeout elapsed");
+  cr_assert_lt(elapsed, 5 * G_TIME_SPAN_SECOND, "lookup did not honour the timeout");
+}
+
+Test(dnsresolver, test_failed_lookup_is_negative)
+{
+  gchar hostname[256] = "";
+  gboolean positive = TRUE;
+
+  _release_stub();
+  _configure_resolver(2, 5000);
+  cr_assert(_lookup("10.1.1.1", hostname, sizeof(hostname), &positive));
+  cr_assert_not(positive);
+  cr_assert_str_eq(hostname, "");
+}
+
+Test(dnsresolver, test_concurrent_lookups_of_the_same_address_are_resolved_once)
+{
+  gchar hostname[256];
+  gboolean positive;
+
+  _configure_resolver(4, 0);
+  for (gint i = 0; i < 10; i++)
+    cr_assert_not(_lookup("192.168.1.1", hostname, sizeof(hostname), &positive));
+  cr_assert_not(_lookup("192.168.1.2", hostname, sizeof(hostname), &positive));
+
+  _release_stub();
+  _configure_resolver(4, 5000);
+  cr_assert(_lookup("192.168.1.1", hostname, sizeof(hostname), &positive));
+  cr_assert(_lookup("192.168.1.2", hostname, sizeof(hostname), &positive));
+  cr_assert_eq(_get_stub_queries(), 2);
+}
+
+Test(dnsresolver, test_pending_lookups_are_not_evicted_from_a_full_cache)
+{
+  gchar hostname[256];
+  gchar ip[32];
+  gboolean positive;
+
+  /* 2 entries per shard */
+  _configure_resolver_with_cache_size(1, 0, 16);
+  cr_assert_not(_lookup("172.16.0.1", hostname, sizeof(hostname), &positive));
+  for (gint i = 0; i < 100; i++)
+    {
+      _format_ip(ip, sizeof(ip), i);
+      cr_assert_not(_lookup(ip, hostname, sizeof(hostname), &positive));
+    }
+
+  /* still in flight, not queued again */
+  cr_assert_not(_lookup("172.16.0.1", hostname, sizeof(hostname), &positive));
+
+  _release_stub();
+  _configure_resolver_with_cache_size(1, 5000, 16);
+  _format_ip(ip, sizeof(ip), 99);
+  cr_assert(_lookup(ip, hostname, sizeof(hostname), &positive));
+  cr_assert_eq(_get_stub_queries(), 101);
+}
+
+Test(dnsresolver, test_number_of_pending_lookups_is_capped)
+{
+  gchar hostname[256];
+  gchar ip[32];
+  gboolean positive;
+
+  _configure_resolver(1, 0);
+  for (gint i = 0; i < 1100; i++)
+    {
+      _format_ip(ip, sizeof(ip), i);
+      cr_assert_not(_lookup(ip, hostname, sizeof(hostname), &positive));
+    }
+
+  /* lookups are served in order by the single thread, once the last
+   * accepted one is done, all of them are */
+  _release_stub();
+  _configure_resolver(1, 5000);
+  _format_ip(ip, sizeof(ip), 1023);
+  cr_assert(_lookup(ip, hostname, sizeof(hostname), &positive));
+  cr_assert_eq(_get_stub_queries(), 1024);
+
+  /* refused addresses are looked up once there is room again */
+  _format_ip(ip, sizeof(ip), 1099);
+  cr_assert(_lookup(ip, hostname, sizeof(hostname), &positive));
+  cr_assert_eq(_get_stub_queries(), 1025);
+}
+
+Test(dnsresolver, test_stopping_does_not_wait_for_running_lookups)
+{
+  gchar hostname[256];
+  gboolean positive;
+
+  _configure_resolver(1, 0);
+  cr_assert_not(_lookup("192.168.1.1", hostname, sizeof(hostname), &positive));
+  cr_assert_not(_lookup("192.168.1.2", hostname, sizeof(hostname), &positive));
+
+  /* the first lookup is blocked in the name server, the second one is queued */
+  gint64 start = g_get_monotonic_time();
+  _configure_resolver(0, 0);
+  cr_assert_lt(g_get_monotonic_time() - start, G_TIME_SPAN_SECOND);
+  cr_assert_not(dns_resolver_is_enabled());
+}
+
+Test(dnsresolver, test_host_resolve_falls_back_to_ip_until_resolved)
+{
+  HostResolveOptions options =
+  {
+    .use_dns = TRUE,
+    .use_fqdn = TRUE,
+    .use_dns_cache = TRUE,
+    .normalize_hostnames = FALSE,
+  };
+  GSockAddr *saddr = g_sockaddr_inet_new("192.168.1.1", 0);
+  gsize result_len;
+
+  _configure_resolver(2, 0);
+  cr_assert_str_eq(resolve_sockaddr_to_hostname(&result_len, saddr, &options), "192.168.1.1");
+
+  /* the IP address must not have been cached as a failed lookup */
+  _release_stub();
+  _configure_resolver(2, 5000);
+  cr_assert_str_eq(resolve_sockaddr_to_hostname(&result_len, saddr, &options), "stub.example.com");
+  cr_assert_eq(result_len, strlen("stub.example.com"));
+
+  g_sockaddr_unref(saddr);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  stub_released = FALSE;
+  stub_queries = 0;
+  dns_resolver_set_resolve_func(_stub_resolve);
+}
+
+static void
+teardown(void)
+{
+  _release_stub();
+  app_shutdown();
+}
+
+TestSuite(dnsresolver, .init = setup, .fini = teardown);
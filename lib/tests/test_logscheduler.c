@@ -24,6 +24,8 @@
 #include "libtest/cr_template.h"
 
 #include "logscheduler.h"
+#include "mainloop-worker.h"
+#include "stats/stats-cluster-single.h"
 #include "apphook.h"
 
 typedef struct TestPipe
@@ -106,11 +108,297 @@ Test(logscheduler, test_log_scheduler_can_be_constructed)
   _destroy_test_pipe(test_pipe);
 }
 
+Test(logscheduler, test_log_scheduler_auto_partitions_follow_the_number_of_io_workers)
+{
+  LogSchedulerOptions options;
+
+  log_scheduler_options_defaults(&options);
+  options.num_partitions = LOGSCHEDULER_PARTITIONS_AUTO;
+  log_scheduler_options_init(&options, configuration);
+  cr_assert_eq(options.num_partitions, main_loop_io_worker_get_max_number_of_threads());
+
+  log_scheduler_options_destroy(&options);
+}
+
+#if SYSLOG_NG_HAVE_IV_WORK_POOL_SUBMIT_CONTINUATION
+
+#define NUM_PARTITIONS 4
+#define NUM_FLUSHES 3
+#define MESSAGES_PER_FLUSH 40
+
+static LogScheduler *
+_construct_scheduler(LogSchedulerOptions *options, TestPipe *test_pipe, const gchar *partition_key)
+{
+  main_loop_worker_allocate_thread_space(1);
+  main_loop_worker_finalize_thread_space();
+
+  log_scheduler_options_defaults(options);
+  options->num_partitions = NUM_PARTITIONS;
+  if (partition_key)
+    log_scheduler_options_set_partition_key_ref(options, compile_template(partition_key));
+  cr_assert(log_scheduler_options_init(options, configuration));
+
+  LogScheduler *s = log_scheduler_new(options, &test_pipe->super);
+  cr_assert(log_scheduler_init(s, "parallelize#0"));
+
+  /* batches are processed explicitly by the tests via _run_partition(),
+   * pretend that a flush is running so that no I/O worker job is submitted */
+  for (gint i = 0; i < s->num_partitions; i++)
+    s->partitions[i].flush_running = TRUE;
+  return s;
+}
+
+static void
+_destroy_scheduler(LogScheduler *s, LogSchedulerOptions *options)
+{
+  log_scheduler_deinit(s);
+  log_scheduler_free(s);
+  log_scheduler_options_destroy(options);
+}
+
+/* push messages from a worker thread, each flush creates one batch in
+ * every partition that received messages */
+static void
+_push_messages(LogScheduler *s, gint num_flushes, gint messages_per_flush)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint seq = 0;
+
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+  for (gint flush = 0; flush < num_flushes; flush++)
+    {
+      for (gint i = 0; i < messages_per_flush; i++)
+        {
+          LogMessage *msg = create_sample_message();
+          gchar buf[32];
+
+          g_snprintf(buf, sizeof(buf), "key%d", seq % 7);
+          log_msg_set_value_by_name(msg, "KEY", buf, -1);
+          g_snprintf(buf, sizeof(buf), "%d", seq);
+          log_msg_set_value_by_name(msg, "SEQ", buf, -1);
+          seq++;
+
+          log_scheduler_push(s, msg, &path_options);
+        }
+      main_loop_worker_invoke_batch_callbacks();
+    }
+  main_loop_worker_thread_stop();
+}
+
+static void
+_run_partition(LogScheduler *s, gint partition_index)
+{
+  LogSchedulerPartition *partition = &s->partitions[partition_index];
+
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+  partition->io_job.work(partition->io_job.user_data, NULL);
+  main_loop_worker_thread_stop();
+}
+
+static StatsCounterItem *
+_get_partition_counter(const gchar *name, gint partition_index)
+{
+  gchar partition[16];
+  StatsClusterKey sc_key;
+
+  g_snprintf(partition, sizeof(partition), "%d", partition_index);
+
+  StatsClusterLabel labels[] =
+  {
+    stats_cluster_label("id", "parallelize#0"),
+    stats_cluster_label("partition", partition),
+  };
+  stats_cluster_single_key_set(&sc_key, name, labels, G_N_ELEMENTS(labels));
+
+  stats_lock();
+  StatsCounterItem *counter = stats_get_counter(&sc_key, SC_TYPE_SINGLE_VALUE);
+  stats_unlock();
+  cr_assert_not_null(counter, "metric %s is not registered for partition %d", name, partition_index);
+  return counter;
+}
+
+static gsize
+_queued_messages(gint partition_index)
+{
+  return stats_counter_get(_get_partition_counter("parallelize_queued_messages", partition_index));
+}
+
+static gsize
+_stolen_batches(gint partition_index)
+{
+  return stats_counter_get(_get_partition_counter("parallelize_stolen_batches_total", partition_index));
+}
+
+Test(logscheduler, test_log_scheduler_metrics_are_labelled_with_the_location_and_the_partition)
+{
+  LogSchedulerOptions options;
+  TestPipe *test_pipe = _construct_test_pipe();
+  LogScheduler *s = _construct_scheduler(&options, test_pipe, NULL);
+
+  for (gint i = 0; i < NUM_PARTITIONS; i++)
+    {
+      cr_assert_eq(_get_partition_counter("parallelize_queued_messages", i), s->partitions[i].metrics.queued_messages);
+      cr_assert_eq(_get_partition_counter("parallelize_stolen_batches_total", i), s->partitions[i].metrics.stolen_batches);
+    }
+
+  _push_messages(s, 1, MESSAGES_PER_FLUSH);
+
+  /* round robin: every partition got the same share */
+  for (gint i = 0; i < NUM_PARTITIONS; i++)
+    cr_assert_eq(_queued_messages(i), MESSAGES_PER_FLUSH / NUM_PARTITIONS);
+
+  for (gint i = 0; i < NUM_PARTITIONS; i++)
+    _run_partition(s, i);
+
+  cr_assert_eq(test_pipe->messages_count, MESSAGES_PER_FLUSH);
+  for (gint i = 0; i < NUM_PARTITIONS; i++)
+    cr_assert_eq(_queued_messages(i), 0);
+
+  _destroy_scheduler(s, &options);
+  _destroy_test_pipe(test_pipe);
+}
+
+Test(logscheduler, test_log_scheduler_idle_partition_steals_batches_without_partition_key)
+{
+  LogSchedulerOptions options;
+  TestPipe *test_pipe = _construct_test_pipe();
+  LogScheduler *s = _construct_scheduler(&options, test_pipe, NULL);
+
+  cr_assert(s->work_stealing);
+  _push_messages(s, NUM_FLUSHES, MESSAGES_PER_FLUSH);
+
+  /* the worker of partition #0 drains its own batches and then takes over
+   * every batch still waiting in the other partitions */
+  _run_partition(s, 0);
+
+  cr_assert_eq(test_pipe->messages_count, NUM_FLUSHES * MESSAGES_PER_FLUSH);
+  cr_assert_eq(_stolen_batches(0), NUM_FLUSHES * (NUM_PARTITIONS - 1));
+  for (gint i = 0; i < NUM_PARTITIONS; i++)
+    {
+      cr_assert_eq(_queued_messages(i), 0);
+      if (i > 0)
+        cr_assert_eq(_stolen_batches(i), 0);
+    }
+
+  /* the others find nothing to do */
+  for (gint i = 1; i < NUM_PARTITIONS; i++)
+    _run_partition(s, i);
+  cr_assert_eq(test_pipe->messages_count, NUM_FLUSHES * MESSAGES_PER_FLUSH);
+
+  _destroy_scheduler(s, &options);
+  _destroy_test_pipe(test_pipe);
+}
+
+static void
+_assert_messages_are_ordered_by_key(TestPipe *test_pipe)
+{
+  GHashTable *last_seq_by_key = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  for (GList *l = test_pipe->messages->head; l; l = l->next)
+    {
+      LogMessage *msg = (LogMessage *) l->data;
+      const gchar *key = log_msg_get_value_by_name(msg, "KEY", NULL);
+      gint seq = atoi(log_msg_get_value_by_name(msg, "SEQ", NULL));
+      gpointer last_seq;
+
+      if (g_hash_table_lookup_extended(last_seq_by_key, key, NULL, &last_seq))
+        cr_assert_gt(seq, GPOINTER_TO_INT(last_seq), "messages of %s were reordered", key);
+      g_hash_table_insert(last_seq_by_key, g_strdup(key), GINT_TO_POINTER(seq));
+    }
+  g_hash_table_unref(last_seq_by_key);
+}
+
+Test(logscheduler, test_log_scheduler_does_not_steal_batches_with_partition_key)
+{
+  LogSchedulerOptions options;
+  TestPipe *test_pipe = _construct_test_pipe();
+  LogScheduler *s = _construct_scheduler(&options, test_pipe, "$KEY");
+
+  cr_assert_not(s->work_stealing);
+  _push_messages(s, NUM_FLUSHES, MESSAGES_PER_FLUSH);
+
+  gsize queued_elsewhere = 0;
+  for (gint i = 1; i < NUM_PARTITIONS; i++)
+    queued_elsewhere += _queued_messages(i);
+
+  /* partition #0 only processes its own batches */
+  _run_partition(s, 0);
+  cr_assert_eq(test_pipe->messages_count, NUM_FLUSHES * MESSAGES_PER_FLUSH - queued_elsewhere);
+  cr_assert_eq(_queued_messages(0), 0);
+  for (gint i = 1; i < NUM_PARTITIONS; i++)
+    queued_elsewhere -= _queued_messages(i);
+  cr_assert_eq(queued_elsewhere, 0);
+
+  for (gint i = 1; i < NUM_PARTITIONS; i++)
+    _run_partition(s, i);
+
+  cr_assert_eq(test_pipe->messages_count, NUM_FLUSHES * MESSAGES_PER_FLUSH);
+  for (gint i = 0; i < NUM_PARTITIONS; i++)
+    {
+      cr_assert_eq(_queued_messages(i), 0);
+      cr_assert_eq(_stolen_batches(i), 0);
+    }
+  _assert_messages_are_ordered_by_key(test_pipe);
+
+  _destroy_scheduler(s, &options);
+  _destroy_test_pipe(test_pipe);
+}
+
+static void
+_set_io_worker_threads(gint num_threads)
+{
+  GOptionContext *ctx = g_option_context_new(NULL);
+  gchar *arg = g_strdup_printf("--worker-threads=%d", num_threads);
+  gchar *argv_storage[] = { (gchar *) "syslog-ng", arg, NULL };
+  gchar **argv = argv_storage;
+  gint argc = 2;
+
+  main_loop_io_worker_add_options(ctx);
+  cr_assert(g_option_context_parse(ctx, &argc, &argv, NULL));
+  g_option_context_free(ctx);
+  g_free(arg);
+}
+
+Test(logscheduler, test_log_scheduler_auto_partitions_are_used_by_the_scheduler)
+{
+  LogSchedulerOptions options;
+  TestPipe *test_pipe = _construct_test_pipe();
+
+  _set_io_worker_threads(3);
+  main_loop_worker_allocate_thread_space(1);
+  main_loop_worker_finalize_thread_space();
+
+  log_scheduler_options_defaults(&options);
+  options.num_partitions = LOGSCHEDULER_PARTITIONS_AUTO;
+  cr_assert(log_scheduler_options_init(&options, configuration));
+  cr_assert_eq(options.num_partitions, 3);
+
+  LogScheduler *s = log_scheduler_new(&options, &test_pipe->super);
+  cr_assert(log_scheduler_init(s, "parallelize#0"));
+  cr_assert_eq(s->num_partitions, 3);
+  for (gint i = 0; i < s->num_partitions; i++)
+    s->partitions[i].flush_running = TRUE;
+
+  _push_messages(s, 1, 30);
+  for (gint i = 0; i < 3; i++)
+    cr_assert_eq(_queued_messages(i), 10);
+
+  for (gint i = 0; i < 3; i++)
+    _run_partition(s, i);
+  cr_assert_eq(test_pipe->messages_count, 30);
+
+  _destroy_scheduler(s, &options);
+  _destroy_test_pipe(test_pipe);
+}
+
+#endif
+
 static void
 setup(void)
 {
   app_startup();
   configuration = cfg_new_snippet();
+  configuration->stats_options.level = 1;
   cr_assert(cfg_init(configuration));
 }
 
@@ -329,6 +329,75 @@ Test(persist_state, test_values)
   cancel_and_destroy_persist_state(state);
 }
 
+Test(persist_state, test_persist_state_sync_flushes_updates_after_commit)
+{
+  const gchar *persist_file = "test_persist_state_sync.persist";
+  PersistState *state = clean_and_create_persist_state_for_test(persist_file);
+
+  cr_assert(persist_state_commit(state));
+
+  PersistEntryHandle handle = persist_state_alloc_entry(state, "alma", sizeof(TestState));
+  TestState *test_state = (TestState *) persist_state_map_entry(state, handle);
+  test_state->value = 0xDEADBEEF;
+  persist_state_unmap_entry(state, handle);
+
+  cr_assert(persist_state_sync(state));
+
+  /* a second reader sees the committed file with the synced value */
+  PersistState *reader = create_persist_state_for_test(persist_file);
+  gsize size;
+  guint8 version;
+  PersistEntryHandle reader_handle = persist_state_lookup_entry(reader, "alma", &size, &version);
+  cr_assert_neq(reader_handle, 0);
+
+  test_state = (TestState *) persist_state_map_entry(reader, reader_handle);
+  cr_assert_eq(test_state->value, 0xDEADBEEF);
+  persist_state_unmap_entry(reader, reader_handle);
+
+  persist_state_cancel(reader);
+  persist_state_free(reader);
+  persist_state_free(state);
+  unlink(persist_file);
+}
+
+static gpointer
+_sync_repeatedly(gpointer user_data)
+{
+  PersistState *state = (PersistState *) user_data;
+
+  for (gint i = 0; i < 200; i++)
+    cr_assert(persist_state_sync(state));
+  return NULL;
+}
+
+Test(persist_state, test_persist_state_sync_from_another_thread_while_the_store_grows)
+{
+  const gchar *persist_file = "test_persist_state_sync_while_growing.persist";
+  PersistState *state = clean_and_create_persist_state_for_test(persist_file);
+
+  cr_assert(persist_state_commit(state));
+
+  GThread *syncer = g_thread_new("persist-sync", _sync_repeatedly, state);
+  for (gint i = 0; i < 1000; i++)
+    {
+      gchar persist_name[32];
+      g_snprintf(persist_name, sizeof(persist_name), "entry-%d", i);
+
+      PersistEntryHandle handle = persist_state_alloc_entry(state, persist_name, 1024);
+      cr_assert_neq(handle, 0);
+      TestState *test_state = (TestState *) persist_state_map_entry(state, handle);
+      test_state->value = i;
+      persist_state_unmap_entry(state, handle);
+    }
+  g_thread_join(syncer);
+
+  cr_assert(persist_state_sync(state));
+  cr_assert_eq(state->mapped_counter, 0);
+
+  persist_state_free(state);
+  unlink(persist_file);
+}
+
 Test(persist_state, test_persist_state_temp_file_cleanup_on_cancel)
 {
   PersistState *state = clean_and_create_persist_state_for_test("test_persist_state_temp_file_cleanup_on_cancel.persist");
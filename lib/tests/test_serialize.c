@@ -56,3 +56,72 @@ Test(serialize, test_serialize)
   serialize_read_string(a, value);
   cr_assert_str_eq(value->str, "tarkabarka");
 }
+
+static void
+_count_release(gpointer user_data)
+{
+  (*(gint *) user_data)++;
+}
+
+Test(serialize, test_iovec_archive_references_borrowed_blocks)
+{
+  GString *buffer = g_string_new("");
+  gchar borrowed[] = "borrowed";
+  gint released = 0;
+
+  SerializeArchive *a = serialize_iovec_archive_new(buffer);
+
+  serialize_write_uint32(a, 0xdeadbeaf);
+  serialize_write_blob_borrowed(a, borrowed, 8, &released, _count_release);
+  serialize_write_cstring(a, "kismacska", -1);
+  cr_assert_eq(released, 0);
+  cr_assert_eq(serialize_iovec_archive_get_length(a), 4 + 8 + 4 + 9);
+
+  gint iovcnt;
+  const struct iovec *iov = serialize_iovec_archive_get_iovec(a, &iovcnt);
+  cr_assert_eq(iovcnt, 3);
+  cr_assert_eq(iov[0].iov_len, 4);
+  cr_assert_eq(iov[1].iov_base, borrowed, "borrowed blocks must not be copied");
+  cr_assert_eq(iov[1].iov_len, 8);
+  cr_assert_eq(iov[2].iov_len, 13);
+
+  GString *flattened = g_string_new("");
+  for (gint i = 0; i < iovcnt; i++)
+    g_string_append_len(flattened, iov[i].iov_base, iov[i].iov_len);
+
+  serialize_archive_free(a);
+  cr_assert_eq(released, 1);
+
+  gchar buf[8];
+  guint32 num = 0;
+  GString *value = g_string_new("");
+
+  a = serialize_string_archive_new(flattened);
+  cr_assert(serialize_read_uint32(a, &num));
+  cr_assert_eq(num, 0xdeadbeaf);
+  cr_assert(serialize_read_blob(a, buf, 8));
+  cr_assert_arr_eq(buf, "borrowed", 8);
+  cr_assert(serialize_read_string(a, value));
+  cr_assert_str_eq(value->str, "kismacska");
+  serialize_archive_free(a);
+
+  g_string_free(value, TRUE);
+  g_string_free(flattened, TRUE);
+  g_string_free(buffer, TRUE);
+}
+
+Test(serialize, test_borrowed_blocks_are_copied_by_other_archives)
+{
+  GString *stream = g_string_new("");
+  gchar borrowed[] = "borrowed";
+  gint released = 0;
+
+  SerializeArchive *a = serialize_string_archive_new(stream);
+  serialize_write_blob_borrowed(a, borrowed, 8, &released, _count_release);
+  cr_assert_eq(released, 1);
+  cr_assert_eq(stream->len, 8);
+  cr_assert_arr_eq(stream->str, "borrowed", 8);
+
+  serialize_archive_free(a);
+  g_string_free(stream, TRUE);
+}
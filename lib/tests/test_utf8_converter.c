@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/stopwatch.h"
+
+#include "utf8-converter.h"
+
+#include <errno.h>
+
+typedef struct _ConversionResult
+{
+  gsize ret;
+  gint error;
+  gsize in_left;
+  gsize out_left;
+  guchar out[2048];
+} ConversionResult;
+
+static void
+_convert_with_iconv(const gchar *encoding, const guchar *input, gsize input_len, gsize out_size,
+                    ConversionResult *result)
+{
+  GIConv cd = g_iconv_open("utf-8", encoding);
+  gchar *in = (gchar *) input;
+  gchar *out = (gchar *) result->out;
+
+  cr_assert(cd != (GIConv) -1);
+  result->in_left = input_len;
+  result->out_left = out_size;
+  errno = 0;
+  result->ret = g_iconv(cd, &in, &result->in_left, &out, &result->out_left);
+  result->error = errno;
+  g_iconv_close(cd);
+}
+
+static void
+_convert_with_converter(const gchar *encoding, const guchar *input, gsize input_len, gsize out_size,
+                        ConversionResult *result)
+{
+  UTF8Converter *converter = utf8_converter_new(encoding);
+  const guchar *in = input;
+  guchar *out = result->out;
+
+  cr_assert_not_null(converter, "no fast path for encoding %s", encoding);
+  result->in_left = input_len;
+  result->out_left = out_size;
+  errno = 0;
+  result->ret = utf8_converter_convert(converter, &in, &result->in_left, &out, &result->out_left);
+  result->error = errno;
+  utf8_converter_free(converter);
+}
+
+static void
+_assert_conversion_matches_iconv(const gchar *encoding, const guchar *input, gsize input_len, gsize out_size)
+{
+  ConversionResult expected, converted;
+
+  _convert_with_iconv(encoding, input, input_len, out_size, &expected);
+  _convert_with_converter(encoding, input, input_len, out_size, &converted);
+
+  cr_assert_eq(converted.ret, expected.ret, "return value mismatch, encoding=%s", encoding);
+  if (expected.ret == (gsize) -1)
+    cr_assert_eq(converted.error, expected.error, "errno mismatch, encoding=%s", encoding);
+  cr_assert_eq(converted.in_left, expected.in_left, "consumed input mismatch, encoding=%s", encoding);
+  cr_assert_eq(converted.out_left, expected.out_left, "output length mismatch, encoding=%s", encoding);
+  cr_assert_arr_eq(converted.out, expected.out, out_size - expected.out_left, "output mismatch, encoding=%s",
+                   encoding);
+}
+
+static const gchar *fast_path_encodings[] =
+{
+  "latin1", "ISO-8859-1", "iso8859-2", "ISO-8859-15", "WINDOWS-1252", "cp1251", "KOI8-R", "ascii",
+  "UTF-16LE", "utf16be", "UTF_16LE",
+  NULL
+};
+
+Test(utf8_converter, converters_are_only_created_for_supported_encodings)
+{
+  for (gint i = 0; fast_path_encodings[i]; i++)
+    {
+      UTF8Converter *converter = utf8_converter_new(fast_path_encodings[i]);
+
+      cr_assert_not_null(converter, "expected a fast path for encoding %s", fast_path_encodings[i]);
+      utf8_converter_free(converter);
+    }
+
+  /* multibyte, stateful or unknown encodings */
+  cr_assert_null(utf8_converter_new("UTF-8"));
+  cr_assert_null(utf8_converter_new("UTF-16"));
+  cr_assert_null(utf8_converter_new("SHIFT_JIS"));
+  cr_assert_null(utf8_converter_new("ISO-2022-JP"));
+  cr_assert_null(utf8_converter_new("no-such-encoding"));
+}
+
+Test(utf8_converter, special_sequences_are_handled_like_iconv)
+{
+  /* undefined in windows-1252 */
+  _assert_conversion_matches_iconv("WINDOWS-1252", (const guchar *) "abc\x81xyz", 7, 64);
+  /* euro sign in windows-1252 and iso-8859-15 */
+  _assert_conversion_matches_iconv("WINDOWS-1252", (const guchar *) "\x80 100", 5, 64);
+  _assert_conversion_matches_iconv("ISO-8859-15", (const guchar *) "\xa4 100", 5, 64);
+  /* non-ascii in ascii */
+  _assert_conversion_matches_iconv("ascii", (const guchar *) "abc\xe9", 4, 64);
+
+  /* surrogate pair, lone low surrogate, truncated pair and odd length */
+  _assert_conversion_matches_iconv("UTF-16LE", (const guchar *) "a\0\x3d\xd8\x00\xde" "b\0", 8, 64);
+  _assert_conversion_matches_iconv("UTF-16LE", (const guchar *) "a\0\x00\xde" "b\0", 6, 64);
+  _assert_conversion_matches_iconv("UTF-16LE", (const guchar *) "a\0\x3d\xd8", 4, 64);
+  _assert_conversion_matches_iconv("UTF-16BE", (const guchar *) "\0a\0b\0", 5, 64);
+  _assert_conversion_matches_iconv("UTF-16BE", (const guchar *) "\xd8\x3d\0a", 4, 64);
+
+  /* output buffer too small in the middle of a character */
+  _assert_conversion_matches_iconv("latin1", (const guchar *) "abc\xe9", 4, 4);
+  _assert_conversion_matches_iconv("UTF-16BE", (const guchar *) "\0a\x20\xac", 4, 3);
+}
+
+Test(utf8_converter, random_input_is_converted_like_iconv)
+{
+  guchar input[512];
+  GRand *rand = g_rand_new_with_seed(1);
+
+  for (gint i = 0; fast_path_encodings[i]; i++)
+    {
+      for (gint round = 0; round < 2000; round++)
+        {
+          gsize input_len = g_rand_int_range(rand, 0, sizeof(input));
+          gint non_ascii_percent = g_rand_int_range(rand, 0, 3) * 50;
+
+          for (gsize j = 0; j < input_len; j++)
+            {
+              if (g_rand_int_range(rand, 0, 100) < non_ascii_percent)
+                input[j] = g_rand_int_range(rand, 0, 256);
+              else if ((j % 2) && strstr(fast_path_encodings[i], "16"))
+                input[j] = 0;
+              else
+                input[j] = g_rand_int_range(rand, 'a', 'z' + 1);
+            }
+
+          gsize out_size = g_rand_boolean(rand) ? sizeof(((ConversionResult *) 0)->out)
+                           : (gsize) g_rand_int_range(rand, 0, 2 * input_len + 2);
+          _assert_conversion_matches_iconv(fast_path_encodings[i], input, input_len, out_size);
+        }
+    }
+
+  g_rand_free(rand);
+}
+
+#define PERFTEST_INPUT_SIZE 65536
+#define PERFTEST_ITERATIONS 2000
+
+static void
+_perftest(const gchar *encoding, const guchar *input)
+{
+  static guchar output[PERFTEST_INPUT_SIZE * 3];
+  UTF8Converter *converter = utf8_converter_new(encoding);
+  GIConv cd = g_iconv_open("utf-8", encoding);
+
+  start_stopwatch();
+  for (gint i = 0; i < PERFTEST_ITERATIONS; i++)
+    {
+      const guchar *in = input;
+      gsize in_left = PERFTEST_INPUT_SIZE;
+      guchar *out = output;
+      gsize out_left = sizeof(output);
+
+      utf8_converter_convert(converter, &in, &in_left, &out, &out_left);
+    }
+  stop_stopwatch_and_display_result(PERFTEST_ITERATIONS, "Converting 64k of %s with the fast path", encoding);
+
+  start_stopwatch();
+  for (gint i = 0; i < PERFTEST_ITERATIONS; i++)
+    {
+      gchar *in = (gchar *) input;
+      gsize in_left = PERFTEST_INPUT_SIZE;
+      gchar *out = (gchar *) output;
+      gsize out_left = sizeof(output);
+
+      g_iconv(cd, &in, &in_left, &out, &out_left);
+    }
+  stop_stopwatch_and_display_result(PERFTEST_ITERATIONS, "Converting 64k of %s with iconv", encoding);
+
+  g_iconv_close(cd);
+  utf8_converter_free(converter);
+}
+
+Test(utf8_converter, test_performance)
+{
+  static guchar single_byte_input[PERFTEST_INPUT_SIZE];
+  static guchar utf16_input[PERFTEST_INPUT_SIZE];
+
+  /* mostly ASCII with an accented character every now and then */
+  for (gint i = 0; i < PERFTEST_INPUT_SIZE; i++)
+    {
+      single_byte_input[i] = (i % 50 == 0) ? 0xE9 : 'a' + i % 26;
+      utf16_input[i] = (i % 2) ? ((i % 100 == 1) ? 0x01 : 0) : 'a' + i % 26;
+    }
+
+  _perftest("latin1", single_byte_input);
+  _perftest("WINDOWS-1252", single_byte_input);
+  _perftest("UTF-16LE", utf16_input);
+}
@@ -36,6 +36,19 @@ typedef struct _TimeCache
   struct tm tm;
 } TimeCache;
 
+#define TIMESTAMP_MEMO_SIZE 4
+
+typedef struct _TimestampMemo
+{
+  gchar key[TIMESTAMP_MEMO_KEY_MAX];
+  gsize key_len;
+  glong gmtoff_hint;
+  /* 0 if the result does not depend on the current time */
+  time_t expires;
+  gint64 ut_sec;
+  gint32 ut_gmtoff;
+} TimestampMemo;
+
 
 TLS_BLOCK_START
 {
@@ -64,6 +77,11 @@ TLS_BLOCK_START
       struct tm mutated_key;
       time_t value;
     } mktime;
+    struct
+    {
+      TimestampMemo entries[TIMESTAMP_MEMO_SIZE];
+      gint next;
+    } timestamps;
   } cache;
   struct
   {
@@ -202,6 +220,7 @@ _clean_timeutils_cache(void)
   memset(&cache.gmtime.buckets, 0, sizeof(cache.gmtime.buckets));
   memset(&cache.localtime.buckets, 0, sizeof(cache.localtime.buckets));
   memset(&cache.mktime.key, 0, sizeof(cache.mktime.key));
+  memset(&cache.timestamps, 0, sizeof(cache.timestamps));
   if (cache.tzinfo.zones)
     cache_clear(cache.tzinfo.zones);
 
@@ -343,6 +362,64 @@ cached_mktime(struct tm *tm)
   return _calculate_and_adjust_mktime_result_based_on_cache(tm);
 }
 
+static TimestampMemo *
+_lookup_timestamp_memo(const gchar *key, gsize key_len, glong gmtoff_hint)
+{
+  for (gint i = 0; i < TIMESTAMP_MEMO_SIZE; i++)
+    {
+      TimestampMemo *memo = &cache.timestamps.entries[i];
+
+      if (memo->key_len == key_len && memo->gmtoff_hint == gmtoff_hint && memcmp(memo->key, key, key_len) == 0)
+        return memo;
+    }
+  return NULL;
+}
+
+/* bursts of messages from the same host usually share the timestamp down to
+ * the second, the conversion results of the last few timestamps are kept
+ * per thread, keyed by the raw timestamp without the fractional part */
+gboolean
+cached_timestamp_lookup(const gchar *key, gsize key_len, glong gmtoff_hint, UnixTime *stamp)
+{
+  _validate_timeutils_cache();
+
+  TimestampMemo *memo = _lookup_timestamp_memo(key, key_len, gmtoff_hint);
+  if (!memo)
+    return FALSE;
+
+  if (memo->expires && memo->expires <= get_cached_realtime_sec())
+    return FALSE;
+
+  stamp->ut_sec = memo->ut_sec;
+  stamp->ut_gmtoff = memo->ut_gmtoff;
+  return TRUE;
+}
+
+/* @depends_on_current_time: the year was guessed based on the current
+ * date, the result is only reused within the same minute */
+void
+cached_timestamp_store(const gchar *key, gsize key_len, glong gmtoff_hint, const UnixTime *stamp,
+                       gboolean depends_on_current_time)
+{
+  g_assert(key_len <= TIMESTAMP_MEMO_KEY_MAX);
+
+  _validate_timeutils_cache();
+
+  TimestampMemo *memo = _lookup_timestamp_memo(key, key_len, gmtoff_hint);
+  if (!memo)
+    {
+      memo = &cache.timestamps.entries[cache.timestamps.next];
+      cache.timestamps.next = (cache.timestamps.next + 1) % TIMESTAMP_MEMO_SIZE;
+    }
+
+  memcpy(memo->key, key, key_len);
+  memo->key_len = key_len;
+  memo->gmtoff_hint = gmtoff_hint;
+  memo->expires = depends_on_current_time ? (get_cached_realtime_sec() / 60 + 1) * 60 : 0;
+  memo->ut_sec = stamp->ut_sec;
+  memo->ut_gmtoff = stamp->ut_gmtoff;
+}
+
 void
 cached_localtime(time_t *when, struct tm *tm)
 {
@@ -27,6 +27,9 @@
 
 #include "timeutils/wallclocktime.h"
 #include "timeutils/zoneinfo.h"
+#include "timeutils/unixtime.h"
+
+#define TIMESTAMP_MEMO_KEY_MAX 32
 
 /* the thread safe variant of the global "timezone" */
 glong cached_get_system_tzofs(void);
@@ -41,6 +44,10 @@ time_t cached_mktime(struct tm *tm);
 void cached_localtime(time_t *when, struct tm *tm);
 void cached_gmtime(time_t *when, struct tm *tm);
 
+gboolean cached_timestamp_lookup(const gchar *key, gsize key_len, glong gmtoff_hint, UnixTime *stamp);
+void cached_timestamp_store(const gchar *key, gsize key_len, glong gmtoff_hint, const UnixTime *stamp,
+                            gboolean depends_on_current_time);
+
 void timeutils_cache_deinit(void);
 
 static inline void
@@ -25,6 +25,7 @@
 #include "timeutils/wallclocktime.h"
 #include "str-format.h"
 #include "timeutils/cache.h"
+#include "timeutils/conv.h"
 
 #include <ctype.h>
 #include <string.h>
@@ -493,6 +494,20 @@ __parse_bsd_timestamp(const guchar **data, gint *length, WallClockTime *wct)
   return TRUE;
 }
 
+static inline void
+__skip_closing_colon(const guchar **data, gint *length)
+{
+  /* we might have a closing colon at the end of the timestamp, "Cisco" I am
+   * looking at you, skip that as well, so we can reliably detect IPv6
+   * addresses as hostnames, which would be using ":" as well. */
+
+  if (*length && **data == ':')
+    {
+      ++(*data);
+      --(*length);
+    }
+}
+
 gboolean
 scan_rfc3164_timestamp(const guchar **data, gint *length, WallClockTime *wct)
 {
@@ -511,15 +526,135 @@ scan_rfc3164_timestamp(const guchar **data, gint *length, WallClockTime *wct)
         return FALSE;
     }
 
-  /* we might have a closing colon at the end of the timestamp, "Cisco" I am
-   * looking at you, skip that as well, so we can reliably detect IPv6
-   * addresses as hostnames, which would be using ":" as well. */
+  __skip_closing_colon(&src, &left);
+
+  *data = src;
+  *length = left;
+  return TRUE;
+}
+
+gboolean
+scan_rfc5424_timestamp(const guchar **data, gint *length, WallClockTime *wct)
+{
+  const guchar *src = *data;
+  gint left = *length;
+
+  if (!__parse_iso_stamp(wct, &src, &left))
+    return FALSE;
 
-  if (left && *src == ':')
+  *data = src;
+  *length = left;
+  return TRUE;
+}
+
+/*******************************************************************************
+ * Scan a timestamp and convert it to UnixTime
+ *
+ * The conversion results are memoized per thread (see
+ * cached_timestamp_lookup()), keyed by the raw bytes of the timestamp
+ * without the fractional seconds, so repeated timestamps are neither fully
+ * scanned nor converted again.  Only the common ISO and "MMM DD HH:MM:SS"
+ * formats are memoized, these have a fixed length that is known right after
+ * the format detection.
+ *******************************************************************************/
+
+#define ISO_STAMP_LEN           19
+#define ISO_TIMEZONE_LEN        6
+#define BSD_STAMP_LEN           15
+#define BSD_NOPAD_DAY_STAMP_LEN 14
+
+static gsize
+__format_memo_key(gchar *key, const guchar *stamp, gsize stamp_len, const guchar *zone, gsize zone_len)
+{
+  memcpy(key, stamp, stamp_len);
+  memcpy(key + stamp_len, zone, zone_len);
+  return stamp_len + zone_len;
+}
+
+/* expects __is_iso_stamp() to be TRUE */
+static gboolean
+__parse_iso_stamp_to_unix_time(const guchar **data, gint *length, UnixTime *ut, glong gmtoff_hint)
+{
+  const guchar *src = *data + ISO_STAMP_LEN;
+  gint left = *length - ISO_STAMP_LEN;
+  gchar key[ISO_STAMP_LEN + ISO_TIMEZONE_LEN];
+
+  guint32 usec = __parse_usec(&src, &left);
+
+  gsize zone_len = 0;
+  if (left > 0 && *src == 'Z')
+    zone_len = 1;
+  else if (__has_iso_timezone(src, left))
+    zone_len = ISO_TIMEZONE_LEN;
+
+  gsize key_len = __format_memo_key(key, *data, ISO_STAMP_LEN, src, zone_len);
+  if (!cached_timestamp_lookup(key, key_len, gmtoff_hint, ut))
     {
-      ++src;
-      --left;
+      WallClockTime wct = WALL_CLOCK_TIME_INIT;
+      const gchar *stamp = (const gchar *) *data;
+      gint stamp_left = ISO_STAMP_LEN;
+
+      if (!scan_iso_timestamp(&stamp, &stamp_left, &wct))
+        return FALSE;
+
+      if (zone_len == 1)
+        wct.wct_gmtoff = 0;
+      else if (zone_len == ISO_TIMEZONE_LEN)
+        {
+          const guchar *zone = src;
+          gint zone_left = left;
+
+          wct.wct_gmtoff = __parse_iso_timezone(&zone, &zone_left);
+        }
+      else
+        wct.wct_gmtoff = -1;
+
+      convert_and_normalize_wall_clock_time_to_unix_time_with_tz_hint(&wct, ut, gmtoff_hint);
+      cached_timestamp_store(key, key_len, gmtoff_hint, ut, FALSE);
     }
+  ut->ut_usec = usec;
+
+  *data = src + zone_len;
+  *length = left - zone_len;
+  return TRUE;
+}
+
+static gboolean
+__parse_bsd_timestamp_to_unix_time(const guchar **data, gint *length, UnixTime *ut, glong gmtoff_hint)
+{
+  WallClockTime wct = WALL_CLOCK_TIME_INIT;
+
+  if (!__parse_bsd_timestamp(data, length, &wct))
+    return FALSE;
+  convert_and_normalize_wall_clock_time_to_unix_time_with_tz_hint(&wct, ut, gmtoff_hint);
+  return TRUE;
+}
+
+/* expects the RFC3164 or the RFC3164 nopad-day format to be detected */
+static gboolean
+__parse_bsd_rfc3164_stamp_to_unix_time(const guchar **data, gint *length, gsize stamp_len,
+                                       UnixTime *ut, glong gmtoff_hint)
+{
+  const guchar *src = *data + stamp_len;
+  gint left = *length - stamp_len;
+
+  guint32 usec = __parse_usec(&src, &left);
+
+  if (!cached_timestamp_lookup((const gchar *) *data, stamp_len, gmtoff_hint, ut))
+    {
+      WallClockTime wct = WALL_CLOCK_TIME_INIT;
+      const gchar *stamp = (const gchar *) *data;
+      gint stamp_left = stamp_len;
+
+      /* odd spacing may shift the fields, leave those to the generic code */
+      if (!scan_bsd_timestamp(&stamp, &stamp_left, &wct) || stamp_left != 0)
+        return __parse_bsd_timestamp_to_unix_time(data, length, ut, gmtoff_hint);
+
+      wall_clock_time_guess_missing_year(&wct);
+      convert_and_normalize_wall_clock_time_to_unix_time_with_tz_hint(&wct, ut, gmtoff_hint);
+      cached_timestamp_store((const gchar *) *data, stamp_len, gmtoff_hint, ut, TRUE);
+    }
+  ut->ut_usec = usec;
 
   *data = src;
   *length = left;
@@ -527,12 +662,54 @@ scan_rfc3164_timestamp(const guchar **data, gint *length, WallClockTime *wct)
 }
 
 gboolean
-scan_rfc5424_timestamp(const guchar **data, gint *length, WallClockTime *wct)
+scan_rfc3164_timestamp_to_unix_time(const guchar **data, gint *length, UnixTime *ut, glong gmtoff_hint)
 {
   const guchar *src = *data;
   gint left = *length;
 
-  if (!__parse_iso_stamp(wct, &src, &left))
+  if (__is_iso_stamp((const gchar *) src, left))
+    {
+      if (!__parse_iso_stamp_to_unix_time(&src, &left, ut, gmtoff_hint))
+        return FALSE;
+    }
+  else if (__is_bsd_pix_or_asa(src, left) || __is_bsd_linksys(src, left))
+    {
+      if (!__parse_bsd_timestamp_to_unix_time(&src, &left, ut, gmtoff_hint))
+        return FALSE;
+    }
+  else if (__is_bsd_rfc_3164(src, left))
+    {
+      if (!__parse_bsd_rfc3164_stamp_to_unix_time(&src, &left, BSD_STAMP_LEN, ut, gmtoff_hint))
+        return FALSE;
+    }
+  else if (__is_bsd_rfc_3164_nopad_day(src, left))
+    {
+      if (!__parse_bsd_rfc3164_stamp_to_unix_time(&src, &left, BSD_NOPAD_DAY_STAMP_LEN, ut, gmtoff_hint))
+        return FALSE;
+    }
+  else
+    {
+      return FALSE;
+    }
+
+  __skip_closing_colon(&src, &left);
+
+  *data = src;
+  *length = left;
+  return TRUE;
+}
+
+gboolean
+scan_rfc5424_timestamp_to_unix_time(const guchar **data, gint *length, UnixTime *ut, glong gmtoff_hint)
+{
+  const guchar *src = *data;
+  gint left = *length;
+
+  /* scan_iso_timestamp() accepts exactly what __is_iso_stamp() detects */
+  if (!__is_iso_stamp((const gchar *) src, left))
+    return FALSE;
+
+  if (!__parse_iso_stamp_to_unix_time(&src, &left, ut, gmtoff_hint))
     return FALSE;
 
   *data = src;
@@ -39,6 +39,10 @@ gboolean scan_bsd_timestamp(const gchar **buf, gint *left, WallClockTime *wct);
 gboolean scan_rfc3164_timestamp(const guchar **data, gint *length, WallClockTime *wct);
 gboolean scan_rfc5424_timestamp(const guchar **data, gint *length, WallClockTime *wct);
 
+/* scan and convert in one step, using a per-thread memo of recent timestamps */
+gboolean scan_rfc3164_timestamp_to_unix_time(const guchar **data, gint *length, UnixTime *ut, glong gmtoff_hint);
+gboolean scan_rfc5424_timestamp_to_unix_time(const guchar **data, gint *length, UnixTime *ut, glong gmtoff_hint);
+
 gboolean scan_day_abbrev(const gchar **buf, gint *left, gint *wday);
 gboolean scan_month_abbrev(const gchar **buf, gint *left, gint *mon);
 
@@ -29,6 +29,7 @@
 #include "timeutils/cache.h"
 #include "timeutils/format.h"
 #include "timeutils/conv.h"
+#include "timeutils/zoneinfo.h"
 #include "apphook.h"
 
 #define CONVERTED_TS_SIZE 32
@@ -451,6 +452,188 @@ Test(parse_timestamp, rfc5424_performance)
   stop_stopwatch_and_display_result(it, "RFC5424 timestamp parsing speed");
 }
 
+static gboolean
+_scan_and_convert(const gchar *ts, gboolean rfc5424, glong gmtoff_hint, UnixTime *stamp, gint *remaining)
+{
+  const guchar *data = (const guchar *) ts;
+  gint length = strlen(ts);
+  WallClockTime wct = WALL_CLOCK_TIME_INIT;
+
+  gboolean success = rfc5424 ? scan_rfc5424_timestamp(&data, &length, &wct)
+                     : scan_rfc3164_timestamp(&data, &length, &wct);
+  if (success)
+    convert_and_normalize_wall_clock_time_to_unix_time_with_tz_hint(&wct, stamp, gmtoff_hint);
+  *remaining = length;
+  return success;
+}
+
+static gboolean
+_scan_to_unix_time(const gchar *ts, gboolean rfc5424, glong gmtoff_hint, UnixTime *stamp, gint *remaining)
+{
+  const guchar *data = (const guchar *) ts;
+  gint length = strlen(ts);
+
+  gboolean success = rfc5424 ? scan_rfc5424_timestamp_to_unix_time(&data, &length, stamp, gmtoff_hint)
+                     : scan_rfc3164_timestamp_to_unix_time(&data, &length, stamp, gmtoff_hint);
+  cr_assert(data == (const guchar *) ts + strlen(ts) - length);
+  *remaining = length;
+  return success;
+}
+
+static void
+_assert_memoized_conversion_matches(const gchar *ts, gboolean rfc5424, glong gmtoff_hint)
+{
+  UnixTime expected, converted;
+  gint expected_remaining, remaining;
+
+  gboolean expected_success = _scan_and_convert(ts, rfc5424, gmtoff_hint, &expected, &expected_remaining);
+
+  /* the first round fills the memo, the second one is served from it */
+  for (gint round = 0; round < 2; round++)
+    {
+      cr_assert_eq(_scan_to_unix_time(ts, rfc5424, gmtoff_hint, &converted, &remaining), expected_success,
+                   "unexpected result, ts=%s, round=%d", ts, round);
+      if (!expected_success)
+        continue;
+
+      cr_assert_eq(remaining, expected_remaining, "remaining length mismatch, ts=%s, round=%d", ts, round);
+      cr_assert(unix_time_eq(&converted, &expected), "conversion mismatch, ts=%s, round=%d", ts, round);
+    }
+}
+
+Test(parse_timestamp, memoized_conversion_matches_scan_and_convert)
+{
+  const gchar *rfc3164_stamps[] =
+  {
+    "Oct  1 17:46:12",
+    "Dec  3 09:10:12.987 host",
+    "Dec  3 09:10:12,987: host",
+    "Dec 3 09:10:12.987 host",
+    "Jan  3 17:46:12 host",
+    "Dec  3 09:10:12 2019 host",
+    "Dec  3 2019 09:10:12: host",
+    "2017-12-03T09:10:12.987+01:00 host",
+    "2017-12-03 09:10:12 host",
+    "2017-12-03T09:10:12Z: host",
+    "Dec 3x09:10:12 host",
+    "Xyz  3 09:10:12 host",
+    NULL
+  };
+  const gchar *rfc5424_stamps[] =
+  {
+    "2017-06-14T23:57:27+02:00 host",
+    "2017-06-14T23:57:27.123456Z host",
+    "2017-06-14T23:57:27.123 host",
+    "2017-06-14T23:57:27-05:30",
+    "2017-06-14T23:57:27+02:001",
+    "2017-06-14T23:57:2x host",
+    "2017-06-14",
+    NULL
+  };
+  glong hints[] = { -1, 0, 3600, -18000 };
+
+  for (gint h = 0; h < G_N_ELEMENTS(hints); h++)
+    {
+      for (gint i = 0; rfc3164_stamps[i]; i++)
+        _assert_memoized_conversion_matches(rfc3164_stamps[i], FALSE, hints[h]);
+      for (gint i = 0; rfc5424_stamps[i]; i++)
+        _assert_memoized_conversion_matches(rfc5424_stamps[i], TRUE, hints[h]);
+    }
+}
+
+Test(parse_timestamp, memoized_conversion_keeps_fractions_and_time_zones_apart)
+{
+  UnixTime stamp;
+  gint remaining;
+
+  cr_assert(_scan_to_unix_time("2017-06-14T23:57:27.100+02:00", TRUE, -1, &stamp, &remaining));
+  cr_assert(_scan_to_unix_time("2017-06-14T23:57:27.200+02:00", TRUE, -1, &stamp, &remaining));
+  cr_assert_eq(stamp.ut_usec, 200000);
+  cr_assert_eq(stamp.ut_gmtoff, 7200);
+
+  cr_assert(_scan_to_unix_time("2017-06-14T23:57:27.300+01:00", TRUE, -1, &stamp, &remaining));
+  cr_assert_eq(stamp.ut_usec, 300000);
+  cr_assert_eq(stamp.ut_gmtoff, 3600);
+
+  cr_assert(_scan_to_unix_time("2017-06-14T23:57:27.400", TRUE, -18000, &stamp, &remaining));
+  cr_assert_eq(stamp.ut_gmtoff, -18000);
+  cr_assert(_scan_to_unix_time("2017-06-14T23:57:27.400", TRUE, 0, &stamp, &remaining));
+  cr_assert_eq(stamp.ut_gmtoff, 0);
+}
+
+Test(parse_timestamp, memoized_conversion_guesses_the_year_again_as_time_passes)
+{
+  UnixTime stamp;
+  gint remaining;
+
+  cr_assert(_scan_to_unix_time("Jan  3 17:46:12", FALSE, 3600, &stamp, &remaining));
+  /* 2018-01-03T17:46:12+01:00 */
+  cr_assert_eq(stamp.ut_sec, 1514997972);
+
+  /* Jan 03 09:32:21 CET 2019 */
+  fake_time(1546504341);
+
+  cr_assert(_scan_to_unix_time("Jan  3 17:46:12", FALSE, 3600, &stamp, &remaining));
+  /* 2019-01-03T17:46:12+01:00 */
+  cr_assert_eq(stamp.ut_sec, 1546533972);
+}
+
+/* bursts of messages from a few hosts, with the receiver time zone looked
+ * up for every message, like the syslog parser does */
+static void
+_timestamp_mix_perftest(const gchar **stamps, gboolean rfc5424, gboolean memoized)
+{
+  TimeZoneInfo *recv_tz = cached_get_time_zone_info("America/New_York");
+  time_t now = get_cached_realtime_sec();
+  UnixTime stamp;
+  gint remaining;
+  gint it = 1000000;
+  gint n = 0;
+
+  while (stamps[n])
+    n++;
+
+  start_stopwatch();
+  for (gint i = 0; i < it; i++)
+    {
+      const gchar *ts = stamps[(i / 16) % n];
+      glong hint = time_zone_info_get_offset(recv_tz, now);
+
+      if (memoized)
+        _scan_to_unix_time(ts, rfc5424, hint, &stamp, &remaining);
+      else
+        _scan_and_convert(ts, rfc5424, hint, &stamp, &remaining);
+    }
+  stop_stopwatch_and_display_result(it, "%s timestamp mix, %s", rfc5424 ? "RFC5424" : "RFC3164",
+                                    memoized ? "memoized" : "scan and convert");
+}
+
+Test(parse_timestamp, timestamp_mix_performance)
+{
+  const gchar *rfc3164_stamps[] =
+  {
+    "Dec 14 05:27:22 host1 prog: msg",
+    "Dec 14 05:27:22.123 host2 prog: msg",
+    "Dec 14 05:27:23 host1 prog: msg",
+    "2019-12-14T05:27:22.456+01:00 host3 prog: msg",
+    "Dec 14 2019 05:27:22: host4 prog: msg",
+    NULL
+  };
+  const gchar *rfc5424_stamps[] =
+  {
+    "2019-12-14T05:27:22.123Z host1 prog",
+    "2019-12-14T05:27:22.456+01:00 host2 prog",
+    "2019-12-14T05:27:23.789 host3 prog",
+    "2019-12-14T05:27:23.012Z host1 prog",
+    NULL
+  };
+
+  _timestamp_mix_perftest(rfc3164_stamps, FALSE, FALSE);
+  _timestamp_mix_perftest(rfc3164_stamps, FALSE, TRUE);
+  _timestamp_mix_perftest(rfc5424_stamps, TRUE, FALSE);
+  _timestamp_mix_perftest(rfc5424_stamps, TRUE, TRUE);
+}
+
 static void
 _parse_valid_month(const gchar *month, const gint expected_month)
 {
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "transport/transport-tls.h"
+#include "transport/tls-context.h"
+#include "transport/tls-session.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "apphook.h"
+
+#include <glib-unix.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define SERVER_KEY TOP_SRCDIR "/tests/light/shared_files/server.key"
+#define SERVER_CERT TOP_SRCDIR "/tests/light/shared_files/server.crt"
+
+static TLSContext *
+_create_tls_context(TLSMode mode, const gchar *ssl_options[], const gchar *cipher_suite)
+{
+  TLSContext *tls_context = tls_context_new(mode, "test_transport_tls");
+  GList *options = NULL;
+
+  for (gint i = 0; ssl_options[i]; i++)
+    options = g_list_append(options, (gpointer) ssl_options[i]);
+  cr_assert(tls_context_set_ssl_options_by_name(tls_context, options));
+  g_list_free(options);
+
+  cr_assert(tls_context_set_verify_mode_by_name(tls_context, "optional-untrusted"));
+  if (mode == TM_SERVER)
+    {
+      tls_context_set_key_file(tls_context, SERVER_KEY);
+      tls_context_set_cert_file(tls_context, SERVER_CERT);
+    }
+  if (cipher_suite)
+    tls_context_set_cipher_suite(tls_context, cipher_suite);
+
+  cr_assert_eq(tls_context_setup_context(tls_context), TLS_CONTEXT_SETUP_OK);
+  return tls_context;
+}
+
+static LogTransport *
+_create_transport(TLSContext *tls_context, gint fd)
+{
+  cr_assert(g_unix_set_fd_nonblocking(fd, TRUE, NULL));
+
+  TLSSession *tls_session = tls_context_setup_session(tls_context);
+  cr_assert_not_null(tls_session);
+  return log_transport_tls_new(tls_session, fd);
+}
+
+/* both ends run in this thread on non-blocking sockets, so the handshake
+ * is driven forward by alternating between them */
+static void
+_send_and_receive(LogTransport *sender, LogTransport *receiver, const gchar *message)
+{
+  gsize message_len = strlen(message);
+  gboolean sent = FALSE;
+  gchar buf[256];
+
+  for (gint i = 0; i < 1000; i++)
+    {
+      if (!sent)
+        {
+          gssize rc = log_transport_write(sender, (const gpointer) message, message_len);
+          if (rc >= 0)
+            {
+              cr_assert_eq(rc, (gssize) message_len);
+              sent = TRUE;
+            }
+          else
+            cr_assert_eq(errno, EAGAIN, "unexpected error while writing: %s", g_strerror(errno));
+        }
+
+      gssize rc = log_transport_read(receiver, buf, sizeof(buf), NULL);
+      if (rc > 0)
+        {
+          cr_assert(sent);
+          cr_assert_eq(rc, (gssize) message_len);
+          cr_assert_arr_eq(buf, message, message_len);
+          return;
+        }
+      cr_assert_eq(rc, -1, "connection closed unexpectedly");
+      cr_assert_eq(errno, EAGAIN, "unexpected error while reading: %s", g_strerror(errno));
+    }
+  cr_assert_fail("message was not delivered over the TLS connection");
+}
+
+static gsize
+_get_counter(const gchar *name, const gchar *direction)
+{
+  StatsClusterLabel labels[] = { stats_cluster_label("direction", direction) };
+  StatsClusterKey sc_key;
+
+  stats_cluster_single_key_set(&sc_key, name, labels, direction ? G_N_ELEMENTS(labels) : 0);
+
+  stats_lock();
+  StatsCounterItem *counter = stats_get_counter(&sc_key, SC_TYPE_SINGLE_VALUE);
+  stats_unlock();
+
+  cr_assert_not_null(counter, "%s is not registered", name);
+  return stats_counter_get(counter);
+}
+
+static void
+_assert_connection_stays_in_userspace(const gchar *ssl_options[], const gchar *cipher_suite, gint client_fd,
+                                      gint server_fd)
+{
+  TLSContext *client_context = _create_tls_context(TM_CLIENT, ssl_options, cipher_suite);
+  TLSContext *server_context = _create_tls_context(TM_SERVER, ssl_options, cipher_suite);
+  gsize fallbacks = _get_counter("tls_ktls_fallbacks_total", NULL);
+
+  LogTransport *client = _create_transport(client_context, client_fd);
+  LogTransport *server = _create_transport(server_context, server_fd);
+
+  _send_and_receive(client, server, "client to server");
+  _send_and_receive(server, client, "server to client");
+  _send_and_receive(client, server, "client to server again");
+
+  /* kTLS was requested on both ends, neither of them got it */
+  cr_assert_eq(_get_counter("tls_ktls_fallbacks_total", NULL), fallbacks + 2);
+  cr_assert_eq(_get_counter("tls_ktls_offloaded_connections", "send"), 0);
+  cr_assert_eq(_get_counter("tls_ktls_offloaded_connections", "recv"), 0);
+
+  log_transport_free(client);
+  log_transport_free(server);
+  tls_context_unref(client_context);
+  tls_context_unref(server_context);
+}
+
+Test(transport_tls, ktls_falls_back_to_userspace_when_the_socket_does_not_support_it)
+{
+  const gchar *ssl_options[] = { "no-sslv2", "ktls", NULL };
+  gint fds[2];
+
+  /* the kernel only offers the TLS ULP on TCP sockets */
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  _assert_connection_stays_in_userspace(ssl_options, NULL, fds[0], fds[1]);
+}
+
+Test(transport_tls, ktls_falls_back_to_userspace_when_the_cipher_does_not_support_it)
+{
+  /* kTLS only implements AEAD ciphers, a CBC suite is never offloaded */
+  const gchar *ssl_options[] = { "no-sslv2", "no-tlsv13", "ktls", NULL };
+  struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t addr_len = sizeof(addr);
+
+  gint listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  cr_assert_geq(listen_fd, 0);
+  cr_assert_eq(bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)), 0);
+  cr_assert_eq(listen(listen_fd, 1), 0);
+  cr_assert_eq(getsockname(listen_fd, (struct sockaddr *) &addr, &addr_len), 0);
+
+  gint client_fd = socket(AF_INET, SOCK_STREAM, 0);
+  cr_assert_eq(connect(client_fd, (struct sockaddr *) &addr, sizeof(addr)), 0);
+  gint server_fd = accept(listen_fd, NULL, NULL);
+  cr_assert_geq(server_fd, 0);
+  close(listen_fd);
+
+  _assert_connection_stays_in_userspace(ssl_options, "ECDHE-RSA-AES128-SHA", client_fd, server_fd);
+}
+
+Test(transport_tls, no_fallback_is_counted_without_ktls)
+{
+  const gchar *ssl_options[] = { "no-sslv2", NULL };
+  gint fds[2];
+
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  TLSContext *client_context = _create_tls_context(TM_CLIENT, ssl_options, NULL);
+  TLSContext *server_context = _create_tls_context(TM_SERVER, ssl_options, NULL);
+  gsize fallbacks = _get_counter("tls_ktls_fallbacks_total", NULL);
+
+  LogTransport *client = _create_transport(client_context, fds[0]);
+  LogTransport *server = _create_transport(server_context, fds[1]);
+
+  _send_and_receive(client, server, "client to server");
+  cr_assert_eq(_get_counter("tls_ktls_fallbacks_total", NULL), fallbacks);
+
+  log_transport_free(client);
+  log_transport_free(server);
+  tls_context_unref(client_context);
+  tls_context_unref(server_context);
+}
+
+TestSuite(transport_tls, .init = app_startup, .fini = app_shutdown);
@@ -235,6 +235,16 @@ tls_context_setup_ssl_options(TLSContext *self)
         ssl_options |= SSL_OP_IGNORE_UNEXPECTED_EOF;
 #endif
 
+      if (self->ssl_options & TSO_KTLS)
+        {
+#ifdef SSL_OP_ENABLE_KTLS
+          ssl_options |= SSL_OP_ENABLE_KTLS;
+#else
+          msg_warning("WARNING: ssl-options(ktls) is not supported by the OpenSSL library syslog-ng was compiled "
+                      "against, falling back to userspace TLS",
+                      tls_context_format_location_tag(self));
+#endif
+        }
 
 #ifdef SSL_OP_CIPHER_SERVER_PREFERENCE
       if (self->mode == TM_SERVER)
@@ -733,6 +743,8 @@ tls_context_set_ssl_options_by_name(TLSContext *self, GList *options)
         self->ssl_options |= TSO_IGNORE_HOSTNAME_MISMATCH;
       else if (strcasecmp(l->data, "ignore-validity-period") == 0 || strcasecmp(l->data, "ignore_validity_period") == 0)
         self->ssl_options |= TSO_IGNORE_VALIDITY_PERIOD;
+      else if (strcasecmp(l->data, "ktls") == 0)
+        self->ssl_options |= TSO_KTLS;
       else
         return FALSE;
     }
@@ -764,6 +776,12 @@ tls_context_ignore_validity_period(TLSContext *self)
   return self->ssl_options & TSO_IGNORE_VALIDITY_PERIOD;
 }
 
+gboolean
+tls_context_ktls_enabled(TLSContext *self)
+{
+  return self->ssl_options & TSO_KTLS;
+}
+
 static int
 _pem_passwd_callback(char *buf, int size, int rwflag, void *user_data)
 {
@@ -56,6 +56,7 @@ typedef enum
   TSO_IGNORE_UNEXPECTED_EOF=0x0040,
   TSO_IGNORE_HOSTNAME_MISMATCH=0x0080,
   TSO_IGNORE_VALIDITY_PERIOD=0x0100,
+  TSO_KTLS=0x0200,
 } TLSSslOptions;
 
 typedef enum
@@ -122,6 +123,7 @@ gint tls_context_get_verify_mode(const TLSContext *self);
 void tls_context_set_verify_mode(TLSContext *self, gint verify_mode);
 gboolean tls_context_ignore_hostname_mismatch(TLSContext *self);
 gboolean tls_context_ignore_validity_period(TLSContext *self);
+gboolean tls_context_ktls_enabled(TLSContext *self);
 void tls_context_set_key_file(TLSContext *self, const gchar *key_file);
 void tls_context_set_cert_file(TLSContext *self, const gchar *cert_file);
 gboolean tls_context_set_keylog_file(TLSContext *self, gchar *keylog_file_path, GError **error);
@@ -25,6 +25,8 @@
 #include "transport/transport-socket.h"
 
 #include "messages.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
 
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -35,8 +37,66 @@ typedef struct _LogTransportTLS
   LogTransportSocket super;
   TLSSession *tls_session;
   gboolean sending_shutdown;
+
+  /* kernel TLS offload, see _check_ktls_offload() */
+  gssize (*socket_write)(LogTransport *s, const gpointer buf, gsize count);
+  gboolean ktls_checked;
+  gboolean ktls_send;
+  gboolean ktls_recv;
+  gboolean ssl_write_pending;
 } LogTransportTLS;
 
+static struct
+{
+  StatsCounterItem *send_offloaded;
+  StatsCounterItem *recv_offloaded;
+  StatsCounterItem *fallbacks;
+} ktls_metrics;
+
+/*
+ * With ssl-options(ktls), OpenSSL installs the negotiated keys into the
+ * kernel once the handshake is finished, if both the cipher and the kernel
+ * support it.  From that point on:
+ *
+ *   - writes bypass OpenSSL and go through the plain socket transport, the
+ *     kernel does the record encryption,
+ *
+ *   - reads still go through SSL_read(), as non-application records (alerts,
+ *     post-handshake messages) can only be received with recvmsg() and
+ *     OpenSSL handles those.  The decryption itself happens in the kernel.
+ *
+ * If the offload is not available, the connection stays in userspace.
+ */
+static void
+_check_ktls_offload(LogTransportTLS *self)
+{
+  if (!SSL_is_init_finished(self->tls_session->ssl))
+    return;
+
+  self->ktls_checked = TRUE;
+
+  if (!tls_context_ktls_enabled(self->tls_session->ctx))
+    return;
+
+#ifdef SSL_OP_ENABLE_KTLS
+  self->ktls_send = BIO_get_ktls_send(SSL_get_wbio(self->tls_session->ssl));
+  self->ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(self->tls_session->ssl));
+#endif
+
+  if (self->ktls_send)
+    stats_counter_inc(ktls_metrics.send_offloaded);
+  if (self->ktls_recv)
+    stats_counter_inc(ktls_metrics.recv_offloaded);
+  if (!self->ktls_send && !self->ktls_recv)
+    stats_counter_inc(ktls_metrics.fallbacks);
+
+  msg_debug("Kernel TLS offload status of the TLS connection",
+            evt_tag_str("cipher", SSL_get_cipher_name(self->tls_session->ssl)),
+            evt_tag_str("ktls_send", self->ktls_send ? "offloaded" : "userspace"),
+            evt_tag_str("ktls_recv", self->ktls_recv ? "offloaded" : "userspace"),
+            tls_context_format_location_tag(self->tls_session->ctx));
+}
+
 static inline gboolean
 _is_shutdown_sent(gint shutdown_rc)
 {
@@ -125,6 +185,9 @@ log_transport_tls_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTr
     {
       rc = SSL_read(self->tls_session->ssl, buf, buflen);
 
+      if (G_UNLIKELY(!self->ktls_checked))
+        _check_ktls_offload(self);
+
       if (rc <= 0)
         {
           ssl_error = SSL_get_error(self->tls_session->ssl, rc);
@@ -181,12 +244,27 @@ log_transport_tls_write_method(LogTransport *s, const gpointer buf, gsize buflen
   gint ssl_error;
   gint rc;
 
+  /* an SSL_write() that returned WANT_READ/WANT_WRITE has to be retried
+   * with SSL_write(), only switch to the socket once it went through */
+  if (self->ktls_send && !self->ssl_write_pending)
+    {
+      self->super.super.cond = G_IO_OUT;
+      rc = self->socket_write(s, buf, buflen);
+      if (rc >= 0)
+        self->super.super.cond = 0;
+      return rc;
+    }
+
   /* assume that we need to poll our output for writing unless
    * SSL_ERROR_WANT_READ is specified by libssl */
 
   self->super.super.cond = G_IO_OUT;
 
   rc = SSL_write(self->tls_session->ssl, buf, buflen);
+  self->ssl_write_pending = FALSE;
+
+  if (G_UNLIKELY(!self->ktls_checked))
+    _check_ktls_offload(self);
 
   if (rc < 0)
     {
@@ -197,9 +275,11 @@ log_transport_tls_write_method(LogTransport *s, const gpointer buf, gsize buflen
           /* although we are writing this fd, libssl wants to read. This
            * happens during renegotiation for example */
           self->super.super.cond = G_IO_IN;
+          self->ssl_write_pending = TRUE;
           errno = EAGAIN;
           break;
         case SSL_ERROR_WANT_WRITE:
+          self->ssl_write_pending = TRUE;
           errno = EAGAIN;
           break;
         case SSL_ERROR_SYSCALL:
@@ -246,6 +326,7 @@ log_transport_tls_new(TLSSession *tls_session, gint fd)
   LogTransportTLS *self = g_new0(LogTransportTLS, 1);
 
   log_transport_stream_socket_init_instance(&self->super, fd);
+  self->socket_write = self->super.super.write;
   self->super.super.cond = 0;
   self->super.super.read = log_transport_tls_read_method;
   self->super.super.write = log_transport_tls_write_method;
@@ -261,6 +342,45 @@ log_transport_tls_free_method(LogTransport *s)
 {
   LogTransportTLS *self = (LogTransportTLS *) s;
 
+  if (self->ktls_send)
+    stats_counter_dec(ktls_metrics.send_offloaded);
+  if (self->ktls_recv)
+    stats_counter_dec(ktls_metrics.recv_offloaded);
+
   tls_session_free(self->tls_session);
   log_transport_stream_socket_free_method(s);
 }
+
+void
+log_transport_tls_global_init(void)
+{
+  StatsClusterKey sc_key;
+  StatsClusterLabel send_labels[] = { stats_cluster_label("direction", "send") };
+  StatsClusterLabel recv_labels[] = { stats_cluster_label("direction", "recv") };
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "tls_ktls_offloaded_connections", send_labels, G_N_ELEMENTS(send_labels));
+  stats_register_counter(STATS_LEVEL0, &sc_key, SC_TYPE_SINGLE_VALUE, &ktls_metrics.send_offloaded);
+  stats_cluster_single_key_set(&sc_key, "tls_ktls_offloaded_connections", recv_labels, G_N_ELEMENTS(recv_labels));
+  stats_register_counter(STATS_LEVEL0, &sc_key, SC_TYPE_SINGLE_VALUE, &ktls_metrics.recv_offloaded);
+  stats_cluster_single_key_set(&sc_key, "tls_ktls_fallbacks_total", NULL, 0);
+  stats_register_counter(STATS_LEVEL0, &sc_key, SC_TYPE_SINGLE_VALUE, &ktls_metrics.fallbacks);
+  stats_unlock();
+}
+
+void
+log_transport_tls_global_deinit(void)
+{
+  StatsClusterKey sc_key;
+  StatsClusterLabel send_labels[] = { stats_cluster_label("direction", "send") };
+  StatsClusterLabel recv_labels[] = { stats_cluster_label("direction", "recv") };
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "tls_ktls_offloaded_connections", send_labels, G_N_ELEMENTS(send_labels));
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &ktls_metrics.send_offloaded);
+  stats_cluster_single_key_set(&sc_key, "tls_ktls_offloaded_connections", recv_labels, G_N_ELEMENTS(recv_labels));
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &ktls_metrics.recv_offloaded);
+  stats_cluster_single_key_set(&sc_key, "tls_ktls_fallbacks_total", NULL, 0);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &ktls_metrics.fallbacks);
+  stats_unlock();
+}
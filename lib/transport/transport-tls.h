@@ -29,4 +29,7 @@
 
 LogTransport *log_transport_tls_new(TLSSession *tls_session, gint fd);
 
+void log_transport_tls_global_init(void);
+void log_transport_tls_global_deinit(void);
+
 #endif
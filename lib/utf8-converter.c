@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "utf8-converter.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+typedef gsize (*UTF8ConvertFunc)(UTF8Converter *self, const guchar **inbuf, gsize *inbytes_left,
+                                 guchar **outbuf, gsize *outbytes_left);
+
+struct _UTF8Converter
+{
+  UTF8ConvertFunc convert;
+
+  /* single byte encodings: the UTF-8 form of each byte, 0 length for
+   * bytes not defined in the encoding */
+  guint8 table_len[256];
+  guchar table[256][3];
+};
+
+/* length of the leading run of ASCII characters in @src */
+static inline gsize
+_find_ascii_run(const guchar *src, gsize len)
+{
+  gsize i = 0;
+
+#ifdef __SSE2__
+  for (; i + 16 <= len; i += 16)
+    {
+      gint mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (src + i)));
+      if (mask)
+        return i + __builtin_ctz(mask);
+    }
+#endif
+
+  for (; i + 8 <= len; i += 8)
+    {
+      guint64 word;
+
+      memcpy(&word, src + i, sizeof(word));
+      if (word & G_GUINT64_CONSTANT(0x8080808080808080))
+        break;
+    }
+
+  while (i < len && src[i] < 0x80)
+    i++;
+  return i;
+}
+
+static gsize
+_convert_single_byte(UTF8Converter *self, const guchar **inbuf, gsize *inbytes_left,
+                     guchar **outbuf, gsize *outbytes_left)
+{
+  const guchar *in = *inbuf;
+  gsize in_left = *inbytes_left;
+  guchar *out = *outbuf;
+  gsize out_left = *outbytes_left;
+  gsize result = 0;
+
+  while (in_left > 0)
+    {
+      gsize run = _find_ascii_run(in, MIN(in_left, out_left));
+
+      memcpy(out, in, run);
+      in += run;
+      in_left -= run;
+      out += run;
+      out_left -= run;
+
+      if (in_left == 0)
+        break;
+
+      guchar c = *in;
+      gsize len = self->table_len[c];
+
+      if (len == 0)
+        {
+          errno = EILSEQ;
+          result = (gsize) -1;
+          break;
+        }
+      if (len > out_left)
+        {
+          errno = E2BIG;
+          result = (gsize) -1;
+          break;
+        }
+
+      memcpy(out, self->table[c], len);
+      out += len;
+      out_left -= len;
+      in++;
+      in_left--;
+    }
+
+  *inbuf = in;
+  *inbytes_left = in_left;
+  *outbuf = out;
+  *outbytes_left = out_left;
+  return result;
+}
+
+static inline gunichar
+_read_utf16_unit(const guchar *src, gboolean big_endian)
+{
+  if (big_endian)
+    return (src[0] << 8) | src[1];
+  return src[0] | (src[1] << 8);
+}
+
+#ifdef __SSE2__
+/* converts blocks of 8 ASCII code units, returns the number of units converted */
+static inline gsize
+_convert_utf16_ascii_blocks(const guchar *in, gsize in_left, guchar *out, gsize out_left, gboolean big_endian)
+{
+  /* bits that must be zero in each 16 bit lane (loaded in little endian
+   * order) for the code unit to be ASCII */
+  const __m128i non_ascii = _mm_set1_epi16(big_endian ? (gshort) 0x80FF : (gshort) 0xFF80);
+  const __m128i zero = _mm_setzero_si128();
+  gsize units = 0;
+
+  while (in_left >= 16 && out_left >= 8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *) in);
+
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, non_ascii), zero)) != 0xFFFF)
+        break;
+
+      if (big_endian)
+        v = _mm_srli_epi16(v, 8);
+      _mm_storel_epi64((__m128i *) out, _mm_packus_epi16(v, v));
+
+      in += 16;
+      in_left -= 16;
+      out += 8;
+      out_left -= 8;
+      units += 8;
+    }
+  return units;
+}
+#endif
+
+static inline gsize
+_convert_utf16(UTF8Converter *self, const guchar **inbuf, gsize *inbytes_left,
+               guchar **outbuf, gsize *outbytes_left, gboolean big_endian)
+{
+  const guchar *in = *inbuf;
+  gsize in_left = *inbytes_left;
+  guchar *out = *outbuf;
+  gsize out_left = *outbytes_left;
+  gsize result = 0;
+
+  while (in_left >= 2)
+    {
+#ifdef __SSE2__
+      gsize units = _convert_utf16_ascii_blocks(in, in_left, out, out_left, big_endian);
+
+      in += units * 2;
+      in_left -= units * 2;
+      out += units;
+      out_left -= units;
+      if (in_left < 2)
+        break;
+#endif
+
+      gunichar c = _read_utf16_unit(in, big_endian);
+      gsize unit_len = 2;
+
+      if (c >= 0xD800 && c < 0xDC00)
+        {
+          if (in_left < 4)
+            {
+              errno = EINVAL;
+              result = (gsize) -1;
+              break;
+            }
+
+          gunichar low = _read_utf16_unit(in + 2, big_endian);
+          if (low < 0xDC00 || low >= 0xE000)
+            {
+              errno = EILSEQ;
+              result = (gsize) -1;
+              break;
+            }
+          c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+          unit_len = 4;
+        }
+      else if (c >= 0xDC00 && c < 0xE000)
+        {
+          errno = EILSEQ;
+          result = (gsize) -1;
+          break;
+        }
+
+      gsize len = c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+      if (len > out_left)
+        {
+          errno = E2BIG;
+          result = (gsize) -1;
+          break;
+        }
+
+      g_unichar_to_utf8(c, (gchar *) out);
+      out += len;
+      out_left -= len;
+      in += unit_len;
+      in_left -= unit_len;
+    }
+
+  if (result == 0 && in_left == 1)
+    {
+      errno = EINVAL;
+      result = (gsize) -1;
+    }
+
+  *inbuf = in;
+  *inbytes_left = in_left;
+  *outbuf = out;
+  *outbytes_left = out_left;
+  return result;
+}
+
+static gsize
+_convert_utf16le(UTF8Converter *self, const guchar **inbuf, gsize *inbytes_left,
+                 guchar **outbuf, gsize *outbytes_left)
+{
+  return _convert_utf16(self, inbuf, inbytes_left, outbuf, outbytes_left, FALSE);
+}
+
+static gsize
+_convert_utf16be(UTF8Converter *self, const guchar **inbuf, gsize *inbytes_left,
+                 guchar **outbuf, gsize *outbytes_left)
+{
+  return _convert_utf16(self, inbuf, inbytes_left, outbuf, outbytes_left, TRUE);
+}
+
+/* Instead of carrying a table for each single byte encoding, the table is
+ * filled by converting every byte with iconv() once, which also guarantees
+ * that the results are identical to what iconv() would produce.  Stateful
+ * or multibyte encodings are detected as iconv() reports incomplete input
+ * (EINVAL) or a missing output for some bytes.  The ASCII range must map to
+ * itself, as it is copied in bulk.  */
+static gboolean
+_fill_single_byte_table(UTF8Converter *self, const gchar *encoding)
+{
+  GIConv cd = g_iconv_open("utf-8", encoding);
+  gboolean result = TRUE;
+
+  if (cd == (GIConv) -1)
+    return FALSE;
+
+  for (gint c = 0; c < 256 && result; c++)
+    {
+      gchar byte = c;
+      gchar *in = &byte;
+      gsize in_left = 1;
+      gchar *out = (gchar *) self->table[c];
+      gsize out_left = sizeof(self->table[c]);
+
+      g_iconv(cd, NULL, NULL, NULL, NULL);
+      if (g_iconv(cd, &in, &in_left, &out, &out_left) == (gsize) -1)
+        {
+          result = (errno == EILSEQ);
+          self->table_len[c] = 0;
+        }
+      else
+        {
+          self->table_len[c] = sizeof(self->table[c]) - out_left;
+          result = (in_left == 0 && self->table_len[c] > 0);
+        }
+
+      if (c < 0x80)
+        result = result && self->table_len[c] == 1 && self->table[c][0] == c;
+    }
+
+  g_iconv_close(cd);
+  return result;
+}
+
+/* "UTF-16LE", "utf16le", "UTF_16LE" are all the same */
+static gboolean
+_encoding_name_equals(const gchar *encoding, const gchar *canonical_name)
+{
+  for (; *encoding; encoding++)
+    {
+      if (*encoding == '-' || *encoding == '_')
+        continue;
+      if (g_ascii_tolower(*encoding) != *canonical_name)
+        return FALSE;
+      canonical_name++;
+    }
+  return *canonical_name == 0;
+}
+
+UTF8Converter *
+utf8_converter_new(const gchar *encoding)
+{
+  UTF8Converter *self = g_new0(UTF8Converter, 1);
+
+  if (_encoding_name_equals(encoding, "utf16le"))
+    self->convert = _convert_utf16le;
+  else if (_encoding_name_equals(encoding, "utf16be"))
+    self->convert = _convert_utf16be;
+  else if (_fill_single_byte_table(self, encoding))
+    self->convert = _convert_single_byte;
+  else
+    {
+      g_free(self);
+      return NULL;
+    }
+  return self;
+}
+
+gsize
+utf8_converter_convert(UTF8Converter *self, const guchar **inbuf, gsize *inbytes_left,
+                       guchar **outbuf, gsize *outbytes_left)
+{
+  return self->convert(self, inbuf, inbytes_left, outbuf, outbytes_left);
+}
+
+void
+utf8_converter_free(UTF8Converter *self)
+{
+  g_free(self);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef UTF8_CONVERTER_H_INCLUDED
+#define UTF8_CONVERTER_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Hand written conversion of the most common input encodings to UTF-8,
+ * used in front of iconv().  Runs of ASCII characters are copied in bulk.
+ *
+ * utf8_converter_new() returns NULL if there is no fast path for
+ * @encoding, in which case iconv() is to be used.  Supported are the
+ * stateless single byte encodings (latin1 and the other ISO-8859-x
+ * variants, windows-125x, koi8, ...) and UTF-16LE/BE.
+ *
+ * utf8_converter_convert() follows the calling convention of g_iconv(),
+ * including the errno values (E2BIG, EINVAL, EILSEQ) on failure, so it can
+ * be used as a drop-in replacement.
+ */
+typedef struct _UTF8Converter UTF8Converter;
+
+UTF8Converter *utf8_converter_new(const gchar *encoding);
+gsize utf8_converter_convert(UTF8Converter *self, const guchar **inbuf, gsize *inbytes_left,
+                             guchar **outbuf, gsize *outbytes_left);
+void utf8_converter_free(UTF8Converter *self);
+
+#endif
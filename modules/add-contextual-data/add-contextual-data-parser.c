@@ -37,6 +37,7 @@ static CfgLexerKeyword add_contextual_data_keywords[] =
 {
   {"add_contextual_data", KW_ADD_CONTEXTUAL_DATA},
   {"database", KW_DATABASE},
+  {"compiled_database", KW_COMPILED_DATABASE},
   {"selector", KW_SELECTOR},
   {"default_selector", KW_DEFAULT_SELECTOR},
   {"prefix", KW_PREFIX},
@@ -35,6 +35,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 
 typedef struct AddContextualData
 {
@@ -43,6 +44,7 @@ typedef struct AddContextualData
   AddContextualDataSelector *selector;
   gchar *default_selector;
   gchar *filename;
+  gchar *compiled_filename;
   gchar *prefix;
   gboolean ignore_case;
 } AddContextualData;
@@ -56,6 +58,15 @@ add_contextual_data_set_filename(LogParser *p, const gchar *filename)
   self->filename = g_strdup(filename);
 }
 
+void
+add_contextual_data_set_compiled_filename(LogParser *p, const gchar *filename)
+{
+  AddContextualData *self = (AddContextualData *) p;
+
+  g_free(self->compiled_filename);
+  self->compiled_filename = g_strdup(filename);
+}
+
 void
 add_contextual_data_set_prefix(LogParser *p, const gchar *prefix)
 {
@@ -100,9 +111,19 @@ static void
 _add_context_data_to_message(gpointer pmsg, const ContextualDataRecord *record)
 {
   LogMessage *msg = (LogMessage *) pmsg;
-  GString *result = scratch_buffers_alloc();
   LogMessageValueType type;
 
+  /* most databases contain plain strings, no need to format those */
+  if (log_template_is_literal_string(record->value))
+    {
+      gssize value_len;
+      const gchar *value = log_template_get_trivial_value_and_type(record->value, msg, &value_len, &type);
+
+      log_msg_set_value_with_type(msg, record->value_handle, value, value_len, type);
+      return;
+    }
+
+  GString *result = scratch_buffers_alloc();
   log_template_format_value_and_type(record->value, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result, &type);
   log_msg_set_value_with_type(msg, record->value_handle, result->str, result->len, type);
 }
@@ -155,6 +176,7 @@ _clone(LogPipe *s)
   _replace_context_info_db(&cloned->context_info_db, self->context_info_db);
   add_contextual_data_set_prefix(&cloned->super, self->prefix);
   add_contextual_data_set_filename(&cloned->super, self->filename);
+  add_contextual_data_set_compiled_filename(&cloned->super, self->compiled_filename);
   add_contextual_data_set_default_selector(&cloned->super,
                                            self->default_selector);
   add_contextual_data_set_ignore_case(&cloned->super, self->ignore_case);
@@ -170,6 +192,7 @@ _free(LogPipe *s)
 
   context_info_db_unref(self->context_info_db);
   g_free(self->filename);
+  g_free(self->compiled_filename);
   g_free(self->prefix);
   g_free(self->default_selector);
   add_contextual_data_selector_free(self->selector);
@@ -190,23 +213,21 @@ _complete_relative_path_with_config_path(const gchar *filename)
                      filename, NULL);
 }
 
+static gchar *
+_resolve_data_file_path(const gchar *filename)
+{
+  if (_is_relative_path(filename))
+    return _complete_relative_path_with_config_path(filename);
+  return g_strdup(filename);
+}
+
 static FILE *
 _open_data_file(const gchar *filename)
 {
-  FILE *f = NULL;
-
-  if (_is_relative_path(filename))
-    {
-      gchar *absolute_path =
-        _complete_relative_path_with_config_path(filename);
-      f = fopen(absolute_path, "r");
-      g_free(absolute_path);
-    }
-  else
-    {
-      f = fopen(filename, "r");
-    }
+  gchar *path = _resolve_data_file_path(filename);
+  FILE *f = fopen(path, "r");
 
+  g_free(path);
   return f;
 }
 
@@ -225,8 +246,65 @@ _get_scanner(AddContextualData *self)
   return contextual_data_record_scanner_new(log_pipe_get_config(&self->super.super), self->prefix);
 }
 
+static gint64
+_get_mtime_nsec(const struct stat *st)
+{
+#ifdef __APPLE__
+  return st->st_mtimespec.tv_nsec;
+#else
+  return st->st_mtim.tv_nsec;
+#endif
+}
+
+static void
+_fill_origin(AddContextualData *self, ContextInfoDBOrigin *origin)
+{
+  gchar *path = _resolve_data_file_path(self->filename);
+  struct stat st;
+
+  memset(origin, 0, sizeof(*origin));
+  if (stat(path, &st) == 0)
+    {
+      origin->has_source = TRUE;
+      origin->source_size = st.st_size;
+      origin->source_inode = st.st_ino;
+      origin->source_mtime = st.st_mtime;
+      origin->source_mtime_nsec = _get_mtime_nsec(&st);
+    }
+  origin->config_version = cfg_get_user_version(log_pipe_get_config(&self->super.super));
+  origin->prefix = self->prefix;
+  g_free(path);
+}
+
 static gboolean
-_load_context_info_db(AddContextualData *self)
+_load_compiled_context_info_db(AddContextualData *self, const ContextInfoDBOrigin *origin)
+{
+  gchar *path = _resolve_data_file_path(self->compiled_filename);
+  gboolean result = context_info_db_load_compiled(self->context_info_db, path, origin,
+                                                  log_pipe_get_config(&self->super.super));
+
+  if (result)
+    msg_debug("add-contextual-data(): using compiled database",
+              evt_tag_str("filename", self->filename),
+              evt_tag_str("compiled_database", path));
+  g_free(path);
+  return result;
+}
+
+static void
+_save_compiled_context_info_db(AddContextualData *self, const ContextInfoDBOrigin *origin)
+{
+  gchar *path = _resolve_data_file_path(self->compiled_filename);
+
+  if (!context_info_db_save_compiled(self->context_info_db, path, origin))
+    msg_warning("add-contextual-data(): Error saving compiled database, it will be rebuilt on the next load",
+                evt_tag_str("filename", self->filename),
+                evt_tag_str("compiled_database", path));
+  g_free(path);
+}
+
+static gboolean
+_load_csv_context_info_db(AddContextualData *self)
 {
   ContextualDataRecordScanner *scanner;
   FILE *f = NULL;
@@ -261,6 +339,25 @@ error:
   return result;
 }
 
+static gboolean
+_load_context_info_db(AddContextualData *self)
+{
+  ContextInfoDBOrigin origin;
+
+  if (!self->compiled_filename)
+    return _load_csv_context_info_db(self);
+
+  _fill_origin(self, &origin);
+  if (_load_compiled_context_info_db(self, &origin))
+    return TRUE;
+
+  if (!_load_csv_context_info_db(self))
+    return FALSE;
+
+  _save_compiled_context_info_db(self, &origin);
+  return TRUE;
+}
+
 static gboolean
 _init_context_info_db(AddContextualData *self)
 {
@@ -0,0 +1,730 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "context-info-db-map.h"
+#include "cfg.h"
+#include "messages.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#define CONTEXT_INFO_DB_MAP_MAGIC "SNGCTXDB"
+#define CONTEXT_INFO_DB_MAP_VERSION 2
+#define CONTEXT_INFO_DB_MAP_BYTE_ORDER 0x01020304
+
+#define CONTEXT_INFO_DB_MAP_IGNORE_CASE 0x0001
+#define CONTEXT_INFO_DB_MAP_ORDERED     0x0002
+
+#define CONTEXT_INFO_DB_MAP_RECORD_LITERAL 0x01
+
+/* All integers are stored in host byte order, offsets are relative to the
+ * start of the file, except for string references which point into the
+ * string pool at the end of the file. */
+typedef struct _ContextInfoDBMapHeader
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 flags;
+  gint32 config_version;
+  guint64 source_size;
+  guint64 source_inode;
+  gint64 source_mtime;
+  gint64 source_mtime_nsec;
+  guint64 prefix;
+  guint64 names_offset, n_names;
+  guint64 selectors_offset, n_selectors;
+  guint64 ordered_offset, n_ordered;
+  guint64 templates_offset, n_templates;
+  guint64 records_offset, n_records;
+  guint64 strings_offset, strings_size;
+} ContextInfoDBMapHeader;
+
+typedef struct _ContextInfoDBMapSelector
+{
+  guint64 selector;
+  guint32 first_record;
+  guint32 number_of_records;
+} ContextInfoDBMapSelector;
+
+typedef struct _ContextInfoDBMapRecord
+{
+  guint64 value;
+  guint32 name;
+  guint8 type_hint;
+  guint8 explicit_type_hint;
+  guint8 flags;
+  guint8 reserved;
+} ContextInfoDBMapRecord;
+
+struct _ContextInfoDBMap
+{
+  GlobalConfig *cfg;
+  gpointer map;
+  gsize map_size;
+
+  const ContextInfoDBMapHeader *header;
+  const guint64 *names;
+  const ContextInfoDBMapSelector *selectors;
+  const guint64 *ordered;
+  const guint32 *templates;
+  const ContextInfoDBMapRecord *records;
+  const gchar *strings;
+
+  gint (*selector_cmp)(const gchar *, const gchar *);
+  NVHandle *name_handles;
+
+  /* lazily populated as records are used, see _materialize_record() */
+  ContextualDataRecord **materialized;
+};
+
+static const gchar *
+_get_string(ContextInfoDBMap *self, guint64 ref)
+{
+  if (ref >= self->header->strings_size)
+    return NULL;
+  return self->strings + ref;
+}
+
+static const gchar *
+_get_selector(ContextInfoDBMap *self, const ContextInfoDBMapSelector *selector)
+{
+  return _get_string(self, selector->selector) ? : "";
+}
+
+static const ContextInfoDBMapSelector *
+_find_selector_of_record(ContextInfoDBMap *self, gsize index)
+{
+  gsize lo = 0, hi = self->header->n_selectors;
+
+  /* records are sorted by selector, so first_record is increasing too,
+   * find the last selector that starts at or before index */
+  while (hi - lo > 1)
+    {
+      gsize mid = (lo + hi) / 2;
+
+      if (self->selectors[mid].first_record <= index)
+        lo = mid;
+      else
+        hi = mid;
+    }
+  return &self->selectors[lo];
+}
+
+static LogTemplate *
+_compile_value(ContextInfoDBMap *self, const ContextInfoDBMapRecord *r, GError **error)
+{
+  const gchar *value_str = _get_string(self, r->value);
+  LogTemplate *value;
+
+  if (!value_str)
+    {
+      g_set_error(error, LOG_TEMPLATE_ERROR, LOG_TEMPLATE_ERROR_FAILED, "invalid string reference");
+      return NULL;
+    }
+
+  value = log_template_new(self->cfg, NULL);
+  if (r->flags & CONTEXT_INFO_DB_MAP_RECORD_LITERAL)
+    {
+      log_template_compile_literal_string(value, value_str);
+    }
+  else if (!log_template_compile(value, value_str, error))
+    {
+      log_template_unref(value);
+      return NULL;
+    }
+  value->explicit_type_hint = r->explicit_type_hint;
+  value->type_hint = r->type_hint;
+  log_template_forget_template_string(value);
+  return value;
+}
+
+static ContextualDataRecord *
+_new_record(ContextInfoDBMap *self, gsize index, GError **error)
+{
+  const ContextInfoDBMapRecord *r = &self->records[index];
+
+  if (r->name >= self->header->n_names)
+    {
+      g_set_error(error, LOG_TEMPLATE_ERROR, LOG_TEMPLATE_ERROR_FAILED, "invalid name reference");
+      return NULL;
+    }
+
+  LogTemplate *value = _compile_value(self, r, error);
+  if (!value)
+    return NULL;
+
+  ContextualDataRecord *record = g_new(ContextualDataRecord, 1);
+
+  contextual_data_record_init(record);
+  record->selector = g_strdup(_get_selector(self, _find_selector_of_record(self, index)));
+  record->value_handle = self->name_handles[r->name];
+  record->value = value;
+  return record;
+}
+
+static void
+_free_record(ContextualDataRecord *record)
+{
+  contextual_data_record_clean(record);
+  g_free(record);
+}
+
+/* Records are materialized the first time they are used, possibly from
+ * multiple worker threads at the same time: the loser of the race drops
+ * its own copy and uses the one that was published first. */
+static ContextualDataRecord *
+_materialize_record(ContextInfoDBMap *self, gsize index)
+{
+  ContextualDataRecord *record = g_atomic_pointer_get(&self->materialized[index]);
+
+  if (record)
+    return record;
+
+  GError *error = NULL;
+  record = _new_record(self, index, &error);
+  if (!record)
+    {
+      msg_error("add-contextual-data(): error loading record from compiled database",
+                evt_tag_long("index", index),
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+      return NULL;
+    }
+
+  if (!g_atomic_pointer_compare_and_exchange(&self->materialized[index], NULL, record))
+    {
+      _free_record(record);
+      record = g_atomic_pointer_get(&self->materialized[index]);
+    }
+  return record;
+}
+
+gboolean
+context_info_db_map_lookup(ContextInfoDBMap *self, const gchar *selector,
+                           gsize *first_record, gsize *number_of_records)
+{
+  gsize lo = 0, hi = self->header->n_selectors;
+
+  while (lo < hi)
+    {
+      gsize mid = (lo + hi) / 2;
+      const ContextInfoDBMapSelector *s = &self->selectors[mid];
+      gint cmp = self->selector_cmp(selector, _get_selector(self, s));
+
+      if (cmp == 0)
+        {
+          if ((guint64) s->first_record + s->number_of_records > self->header->n_records)
+            return FALSE;
+
+          *first_record = s->first_record;
+          *number_of_records = s->number_of_records;
+          return TRUE;
+        }
+      if (cmp < 0)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+  return FALSE;
+}
+
+const ContextualDataRecord *
+context_info_db_map_get_record(ContextInfoDBMap *self, gsize index)
+{
+  g_assert(index < self->header->n_records);
+
+  return _materialize_record(self, index);
+}
+
+gsize
+context_info_db_map_get_number_of_records(ContextInfoDBMap *self)
+{
+  return self->header->n_records;
+}
+
+GList *
+context_info_db_map_get_selectors(ContextInfoDBMap *self)
+{
+  GList *selectors = NULL;
+
+  for (gsize i = self->header->n_selectors; i > 0; i--)
+    selectors = g_list_prepend(selectors, (gpointer) _get_selector(self, &self->selectors[i - 1]));
+  return selectors;
+}
+
+GList *
+context_info_db_map_get_ordered_selectors(ContextInfoDBMap *self)
+{
+  GList *selectors = NULL;
+
+  for (gsize i = self->header->n_ordered; i > 0; i--)
+    selectors = g_list_prepend(selectors, (gpointer) (_get_string(self, self->ordered[i - 1]) ? : ""));
+  return selectors;
+}
+
+static gboolean
+_is_table_valid(ContextInfoDBMap *self, guint64 offset, guint64 count, gsize entry_size)
+{
+  if (offset % sizeof(guint64) != 0 || offset > self->map_size)
+    return FALSE;
+  return count <= (self->map_size - offset) / entry_size;
+}
+
+static gboolean
+_is_origin_matching(ContextInfoDBMap *self, const ContextInfoDBOrigin *origin)
+{
+  const ContextInfoDBMapHeader *header = self->header;
+
+  if (header->config_version != origin->config_version)
+    return FALSE;
+
+  if (strcmp(_get_string(self, header->prefix) ? : "", origin->prefix ? : "") != 0)
+    return FALSE;
+
+  /* without the CSV file at hand a compiled database is used as is */
+  if (origin->has_source &&
+      (header->source_size != origin->source_size ||
+       header->source_inode != origin->source_inode ||
+       header->source_mtime != origin->source_mtime ||
+       header->source_mtime_nsec != origin->source_mtime_nsec))
+    return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+_map_tables(ContextInfoDBMap *self)
+{
+  const ContextInfoDBMapHeader *header = self->header;
+  const gchar *base = (const gchar *) self->map;
+
+  if (!_is_table_valid(self, header->names_offset, header->n_names, sizeof(guint64)) ||
+      !_is_table_valid(self, header->selectors_offset, header->n_selectors, sizeof(ContextInfoDBMapSelector)) ||
+      !_is_table_valid(self, header->ordered_offset, header->n_ordered, sizeof(guint64)) ||
+      !_is_table_valid(self, header->templates_offset, header->n_templates, sizeof(guint32)) ||
+      !_is_table_valid(self, header->records_offset, header->n_records, sizeof(ContextInfoDBMapRecord)) ||
+      !_is_table_valid(self, header->strings_offset, header->strings_size, 1))
+    return FALSE;
+
+  /* every string reference within the pool is NUL terminated this way */
+  if (header->strings_size == 0 || base[header->strings_offset + header->strings_size - 1] != '\0')
+    return FALSE;
+
+  self->names = (const guint64 *) (base + header->names_offset);
+  self->selectors = (const ContextInfoDBMapSelector *) (base + header->selectors_offset);
+  self->ordered = (const guint64 *) (base + header->ordered_offset);
+  self->templates = (const guint32 *) (base + header->templates_offset);
+  self->records = (const ContextInfoDBMapRecord *) (base + header->records_offset);
+  self->strings = base + header->strings_offset;
+  return TRUE;
+}
+
+static gboolean
+_validate_header(ContextInfoDBMap *self, const ContextInfoDBOrigin *origin,
+                 gboolean ignore_case, gboolean ordering_required)
+{
+  const ContextInfoDBMapHeader *header = self->header;
+
+  if (memcmp(header->magic, CONTEXT_INFO_DB_MAP_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != CONTEXT_INFO_DB_MAP_VERSION ||
+      header->byte_order != CONTEXT_INFO_DB_MAP_BYTE_ORDER)
+    {
+      msg_warning("add-contextual-data(): compiled database has an unsupported format, ignoring");
+      return FALSE;
+    }
+
+  if (!_map_tables(self))
+    {
+      msg_warning("add-contextual-data(): compiled database is truncated or corrupt, ignoring");
+      return FALSE;
+    }
+
+  if (!!(header->flags & CONTEXT_INFO_DB_MAP_IGNORE_CASE) != !!ignore_case ||
+      (ordering_required && !(header->flags & CONTEXT_INFO_DB_MAP_ORDERED)) ||
+      !_is_origin_matching(self, origin))
+    {
+      msg_debug("add-contextual-data(): compiled database is out of date");
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_resolve_names(ContextInfoDBMap *self)
+{
+  self->name_handles = g_new(NVHandle, self->header->n_names);
+  for (gsize i = 0; i < self->header->n_names; i++)
+    {
+      const gchar *name = _get_string(self, self->names[i]);
+
+      if (!name || !name[0])
+        return FALSE;
+      self->name_handles[i] = log_msg_get_value_handle(name);
+    }
+
+  return TRUE;
+}
+
+/* non-literal values are compiled right away, so that errors surface
+ * during initialization just like with the CSV loader */
+static gboolean
+_compile_templates(ContextInfoDBMap *self)
+{
+  for (gsize i = 0; i < self->header->n_templates; i++)
+    {
+      guint32 index = self->templates[i];
+      GError *error = NULL;
+
+      if (index >= self->header->n_records || self->materialized[index])
+        return FALSE;
+
+      ContextualDataRecord *record = _new_record(self, index, &error);
+      if (!record)
+        {
+          msg_error("add-contextual-data(): error compiling template from compiled database",
+                    evt_tag_str("error", error->message));
+          g_clear_error(&error);
+          return FALSE;
+        }
+      self->materialized[index] = record;
+    }
+  return TRUE;
+}
+
+ContextInfoDBMap *
+context_info_db_map_open(const gchar *filename, const ContextInfoDBOrigin *origin,
+                         gboolean ignore_case, gboolean ordering_required,
+                         GlobalConfig *cfg)
+{
+  struct stat st;
+  gint fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+    {
+      if (errno == ENOENT)
+        msg_debug("add-contextual-data(): compiled database does not exist yet",
+                  evt_tag_str("filename", filename));
+      else
+        msg_error("add-contextual-data(): error opening compiled database",
+                  evt_tag_str("filename", filename),
+                  evt_tag_error("error"));
+      return NULL;
+    }
+
+  if (fstat(fd, &st) < 0 || st.st_size < sizeof(ContextInfoDBMapHeader))
+    {
+      msg_warning("add-contextual-data(): compiled database is truncated, ignoring",
+                  evt_tag_str("filename", filename));
+      close(fd);
+      return NULL;
+    }
+
+  /* MAP_PRIVATE would not help against the file being modified in place,
+   * see the requirements of replacing it in the header */
+  gpointer map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    {
+      msg_error("add-contextual-data(): error mapping compiled database",
+                evt_tag_str("filename", filename),
+                evt_tag_error("error"));
+      return NULL;
+    }
+
+  ContextInfoDBMap *self = g_new0(ContextInfoDBMap, 1);
+  self->cfg = cfg;
+  self->map = map;
+  self->map_size = st.st_size;
+  self->header = (const ContextInfoDBMapHeader *) map;
+  self->selector_cmp = ignore_case ? g_ascii_strcasecmp : strcmp;
+
+  if (!_validate_header(self, origin, ignore_case, ordering_required))
+    goto error;
+
+  /* a zero filled allocation of this size is backed by untouched pages
+   * until records are actually used */
+  self->materialized = g_new0(ContextualDataRecord *, self->header->n_records);
+  if (!_resolve_names(self) || !_compile_templates(self))
+    {
+      msg_warning("add-contextual-data(): compiled database is corrupt, ignoring",
+                  evt_tag_str("filename", filename));
+      goto error;
+    }
+
+  msg_debug("add-contextual-data(): compiled database mapped",
+            evt_tag_str("filename", filename),
+            evt_tag_long("records", self->header->n_records),
+            evt_tag_long("selectors", self->header->n_selectors));
+  return self;
+
+error:
+  context_info_db_map_close(self);
+  return NULL;
+}
+
+void
+context_info_db_map_close(ContextInfoDBMap *self)
+{
+  if (self->materialized)
+    {
+      for (gsize i = 0; i < self->header->n_records; i++)
+        {
+          if (self->materialized[i])
+            _free_record(self->materialized[i]);
+        }
+      g_free(self->materialized);
+    }
+  g_free(self->name_handles);
+  munmap(self->map, self->map_size);
+  g_free(self);
+}
+
+/* writer */
+
+typedef struct _ContextInfoDBMapWriter
+{
+  FILE *fp;
+  GPtrArray *strings;
+  guint64 strings_size;
+} ContextInfoDBMapWriter;
+
+static guint64
+_writer_add_string(ContextInfoDBMapWriter *self, const gchar *str)
+{
+  guint64 ref = self->strings_size;
+
+  g_ptr_array_add(self->strings, (gpointer) str);
+  self->strings_size += strlen(str) + 1;
+  return ref;
+}
+
+static gboolean
+_writer_write(ContextInfoDBMapWriter *self, gconstpointer data, gsize size)
+{
+  return size == 0 || fwrite(data, size, 1, self->fp) == 1;
+}
+
+static gboolean
+_writer_pad(ContextInfoDBMapWriter *self, gsize size)
+{
+  static const gchar zeros[sizeof(guint64)];
+  gsize pad = (sizeof(guint64) - size % sizeof(guint64)) % sizeof(guint64);
+
+  return _writer_write(self, zeros, pad);
+}
+
+static inline guint64
+_align(guint64 offset)
+{
+  return (offset + sizeof(guint64) - 1) & ~((guint64) sizeof(guint64) - 1);
+}
+
+static const gchar *
+_get_value_string(const ContextualDataRecord *record)
+{
+  if (log_template_is_literal_string(record->value))
+    return log_template_get_literal_value(record->value, NULL);
+  return record->value->template_str;
+}
+
+gboolean
+context_info_db_map_write(const gchar *filename, const ContextInfoDBOrigin *origin,
+                          gboolean ignore_case, GArray *sorted_records, GList *ordered_selectors)
+{
+  gint (*selector_cmp)(const gchar *, const gchar *) = ignore_case ? g_ascii_strcasecmp : strcmp;
+  ContextInfoDBMapWriter writer = { .strings = g_ptr_array_new() };
+  ContextInfoDBMapHeader header = { .version = CONTEXT_INFO_DB_MAP_VERSION };
+  GArray *names = g_array_new(FALSE, FALSE, sizeof(guint64));
+  GArray *selectors = g_array_new(FALSE, FALSE, sizeof(ContextInfoDBMapSelector));
+  GArray *ordered = g_array_new(FALSE, FALSE, sizeof(guint64));
+  GArray *templates = g_array_new(FALSE, FALSE, sizeof(guint32));
+  GHashTable *name_indices = g_hash_table_new(g_direct_hash, g_direct_equal);
+  gchar *tmp_filename = g_strdup_printf("%s.XXXXXX", filename);
+  const gchar *last_selector = NULL;
+  guint64 value_ref;
+  gboolean result = FALSE;
+  gint fd = -1;
+
+  memcpy(header.magic, CONTEXT_INFO_DB_MAP_MAGIC, sizeof(header.magic));
+  header.byte_order = CONTEXT_INFO_DB_MAP_BYTE_ORDER;
+  header.flags = (ignore_case ? CONTEXT_INFO_DB_MAP_IGNORE_CASE : 0) |
+                 (ordered_selectors ? CONTEXT_INFO_DB_MAP_ORDERED : 0);
+  header.config_version = origin->config_version;
+  header.source_size = origin->source_size;
+  header.source_inode = origin->source_inode;
+  header.source_mtime = origin->source_mtime;
+  header.source_mtime_nsec = origin->source_mtime_nsec;
+  header.prefix = _writer_add_string(&writer, origin->prefix ? : "");
+
+  for (gsize i = 0; i < sorted_records->len; i++)
+    {
+      ContextualDataRecord *record = &g_array_index(sorted_records, ContextualDataRecord, i);
+      gpointer key = GUINT_TO_POINTER(record->value_handle);
+
+      if (!g_hash_table_contains(name_indices, key))
+        {
+          guint64 name = _writer_add_string(&writer, log_msg_get_value_name(record->value_handle, NULL));
+
+          g_hash_table_insert(name_indices, key, GUINT_TO_POINTER(names->len));
+          g_array_append_val(names, name);
+        }
+
+      if (!last_selector || selector_cmp(record->selector, last_selector) != 0)
+        {
+          ContextInfoDBMapSelector selector = { .first_record = i };
+
+          selector.selector = _writer_add_string(&writer, record->selector);
+          g_array_append_val(selectors, selector);
+          last_selector = record->selector;
+        }
+      g_array_index(selectors, ContextInfoDBMapSelector, selectors->len - 1).number_of_records++;
+
+      if (!log_template_is_literal_string(record->value))
+        {
+          guint32 index = i;
+
+          if (!record->value->template_str)
+            {
+              msg_error("add-contextual-data(): template source is not available, unable to compile database",
+                        evt_tag_str("selector", record->selector));
+              goto exit;
+            }
+          g_array_append_val(templates, index);
+        }
+    }
+
+  for (GList *l = ordered_selectors; l; l = l->next)
+    {
+      guint64 selector = _writer_add_string(&writer, (const gchar *) l->data);
+      g_array_append_val(ordered, selector);
+    }
+
+  header.n_names = names->len;
+  header.n_selectors = selectors->len;
+  header.n_ordered = ordered->len;
+  header.n_templates = templates->len;
+  header.n_records = sorted_records->len;
+
+  header.names_offset = _align(sizeof(header));
+  header.selectors_offset = _align(header.names_offset + header.n_names * sizeof(guint64));
+  header.ordered_offset = _align(header.selectors_offset + header.n_selectors * sizeof(ContextInfoDBMapSelector));
+  header.templates_offset = _align(header.ordered_offset + header.n_ordered * sizeof(guint64));
+  header.records_offset = _align(header.templates_offset + header.n_templates * sizeof(guint32));
+  header.strings_offset = _align(header.records_offset + header.n_records * sizeof(ContextInfoDBMapRecord));
+
+  /* the string pool is written last, record values are at its end in
+   * record order */
+  value_ref = writer.strings_size;
+  for (gsize i = 0; i < sorted_records->len; i++)
+    _writer_add_string(&writer, _get_value_string(&g_array_index(sorted_records, ContextualDataRecord, i)));
+  header.strings_size = writer.strings_size;
+
+  fd = g_mkstemp(tmp_filename);
+  if (fd < 0 || !(writer.fp = fdopen(fd, "w")))
+    {
+      msg_error("add-contextual-data(): error creating compiled database",
+                evt_tag_str("filename", tmp_filename),
+                evt_tag_error("error"));
+      goto exit;
+    }
+  fd = -1;
+
+  if (!_writer_write(&writer, &header, sizeof(header)) || !_writer_pad(&writer, sizeof(header)) ||
+      !_writer_write(&writer, names->data, names->len * sizeof(guint64)) ||
+      !_writer_write(&writer, selectors->data, selectors->len * sizeof(ContextInfoDBMapSelector)) ||
+      !_writer_write(&writer, ordered->data, ordered->len * sizeof(guint64)) ||
+      !_writer_write(&writer, templates->data, templates->len * sizeof(guint32)) ||
+      !_writer_pad(&writer, templates->len * sizeof(guint32)))
+    goto write_error;
+
+  for (gsize i = 0; i < sorted_records->len; i++)
+    {
+      ContextualDataRecord *record = &g_array_index(sorted_records, ContextualDataRecord, i);
+      ContextInfoDBMapRecord r =
+      {
+        .value = value_ref,
+        .name = GPOINTER_TO_UINT(g_hash_table_lookup(name_indices, GUINT_TO_POINTER(record->value_handle))),
+        .type_hint = record->value->type_hint,
+        .explicit_type_hint = record->value->explicit_type_hint,
+        .flags = log_template_is_literal_string(record->value) ? CONTEXT_INFO_DB_MAP_RECORD_LITERAL : 0,
+      };
+
+      if (!_writer_write(&writer, &r, sizeof(r)))
+        goto write_error;
+      value_ref += strlen(_get_value_string(record)) + 1;
+    }
+
+  for (guint i = 0; i < writer.strings->len; i++)
+    {
+      const gchar *str = g_ptr_array_index(writer.strings, i);
+
+      if (!_writer_write(&writer, str, strlen(str) + 1))
+        goto write_error;
+    }
+
+  if (fflush(writer.fp) != 0 || fsync(fileno(writer.fp)) < 0)
+    goto write_error;
+  fclose(writer.fp);
+  writer.fp = NULL;
+
+  if (rename(tmp_filename, filename) < 0)
+    {
+      msg_error("add-contextual-data(): error renaming compiled database",
+                evt_tag_str("filename", filename),
+                evt_tag_error("error"));
+      unlink(tmp_filename);
+      goto exit;
+    }
+
+  msg_debug("add-contextual-data(): compiled database written",
+            evt_tag_str("filename", filename),
+            evt_tag_long("records", header.n_records));
+  result = TRUE;
+  goto exit;
+
+write_error:
+  msg_error("add-contextual-data(): error writing compiled database",
+            evt_tag_str("filename", tmp_filename),
+            evt_tag_error("error"));
+  unlink(tmp_filename);
+
+exit:
+  if (writer.fp)
+    fclose(writer.fp);
+  if (fd >= 0)
+    close(fd);
+  g_free(tmp_filename);
+  g_hash_table_unref(name_indices);
+  g_array_free(templates, TRUE);
+  g_array_free(ordered, TRUE);
+  g_array_free(selectors, TRUE);
+  g_array_free(names, TRUE);
+  g_ptr_array_free(writer.strings, TRUE);
+  return result;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef CONTEXT_INFO_DB_MAP_H_INCLUDED
+#define CONTEXT_INFO_DB_MAP_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "contextual-data-record.h"
+
+/*
+ * Compiled, memory mapped representation of a ContextInfoDB.
+ *
+ * The file contains the records sorted by selector along with a sorted
+ * selector table, so opening it does not need to parse or index anything:
+ * selectors are looked up using a binary search right in the mapped file
+ * and ContextualDataRecord instances are only materialized when a record
+ * is first used.
+ *
+ * The origin describes the CSV file and the settings the compiled file was
+ * generated from, a compiled file with a different origin is not used.
+ *
+ * The file stays mapped while the database is in use: it must only be
+ * replaced by renaming a new file over it (as context_info_db_map_write()
+ * does), truncating or rewriting it in place makes the reader crash with
+ * SIGBUS.
+ */
+typedef struct _ContextInfoDBOrigin
+{
+  gboolean has_source;
+  guint64 source_size;
+  guint64 source_inode;
+  gint64 source_mtime;
+  gint64 source_mtime_nsec;
+  gint config_version;
+  const gchar *prefix;
+} ContextInfoDBOrigin;
+
+typedef struct _ContextInfoDBMap ContextInfoDBMap;
+
+gboolean context_info_db_map_lookup(ContextInfoDBMap *self, const gchar *selector,
+                                    gsize *first_record, gsize *number_of_records);
+const ContextualDataRecord *context_info_db_map_get_record(ContextInfoDBMap *self, gsize index);
+gsize context_info_db_map_get_number_of_records(ContextInfoDBMap *self);
+GList *context_info_db_map_get_selectors(ContextInfoDBMap *self);
+GList *context_info_db_map_get_ordered_selectors(ContextInfoDBMap *self);
+
+gboolean context_info_db_map_write(const gchar *filename, const ContextInfoDBOrigin *origin,
+                                   gboolean ignore_case, GArray *sorted_records, GList *ordered_selectors);
+
+ContextInfoDBMap *context_info_db_map_open(const gchar *filename, const ContextInfoDBOrigin *origin,
+                                           gboolean ignore_case, gboolean ordering_required,
+                                           GlobalConfig *cfg);
+void context_info_db_map_close(ContextInfoDBMap *self);
+
+#endif
@@ -39,6 +39,9 @@ struct _ContextInfoDB
   gboolean is_ordering_enabled;
   GList *ordered_selectors;
   gboolean ignore_case;
+  /* set when the records come from a compiled database, data and index
+   * are unused in that case */
+  ContextInfoDBMap *map;
 };
 
 typedef struct _element_range
@@ -183,6 +186,18 @@ _free_array(GArray *array)
   g_array_free(array, TRUE);
 }
 
+static void
+_close_map(ContextInfoDB *self)
+{
+  if (!self->map)
+    return;
+
+  g_list_free(self->ordered_selectors);
+  self->ordered_selectors = NULL;
+  context_info_db_map_close(self->map);
+  self->map = NULL;
+}
+
 static void
 _free(ContextInfoDB *self)
 {
@@ -198,6 +213,10 @@ _free(ContextInfoDB *self)
     {
       g_list_free(self->ordered_selectors);
     }
+  if (self->map)
+    {
+      context_info_db_map_close(self->map);
+    }
 }
 
 
@@ -211,6 +230,7 @@ _get_range_of_records(ContextInfoDB *self, const gchar *selector)
 void
 context_info_db_purge(ContextInfoDB *self)
 {
+  _close_map(self);
   g_hash_table_remove_all(self->index);
   if (self->data->len > 0)
     self->data = g_array_remove_range(self->data, 0, self->data->len);
@@ -221,7 +241,12 @@ void
 context_info_db_insert(ContextInfoDB *self,
                        const ContextualDataRecord *record)
 {
-  log_template_forget_template_string(record->value);
+  g_assert(!self->map);
+
+  /* the source of non-literal templates is kept so that they can be
+   * stored in a compiled database */
+  if (log_template_is_literal_string(record->value))
+    log_template_forget_template_string(record->value);
 
   g_array_append_val(self->data, *record);
   self->is_data_indexed = FALSE;
@@ -235,6 +260,12 @@ context_info_db_contains(ContextInfoDB *self, const gchar *selector)
   if (!selector)
     return FALSE;
 
+  if (self->map)
+    {
+      gsize first, length;
+      return context_info_db_map_lookup(self->map, selector, &first, &length);
+    }
+
   _ensure_indexed_db(self);
   return (_get_range_of_records(self, selector) != NULL);
 }
@@ -243,9 +274,18 @@ gsize
 context_info_db_number_of_records(ContextInfoDB *self,
                                   const gchar *selector)
 {
+  gsize n = 0;
+
+  if (self->map)
+    {
+      gsize first;
+      if (!context_info_db_map_lookup(self->map, selector, &first, &n))
+        return 0;
+      return n;
+    }
+
   _ensure_indexed_db(self);
 
-  gsize n = 0;
   element_range *range = _get_range_of_records(self, selector);
 
   if (range)
@@ -254,10 +294,34 @@ context_info_db_number_of_records(ContextInfoDB *self,
   return n;
 }
 
+static void
+_foreach_mapped_record(ContextInfoDB *self, const gchar *selector,
+                       ADD_CONTEXT_INFO_CB callback, gpointer arg)
+{
+  gsize first, length;
+
+  if (!context_info_db_map_lookup(self->map, selector, &first, &length))
+    return;
+
+  for (gsize i = first; i < first + length; ++i)
+    {
+      const ContextualDataRecord *record = context_info_db_map_get_record(self->map, i);
+
+      if (record)
+        callback(arg, record);
+    }
+}
+
 void
 context_info_db_foreach_record(ContextInfoDB *self, const gchar *selector,
                                ADD_CONTEXT_INFO_CB callback, gpointer arg)
 {
+  if (self->map)
+    {
+      _foreach_mapped_record(self, selector, callback, arg);
+      return;
+    }
+
   _ensure_indexed_db(self);
 
   element_range *record_range = _get_range_of_records(self, selector);
@@ -277,18 +341,25 @@ context_info_db_foreach_record(ContextInfoDB *self, const gchar *selector,
 gboolean
 context_info_db_is_indexed(const ContextInfoDB *self)
 {
+  if (self->map)
+    return TRUE;
   return self->is_data_indexed;
 }
 
 gboolean
 context_info_db_is_loaded(const ContextInfoDB *self)
 {
+  if (self->map)
+    return context_info_db_map_get_number_of_records(self->map) > 0;
   return (self->data != NULL && self->data->len > 0);
 }
 
 GList *
 context_info_db_get_selectors(ContextInfoDB *self)
 {
+  if (self->map)
+    return context_info_db_map_get_selectors(self->map);
+
   _ensure_indexed_db(self);
   return g_hash_table_get_keys(self->index);
 }
@@ -354,6 +425,32 @@ context_info_db_import(ContextInfoDB *self, FILE *fp, const gchar *filename,
   return TRUE;
 }
 
+gboolean
+context_info_db_load_compiled(ContextInfoDB *self, const gchar *filename,
+                              const ContextInfoDBOrigin *origin, GlobalConfig *cfg)
+{
+  g_assert(!self->map && self->data->len == 0);
+
+  self->map = context_info_db_map_open(filename, origin, self->ignore_case, self->is_ordering_enabled, cfg);
+  if (!self->map)
+    return FALSE;
+
+  if (self->is_ordering_enabled)
+    self->ordered_selectors = context_info_db_map_get_ordered_selectors(self->map);
+  return TRUE;
+}
+
+gboolean
+context_info_db_save_compiled(ContextInfoDB *self, const gchar *filename,
+                              const ContextInfoDBOrigin *origin)
+{
+  g_assert(!self->map);
+
+  _ensure_indexed_db(self);
+  return context_info_db_map_write(filename, origin, self->ignore_case, self->data,
+                                   self->is_ordering_enabled ? self->ordered_selectors : NULL);
+}
+
 ContextInfoDB *
 context_info_db_new(gboolean ignore_case)
 {
@@ -25,6 +25,7 @@
 
 #include "syslog-ng.h"
 #include "contextual-data-record-scanner.h"
+#include "context-info-db-map.h"
 #include <stdio.h>
 
 typedef struct _ContextInfoDB ContextInfoDB;
@@ -60,6 +61,11 @@ GList *context_info_db_get_selectors(ContextInfoDB *self);
 gboolean context_info_db_import(ContextInfoDB *self, FILE *fp, const gchar *filename,
                                 ContextualDataRecordScanner *scanner);
 
+gboolean context_info_db_load_compiled(ContextInfoDB *self, const gchar *filename,
+                                       const ContextInfoDBOrigin *origin, GlobalConfig *cfg);
+gboolean context_info_db_save_compiled(ContextInfoDB *self, const gchar *filename,
+                                       const ContextInfoDBOrigin *origin);
+
 
 ContextInfoDB *context_info_db_new(gboolean ignore_case);
 ContextInfoDB *context_info_db_ref(ContextInfoDB *self);
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "glob-matcher.h"
+
+#include <string.h>
+
+typedef struct _GlobTrieNode GlobTrieNode;
+
+typedef struct _GlobTrieEdge
+{
+  guchar key;
+  GlobTrieNode *node;
+} GlobTrieEdge;
+
+struct _GlobTrieNode
+{
+  /* GlobTrieEdge, sorted by key */
+  GArray *edges;
+  /* indices of patterns whose literal prefix ends at this node, in
+   * ascending order */
+  GArray *patterns;
+};
+
+typedef struct _GlobPattern
+{
+  gchar *pattern;
+  /* the part of the pattern following its literal prefix, starts with a
+   * wildcard or is empty */
+  const gchar *remainder;
+} GlobPattern;
+
+struct _GlobMatcher
+{
+  GArray *patterns;
+  GlobTrieNode *root;
+};
+
+static GlobTrieNode *
+_trie_node_new(void)
+{
+  GlobTrieNode *self = g_new0(GlobTrieNode, 1);
+
+  self->edges = g_array_new(FALSE, FALSE, sizeof(GlobTrieEdge));
+  self->patterns = g_array_new(FALSE, FALSE, sizeof(guint));
+  return self;
+}
+
+static void
+_trie_node_free(GlobTrieNode *self)
+{
+  for (guint i = 0; i < self->edges->len; i++)
+    _trie_node_free(g_array_index(self->edges, GlobTrieEdge, i).node);
+  g_array_free(self->edges, TRUE);
+  g_array_free(self->patterns, TRUE);
+  g_free(self);
+}
+
+/* returns the position of the edge with the given key or the position it
+ * should be inserted at */
+static guint
+_trie_node_bsearch(GlobTrieNode *self, guchar key, gboolean *found)
+{
+  guint lo = 0, hi = self->edges->len;
+
+  while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
+      guchar mid_key = g_array_index(self->edges, GlobTrieEdge, mid).key;
+
+      if (mid_key == key)
+        {
+          *found = TRUE;
+          return mid;
+        }
+      if (mid_key < key)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  *found = FALSE;
+  return lo;
+}
+
+static GlobTrieNode *
+_trie_node_lookup_child(GlobTrieNode *self, guchar key)
+{
+  gboolean found;
+  guint pos = _trie_node_bsearch(self, key, &found);
+
+  return found ? g_array_index(self->edges, GlobTrieEdge, pos).node : NULL;
+}
+
+static GlobTrieNode *
+_trie_node_get_or_add_child(GlobTrieNode *self, guchar key)
+{
+  gboolean found;
+  guint pos = _trie_node_bsearch(self, key, &found);
+
+  if (found)
+    return g_array_index(self->edges, GlobTrieEdge, pos).node;
+
+  GlobTrieEdge edge = { .key = key, .node = _trie_node_new() };
+  g_array_insert_val(self->edges, pos, edge);
+  return edge.node;
+}
+
+static inline const gchar *
+_next_char(const gchar *s, const gchar *end)
+{
+  const gchar *next = g_utf8_next_char(s);
+
+  return next > end ? end : next;
+}
+
+/* Matches the part of a pattern that follows its literal prefix.  '*'
+ * matches any sequence of characters, '?' matches exactly one (UTF-8)
+ * character, just like GPatternSpec.  On a mismatch we backtrack to the
+ * last '*' and let it consume one more character, which is sufficient as
+ * there are no other constructs in the pattern language.  */
+static gboolean
+_match_remainder(const gchar *pattern, const gchar *s, const gchar *end)
+{
+  const gchar *star_pattern = NULL;
+  const gchar *star_s = NULL;
+
+  while (s < end)
+    {
+      if (*pattern == '*')
+        {
+          while (*pattern == '*')
+            pattern++;
+          if (!*pattern)
+            return TRUE;
+          star_pattern = pattern;
+          star_s = s;
+        }
+      else if (*pattern == '?')
+        {
+          pattern++;
+          s = _next_char(s, end);
+        }
+      else if (*pattern && *pattern == *s)
+        {
+          pattern++;
+          s++;
+        }
+      else if (star_pattern)
+        {
+          pattern = star_pattern;
+          star_s = _next_char(star_s, end);
+          s = star_s;
+        }
+      else
+        {
+          return FALSE;
+        }
+    }
+
+  while (*pattern == '*')
+    pattern++;
+  return *pattern == '\0';
+}
+
+static gsize
+_literal_prefix_length(const gchar *pattern)
+{
+  return strcspn(pattern, "*?");
+}
+
+void
+glob_matcher_add_pattern(GlobMatcher *self, const gchar *pattern)
+{
+  GlobPattern p;
+  guint index = self->patterns->len;
+  gsize prefix_len = _literal_prefix_length(pattern);
+  GlobTrieNode *node = self->root;
+
+  p.pattern = g_strdup(pattern);
+  p.remainder = p.pattern + prefix_len;
+  g_array_append_val(self->patterns, p);
+
+  for (gsize i = 0; i < prefix_len; i++)
+    node = _trie_node_get_or_add_child(node, (guchar) pattern[i]);
+  g_array_append_val(node->patterns, index);
+}
+
+static guint
+_find_first_match_in_node(GlobMatcher *self, GlobTrieNode *node, const gchar *s, const gchar *end, guint best)
+{
+  for (guint i = 0; i < node->patterns->len; i++)
+    {
+      guint index = g_array_index(node->patterns, guint, i);
+
+      if (index >= best)
+        break;
+
+      GlobPattern *p = &g_array_index(self->patterns, GlobPattern, index);
+      if (_match_remainder(p->remainder, s, end))
+        return index;
+    }
+  return best;
+}
+
+const gchar *
+glob_matcher_lookup(GlobMatcher *self, const gchar *string, gssize string_len)
+{
+  if (string_len < 0)
+    string_len = strlen(string);
+
+  const gchar *end = string + string_len;
+  const gchar *s = string;
+  GlobTrieNode *node = self->root;
+  guint best = G_MAXUINT;
+
+  while (node)
+    {
+      best = _find_first_match_in_node(self, node, s, end, best);
+      if (s == end)
+        break;
+      node = _trie_node_lookup_child(node, (guchar) *s);
+      s++;
+    }
+
+  if (best == G_MAXUINT)
+    return NULL;
+  return g_array_index(self->patterns, GlobPattern, best).pattern;
+}
+
+guint
+glob_matcher_get_number_of_patterns(GlobMatcher *self)
+{
+  return self->patterns->len;
+}
+
+GlobMatcher *
+glob_matcher_clone(GlobMatcher *self)
+{
+  GlobMatcher *cloned = glob_matcher_new();
+
+  for (guint i = 0; i < self->patterns->len; i++)
+    glob_matcher_add_pattern(cloned, g_array_index(self->patterns, GlobPattern, i).pattern);
+  return cloned;
+}
+
+GlobMatcher *
+glob_matcher_new(void)
+{
+  GlobMatcher *self = g_new0(GlobMatcher, 1);
+
+  self->patterns = g_array_new(FALSE, FALSE, sizeof(GlobPattern));
+  self->root = _trie_node_new();
+  return self;
+}
+
+void
+glob_matcher_free(GlobMatcher *self)
+{
+  for (guint i = 0; i < self->patterns->len; i++)
+    g_free(g_array_index(self->patterns, GlobPattern, i).pattern);
+  g_array_free(self->patterns, TRUE);
+  _trie_node_free(self->root);
+  g_free(self);
+}
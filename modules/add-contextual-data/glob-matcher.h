@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef GLOB_MATCHER_H_INCLUDED
+#define GLOB_MATCHER_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * GlobMatcher evaluates an ordered set of glob patterns ('*' and '?'
+ * wildcards, with the same semantics as GPatternSpec) against a string and
+ * returns the first pattern (in insertion order) that matches.
+ *
+ * Patterns are indexed by their literal prefix in a trie, so a lookup only
+ * evaluates the patterns whose prefix matches the beginning of the input.
+ */
+typedef struct _GlobMatcher GlobMatcher;
+
+void glob_matcher_add_pattern(GlobMatcher *self, const gchar *pattern);
+const gchar *glob_matcher_lookup(GlobMatcher *self, const gchar *string, gssize string_len);
+guint glob_matcher_get_number_of_patterns(GlobMatcher *self);
+
+GlobMatcher *glob_matcher_clone(GlobMatcher *self);
+GlobMatcher *glob_matcher_new(void);
+void glob_matcher_free(GlobMatcher *self);
+
+#endif
@@ -30,6 +30,8 @@
 #include "cfg.h"
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
@@ -539,6 +541,215 @@ Test(add_contextual_data, test_selected_nvpairs_when_ignore_case_on)
   contextual_data_record_scanner_free(scanner);
 }
 
+#define COMPILED_DB_FILENAME "test_context_info_db.cdb"
+
+static ContextInfoDB *
+_import_csv(gchar *csv_content, gboolean ignore_case, gboolean ordering)
+{
+  FILE *fp = fmemopen(csv_content, strlen(csv_content), "r");
+  ContextInfoDB *db = context_info_db_new(ignore_case);
+  ContextualDataRecordScanner *scanner =
+    contextual_data_record_scanner_new(configuration, NULL);
+
+  if (ordering)
+    context_info_db_enable_ordering(db);
+  cr_assert(context_info_db_import(db, fp, "dummy.csv", scanner),
+            "Failed to import valid CSV file.");
+  fclose(fp);
+  contextual_data_record_scanner_free(scanner);
+  return db;
+}
+
+static ContextInfoDBOrigin
+_compiled_db_origin(void)
+{
+  ContextInfoDBOrigin origin =
+  {
+    .has_source = TRUE,
+    .source_size = 1024,
+    .source_inode = 4242,
+    .source_mtime = 1700000000,
+    .source_mtime_nsec = 500000000,
+    .config_version = cfg_get_user_version(configuration),
+    .prefix = NULL,
+  };
+  return origin;
+}
+
+static void
+_save_compiled_db(gchar *csv_content, gboolean ignore_case, gboolean ordering)
+{
+  ContextInfoDBOrigin origin = _compiled_db_origin();
+  ContextInfoDB *db = _import_csv(csv_content, ignore_case, ordering);
+
+  cr_assert(context_info_db_save_compiled(db, COMPILED_DB_FILENAME, &origin));
+  context_info_db_unref(db);
+}
+
+static gboolean
+_load_compiled_db(ContextInfoDB *db, const ContextInfoDBOrigin *origin)
+{
+  return context_info_db_load_compiled(db, COMPILED_DB_FILENAME, origin, configuration);
+}
+
+Test(add_contextual_data, test_compiled_db_contains_the_same_records)
+{
+  gchar csv_content[] = "selector3,name3,value3\n"
+                        "selector1,name1,value1\n"
+                        "selector2,name2,value2\n"
+                        "selector1,name1.1,value1.1\n"
+                        "selector3,name3.1,$(echo $HOST_FROM)";
+  ContextInfoDBOrigin origin = _compiled_db_origin();
+
+  _save_compiled_db(csv_content, FALSE, FALSE);
+
+  ContextInfoDB *db = context_info_db_new(FALSE);
+  cr_assert(_load_compiled_db(db, &origin));
+  cr_assert(context_info_db_is_loaded(db));
+  cr_assert(context_info_db_is_indexed(db));
+
+  TestNVPair expected_nvpairs_selector1[] =
+  {
+    {.name = "name1", .value = "value1"},
+    {.name = "name1.1", .value = "value1.1"},
+  };
+
+  TestNVPair expected_nvpairs_selector3[] =
+  {
+    {.name = "name3", .value = "value3"},
+    {.name = "name3.1", .value = "kismacska"},
+  };
+
+  _assert_context_info_db_contains_name_value_pairs_by_selector(db,
+      "selector1",
+      expected_nvpairs_selector1,
+      ARRAY_SIZE(expected_nvpairs_selector1));
+  _assert_context_info_db_contains_name_value_pairs_by_selector(db,
+      "selector3",
+      expected_nvpairs_selector3,
+      ARRAY_SIZE(expected_nvpairs_selector3));
+
+  cr_assert(context_info_db_contains(db, "selector2"));
+  cr_assert_not(context_info_db_contains(db, "selector4"));
+  cr_assert_eq(context_info_db_number_of_records(db, "selector2"), 1);
+  cr_assert_eq(context_info_db_number_of_records(db, "selector4"), 0);
+
+  GList *selectors = context_info_db_get_selectors(db);
+  cr_assert_eq(g_list_length(selectors), 3);
+  g_list_free(selectors);
+
+  context_info_db_unref(db);
+  unlink(COMPILED_DB_FILENAME);
+}
+
+Test(add_contextual_data, test_compiled_db_keeps_the_order_of_selectors)
+{
+  gchar csv_content[] = "selector3,name3,value3\n"
+                        "selector1,name1,value1\n"
+                        "selector3,name3.1,value3.1\n"
+                        "selector2,name2,value2\n";
+  ContextInfoDBOrigin origin = _compiled_db_origin();
+  const gchar *expected_selectors[] = { "selector3", "selector1", "selector2" };
+
+  _save_compiled_db(csv_content, FALSE, TRUE);
+
+  ContextInfoDB *db = context_info_db_new(FALSE);
+  context_info_db_enable_ordering(db);
+  cr_assert(_load_compiled_db(db, &origin));
+
+  GList *ordered_selectors = context_info_db_ordered_selectors(db);
+  cr_assert_eq(g_list_length(ordered_selectors), ARRAY_SIZE(expected_selectors));
+  for (gsize i = 0; i < ARRAY_SIZE(expected_selectors); i++, ordered_selectors = ordered_selectors->next)
+    cr_assert_str_eq((const gchar *) ordered_selectors->data, expected_selectors[i]);
+
+  context_info_db_unref(db);
+  unlink(COMPILED_DB_FILENAME);
+}
+
+Test(add_contextual_data, test_compiled_db_with_ignore_case)
+{
+  gchar csv_content[] = "LoCaLhOsT,tag1,value1\n"
+                        "otherhost,tag2,value2\n";
+  ContextInfoDBOrigin origin = _compiled_db_origin();
+
+  _save_compiled_db(csv_content, TRUE, FALSE);
+
+  ContextInfoDB *db = context_info_db_new(FALSE);
+  cr_assert_not(_load_compiled_db(db, &origin),
+                "A compiled database should not be used with a different ignore-case setting");
+  context_info_db_unref(db);
+
+  db = context_info_db_new(TRUE);
+  cr_assert(_load_compiled_db(db, &origin));
+  cr_assert(context_info_db_contains(db, "localhost"));
+  cr_assert(context_info_db_contains(db, "LOCALHOST"));
+  cr_assert(context_info_db_contains(db, "OtherHost"));
+  cr_assert_not(context_info_db_contains(db, "thirdhost"));
+
+  context_info_db_unref(db);
+  unlink(COMPILED_DB_FILENAME);
+}
+
+Test(add_contextual_data, test_compiled_db_is_not_used_with_a_different_origin)
+{
+  gchar csv_content[] = "selector1,name1,value1\n";
+  ContextInfoDBOrigin origin = _compiled_db_origin();
+  ContextInfoDB *db;
+
+  _save_compiled_db(csv_content, FALSE, FALSE);
+
+  origin.source_mtime++;
+  db = context_info_db_new(FALSE);
+  cr_assert_not(_load_compiled_db(db, &origin), "A compiled database of a modified CSV file should not be used");
+  context_info_db_unref(db);
+
+  origin = _compiled_db_origin();
+  origin.source_mtime_nsec++;
+  db = context_info_db_new(FALSE);
+  cr_assert_not(_load_compiled_db(db, &origin),
+                "A compiled database of a CSV file modified within the same second should not be used");
+  context_info_db_unref(db);
+
+  origin = _compiled_db_origin();
+  origin.source_inode++;
+  db = context_info_db_new(FALSE);
+  cr_assert_not(_load_compiled_db(db, &origin), "A compiled database of a replaced CSV file should not be used");
+  context_info_db_unref(db);
+
+  origin = _compiled_db_origin();
+  origin.prefix = "prefix.";
+  db = context_info_db_new(FALSE);
+  cr_assert_not(_load_compiled_db(db, &origin), "A compiled database with a different prefix should not be used");
+  context_info_db_unref(db);
+
+  origin = _compiled_db_origin();
+  origin.has_source = FALSE;
+  db = context_info_db_new(FALSE);
+  cr_assert(_load_compiled_db(db, &origin), "A compiled database should be used as is without a CSV file");
+  cr_assert(context_info_db_contains(db, "selector1"));
+  context_info_db_unref(db);
+
+  unlink(COMPILED_DB_FILENAME);
+}
+
+Test(add_contextual_data, test_truncated_compiled_db_is_rejected)
+{
+  gchar csv_content[] = "selector1,name1,value1\n"
+                        "selector2,name2,value2\n";
+  ContextInfoDBOrigin origin = _compiled_db_origin();
+  struct stat st;
+
+  _save_compiled_db(csv_content, FALSE, FALSE);
+  cr_assert(stat(COMPILED_DB_FILENAME, &st) == 0);
+  cr_assert(truncate(COMPILED_DB_FILENAME, st.st_size - 8) == 0);
+
+  ContextInfoDB *db = context_info_db_new(FALSE);
+  cr_assert_not(_load_compiled_db(db, &origin));
+  context_info_db_unref(db);
+
+  unlink(COMPILED_DB_FILENAME);
+}
+
 static void
 setup(void)
 {
@@ -106,6 +106,56 @@ Test(add_contextual_data_glob_selector,
   add_contextual_data_selector_free(selector);
 }
 
+Test(add_contextual_data_glob_selector,
+     glob_selector_respects_the_order_of_patterns_with_different_prefixes)
+{
+  AddContextualDataSelector *selector = _create_glob_selector("$HOST", "*host", "local*", "localhost", "l?c*", NULL);
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_HOST, "localhost", -1);
+  _assert_resolved_value(selector, msg, "*host");
+
+  log_msg_set_value(msg, LM_V_HOST, "localdomain", -1);
+  _assert_resolved_value(selector, msg, "local*");
+
+  log_msg_set_value(msg, LM_V_HOST, "lacdomain", -1);
+  _assert_resolved_value(selector, msg, "l?c*");
+
+  log_msg_set_value(msg, LM_V_HOST, "lcdomain", -1);
+  _assert_resolved_value_is_null(selector, msg);
+
+  log_msg_unref(msg);
+  add_contextual_data_selector_free(selector);
+}
+
+Test(add_contextual_data_glob_selector,
+     glob_selector_matches_literal_and_wildcard_patterns)
+{
+  AddContextualDataSelector *selector = _create_glob_selector("$HOST", "exact", "a*b*c", "x?z", "multi*?", "*", NULL);
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_HOST, "exact", -1);
+  _assert_resolved_value(selector, msg, "exact");
+
+  log_msg_set_value(msg, LM_V_HOST, "abxbxc", -1);
+  _assert_resolved_value(selector, msg, "a*b*c");
+
+  log_msg_set_value(msg, LM_V_HOST, "x\xc3\xa1z", -1);
+  _assert_resolved_value(selector, msg, "x?z");
+
+  log_msg_set_value(msg, LM_V_HOST, "multi", -1);
+  _assert_resolved_value(selector, msg, "*");
+
+  log_msg_set_value(msg, LM_V_HOST, "multiple", -1);
+  _assert_resolved_value(selector, msg, "multi*?");
+
+  log_msg_set_value(msg, LM_V_HOST, "exactly", -1);
+  _assert_resolved_value(selector, msg, "*");
+
+  log_msg_unref(msg);
+  add_contextual_data_selector_free(selector);
+}
+
 static void
 startup(void)
 {
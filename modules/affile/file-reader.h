@@ -25,6 +25,7 @@
 #include "driver.h"
 #include "logreader.h"
 #include "file-opener.h"
+#include "directory-monitor-factory.h"
 
 typedef struct _FileReaderOptions
 {
@@ -33,6 +34,7 @@ typedef struct _FileReaderOptions
   gboolean restore_state;
   LogReaderOptions reader_options;
   gboolean exit_on_eof;
+  MonitorMethod monitor_method;
 } FileReaderOptions;
 
 typedef struct _FileReader
@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "file-watch-inotify.h"
+#include "messages.h"
+#include "mainloop.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <iv.h>
+
+#define FILE_WATCH_FILE_MASK (IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+#define FILE_WATCH_DIR_MASK  (IN_CREATE | IN_MOVED_TO | IN_MOVE_SELF | IN_DELETE_SELF)
+
+/* superblock magics of network filesystems, where inotify only sees local changes */
+#define NFS_SUPER_MAGIC   0x6969
+#define SMB_SUPER_MAGIC   0x517B
+#define CIFS_SUPER_MAGIC  0xFF534D42
+#define SMB2_SUPER_MAGIC  0xFE534D42
+#define FUSE_SUPER_MAGIC  0x65735546
+#define V9FS_SUPER_MAGIC  0x01021997
+#define CEPH_SUPER_MAGIC  0x00C36400
+
+typedef struct _FileWatchRegistration
+{
+  FileWatchInotify *owner;
+  gint wd;
+  gboolean is_dir;
+} FileWatchRegistration;
+
+struct _FileWatchInotify
+{
+  FileWatchRegistration file;
+  FileWatchRegistration dir;
+  gboolean file_required;
+  gchar *basename;
+  gint follow_freq;
+
+  gboolean armed;
+  gboolean notified;
+  gint64 armed_since;
+
+  FileWatchInotifyCallback callback;
+  gpointer user_data;
+};
+
+/* shared by all watches, only touched from the main thread */
+static struct
+{
+  gint ref_cnt;
+  struct iv_fd fd;
+  /* wd -> GList of FileWatchRegistration, the same inode may be followed by several readers */
+  GHashTable *registrations;
+
+  StatsCounterItem *watched_files;
+  StatsCounterItem *wakeups;
+  StatsCounterItem *polls_avoided;
+} inotify_instance;
+
+static void
+_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "file_watch_inotify_watched_files", NULL, 0);
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &inotify_instance.watched_files);
+  stats_cluster_single_key_set(&sc_key, "file_watch_inotify_wakeups_total", NULL, 0);
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &inotify_instance.wakeups);
+  stats_cluster_single_key_set(&sc_key, "file_watch_polls_avoided_total", NULL, 0);
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &inotify_instance.polls_avoided);
+  stats_unlock();
+}
+
+static void
+_unregister_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "file_watch_inotify_watched_files", NULL, 0);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &inotify_instance.watched_files);
+  stats_cluster_single_key_set(&sc_key, "file_watch_inotify_wakeups_total", NULL, 0);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &inotify_instance.wakeups);
+  stats_cluster_single_key_set(&sc_key, "file_watch_polls_avoided_total", NULL, 0);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &inotify_instance.polls_avoided);
+  stats_unlock();
+}
+
+static void
+_notify(FileWatchInotify *self)
+{
+  if (!self->armed || self->notified)
+    return;
+
+  self->notified = TRUE;
+  stats_counter_inc(inotify_instance.wakeups);
+  self->callback(self->user_data);
+}
+
+static void
+_notify_all(void)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init(&iter, inotify_instance.registrations);
+  while (g_hash_table_iter_next(&iter, NULL, &value))
+    {
+      for (GList *l = value; l; l = l->next)
+        {
+          FileWatchRegistration *reg = (FileWatchRegistration *) l->data;
+          _notify(reg->owner);
+        }
+    }
+}
+
+static gboolean
+_registration_matches(FileWatchRegistration *reg, const struct inotify_event *event)
+{
+  if (event->mask & (IN_IGNORED | IN_UNMOUNT | IN_MOVE_SELF | IN_DELETE_SELF))
+    return TRUE;
+
+  if (!reg->is_dir)
+    return (event->mask & FILE_WATCH_FILE_MASK) != 0;
+
+  return (event->mask & (IN_CREATE | IN_MOVED_TO)) && event->len > 0
+         && strcmp(event->name, reg->owner->basename) == 0;
+}
+
+/* the kernel dropped the watch (file removed, filesystem unmounted), the
+ * owners fall back to polling */
+static void
+_drop_registrations(gint wd, GList *registrations)
+{
+  for (GList *l = registrations; l; l = l->next)
+    {
+      FileWatchRegistration *reg = (FileWatchRegistration *) l->data;
+      reg->wd = -1;
+    }
+  g_list_free(registrations);
+  g_hash_table_remove(inotify_instance.registrations, GINT_TO_POINTER(wd));
+}
+
+static void
+_dispatch_event(const struct inotify_event *event)
+{
+  if (event->mask & IN_Q_OVERFLOW)
+    {
+      msg_debug("file-watch-inotify: event queue overflow, rechecking all followed files");
+      _notify_all();
+      return;
+    }
+
+  GList *registrations = g_hash_table_lookup(inotify_instance.registrations, GINT_TO_POINTER(event->wd));
+  for (GList *l = registrations; l; l = l->next)
+    {
+      FileWatchRegistration *reg = (FileWatchRegistration *) l->data;
+
+      if (_registration_matches(reg, event))
+        _notify(reg->owner);
+    }
+
+  if (registrations && (event->mask & IN_IGNORED))
+    _drop_registrations(event->wd, registrations);
+}
+
+static void
+_read_events(gpointer s)
+{
+  gchar buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  while (TRUE)
+    {
+      gssize len = read(inotify_instance.fd.fd, buf, sizeof(buf));
+
+      if (len < 0)
+        {
+          if (errno != EAGAIN && errno != EINTR)
+            msg_error("file-watch-inotify: error reading inotify events",
+                      evt_tag_error("error"));
+          return;
+        }
+
+      for (gchar *p = buf; p < buf + len; )
+        {
+          const struct inotify_event *event = (const struct inotify_event *) p;
+
+          _dispatch_event(event);
+          p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+static gboolean
+_instance_ref(void)
+{
+  if (inotify_instance.ref_cnt > 0)
+    {
+      inotify_instance.ref_cnt++;
+      return TRUE;
+    }
+
+  gint fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+    {
+      msg_verbose("file-watch-inotify: could not create inotify object, falling back to follow-freq() polling. "
+                  "You may need to increase /proc/sys/fs/inotify/max_user_instances",
+                  evt_tag_error("error"));
+      return FALSE;
+    }
+
+  IV_FD_INIT(&inotify_instance.fd);
+  inotify_instance.fd.fd = fd;
+  inotify_instance.fd.handler_in = _read_events;
+  iv_fd_register(&inotify_instance.fd);
+
+  inotify_instance.registrations = g_hash_table_new(g_direct_hash, g_direct_equal);
+  _register_stats();
+
+  inotify_instance.ref_cnt = 1;
+  return TRUE;
+}
+
+static void
+_instance_unref(void)
+{
+  g_assert(inotify_instance.ref_cnt > 0);
+
+  if (--inotify_instance.ref_cnt > 0)
+    return;
+
+  _unregister_stats();
+  g_hash_table_destroy(inotify_instance.registrations);
+  inotify_instance.registrations = NULL;
+
+  iv_fd_unregister(&inotify_instance.fd);
+  close(inotify_instance.fd.fd);
+}
+
+static gboolean
+_registration_add(FileWatchRegistration *reg, const gchar *path, guint32 mask)
+{
+  gint wd = inotify_add_watch(inotify_instance.fd.fd, path, mask | IN_MASK_ADD);
+  if (wd < 0)
+    return FALSE;
+
+  GList *registrations = g_hash_table_lookup(inotify_instance.registrations, GINT_TO_POINTER(wd));
+  registrations = g_list_prepend(registrations, reg);
+  g_hash_table_insert(inotify_instance.registrations, GINT_TO_POINTER(wd), registrations);
+
+  reg->wd = wd;
+  return TRUE;
+}
+
+static void
+_registration_remove(FileWatchRegistration *reg)
+{
+  if (reg->wd < 0)
+    return;
+
+  GList *registrations = g_hash_table_lookup(inotify_instance.registrations, GINT_TO_POINTER(reg->wd));
+  registrations = g_list_remove(registrations, reg);
+  if (registrations)
+    {
+      g_hash_table_insert(inotify_instance.registrations, GINT_TO_POINTER(reg->wd), registrations);
+    }
+  else
+    {
+      g_hash_table_remove(inotify_instance.registrations, GINT_TO_POINTER(reg->wd));
+      inotify_rm_watch(inotify_instance.fd.fd, reg->wd);
+    }
+  reg->wd = -1;
+}
+
+static gboolean
+_is_local_filesystem(const gchar *dir)
+{
+  struct statfs st;
+
+  if (statfs(dir, &st) < 0)
+    return FALSE;
+
+  switch ((guint32) st.f_type)
+    {
+    case NFS_SUPER_MAGIC:
+    case SMB_SUPER_MAGIC:
+    case CIFS_SUPER_MAGIC:
+    case SMB2_SUPER_MAGIC:
+    case FUSE_SUPER_MAGIC:
+    case V9FS_SUPER_MAGIC:
+    case CEPH_SUPER_MAGIC:
+      return FALSE;
+    default:
+      return TRUE;
+    }
+}
+
+static gboolean
+_start(FileWatchInotify *self, const gchar *filename)
+{
+  gchar *dirname = g_path_get_dirname(filename);
+  gboolean result = FALSE;
+
+  if (!_is_local_filesystem(dirname))
+    {
+      msg_debug("file-watch-inotify: file is not on a local filesystem, using follow-freq() polling",
+                evt_tag_str("filename", filename));
+      goto exit;
+    }
+
+  /* watch the directory first, so a file created after our attempt to watch it is not missed */
+  if (!_registration_add(&self->dir, dirname, FILE_WATCH_DIR_MASK))
+    goto watch_error;
+
+  self->file_required = _registration_add(&self->file, filename, FILE_WATCH_FILE_MASK);
+  if (!self->file_required && errno != ENOENT)
+    goto watch_error;
+
+  result = TRUE;
+  goto exit;
+
+watch_error:
+  msg_verbose("file-watch-inotify: could not add inotify watch, falling back to follow-freq() polling. "
+              "You may need to increase /proc/sys/fs/inotify/max_user_watches",
+              evt_tag_str("filename", filename),
+              evt_tag_error("error"));
+exit:
+  g_free(dirname);
+  return result;
+}
+
+gboolean
+file_watch_inotify_is_active(FileWatchInotify *self)
+{
+  return self->dir.wd >= 0 && (self->file.wd >= 0 || !self->file_required);
+}
+
+void
+file_watch_inotify_arm(FileWatchInotify *self)
+{
+  if (self->armed)
+    return;
+
+  self->armed = TRUE;
+  self->notified = FALSE;
+  self->armed_since = g_get_monotonic_time();
+}
+
+/* Called when the owner checks the file again, either because we notified
+ * it or because its fallback timer expired. Everything plain follow-freq()
+ * polling would have done in the meantime is accounted as avoided. */
+void
+file_watch_inotify_disarm(FileWatchInotify *self)
+{
+  if (!self->armed)
+    return;
+
+  self->armed = FALSE;
+
+  gint64 idle_msec = (g_get_monotonic_time() - self->armed_since) / 1000;
+  gint64 polls = idle_msec / self->follow_freq;
+  if (polls > 1)
+    stats_counter_add(inotify_instance.polls_avoided, polls - 1);
+}
+
+void
+file_watch_inotify_free(FileWatchInotify *self)
+{
+  _registration_remove(&self->file);
+  _registration_remove(&self->dir);
+  g_free(self->basename);
+  g_free(self);
+
+  stats_counter_dec(inotify_instance.watched_files);
+  _instance_unref();
+}
+
+FileWatchInotify *
+file_watch_inotify_new(const gchar *filename, gint follow_freq, FileWatchInotifyCallback callback, gpointer user_data)
+{
+  main_loop_assert_main_thread();
+  g_assert(follow_freq > 0);
+
+  if (!_instance_ref())
+    return NULL;
+
+  FileWatchInotify *self = g_new0(FileWatchInotify, 1);
+  self->file.owner = self;
+  self->file.wd = -1;
+  self->dir.owner = self;
+  self->dir.wd = -1;
+  self->dir.is_dir = TRUE;
+  self->basename = g_path_get_basename(filename);
+  self->follow_freq = follow_freq;
+  self->callback = callback;
+  self->user_data = user_data;
+
+  stats_counter_inc(inotify_instance.watched_files);
+
+  if (!_start(self, filename))
+    {
+      file_watch_inotify_free(self);
+      return NULL;
+    }
+
+  return self;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef MODULES_AFFILE_FILE_WATCH_INOTIFY_H_
+#define MODULES_AFFILE_FILE_WATCH_INOTIFY_H_
+
+#include "syslog-ng.h"
+
+/*
+ * Wakes up a followed file when inotify reports a change to it (IN_MODIFY,
+ * truncation, removal) or when a file with the same name appears in its
+ * directory (rotation). All watches share a single inotify instance that
+ * is driven from the main thread.
+ *
+ * A watch only delivers notifications while it is armed, i.e. while its
+ * owner sits at EOF waiting for the file to change. The callback is
+ * invoked from within the inotify dispatch loop: it must not free the
+ * watch, it should just schedule the actual check.
+ */
+typedef struct _FileWatchInotify FileWatchInotify;
+typedef void (*FileWatchInotifyCallback)(gpointer user_data);
+
+FileWatchInotify *file_watch_inotify_new(const gchar *filename, gint follow_freq,
+                                         FileWatchInotifyCallback callback, gpointer user_data);
+gboolean file_watch_inotify_is_active(FileWatchInotify *self);
+void file_watch_inotify_arm(FileWatchInotify *self);
+void file_watch_inotify_disarm(FileWatchInotify *self);
+void file_watch_inotify_free(FileWatchInotify *self);
+
+#endif /* MODULES_AFFILE_FILE_WATCH_INOTIFY_H_ */
@@ -26,6 +26,10 @@
 #include "logpipe.h"
 #include "timeutils/misc.h"
 
+#if SYSLOG_NG_HAVE_INOTIFY
+#include "file-watch-inotify.h"
+#endif
+
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -39,6 +43,17 @@
 #include <iv.h>
 #include <iv_work.h>
 
+/* at EOF, inotify wakes us up, the timer only catches changes it missed */
+#define POLL_FILE_CHANGES_INOTIFY_FALLBACK_FREQ 10000
+
+static inline void
+poll_file_changes_disarm_inotify(PollFileChanges *self)
+{
+#if SYSLOG_NG_HAVE_INOTIFY
+  if (self->inotify_watch)
+    file_watch_inotify_disarm(self->inotify_watch);
+#endif
+}
 
 static inline void
 poll_file_changes_on_read(PollFileChanges *self)
@@ -80,6 +95,8 @@ poll_file_changes_check_file(gpointer s)
   off_t pos = -1;
   gint fd = self->fd;
 
+  poll_file_changes_disarm_inotify(self);
+
   msg_trace("Checking if the followed file has new lines",
             evt_tag_str("follow_filename", self->follow_filename));
   if (fd >= 0)
@@ -164,18 +181,51 @@ poll_file_changes_stop_watches(PollEvents *s)
 {
   PollFileChanges *self = (PollFileChanges *) s;
 
+  poll_file_changes_disarm_inotify(self);
   if (iv_timer_registered(&self->follow_timer))
     iv_timer_unregister(&self->follow_timer);
 }
 
 static void
-poll_file_changes_rearm_timer(PollFileChanges *self)
+poll_file_changes_rearm_timer(PollFileChanges *self, gint freq)
 {
   iv_validate_now();
   self->follow_timer.expires = iv_now;
-  timespec_add_msec(&self->follow_timer.expires, self->follow_freq);
+  timespec_add_msec(&self->follow_timer.expires, freq);
+  iv_timer_register(&self->follow_timer);
+}
+
+#if SYSLOG_NG_HAVE_INOTIFY
+/* inotify callback: the file changed while we were idle, check it right away */
+static void
+poll_file_changes_wake_up(gpointer s)
+{
+  PollFileChanges *self = (PollFileChanges *) s;
+
+  if (!iv_timer_registered(&self->follow_timer))
+    return;
+
+  iv_timer_unregister(&self->follow_timer);
+  iv_validate_now();
+  self->follow_timer.expires = iv_now;
   iv_timer_register(&self->follow_timer);
 }
+#endif
+
+static gboolean
+poll_file_changes_wait_for_notification(PollFileChanges *self)
+{
+#if SYSLOG_NG_HAVE_INOTIFY
+  if (!self->inotify_watch || self->keep_polling || !file_watch_inotify_is_active(self->inotify_watch))
+    return FALSE;
+
+  file_watch_inotify_arm(self->inotify_watch);
+  poll_file_changes_rearm_timer(self, MAX(self->follow_freq, POLL_FILE_CHANGES_INOTIFY_FALLBACK_FREQ));
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
 
 static gboolean
 poll_file_changes_check_eof(PollFileChanges *self)
@@ -209,15 +259,21 @@ poll_file_changes_update_watches(PollEvents *s, GIOCondition cond)
 
   poll_file_changes_stop_watches(s);
 
-  if (poll_file_changes_check_eof(self))
+  gboolean end_of_file = poll_file_changes_check_eof(self);
+  if (end_of_file)
     {
       msg_trace("End of file, following file",
                 evt_tag_str("follow_filename", self->follow_filename));
       check_again = poll_file_changes_on_eof(self);
     }
 
-  if (check_again)
-    poll_file_changes_rearm_timer(self);
+  if (!check_again)
+    return;
+
+  if ((end_of_file || self->fd < 0) && poll_file_changes_wait_for_notification(self))
+    return;
+
+  poll_file_changes_rearm_timer(self, self->follow_freq);
 }
 
 void
@@ -228,11 +284,30 @@ poll_file_changes_stop_on_eof(PollEvents *s)
   self->stop_on_eof = TRUE;
 }
 
+/* Use inotify to learn about changes of the followed file instead of
+ * checking it every follow_freq, if it is supported for this file. The
+ * follow timer is kept as a fallback. */
+void
+poll_file_changes_watch_with_inotify(PollEvents *s)
+{
+#if SYSLOG_NG_HAVE_INOTIFY
+  PollFileChanges *self = (PollFileChanges *) s;
+
+  g_assert(!self->inotify_watch);
+  self->inotify_watch = file_watch_inotify_new(self->follow_filename, self->follow_freq,
+                                               poll_file_changes_wake_up, self);
+#endif
+}
+
 void
 poll_file_changes_free(PollEvents *s)
 {
   PollFileChanges *self = (PollFileChanges *) s;
 
+#if SYSLOG_NG_HAVE_INOTIFY
+  if (self->inotify_watch)
+    file_watch_inotify_free(self->inotify_watch);
+#endif
   log_pipe_unref(self->control);
   g_free(self->follow_filename);
 }
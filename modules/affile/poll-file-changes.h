@@ -31,6 +31,7 @@
 #include <iv.h>
 
 typedef struct _PollFileChanges PollFileChanges;
+struct _FileWatchInotify;
 
 struct _PollFileChanges
 {
@@ -40,8 +41,11 @@ struct _PollFileChanges
   gint follow_freq;
   struct iv_timer follow_timer;
   LogPipe *control;
+  struct _FileWatchInotify *inotify_watch;
 
   gboolean stop_on_eof;
+  /* keep checking every follow_freq at EOF, even if inotify could tell us about changes */
+  gboolean keep_polling;
   void (*on_read)(PollFileChanges *);
   gboolean (*on_eof)(PollFileChanges *);
   void (*on_file_moved)(PollFileChanges *);
@@ -54,6 +58,7 @@ void poll_file_changes_init_instance(PollFileChanges *self, gint fd, const gchar
 void poll_file_changes_update_watches(PollEvents *s, GIOCondition cond);
 void poll_file_changes_stop_watches(PollEvents *s);
 void poll_file_changes_stop_on_eof(PollEvents *s);
+void poll_file_changes_watch_with_inotify(PollEvents *s);
 void poll_file_changes_free(PollEvents *s);
 
 #endif
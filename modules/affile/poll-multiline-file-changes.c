@@ -55,12 +55,14 @@ static void
 poll_multiline_file_changes_start_timer(PollMultilineFileChanges *self)
 {
   self->last_eof = g_get_monotonic_time();
+  self->super.keep_polling = TRUE;
 }
 
 static void
 poll_multiline_file_changes_stop_timer(PollMultilineFileChanges *self)
 {
   self->last_eof = 0;
+  self->super.keep_polling = FALSE;
 }
 
 static void
@@ -69,7 +71,7 @@ poll_multiline_file_changes_timeout_expired(PollMultilineFileChanges *self)
   msg_debug("Multi-line timeout has elapsed, processing partial message",
             evt_tag_str("filename", self->super.follow_filename));
 
-  self->last_eof = 0;
+  poll_multiline_file_changes_stop_timer(self);
   self->timed_out = TRUE;
   _flush_partial_message(self);
 }
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "syslog-ng.h"
+#include "apphook.h"
+
+#if SYSLOG_NG_HAVE_INOTIFY
+
+#include "file-watch-inotify.h"
+
+#include <glib/gstdio.h>
+#include <unistd.h>
+#include <iv.h>
+
+static gchar *tmpdir;
+static gchar *filename;
+static struct iv_timer guard_timer;
+static gint notified;
+
+static void
+_callback(gpointer user_data)
+{
+  notified++;
+  iv_quit();
+}
+
+static void
+_guard_timer_expired(gpointer user_data)
+{
+  iv_quit();
+}
+
+static void
+_run_main_loop_for(gint msec)
+{
+  IV_TIMER_INIT(&guard_timer);
+  guard_timer.handler = _guard_timer_expired;
+  iv_validate_now();
+  guard_timer.expires = iv_now;
+  guard_timer.expires.tv_sec += msec / 1000;
+  guard_timer.expires.tv_nsec += (msec % 1000) * 1000000;
+  if (guard_timer.expires.tv_nsec >= 1000000000)
+    {
+      guard_timer.expires.tv_sec++;
+      guard_timer.expires.tv_nsec -= 1000000000;
+    }
+  iv_timer_register(&guard_timer);
+
+  iv_main();
+
+  if (iv_timer_registered(&guard_timer))
+    iv_timer_unregister(&guard_timer);
+}
+
+static void
+_append(const gchar *content)
+{
+  FILE *f = fopen(filename, "a");
+  cr_assert(f);
+  fputs(content, f);
+  fclose(f);
+}
+
+Test(file_watch_inotify, modification_wakes_up_armed_watch)
+{
+  _append("first\n");
+
+  FileWatchInotify *watch = file_watch_inotify_new(filename, 1000, _callback, NULL);
+  cr_assert(watch);
+  cr_assert(file_watch_inotify_is_active(watch));
+
+  file_watch_inotify_arm(watch);
+  _append("second\n");
+  _run_main_loop_for(5000);
+  cr_assert_eq(notified, 1);
+
+  file_watch_inotify_disarm(watch);
+  file_watch_inotify_free(watch);
+}
+
+Test(file_watch_inotify, disarmed_watch_is_not_notified)
+{
+  _append("first\n");
+
+  FileWatchInotify *watch = file_watch_inotify_new(filename, 1000, _callback, NULL);
+  cr_assert(watch);
+
+  _append("second\n");
+  _run_main_loop_for(200);
+  cr_assert_eq(notified, 0);
+
+  file_watch_inotify_free(watch);
+}
+
+Test(file_watch_inotify, file_created_in_directory_wakes_up_watch)
+{
+  FileWatchInotify *watch = file_watch_inotify_new(filename, 1000, _callback, NULL);
+  cr_assert(watch, "the directory is watched even if the followed file does not exist yet");
+  cr_assert(file_watch_inotify_is_active(watch));
+
+  file_watch_inotify_arm(watch);
+  _append("created\n");
+  _run_main_loop_for(5000);
+  cr_assert_eq(notified, 1);
+
+  file_watch_inotify_free(watch);
+}
+
+Test(file_watch_inotify, removed_file_falls_back_to_polling)
+{
+  _append("first\n");
+
+  FileWatchInotify *watch = file_watch_inotify_new(filename, 1000, _callback, NULL);
+  cr_assert(watch);
+
+  file_watch_inotify_arm(watch);
+  g_unlink(filename);
+  _run_main_loop_for(5000);
+  cr_assert_eq(notified, 1);
+
+  /* wait for IN_IGNORED, it may arrive in a separate read */
+  _run_main_loop_for(200);
+  cr_assert_not(file_watch_inotify_is_active(watch));
+
+  file_watch_inotify_free(watch);
+}
+
+Test(file_watch_inotify, missing_directory_is_not_watched)
+{
+  cr_assert_null(file_watch_inotify_new("/this/directory/should/not/exist/file.log", 1000, _callback, NULL));
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  notified = 0;
+  tmpdir = g_dir_make_tmp("test_file_watch_inotify_XXXXXX", NULL);
+  cr_assert(tmpdir);
+  filename = g_build_filename(tmpdir, "followed.log", NULL);
+}
+
+static void
+teardown(void)
+{
+  g_unlink(filename);
+  g_rmdir(tmpdir);
+  g_free(filename);
+  g_free(tmpdir);
+  app_shutdown();
+}
+
+TestSuite(file_watch_inotify, .init = setup, .fini = teardown);
+
+#else
+
+Test(file_watch_inotify, inotify_is_not_supported)
+{
+}
+
+#endif
@@ -409,6 +409,7 @@ wildcard_sd_set_monitor_method(LogDriver *s, const gchar *method)
       return FALSE;
     }
   self->monitor_method = new_method;
+  self->file_reader_options.monitor_method = new_method;
   return TRUE;
 }
 
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/config_parse_lib.h"
+
+#include "afsocket-dest.h"
+#include "transport-mapper-inet.h"
+#include "transport/tls-context.h"
+#include "cfg.h"
+#include "cfg-grammar.h"
+#include "apphook.h"
+#include "plugin.h"
+
+static gboolean
+_parse_destination(const gchar *tls_options)
+{
+  gchar *raw_config = g_strdup_printf("destination d_tls { network(\"127.0.0.1\" port(6514) transport(tls) tls(%s)); };"
+                                      "log { destination(d_tls); };", tls_options);
+  gboolean result = parse_config(raw_config, LL_CONTEXT_ROOT, NULL, NULL);
+  g_free(raw_config);
+  return result;
+}
+
+static TLSContext *
+_get_tls_context(void)
+{
+  LogExprNode *expr_node = cfg_tree_get_object(&configuration->tree, ENC_DESTINATION, "d_tls");
+  cr_assert_not_null(expr_node);
+
+  AFSocketDestDriver *driver = (AFSocketDestDriver *) expr_node->children->children->object;
+  cr_assert_not_null(driver);
+
+  TLSContext *tls_context = ((TransportMapperInet *) driver->transport_mapper)->tls_context;
+  cr_assert_not_null(tls_context);
+  return tls_context;
+}
+
+Test(tls_options, ssl_options_ktls_is_parsed)
+{
+  cr_assert(_parse_destination("peer-verify(optional-untrusted) ssl-options(no-sslv3, ktls)"));
+
+  TLSContext *tls_context = _get_tls_context();
+  cr_assert(tls_context_ktls_enabled(tls_context));
+  cr_assert(tls_context->ssl_options & TSO_NOSSLv3);
+}
+
+Test(tls_options, ktls_is_disabled_by_default)
+{
+  cr_assert(_parse_destination("peer-verify(optional-untrusted) ssl-options(no-sslv3)"));
+
+  cr_assert_not(tls_context_ktls_enabled(_get_tls_context()));
+}
+
+Test(tls_options, unknown_ssl_option_is_rejected)
+{
+  cr_assert_not(_parse_destination("ssl-options(ktls, no-such-option)"));
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  cr_assert(cfg_load_module(configuration, "afsocket"));
+}
+
+static void
+teardown(void)
+{
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(tls_options, .init = setup, .fini = teardown);
@@ -34,6 +34,7 @@ static CfgLexerKeyword correlation_keywords[] =
   { "db_parser",          KW_DB_PARSER },
   { "grouping_by",        KW_GROUPING_BY },
   { "file",               KW_FILE },
+  { "cache_file",         KW_CACHE_FILE },
 
   /* correlate options */
   { "inject_mode",        KW_INJECT_MODE },
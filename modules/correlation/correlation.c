@@ -26,43 +26,129 @@
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 
+static inline CorrelationStateShard *
+_get_shard(CorrelationState *self, const CorrelationKey *key)
+{
+  if (self->num_shards == 1)
+    return self->shards[0];
+
+  guint hash = correlation_key_hash(key);
+
+  /* the low bits of g_str_hash() are not too well distributed, fold the
+   * high bits into them before taking the modulo */
+  hash ^= hash >> 16;
+  return self->shards[hash % self->num_shards];
+}
+
+static void
+_lock_all_shards(CorrelationState *self)
+{
+  /* always in the same order, to avoid deadlocks */
+  for (gint i = 0; i < self->num_shards; i++)
+    g_mutex_lock(&self->shards[i]->lock);
+}
+
+static void
+_unlock_all_shards(CorrelationState *self)
+{
+  for (gint i = self->num_shards - 1; i >= 0; i--)
+    g_mutex_unlock(&self->shards[i]->lock);
+}
+
+static gint
+_get_num_timers(CorrelationState *self)
+{
+  gint num_timers = 0;
+
+  for (gint i = 0; i < self->num_shards; i++)
+    num_timers += timer_wheel_get_num_timers(self->shards[i]->timer_wheel);
+  return num_timers;
+}
+
+/* NOTE: must be called with all shard locks held */
+static void
+_set_time_locked(CorrelationState *self, guint64 new_now, gpointer caller_context)
+{
+  if (self->num_shards == 1)
+    {
+      timer_wheel_set_time(self->shards[0]->timer_wheel, new_now, caller_context);
+      atomic_gssize_set(&self->now, timer_wheel_get_time(self->shards[0]->timer_wheel));
+      return;
+    }
+
+  /* Advance the wheels in lockstep, one second at a time, so that
+   * expiration callbacks are invoked ordered by their expiration time
+   * and by the shard index within the same second, regardless of how the
+   * contexts are distributed among the shards.  Once there are no timers
+   * left, all wheels can jump to the new time directly. */
+
+  guint64 now = timer_wheel_get_time(self->shards[0]->timer_wheel);
+  while (now < new_now)
+    {
+      if (_get_num_timers(self) == 0)
+        now = new_now;
+      else
+        now++;
+
+      for (gint i = 0; i < self->num_shards; i++)
+        timer_wheel_set_time(self->shards[i]->timer_wheel, now, caller_context);
+      atomic_gssize_set(&self->now, now);
+    }
+}
+
 void
 correlation_state_tx_begin(CorrelationState *self)
 {
-  g_mutex_lock(&self->lock);
+  _lock_all_shards(self);
 }
 
 void
 correlation_state_tx_end(CorrelationState *self)
 {
-  g_mutex_unlock(&self->lock);
+  _unlock_all_shards(self);
+}
+
+void
+correlation_state_tx_begin_key(CorrelationState *self, const CorrelationKey *key)
+{
+  g_mutex_lock(&_get_shard(self, key)->lock);
+}
+
+void
+correlation_state_tx_end_key(CorrelationState *self, const CorrelationKey *key)
+{
+  g_mutex_unlock(&_get_shard(self, key)->lock);
 }
 
 CorrelationContext *
 correlation_state_tx_lookup_context(CorrelationState *self, const CorrelationKey *key)
 {
-  return g_hash_table_lookup(self->state, key);
+  return g_hash_table_lookup(_get_shard(self, key)->state, key);
 }
 
 void
 correlation_state_tx_store_context(CorrelationState *self, CorrelationContext *context, gint timeout)
 {
+  CorrelationStateShard *shard = _get_shard(self, &context->key);
+
   g_assert(context->timer == NULL);
 
-  g_hash_table_insert(self->state, &context->key, context);
-  context->timer = timer_wheel_add_timer(self->timer_wheel, timeout, self->expire_callback,
+  g_hash_table_insert(shard->state, &context->key, context);
+  context->timer = timer_wheel_add_timer(shard->timer_wheel, timeout, self->expire_callback,
                                          correlation_context_ref(context), (GDestroyNotify) correlation_context_unref);
 }
 
 void
 correlation_state_tx_remove_context(CorrelationState *self, CorrelationContext *context)
 {
+  CorrelationStateShard *shard = _get_shard(self, &context->key);
+
   /* NOTE: in expire callbacks our timer is already deleted and thus it is
    * set to NULL in which case we don't need to remove it again.  */
 
   if (context->timer)
-    timer_wheel_del_timer(self->timer_wheel, context->timer);
-  g_hash_table_remove(self->state, &context->key);
+    timer_wheel_del_timer(shard->timer_wheel, context->timer);
+  g_hash_table_remove(shard->state, &context->key);
 }
 
 void
@@ -70,15 +156,16 @@ correlation_state_tx_update_context(CorrelationState *self, CorrelationContext *
 {
   g_assert(context->timer != NULL);
 
-  timer_wheel_mod_timer(self->timer_wheel, context->timer, timeout);
+  timer_wheel_mod_timer(_get_shard(self, &context->key)->timer_wheel, context->timer, timeout);
 }
 
 void
 correlation_state_expire_all(CorrelationState *self, gpointer caller_context)
 {
-  g_mutex_lock(&self->lock);
-  timer_wheel_expire_all(self->timer_wheel, caller_context);
-  g_mutex_unlock(&self->lock);
+  _lock_all_shards(self);
+  for (gint i = 0; i < self->num_shards; i++)
+    timer_wheel_expire_all(self->shards[i]->timer_wheel, caller_context);
+  _unlock_all_shards(self);
 }
 
 void
@@ -86,10 +173,10 @@ correlation_state_advance_time(CorrelationState *self, gint timeout, gpointer ca
 {
   guint64  new_time;
 
-  g_mutex_lock(&self->lock);
-  new_time = timer_wheel_get_time(self->timer_wheel) + timeout;
-  timer_wheel_set_time(self->timer_wheel, new_time, caller_context);
-  g_mutex_unlock(&self->lock);
+  _lock_all_shards(self);
+  new_time = correlation_state_get_time(self) + timeout;
+  _set_time_locked(self, new_time, caller_context);
+  _unlock_all_shards(self);
 }
 
 void
@@ -108,15 +195,21 @@ correlation_state_set_time(CorrelationState *self, guint64 sec, gpointer caller_
   if (sec < now.tv_sec)
     now.tv_sec = sec;
 
-  g_mutex_lock(&self->lock);
-  timer_wheel_set_time(self->timer_wheel, now.tv_sec, caller_context);
-  g_mutex_unlock(&self->lock);
+  /* time does not go backwards, most messages arrive within the current
+   * second, avoid stopping all shards for those */
+  if (now.tv_sec <= correlation_state_get_time(self))
+    return;
+
+  _lock_all_shards(self);
+  _set_time_locked(self, now.tv_sec, caller_context);
+  _unlock_all_shards(self);
 }
 
 guint64
 correlation_state_get_time(CorrelationState *self)
 {
-  return timer_wheel_get_time(self->timer_wheel);
+  /* the wheels of all shards are kept at the same time, see _set_time_locked() */
+  return atomic_gssize_get_unsigned(&self->now);
 }
 
 gboolean
@@ -126,7 +219,7 @@ correlation_state_timer_tick(CorrelationState *self, gpointer caller_context)
   glong diff;
   gboolean updated = FALSE;
 
-  g_mutex_lock(&self->lock);
+  _lock_all_shards(self);
   get_cached_realtime(&now);
   diff = timespec_diff_usec(&now, &self->last_tick);
 
@@ -134,7 +227,7 @@ correlation_state_timer_tick(CorrelationState *self, gpointer caller_context)
     {
       glong diff_sec = (glong)(diff / 1e6);
 
-      timer_wheel_set_time(self->timer_wheel, timer_wheel_get_time(self->timer_wheel) + diff_sec, caller_context);
+      _set_time_locked(self, correlation_state_get_time(self) + diff_sec, caller_context);
       /* update last_tick, take the fraction of the seconds not calculated into this update into account */
 
       self->last_tick = now;
@@ -149,20 +242,53 @@ correlation_state_timer_tick(CorrelationState *self, gpointer caller_context)
        */
       self->last_tick = now;
     }
-  g_mutex_unlock(&self->lock);
+  _unlock_all_shards(self);
   return updated;
 }
 
+/* The expire callbacks find their owner via the associated data of the
+ * timer wheel they were invoked from, so it is set on every shard.  Only
+ * the first shard owns the data. */
+void
+correlation_state_set_associated_data(CorrelationState *self, gpointer assoc_data, GDestroyNotify assoc_data_free)
+{
+  for (gint i = 0; i < self->num_shards; i++)
+    timer_wheel_set_associated_data(self->shards[i]->timer_wheel, assoc_data, i == 0 ? assoc_data_free : NULL);
+}
 
-CorrelationState *
-correlation_state_new(TWCallbackFunc expire_callback)
+static CorrelationStateShard *
+_shard_new(void)
 {
-  CorrelationState *self = g_new0(CorrelationState, 1);
+  CorrelationStateShard *self = g_new0(CorrelationStateShard, 1);
 
   g_mutex_init(&self->lock);
   self->state = g_hash_table_new_full(correlation_key_hash, correlation_key_equal, NULL,
                                       (GDestroyNotify) correlation_context_unref);
   self->timer_wheel = timer_wheel_new();
+  return self;
+}
+
+static void
+_shard_free(CorrelationStateShard *self)
+{
+  if (self->state)
+    g_hash_table_destroy(self->state);
+  timer_wheel_free(self->timer_wheel);
+  g_mutex_clear(&self->lock);
+  g_free(self);
+}
+
+CorrelationState *
+correlation_state_new(TWCallbackFunc expire_callback, gint num_shards)
+{
+  CorrelationState *self = g_new0(CorrelationState, 1);
+
+  g_assert(num_shards > 0);
+
+  self->num_shards = num_shards;
+  self->shards = g_new0(CorrelationStateShard *, num_shards);
+  for (gint i = 0; i < num_shards; i++)
+    self->shards[i] = _shard_new();
   get_cached_realtime(&self->last_tick);
   g_atomic_counter_set(&self->ref_cnt, 1);
   self->expire_callback = expire_callback;
@@ -172,10 +298,10 @@ correlation_state_new(TWCallbackFunc expire_callback)
 void
 _free(CorrelationState *self)
 {
-  if (self->state)
-    g_hash_table_destroy(self->state);
-  timer_wheel_free(self->timer_wheel);
-  g_mutex_clear(&self->lock);
+  /* free the owner of the associated data last */
+  for (gint i = self->num_shards - 1; i >= 0; i--)
+    _shard_free(self->shards[i]);
+  g_free(self->shards);
   g_free(self);
 }
 
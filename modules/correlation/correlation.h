@@ -28,19 +28,48 @@
 #include "correlation-context.h"
 #include "timerwheel.h"
 #include "timeutils/unixtime.h"
+#include "atomic-gssize.h"
 
-typedef struct _CorrelationState
+/*
+ * The state is split into shards by the hash of the CorrelationKey, each
+ * shard having its own lock, context table and timer wheel, so that
+ * messages with different keys can be correlated in parallel.
+ *
+ * The timer wheels of the shards are always advanced in lockstep (one
+ * second at a time, in shard order), with all shard locks held, so that
+ * the expiration of contexts happens in a deterministic order: contexts
+ * expire in the order of their expiration time, contexts expiring in the
+ * same second are ordered by their shard.
+ */
+#define CORRELATION_STATE_DEFAULT_SHARDS 16
+
+typedef struct _CorrelationStateShard
 {
-  GAtomicCounter ref_cnt;
   GMutex lock;
   GHashTable *state;
   TimerWheel *timer_wheel;
+} CorrelationStateShard;
+
+typedef struct _CorrelationState
+{
+  GAtomicCounter ref_cnt;
+  CorrelationStateShard **shards;
+  gint num_shards;
   TWCallbackFunc expire_callback;
   struct timespec last_tick;
+  /* the time of the timer wheels, only changed with all shard locks held
+   * but read without any */
+  atomic_gssize now;
 } CorrelationState;
 
+/* transaction covering all shards, the caller can access any context */
 void correlation_state_tx_begin(CorrelationState *self);
 void correlation_state_tx_end(CorrelationState *self);
+
+/* transaction covering the shard of a single key */
+void correlation_state_tx_begin_key(CorrelationState *self, const CorrelationKey *key);
+void correlation_state_tx_end_key(CorrelationState *self, const CorrelationKey *key);
+
 CorrelationContext *correlation_state_tx_lookup_context(CorrelationState *self, const CorrelationKey *key);
 void correlation_state_tx_store_context(CorrelationState *self, CorrelationContext *context, gint timeout);
 void correlation_state_tx_remove_context(CorrelationState *self, CorrelationContext *context);
@@ -51,10 +80,11 @@ guint64 correlation_state_get_time(CorrelationState *self);
 gboolean correlation_state_timer_tick(CorrelationState *self, gpointer caller_context);
 void correlation_state_expire_all(CorrelationState *self, gpointer caller_context);
 void correlation_state_advance_time(CorrelationState *self, gint timeout, gpointer caller_context);
+void correlation_state_set_associated_data(CorrelationState *self, gpointer assoc_data, GDestroyNotify assoc_data_free);
 
 void correlation_state_init_instance(CorrelationState *self);
 void correlation_state_deinit_instance(CorrelationState *self);
-CorrelationState *correlation_state_new(TWCallbackFunc expire);
+CorrelationState *correlation_state_new(TWCallbackFunc expire, gint num_shards);
 CorrelationState *correlation_state_ref(CorrelationState *self);
 void correlation_state_unref(CorrelationState *self);
 
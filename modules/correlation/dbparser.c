@@ -40,6 +40,7 @@ struct _LogDBParser
   struct iv_timer tick;
   PatternDB *db;
   gchar *db_file;
+  gchar *cache_file;
   gchar *prefix;
   time_t db_file_last_check;
   ino_t db_file_inode;
@@ -132,6 +133,7 @@ log_db_parser_init(LogPipe *s)
   if (!self->db)
     self->db = pattern_db_new(self->prefix);
 
+  pattern_db_set_cache_file(self->db, self->cache_file);
   log_db_parser_reload_database(self);
   if (self->db)
     {
@@ -230,6 +232,13 @@ log_db_parser_set_db_file(LogDBParser *self, const gchar *db_file)
   self->db_file = g_strdup(db_file);
 }
 
+void
+log_db_parser_set_cache_file(LogDBParser *self, const gchar *cache_file)
+{
+  g_free(self->cache_file);
+  self->cache_file = g_strdup(cache_file);
+}
+
 void
 log_db_parser_set_prefix(LogDBParser *self, const gchar *prefix)
 {
@@ -255,6 +264,7 @@ log_db_parser_clone(LogPipe *s)
   cloned = (LogDBParser *) log_db_parser_new(s->cfg);
   stateful_parser_clone_settings(&self->super, &cloned->super);
   log_db_parser_set_db_file(cloned, self->db_file);
+  log_db_parser_set_cache_file(cloned, self->cache_file);
   log_db_parser_set_prefix(cloned, self->prefix);
   log_db_parser_set_drop_unmatched(cloned, self->drop_unmatched);
   log_db_parser_set_program_template_ref(&cloned->super.super, log_template_ref(self->program_template));
@@ -281,6 +291,7 @@ log_db_parser_free(LogPipe *s)
     pattern_db_free(self->db);
 
   g_free(self->db_file);
+  g_free(self->cache_file);
   g_free(self->prefix);
   stateful_parser_free_method(s);
 }
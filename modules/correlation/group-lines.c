@@ -264,7 +264,7 @@ _init(LogPipe *s)
       return FALSE;
     }
 
-  if (!multi_line_options_validate(&self->multi_line_options))
+  if (!multi_line_options_init(&self->multi_line_options))
     return FALSE;
   return grouping_parser_init_method(s);
 }
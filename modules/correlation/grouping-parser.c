@@ -124,8 +124,8 @@ _load_correlation_state(GroupingParser *self, GlobalConfig *cfg)
       self->correlation = persisted_correlation;
     }
 
-  timer_wheel_set_associated_data(self->correlation->timer_wheel, log_pipe_ref((LogPipe *)self),
-                                  (GDestroyNotify)log_pipe_unref);
+  correlation_state_set_associated_data(self->correlation, log_pipe_ref((LogPipe *)self),
+                                        (GDestroyNotify)log_pipe_unref);
 }
 
 static void
@@ -180,33 +180,32 @@ _expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer calle
 }
 
 
+/* NOTE: must be called within a transaction covering the key */
 CorrelationContext *
-grouping_parser_lookup_or_create_context(GroupingParser *self, LogMessage *msg)
+grouping_parser_lookup_or_create_context(GroupingParser *self, const CorrelationKey *key)
 {
   CorrelationContext *context;
-  CorrelationKey key;
-  GString *buffer = scratch_buffers_alloc();
-
-  log_template_format(self->key_template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer);
 
-  correlation_key_init(&key, self->scope, msg, buffer->str);
-  context = correlation_state_tx_lookup_context(self->correlation, &key);
+  context = correlation_state_tx_lookup_context(self->correlation, key);
   if (!context)
     {
       msg_debug("grouping-parser: Correlation context lookup failure, starting a new context",
-                evt_tag_str("key", key.session_id),
+                evt_tag_str("key", key->session_id),
                 evt_tag_int("timeout", self->timeout),
                 evt_tag_int("expiration", correlation_state_get_time(self->correlation) + self->timeout),
                 log_pipe_location_tag(&self->super.super.super));
 
-      context = grouping_parser_construct_context(self, &key);
+      /* the context takes ownership of the session_id */
+      CorrelationKey context_key = *key;
+      context_key.session_id = g_strdup(key->session_id);
+
+      context = grouping_parser_construct_context(self, &context_key);
       correlation_state_tx_store_context(self->correlation, context, self->timeout);
-      g_string_steal(buffer);
     }
   else
     {
       msg_debug("grouping-parser: Correlation context lookup successful",
-                evt_tag_str("key", key.session_id),
+                evt_tag_str("key", key->session_id),
                 evt_tag_int("timeout", self->timeout),
                 evt_tag_int("expiration", correlation_state_get_time(self->correlation) + self->timeout),
                 evt_tag_int("num_messages", context->messages->len),
@@ -221,7 +220,7 @@ _aggregate_and_emit(GroupingParser *self, CorrelationContext *context, StatefulP
 {
   LogMessage *genmsg = grouping_parser_aggregate_context(self, context);
   correlation_state_tx_update_context(self->correlation, context, self->timeout);
-  correlation_state_tx_end(self->correlation);
+  correlation_state_tx_end_key(self->correlation, &context->key);
   if (genmsg)
     {
       stateful_parser_emitted_messages_add(emitted_messages, genmsg);
@@ -232,9 +231,17 @@ _aggregate_and_emit(GroupingParser *self, CorrelationContext *context, StatefulP
 void
 grouping_parser_perform_grouping(GroupingParser *self, LogMessage *msg, StatefulParserEmittedMessages *emitted_messages)
 {
-  correlation_state_tx_begin(self->correlation);
+  CorrelationKey key;
+  GString *buffer = scratch_buffers_alloc();
+
+  log_template_format(self->key_template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer);
+  correlation_key_init(&key, self->scope, msg, buffer->str);
+
+  /* only the shard of the key is locked, messages with keys in other
+   * shards can be grouped in parallel */
+  correlation_state_tx_begin_key(self->correlation, &key);
 
-  CorrelationContext *context = grouping_parser_lookup_or_create_context(self, msg);
+  CorrelationContext *context = grouping_parser_lookup_or_create_context(self, &key);
 
   GroupingParserUpdateContextResult r = grouping_parser_update_context(self, context, msg);
 
@@ -246,7 +253,7 @@ grouping_parser_perform_grouping(GroupingParser *self, LogMessage *msg, Stateful
                 evt_tag_int("expiration", correlation_state_get_time(self->correlation) + self->timeout),
                 log_pipe_location_tag(&self->super.super.super));
       correlation_state_tx_update_context(self->correlation, context, self->timeout);
-      correlation_state_tx_end(self->correlation);
+      correlation_state_tx_end_key(self->correlation, &key);
     }
   else if (r == GP_CONTEXT_COMPLETE)
     {
@@ -346,7 +353,7 @@ grouping_parser_init_instance(GroupingParser *self, GlobalConfig *cfg)
   self->super.super.process = grouping_parser_process_method;
   self->scope = RCS_GLOBAL;
   self->timeout = -1;
-  self->correlation = correlation_state_new(_expire_entry);
+  self->correlation = correlation_state_new(_expire_entry, CORRELATION_STATE_DEFAULT_SHARDS);
 }
 
 void
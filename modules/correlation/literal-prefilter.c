@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "literal-prefilter.h"
+
+#include <string.h>
+
+/* anything beyond this is unlikely to make the anchor more selective, it
+ * just makes the automaton larger */
+#define LITERAL_PREFILTER_MAX_ANCHOR_LEN 16
+#define LITERAL_PREFILTER_ROOT 0
+
+typedef struct _LiteralPrefilterEdge
+{
+  guchar c;
+  guint32 target;
+} LiteralPrefilterEdge;
+
+typedef struct _LiteralPrefilterState
+{
+  guint32 fail;
+  guint32 edges_start;
+  guint32 edges_len;
+  gboolean output;
+} LiteralPrefilterState;
+
+struct _LiteralPrefilter
+{
+  GPtrArray *anchors;
+  gboolean match_all;
+  gboolean dirty;
+
+  /* the compiled automaton, transitions of the root state are stored in
+   * a dense table as that is the state we spend most of our time in */
+  guint32 root_transitions[256];
+  LiteralPrefilterState *states;
+  guint32 num_states;
+  LiteralPrefilterEdge *edges;
+};
+
+/*
+ * Extracts the longest literal segment of a radix pattern, following the
+ * key syntax of r_insert_node(): "@@" is an escaped '@' character, while
+ * "@TYPE:name:param@" is a parser that may match anything.
+ *
+ * Newlines also terminate a segment, as the radix lookup skips a CR in
+ * the input in front of a LF in the pattern, so "a\nb" may match "a\r\nb"
+ * which does not contain the literal itself.
+ */
+static void
+_extract_anchor(const gchar *pattern, GString *anchor)
+{
+  GString *current = g_string_sized_new(32);
+  const gchar *p = pattern;
+
+  g_string_truncate(anchor, 0);
+  while (TRUE)
+    {
+      gboolean segment_ends = FALSE;
+
+      if (*p == '\0')
+        segment_ends = TRUE;
+      else if (*p == '@' && p[1] == '@')
+        {
+          g_string_append_c(current, '@');
+          p += 2;
+        }
+      else if (*p == '@')
+        {
+          const gchar *end = strchr(p + 1, '@');
+
+          segment_ends = TRUE;
+          p = end ? end + 1 : p + strlen(p);
+        }
+      else if (*p == '\n')
+        {
+          segment_ends = TRUE;
+          p++;
+        }
+      else
+        {
+          g_string_append_c(current, *p);
+          p++;
+        }
+
+      if (segment_ends)
+        {
+          if (current->len > anchor->len)
+            g_string_assign(anchor, current->str);
+          g_string_truncate(current, 0);
+          if (*p == '\0')
+            break;
+        }
+    }
+  g_string_free(current, TRUE);
+
+  if (anchor->len > LITERAL_PREFILTER_MAX_ANCHOR_LEN)
+    g_string_truncate(anchor, LITERAL_PREFILTER_MAX_ANCHOR_LEN);
+}
+
+void
+literal_prefilter_add_pattern(LiteralPrefilter *self, const gchar *pattern)
+{
+  GString *anchor = g_string_sized_new(LITERAL_PREFILTER_MAX_ANCHOR_LEN + 1);
+
+  _extract_anchor(pattern, anchor);
+  if (anchor->len == 0)
+    {
+      self->match_all = TRUE;
+      g_string_free(anchor, TRUE);
+    }
+  else
+    {
+      g_ptr_array_add(self->anchors, g_string_free(anchor, FALSE));
+    }
+  self->dirty = TRUE;
+}
+
+/* compilation */
+
+typedef struct _LiteralPrefilterBuildState
+{
+  GArray *edges;
+  guint32 fail;
+  gboolean output;
+} LiteralPrefilterBuildState;
+
+static gint
+_find_edge_index(GArray *edges, guchar c, gboolean *found)
+{
+  gint lo = 0, hi = edges->len;
+
+  while (lo < hi)
+    {
+      gint mid = (lo + hi) / 2;
+      guchar mid_c = g_array_index(edges, LiteralPrefilterEdge, mid).c;
+
+      if (mid_c == c)
+        {
+          *found = TRUE;
+          return mid;
+        }
+      if (mid_c < c)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  *found = FALSE;
+  return lo;
+}
+
+static guint32
+_build_goto(GArray *build_states, guint32 state, guchar c)
+{
+  LiteralPrefilterBuildState *s = &g_array_index(build_states, LiteralPrefilterBuildState, state);
+  gboolean found;
+  gint ndx = _find_edge_index(s->edges, c, &found);
+
+  return found ? g_array_index(s->edges, LiteralPrefilterEdge, ndx).target : LITERAL_PREFILTER_ROOT;
+}
+
+static guint32
+_build_new_state(GArray *build_states)
+{
+  LiteralPrefilterBuildState s = { .edges = g_array_new(FALSE, FALSE, sizeof(LiteralPrefilterEdge)) };
+
+  g_array_append_val(build_states, s);
+  return build_states->len - 1;
+}
+
+static void
+_build_insert_anchor(GArray *build_states, const gchar *anchor)
+{
+  guint32 state = LITERAL_PREFILTER_ROOT;
+
+  for (const guchar *p = (const guchar *) anchor; *p; p++)
+    {
+      LiteralPrefilterBuildState *s = &g_array_index(build_states, LiteralPrefilterBuildState, state);
+      gboolean found;
+      gint ndx = _find_edge_index(s->edges, *p, &found);
+
+      if (s->output)
+        {
+          /* a shorter anchor is a prefix of this one, which already
+           * accepts everything this one would */
+          return;
+        }
+
+      if (found)
+        {
+          state = g_array_index(s->edges, LiteralPrefilterEdge, ndx).target;
+          continue;
+        }
+
+      /* NOTE: _build_new_state() may reallocate build_states, don't use s after this */
+      guint32 new_state = _build_new_state(build_states);
+      LiteralPrefilterEdge edge = { .c = *p, .target = new_state };
+
+      s = &g_array_index(build_states, LiteralPrefilterBuildState, state);
+      g_array_insert_val(s->edges, ndx, edge);
+      state = new_state;
+    }
+  g_array_index(build_states, LiteralPrefilterBuildState, state).output = TRUE;
+}
+
+static void
+_build_failure_links(GArray *build_states)
+{
+  GQueue queue = G_QUEUE_INIT;
+  LiteralPrefilterBuildState *root = &g_array_index(build_states, LiteralPrefilterBuildState, LITERAL_PREFILTER_ROOT);
+
+  for (guint i = 0; i < root->edges->len; i++)
+    {
+      guint32 target = g_array_index(root->edges, LiteralPrefilterEdge, i).target;
+
+      g_array_index(build_states, LiteralPrefilterBuildState, target).fail = LITERAL_PREFILTER_ROOT;
+      g_queue_push_tail(&queue, GUINT_TO_POINTER(target));
+    }
+
+  while (!g_queue_is_empty(&queue))
+    {
+      guint32 state = GPOINTER_TO_UINT(g_queue_pop_head(&queue));
+      LiteralPrefilterBuildState *s = &g_array_index(build_states, LiteralPrefilterBuildState, state);
+
+      for (guint i = 0; i < s->edges->len; i++)
+        {
+          LiteralPrefilterEdge *edge = &g_array_index(s->edges, LiteralPrefilterEdge, i);
+          LiteralPrefilterBuildState *t = &g_array_index(build_states, LiteralPrefilterBuildState, edge->target);
+          guint32 fail = s->fail;
+
+          while (fail != LITERAL_PREFILTER_ROOT && _build_goto(build_states, fail, edge->c) == LITERAL_PREFILTER_ROOT)
+            fail = g_array_index(build_states, LiteralPrefilterBuildState, fail).fail;
+
+          t->fail = _build_goto(build_states, fail, edge->c);
+          t->output |= g_array_index(build_states, LiteralPrefilterBuildState, t->fail).output;
+          g_queue_push_tail(&queue, GUINT_TO_POINTER(edge->target));
+        }
+    }
+}
+
+static void
+_clear_automaton(LiteralPrefilter *self)
+{
+  g_free(self->states);
+  g_free(self->edges);
+  self->states = NULL;
+  self->edges = NULL;
+  self->num_states = 0;
+  memset(self->root_transitions, 0, sizeof(self->root_transitions));
+}
+
+void
+literal_prefilter_compile(LiteralPrefilter *self)
+{
+  if (!self->dirty)
+    return;
+
+  self->dirty = FALSE;
+  _clear_automaton(self);
+
+  if (self->match_all || self->anchors->len == 0)
+    return;
+
+  GArray *build_states = g_array_new(FALSE, FALSE, sizeof(LiteralPrefilterBuildState));
+  guint32 num_edges = 0;
+
+  _build_new_state(build_states);
+  for (guint i = 0; i < self->anchors->len; i++)
+    _build_insert_anchor(build_states, g_ptr_array_index(self->anchors, i));
+  _build_failure_links(build_states);
+
+  self->num_states = build_states->len;
+  self->states = g_new0(LiteralPrefilterState, self->num_states);
+  for (guint32 i = 0; i < self->num_states; i++)
+    num_edges += g_array_index(build_states, LiteralPrefilterBuildState, i).edges->len;
+  self->edges = g_new0(LiteralPrefilterEdge, MAX(num_edges, 1));
+
+  num_edges = 0;
+  for (guint32 i = 0; i < self->num_states; i++)
+    {
+      LiteralPrefilterBuildState *s = &g_array_index(build_states, LiteralPrefilterBuildState, i);
+
+      self->states[i].fail = s->fail;
+      self->states[i].output = s->output;
+      self->states[i].edges_start = num_edges;
+      self->states[i].edges_len = s->edges->len;
+      memcpy(&self->edges[num_edges], s->edges->data, s->edges->len * sizeof(LiteralPrefilterEdge));
+      num_edges += s->edges->len;
+
+      if (i == LITERAL_PREFILTER_ROOT)
+        {
+          for (guint j = 0; j < s->edges->len; j++)
+            {
+              LiteralPrefilterEdge *edge = &g_array_index(s->edges, LiteralPrefilterEdge, j);
+              self->root_transitions[edge->c] = edge->target;
+            }
+        }
+      g_array_free(s->edges, TRUE);
+    }
+  g_array_free(build_states, TRUE);
+}
+
+/* matching */
+
+static inline guint32
+_find_transition(LiteralPrefilter *self, guint32 state, guchar c)
+{
+  const LiteralPrefilterState *s = &self->states[state];
+  const LiteralPrefilterEdge *edges = &self->edges[s->edges_start];
+  guint32 lo = 0, hi = s->edges_len;
+
+  while (lo < hi)
+    {
+      guint32 mid = (lo + hi) / 2;
+
+      if (edges[mid].c == c)
+        return edges[mid].target;
+      if (edges[mid].c < c)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return LITERAL_PREFILTER_ROOT;
+}
+
+/*
+ * Returns TRUE if @message may match any of the patterns added to the
+ * prefilter.  A prefilter that was not compiled since the last
+ * literal_prefilter_add_pattern() call accepts everything.
+ */
+gboolean
+literal_prefilter_match(LiteralPrefilter *self, const gchar *message, gssize message_len)
+{
+  if (!self->states || self->dirty)
+    return TRUE;
+
+  if (message_len < 0)
+    message_len = strlen(message);
+
+  const guchar *p = (const guchar *) message;
+  const guchar *end = p + message_len;
+  guint32 state = LITERAL_PREFILTER_ROOT;
+
+  for (; p < end; p++)
+    {
+      while (TRUE)
+        {
+          if (state == LITERAL_PREFILTER_ROOT)
+            {
+              state = self->root_transitions[*p];
+              break;
+            }
+
+          guint32 next = _find_transition(self, state, *p);
+          if (next != LITERAL_PREFILTER_ROOT)
+            {
+              state = next;
+              break;
+            }
+          state = self->states[state].fail;
+        }
+
+      if (self->states[state].output)
+        return TRUE;
+    }
+  return FALSE;
+}
+
+/*
+ * Returns TRUE if the prefilter is able to reject messages at all, e.g. it
+ * has been compiled and none of the patterns were free of literals.
+ */
+gboolean
+literal_prefilter_is_effective(LiteralPrefilter *self)
+{
+  return self->states != NULL && !self->dirty;
+}
+
+LiteralPrefilter *
+literal_prefilter_new(void)
+{
+  LiteralPrefilter *self = g_new0(LiteralPrefilter, 1);
+
+  self->anchors = g_ptr_array_new_with_free_func(g_free);
+  return self;
+}
+
+void
+literal_prefilter_free(LiteralPrefilter *self)
+{
+  _clear_automaton(self);
+  g_ptr_array_free(self->anchors, TRUE);
+  g_free(self);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef CORRELATION_LITERAL_PREFILTER_H_INCLUDED
+#define CORRELATION_LITERAL_PREFILTER_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * A cheap gate in front of the message radix of a PDBProgram.
+ *
+ * Every pattern contributes its longest literal segment (the "anchor") to
+ * an Aho-Corasick automaton.  A message that contains none of the anchors
+ * cannot match any of the patterns, so the radix lookup (with all of its
+ * parser invocations and backtracking) can be skipped for it.  A pattern
+ * without any literal characters makes the prefilter accept everything.
+ */
+typedef struct _LiteralPrefilter LiteralPrefilter;
+
+LiteralPrefilter *literal_prefilter_new(void);
+void literal_prefilter_add_pattern(LiteralPrefilter *self, const gchar *pattern);
+void literal_prefilter_compile(LiteralPrefilter *self);
+gboolean literal_prefilter_match(LiteralPrefilter *self, const gchar *message, gssize message_len);
+gboolean literal_prefilter_is_effective(LiteralPrefilter *self);
+void literal_prefilter_free(LiteralPrefilter *self);
+
+#endif
@@ -69,6 +69,7 @@ struct _PatternDB
   PatternDBEmitFunc emit;
   gpointer emit_data;
   gchar *prefix;
+  gchar *cache_file;
 };
 
 /* This function is called to populate the emitted_messages array in
@@ -454,7 +455,7 @@ pattern_db_reload_ruleset(PatternDB *self, GlobalConfig *cfg, const gchar *pdb_f
   PDBRuleSet *new_ruleset;
 
   new_ruleset = pdb_rule_set_new(self->prefix);
-  if (!pdb_rule_set_load(new_ruleset, cfg, pdb_file, NULL))
+  if (!pdb_rule_set_load_with_cache(new_ruleset, cfg, pdb_file, self->cache_file, NULL))
     {
       pdb_rule_set_free(new_ruleset);
       return FALSE;
@@ -478,6 +479,13 @@ pattern_db_set_emit_func(PatternDB *self, PatternDBEmitFunc emit, gpointer emit_
   self->emit_data = emit_data;
 }
 
+void
+pattern_db_set_cache_file(PatternDB *self, const gchar *cache_file)
+{
+  g_free(self->cache_file);
+  self->cache_file = g_strdup(cache_file);
+}
+
 void
 pattern_db_set_program_template(PatternDB *self, LogTemplate *program_template)
 {
@@ -657,8 +665,10 @@ _init_state(PatternDB *self)
 {
   self->rate_limits = g_hash_table_new_full(correlation_key_hash, correlation_key_equal, NULL,
                                             (GDestroyNotify) pdb_rate_limit_free);
-  self->correlation = correlation_state_new(pattern_db_expire_entry);
-  timer_wheel_set_associated_data(self->correlation->timer_wheel, self, NULL);
+  /* rule actions may create contexts with arbitrary keys while a
+   * transaction is open, so patterndb uses a single shard */
+  self->correlation = correlation_state_new(pattern_db_expire_entry, 1);
+  correlation_state_set_associated_data(self->correlation, self, NULL);
 }
 
 static void
@@ -695,6 +705,7 @@ void
 pattern_db_free(PatternDB *self)
 {
   g_free(self->prefix);
+  g_free(self->cache_file);
   log_template_unref(self->program_template);
   if (self->ruleset)
     pdb_rule_set_free(self->ruleset);
@@ -0,0 +1,491 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "pdb-cache.h"
+#include "pdb-error.h"
+#include "messages.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define PDB_CACHE_MAGIC "PDBC"
+#define PDB_CACHE_VERSION 2
+
+typedef struct _PDBCacheHeader
+{
+  gchar magic[4];
+  guint32 version;
+  PDBCacheKey key;
+  guint64 payload_len;
+} PDBCacheHeader;
+
+enum
+{
+  PDB_CACHE_START_ELEMENT = 1,
+  PDB_CACHE_END_ELEMENT,
+  PDB_CACHE_TEXT,
+};
+
+/* PDBCacheKey */
+
+static gint64
+_get_mtime_nsec(const struct stat *st)
+{
+#ifdef __APPLE__
+  return st->st_mtimespec.tv_nsec;
+#else
+  return st->st_mtim.tv_nsec;
+#endif
+}
+
+gboolean
+pdb_cache_key_stat(PDBCacheKey *key, const gchar *filename, GError **error)
+{
+  struct stat st;
+
+  if (stat(filename, &st) < 0)
+    {
+      g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Error stating patterndb file %s: %s",
+                  filename, g_strerror(errno));
+      return FALSE;
+    }
+  key->size = st.st_size;
+  key->inode = st.st_ino;
+  key->mtime = st.st_mtime;
+  key->mtime_nsec = _get_mtime_nsec(&st);
+  return TRUE;
+}
+
+gboolean
+pdb_cache_key_digest_file(PDBCacheKey *key, const gchar *filename, GError **error)
+{
+  GMappedFile *source = g_mapped_file_new(filename, FALSE, error);
+
+  if (!source)
+    return FALSE;
+
+  GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  gsize digest_len = sizeof(key->digest);
+
+  g_checksum_update(checksum, (const guchar *) g_mapped_file_get_contents(source), g_mapped_file_get_length(source));
+  g_checksum_get_digest(checksum, key->digest, &digest_len);
+  g_checksum_free(checksum);
+  g_mapped_file_unref(source);
+  return TRUE;
+}
+
+static gboolean
+_key_identity_equals(const PDBCacheKey *a, const PDBCacheKey *b)
+{
+  return a->size == b->size && a->inode == b->inode &&
+         a->mtime == b->mtime && a->mtime_nsec == b->mtime_nsec;
+}
+
+/* PDBCacheRecorder */
+
+struct _PDBCacheRecorder
+{
+  GMarkupParser wrapper;
+  const GMarkupParser *parser;
+  gpointer user_data;
+  GString *payload;
+};
+
+static void
+_append_u32(GString *payload, guint32 value)
+{
+  g_string_append_len(payload, (const gchar *) &value, sizeof(value));
+}
+
+static void
+_append_string(GString *payload, const gchar *str, gsize len)
+{
+  _append_u32(payload, len);
+  g_string_append_len(payload, str, len);
+  g_string_append_c(payload, '\0');
+}
+
+static void
+_record_event(PDBCacheRecorder *self, GMarkupParseContext *context, guint8 type)
+{
+  gint line = 0, column = 0;
+
+  g_markup_parse_context_get_position(context, &line, &column);
+  g_string_append_c(self->payload, type);
+  _append_u32(self->payload, line);
+  _append_u32(self->payload, column);
+}
+
+static void
+_record_start_element(GMarkupParseContext *context, const gchar *element_name, const gchar **attribute_names,
+                      const gchar **attribute_values, gpointer user_data, GError **error)
+{
+  PDBCacheRecorder *self = (PDBCacheRecorder *) user_data;
+  guint32 num_attributes = g_strv_length((gchar **) attribute_names);
+
+  _record_event(self, context, PDB_CACHE_START_ELEMENT);
+  _append_string(self->payload, element_name, strlen(element_name));
+  _append_u32(self->payload, num_attributes);
+  for (guint32 i = 0; i < num_attributes; i++)
+    {
+      _append_string(self->payload, attribute_names[i], strlen(attribute_names[i]));
+      _append_string(self->payload, attribute_values[i], strlen(attribute_values[i]));
+    }
+
+  self->parser->start_element(context, element_name, attribute_names, attribute_values, self->user_data, error);
+}
+
+static void
+_record_end_element(GMarkupParseContext *context, const gchar *element_name, gpointer user_data, GError **error)
+{
+  PDBCacheRecorder *self = (PDBCacheRecorder *) user_data;
+
+  _record_event(self, context, PDB_CACHE_END_ELEMENT);
+  _append_string(self->payload, element_name, strlen(element_name));
+
+  self->parser->end_element(context, element_name, self->user_data, error);
+}
+
+static void
+_record_text(GMarkupParseContext *context, const gchar *text, gsize text_len, gpointer user_data, GError **error)
+{
+  PDBCacheRecorder *self = (PDBCacheRecorder *) user_data;
+
+  _record_event(self, context, PDB_CACHE_TEXT);
+  _append_string(self->payload, text, text_len);
+
+  self->parser->text(context, text, text_len, self->user_data, error);
+}
+
+/*
+ * Returns a GMarkupParser that records the events before passing them on
+ * to the wrapped parser.  It expects the recorder as its user_data.
+ */
+const GMarkupParser *
+pdb_cache_recorder_get_parser(PDBCacheRecorder *self)
+{
+  return &self->wrapper;
+}
+
+gboolean
+pdb_cache_recorder_save(PDBCacheRecorder *self, const gchar *cache_file, const PDBCacheKey *key, GError **error)
+{
+  PDBCacheHeader header;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PDB_CACHE_MAGIC, sizeof(header.magic));
+  header.version = PDB_CACHE_VERSION;
+  header.key = *key;
+  header.payload_len = self->payload->len - sizeof(header);
+
+  memcpy(self->payload->str, &header, sizeof(header));
+  return g_file_set_contents(cache_file, self->payload->str, self->payload->len, error);
+}
+
+PDBCacheRecorder *
+pdb_cache_recorder_new(const GMarkupParser *parser, gpointer user_data)
+{
+  PDBCacheRecorder *self = g_new0(PDBCacheRecorder, 1);
+
+  self->wrapper.start_element = _record_start_element;
+  self->wrapper.end_element = _record_end_element;
+  self->wrapper.text = _record_text;
+  self->parser = parser;
+  self->user_data = user_data;
+  self->payload = g_string_sized_new(65536);
+
+  /* space for the header, filled in by pdb_cache_recorder_save() */
+  g_string_set_size(self->payload, sizeof(PDBCacheHeader));
+  return self;
+}
+
+void
+pdb_cache_recorder_free(PDBCacheRecorder *self)
+{
+  g_string_free(self->payload, TRUE);
+  g_free(self);
+}
+
+/* PDBCache */
+
+struct _PDBCache
+{
+  gchar *filename;
+  GMappedFile *file;
+  PDBCacheHeader header;
+  const gchar *payload;
+};
+
+typedef struct _PDBCacheReader
+{
+  const gchar *pos;
+  const gchar *end;
+} PDBCacheReader;
+
+static gboolean
+_read_u8(PDBCacheReader *reader, guint8 *value)
+{
+  if (reader->pos >= reader->end)
+    return FALSE;
+  *value = *(const guint8 *) reader->pos;
+  reader->pos++;
+  return TRUE;
+}
+
+static gboolean
+_read_u32(PDBCacheReader *reader, guint32 *value)
+{
+  if ((gsize) (reader->end - reader->pos) < sizeof(*value))
+    return FALSE;
+  memcpy(value, reader->pos, sizeof(*value));
+  reader->pos += sizeof(*value);
+  return TRUE;
+}
+
+static gboolean
+_read_string(PDBCacheReader *reader, const gchar **str, gsize *len)
+{
+  guint32 str_len;
+
+  if (!_read_u32(reader, &str_len))
+    return FALSE;
+  if ((gsize) str_len >= (gsize) (reader->end - reader->pos) || reader->pos[str_len] != '\0')
+    return FALSE;
+
+  *str = reader->pos;
+  if (len)
+    *len = str_len;
+  reader->pos += str_len + 1;
+  return TRUE;
+}
+
+/*
+ * Walks through the recorded events and passes them to @parser.  If
+ * @parser is NULL, it only validates the structure of the cache.
+ */
+static gboolean
+_walk_events(PDBCache *self, const GMarkupParser *parser, gpointer user_data, gint *line, gint *column,
+             GError **error)
+{
+  PDBCacheReader reader = { .pos = self->payload, .end = self->payload + self->header.payload_len };
+  GPtrArray *attribute_names = g_ptr_array_new();
+  GPtrArray *attribute_values = g_ptr_array_new();
+  GError *callback_error = NULL;
+  gboolean result = FALSE;
+
+  while (reader.pos < reader.end)
+    {
+      guint8 type;
+      guint32 event_line, event_column, num_attributes;
+      const gchar *name, *value;
+      gsize len;
+
+      if (!_read_u8(&reader, &type) || !_read_u32(&reader, &event_line) || !_read_u32(&reader, &event_column))
+        goto corrupt;
+
+      if (line)
+        *line = event_line;
+      if (column)
+        *column = event_column;
+
+      switch (type)
+        {
+        case PDB_CACHE_START_ELEMENT:
+          if (!_read_string(&reader, &name, NULL) || !_read_u32(&reader, &num_attributes))
+            goto corrupt;
+
+          g_ptr_array_set_size(attribute_names, 0);
+          g_ptr_array_set_size(attribute_values, 0);
+          for (guint32 i = 0; i < num_attributes; i++)
+            {
+              const gchar *attribute_name, *attribute_value;
+
+              if (!_read_string(&reader, &attribute_name, NULL) || !_read_string(&reader, &attribute_value, NULL))
+                goto corrupt;
+              g_ptr_array_add(attribute_names, (gpointer) attribute_name);
+              g_ptr_array_add(attribute_values, (gpointer) attribute_value);
+            }
+          g_ptr_array_add(attribute_names, NULL);
+          g_ptr_array_add(attribute_values, NULL);
+
+          if (parser)
+            parser->start_element(NULL, name, (const gchar **) attribute_names->pdata,
+                                  (const gchar **) attribute_values->pdata, user_data, &callback_error);
+          break;
+        case PDB_CACHE_END_ELEMENT:
+          if (!_read_string(&reader, &name, NULL))
+            goto corrupt;
+          if (parser)
+            parser->end_element(NULL, name, user_data, &callback_error);
+          break;
+        case PDB_CACHE_TEXT:
+          if (!_read_string(&reader, &value, &len))
+            goto corrupt;
+          if (parser)
+            parser->text(NULL, value, len, user_data, &callback_error);
+          break;
+        default:
+          goto corrupt;
+        }
+
+      if (callback_error)
+        {
+          g_propagate_error(error, callback_error);
+          goto exit;
+        }
+    }
+  result = TRUE;
+  goto exit;
+
+corrupt:
+  g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Corrupt patterndb cache file, offset=%ld",
+              (glong) (reader.pos - self->payload));
+exit:
+  g_ptr_array_free(attribute_names, TRUE);
+  g_ptr_array_free(attribute_values, TRUE);
+  return result;
+}
+
+/*
+ * Opens and validates a cache file.  Returns NULL if the file does not
+ * exist, was written by an incompatible version or is corrupt.
+ */
+PDBCache *
+pdb_cache_open(const gchar *cache_file, GError **error)
+{
+  GMappedFile *file = g_mapped_file_new(cache_file, FALSE, error);
+
+  if (!file)
+    return NULL;
+
+  PDBCache *self = g_new0(PDBCache, 1);
+  gsize length = g_mapped_file_get_length(file);
+
+  self->filename = g_strdup(cache_file);
+  self->file = file;
+  if (length < sizeof(self->header))
+    {
+      g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Truncated patterndb cache file");
+      goto error;
+    }
+
+  memcpy(&self->header, g_mapped_file_get_contents(file), sizeof(self->header));
+  if (memcmp(self->header.magic, PDB_CACHE_MAGIC, sizeof(self->header.magic)) != 0
+      || self->header.version != PDB_CACHE_VERSION)
+    {
+      g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Incompatible patterndb cache file");
+      goto error;
+    }
+  if (self->header.payload_len != length - sizeof(self->header))
+    {
+      g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "Truncated patterndb cache file");
+      goto error;
+    }
+  self->payload = g_mapped_file_get_contents(file) + sizeof(self->header);
+
+  if (!_walk_events(self, NULL, NULL, NULL, NULL, error))
+    goto error;
+
+  return self;
+
+error:
+  pdb_cache_close(self);
+  return NULL;
+}
+
+/*
+ * Records the new identity of an unchanged source file in the header, so
+ * that the next load does not need to hash it again.  The header is
+ * rewritten in place, the payload is left untouched.
+ */
+static void
+_update_identity(PDBCache *self, const PDBCacheKey *key)
+{
+  PDBCacheHeader header = self->header;
+
+  header.key.size = key->size;
+  header.key.inode = key->inode;
+  header.key.mtime = key->mtime;
+  header.key.mtime_nsec = key->mtime_nsec;
+
+  gint fd = open(self->filename, O_WRONLY);
+  if (fd < 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header))
+    {
+      msg_debug("Error updating the header of the patterndb cache file, the source will be hashed again on the next load",
+                evt_tag_str("cache_file", self->filename),
+                evt_tag_errno("error", errno));
+    }
+  else
+    {
+      self->header = header;
+    }
+
+  if (fd >= 0)
+    close(fd);
+}
+
+gboolean
+pdb_cache_is_valid_for(PDBCache *self, const gchar *source_file)
+{
+  PDBCacheKey key;
+
+  if (!pdb_cache_key_stat(&key, source_file, NULL))
+    return FALSE;
+
+  if (_key_identity_equals(&key, &self->header.key))
+    return TRUE;
+
+  /* the file was touched, rewritten or moved, check if the contents have
+   * actually changed */
+  if (key.size != self->header.key.size || !pdb_cache_key_digest_file(&key, source_file, NULL))
+    return FALSE;
+
+  if (memcmp(key.digest, self->header.key.digest, sizeof(key.digest)) != 0)
+    return FALSE;
+
+  _update_identity(self, &key);
+  return TRUE;
+}
+
+/*
+ * Replays the recorded events into @parser.  The GMarkupParseContext
+ * argument of the callbacks is NULL, the position of the current event
+ * is stored in @line and @column instead.
+ */
+gboolean
+pdb_cache_replay(PDBCache *self, const GMarkupParser *parser, gpointer user_data, gint *line, gint *column,
+                 GError **error)
+{
+  return _walk_events(self, parser, user_data, line, column, error);
+}
+
+void
+pdb_cache_close(PDBCache *self)
+{
+  g_mapped_file_unref(self->file);
+  g_free(self->filename);
+  g_free(self);
+}
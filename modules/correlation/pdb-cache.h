@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef CORRELATION_PDB_CACHE_H_INCLUDED
+#define CORRELATION_PDB_CACHE_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * A cache of a pre-parsed patterndb XML file.
+ *
+ * The cache stores the stream of GMarkup events (elements, attributes and
+ * text nodes along with their positions in the source file), which can be
+ * replayed into the same GMarkupParser callbacks without having to parse
+ * the XML again.  The file is mapped into memory and the strings are
+ * passed to the callbacks directly from the mapping.
+ *
+ * A cache is only used if it was created from the same source file
+ * contents: it records the size, inode, mtime (with nanoseconds) and
+ * SHA-256 digest of the source.  If the size, the inode and the mtime all
+ * match, the contents
+ * are assumed to be the same, otherwise the source is rehashed and
+ * compared to the digest.
+ */
+
+#define PDB_CACHE_DIGEST_LEN 32
+
+typedef struct _PDBCacheKey
+{
+  guint64 size;
+  guint64 inode;
+  gint64 mtime;
+  gint64 mtime_nsec;
+  guint8 digest[PDB_CACHE_DIGEST_LEN];
+} PDBCacheKey;
+
+gboolean pdb_cache_key_stat(PDBCacheKey *key, const gchar *filename, GError **error);
+gboolean pdb_cache_key_digest_file(PDBCacheKey *key, const gchar *filename, GError **error);
+
+typedef struct _PDBCacheRecorder PDBCacheRecorder;
+
+PDBCacheRecorder *pdb_cache_recorder_new(const GMarkupParser *parser, gpointer user_data);
+const GMarkupParser *pdb_cache_recorder_get_parser(PDBCacheRecorder *self);
+gboolean pdb_cache_recorder_save(PDBCacheRecorder *self, const gchar *cache_file, const PDBCacheKey *key,
+                                 GError **error);
+void pdb_cache_recorder_free(PDBCacheRecorder *self);
+
+typedef struct _PDBCache PDBCache;
+
+PDBCache *pdb_cache_open(const gchar *cache_file, GError **error);
+gboolean pdb_cache_is_valid_for(PDBCache *self, const gchar *source_file);
+gboolean pdb_cache_replay(PDBCache *self, const GMarkupParser *parser, gpointer user_data,
+                          gint *line, gint *column, GError **error);
+void pdb_cache_close(PDBCache *self);
+
+#endif
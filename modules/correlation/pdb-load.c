@@ -27,11 +27,16 @@
 #include "pdb-example.h"
 #include "pdb-ruleset.h"
 #include "pdb-error.h"
+#include "pdb-cache.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <unistd.h>
+
+/* below this, starting the threads costs more than what they save */
+#define PDB_PARALLEL_BUILD_MIN_PATTERNS 1024
 
 enum PDBLoaderState
 {
@@ -95,6 +100,10 @@ typedef struct _PDBLoader
   gint action_id;
   GHashTable *ruleset_patterns;
   GArray *program_patterns;
+  GHashTable *pending_patterns;
+  /* position of the event being replayed from a PDBCache */
+  gint replay_line;
+  gint replay_column;
 } PDBLoader;
 
 typedef struct _PDBProgramPattern
@@ -112,6 +121,14 @@ pdb_program_pattern_clear(PDBProgramPattern *self)
   g_free(self->pdb_location);
 }
 
+static void
+_free_pending_patterns(GArray *patterns)
+{
+  for (gint i = 0; i < patterns->len; i++)
+    pdb_program_pattern_clear(&g_array_index(patterns, PDBProgramPattern, i));
+  g_array_free(patterns, TRUE);
+}
+
 
 static void
 _pdb_state_stack_push(PDBStateStack *self, gint state)
@@ -130,12 +147,26 @@ _pdb_state_stack_pop(PDBStateStack *self)
   return self->stack[self->top];
 }
 
+static void
+_pdb_get_position(PDBLoader *state, gint *line, gint *column)
+{
+  if (state->context)
+    {
+      g_markup_parse_context_get_position(state->context, line, column);
+    }
+  else
+    {
+      *line = state->replay_line;
+      *column = state->replay_column;
+    }
+}
+
 static gchar *
 _pdb_format_location(PDBLoader *state)
 {
   gint line, column;
 
-  g_markup_parse_context_get_position(state->context, &line, &column);
+  _pdb_get_position(state, &line, &column);
   return g_strdup_printf("%s:%d:%d", state->filename, line, column);
 }
 
@@ -151,7 +182,7 @@ pdb_loader_set_error(PDBLoader *state, GError **error, const gchar *format, ...)
   error_text = g_strdup_vprintf(format, va);
   va_end(va);
 
-  g_markup_parse_context_get_position(state->context, &line_number, &col_number);
+  _pdb_get_position(state, &line_number, &col_number);
   error_location = g_strdup_printf("%s:%d:%d", state->filename, line_number, col_number);
 
   g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "%s: %s", error_location, error_text);
@@ -377,11 +408,100 @@ _populate_ruleset_radix(gpointer key, gpointer value, gpointer user_data)
                 state->ruleset->prefix, NULL, program->pdb_location);
 }
 
+/*
+ * The rules of the different programs end up in independent radix trees,
+ * so once the whole file is read, the trees are built in parallel.
+ */
+typedef struct _PDBProgramBuildJob
+{
+  PDBProgram *program;
+  GArray *patterns;
+  const gchar *prefix;
+} PDBProgramBuildJob;
+
+static void
+_build_program(PDBProgramBuildJob *job, gpointer user_data)
+{
+  for (gint i = 0; i < job->patterns->len; i++)
+    {
+      PDBProgramPattern *program_pattern = &g_array_index(job->patterns, PDBProgramPattern, i);
+
+      /* r_insert_node() modifies the pattern, so extract the literals first */
+      literal_prefilter_add_pattern(job->program->prefilter, program_pattern->pattern);
+      r_insert_node(job->program->rules,
+                    program_pattern->pattern,
+                    pdb_rule_ref(program_pattern->rule),
+                    job->prefix,
+                    (RNodeGetValueFunc) pdb_rule_get_name,
+                    program_pattern->pdb_location);
+      pdb_program_pattern_clear(program_pattern);
+    }
+  g_array_set_size(job->patterns, 0);
+  literal_prefilter_compile(job->program->prefilter);
+}
+
+static gint
+_get_processor_count(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  return sysconf(_SC_NPROCESSORS_ONLN);
+#else
+  return -1;
+#endif
+}
+
+static void
+_build_program_radix_trees(PDBLoader *state)
+{
+  GArray *jobs = g_array_new(FALSE, FALSE, sizeof(PDBProgramBuildJob));
+  GHashTableIter iter;
+  gpointer key, value;
+  gint num_patterns = 0;
+  gint num_threads;
+
+  g_hash_table_iter_init(&iter, state->pending_patterns);
+  while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+      PDBProgramBuildJob job = { .program = key, .patterns = value, .prefix = state->ruleset->prefix };
+
+      g_array_append_val(jobs, job);
+      num_patterns += job.patterns->len;
+    }
+
+  num_threads = MIN(_get_processor_count(), (gint) jobs->len);
+  if (num_threads <= 1 || num_patterns < PDB_PARALLEL_BUILD_MIN_PATTERNS)
+    {
+      num_threads = 1;
+      for (gint i = 0; i < jobs->len; i++)
+        _build_program(&g_array_index(jobs, PDBProgramBuildJob, i), NULL);
+    }
+  else
+    {
+      GThreadPool *pool = g_thread_pool_new((GFunc) _build_program, NULL, num_threads, TRUE, NULL);
+
+      for (gint i = 0; i < jobs->len; i++)
+        g_thread_pool_push(pool, &g_array_index(jobs, PDBProgramBuildJob, i), NULL);
+
+      /* waits for all the jobs to finish */
+      g_thread_pool_free(pool, FALSE, TRUE);
+    }
+
+  msg_debug("patterndb: radix trees built",
+            evt_tag_str(EVT_TAG_FILENAME, state->filename),
+            evt_tag_int("programs", jobs->len),
+            evt_tag_int("patterns", num_patterns),
+            evt_tag_int("threads", num_threads));
+
+  g_array_free(jobs, TRUE);
+  g_hash_table_remove_all(state->pending_patterns);
+}
+
 static void
 _pdbl_patterndb_end(PDBLoader *state, const gchar *element_name, GError **error)
 {
   if (_pop_state_for_closing_tag(state, element_name, "patterndb", error))
     {
+      _build_program_radix_trees(state);
       g_hash_table_foreach(state->ruleset_patterns, _populate_ruleset_radix, state);
       g_hash_table_remove_all(state->ruleset_patterns);
     }
@@ -426,9 +546,8 @@ _pdbl_ruleset_start(PDBLoader *state, const gchar *element_name, GError **error)
 static void
 _pdbl_ruleset_end(PDBLoader *state, const gchar *element_name, GError **error)
 {
-  gint i;
-  PDBProgramPattern *program_pattern;
   PDBProgram *program;
+  GArray *pending;
 
   if (strcmp(element_name, "patterns") == 0)
     {
@@ -442,19 +561,15 @@ _pdbl_ruleset_end(PDBLoader *state, const gchar *element_name, GError **error)
     {
       program = (state->current_program ? state->current_program : state->root_program);
 
-      /* Copy stored rules into current program */
-      for (i = 0; i < state->program_patterns->len; i++)
+      /* Move stored rules to the current program, they are inserted into
+       * its radix tree at the end of the file */
+      pending = g_hash_table_lookup(state->pending_patterns, program);
+      if (!pending)
         {
-          program_pattern = &g_array_index(state->program_patterns, PDBProgramPattern, i);
-
-          r_insert_node(program->rules,
-                        program_pattern->pattern,
-                        pdb_rule_ref(program_pattern->rule),
-                        state->ruleset->prefix,
-                        (RNodeGetValueFunc) pdb_rule_get_name,
-                        program_pattern->pdb_location);
-          pdb_program_pattern_clear(program_pattern);
+          pending = g_array_new(FALSE, FALSE, sizeof(PDBProgramPattern));
+          g_hash_table_insert(state->pending_patterns, pdb_program_ref(program), pending);
         }
+      g_array_append_vals(pending, state->program_patterns->data, state->program_patterns->len);
 
       state->current_program = NULL;
 
@@ -1175,11 +1290,13 @@ GMarkupParser db_parser =
   .error = NULL
 };
 
-gboolean
-pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GList **examples)
+static gboolean
+_pdb_loader_parse_file(PDBLoader *state, const gchar *config, const gchar *cache_file)
 {
-  PDBLoader state;
   GMarkupParseContext *parse_ctx = NULL;
+  PDBCacheRecorder *recorder = NULL;
+  GChecksum *checksum = NULL;
+  PDBCacheKey key;
   GError *error = NULL;
   FILE *dbfile = NULL;
   gint bytes_read;
@@ -1194,20 +1311,25 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
       return FALSE;
     }
 
-  memset(&state, 0x0, sizeof(state));
-
-  state.ruleset = self;
-  state.root_program = pdb_program_new();
-  state.load_examples = !!examples;
-  state.ruleset_patterns = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) pdb_program_unref);
-  state.cfg = cfg;
-  state.filename = config;
-  state.context = parse_ctx = g_markup_parse_context_new(&db_parser, 0, &state, NULL);
-
-  self->programs = r_new_node("", state.root_program);
+  /* the key is taken before reading the file, so a change while we are
+   * reading it invalidates the cache we are about to write */
+  if (cache_file && pdb_cache_key_stat(&key, config, NULL))
+    {
+      recorder = pdb_cache_recorder_new(&db_parser, state);
+      checksum = g_checksum_new(G_CHECKSUM_SHA256);
+      parse_ctx = g_markup_parse_context_new(pdb_cache_recorder_get_parser(recorder), 0, recorder, NULL);
+    }
+  else
+    {
+      parse_ctx = g_markup_parse_context_new(&db_parser, 0, state, NULL);
+    }
+  state->context = parse_ctx;
 
   while ((bytes_read = fread(buff, sizeof(gchar), 4096, dbfile)) != 0)
     {
+      if (checksum)
+        g_checksum_update(checksum, (const guchar *) buff, bytes_read);
+
       if (!g_markup_parse_context_parse(parse_ctx, buff, bytes_read, &error))
         {
           msg_error("Error parsing pattern database file",
@@ -1227,18 +1349,136 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
       goto error;
     }
 
-  if (state.load_examples)
-    *examples = state.examples;
+  if (recorder)
+    {
+      gsize digest_len = sizeof(key.digest);
+
+      g_checksum_get_digest(checksum, key.digest, &digest_len);
+      if (!pdb_cache_recorder_save(recorder, cache_file, &key, &error))
+        {
+          msg_warning("Error writing pattern database cache file",
+                      evt_tag_str(EVT_TAG_FILENAME, config),
+                      evt_tag_str("cache_file", cache_file),
+                      evt_tag_str("error", error ? error->message : "unknown"));
+          g_clear_error(&error);
+        }
+    }
 
   success = TRUE;
 
 error:
   if (dbfile)
     fclose(dbfile);
-  if (parse_ctx)
-    g_markup_parse_context_free(parse_ctx);
-  g_hash_table_unref(state.ruleset_patterns);
+  g_markup_parse_context_free(parse_ctx);
+  state->context = NULL;
+  if (recorder)
+    pdb_cache_recorder_free(recorder);
+  if (checksum)
+    g_checksum_free(checksum);
   if (error)
     g_error_free(error);
   return success;
 }
+
+static PDBCache *
+_pdb_loader_open_cache(const gchar *config, const gchar *cache_file)
+{
+  GError *error = NULL;
+  PDBCache *cache = pdb_cache_open(cache_file, &error);
+
+  if (!cache)
+    {
+      if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        msg_warning("Ignoring invalid pattern database cache file",
+                    evt_tag_str(EVT_TAG_FILENAME, config),
+                    evt_tag_str("cache_file", cache_file),
+                    evt_tag_str("error", error ? error->message : "unknown"));
+      g_clear_error(&error);
+      return NULL;
+    }
+
+  if (!pdb_cache_is_valid_for(cache, config))
+    {
+      msg_debug("Pattern database changed since its cache was written",
+                evt_tag_str(EVT_TAG_FILENAME, config),
+                evt_tag_str("cache_file", cache_file));
+      pdb_cache_close(cache);
+      return NULL;
+    }
+  return cache;
+}
+
+static gboolean
+_pdb_loader_replay_cache(PDBLoader *state, PDBCache *cache, const gchar *cache_file)
+{
+  GError *error = NULL;
+
+  msg_debug("Loading pattern database from cache",
+            evt_tag_str(EVT_TAG_FILENAME, state->filename),
+            evt_tag_str("cache_file", cache_file));
+
+  if (!pdb_cache_replay(cache, &db_parser, state, &state->replay_line, &state->replay_column, &error))
+    {
+      msg_error("Error parsing pattern database file",
+                evt_tag_str(EVT_TAG_FILENAME, state->filename),
+                evt_tag_str("cache_file", cache_file),
+                evt_tag_str("error", error ? error->message : "unknown"));
+      g_clear_error(&error);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+/*
+ * Loads @config into @self. If @cache_file is not NULL, the pre-parsed
+ * contents of @config are read from there if it is up-to-date, or written
+ * there after parsing @config otherwise.
+ */
+gboolean
+pdb_rule_set_load_with_cache(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, const gchar *cache_file,
+                             GList **examples)
+{
+  PDBLoader state;
+  PDBCache *cache = NULL;
+  gboolean success;
+
+  memset(&state, 0x0, sizeof(state));
+
+  state.ruleset = self;
+  state.root_program = pdb_program_new();
+  state.load_examples = !!examples;
+  state.ruleset_patterns = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) pdb_program_unref);
+  state.pending_patterns = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                                 (GDestroyNotify) pdb_program_unref,
+                                                 (GDestroyNotify) _free_pending_patterns);
+  state.cfg = cfg;
+  state.filename = config;
+
+  self->programs = r_new_node("", state.root_program);
+
+  if (cache_file)
+    cache = _pdb_loader_open_cache(config, cache_file);
+
+  if (cache)
+    {
+      success = _pdb_loader_replay_cache(&state, cache, cache_file);
+      pdb_cache_close(cache);
+    }
+  else
+    {
+      success = _pdb_loader_parse_file(&state, config, cache_file);
+    }
+
+  if (success && state.load_examples)
+    *examples = state.examples;
+
+  g_hash_table_unref(state.ruleset_patterns);
+  g_hash_table_unref(state.pending_patterns);
+  return success;
+}
+
+gboolean
+pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GList **examples)
+{
+  return pdb_rule_set_load_with_cache(self, cfg, config, NULL, examples);
+}
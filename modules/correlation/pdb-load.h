@@ -28,5 +28,7 @@
 #include "cfg.h"
 
 gboolean pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GList **examples);
+gboolean pdb_rule_set_load_with_cache(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config,
+                                      const gchar *cache_file, GList **examples);
 
 #endif
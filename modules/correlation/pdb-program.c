@@ -35,6 +35,7 @@ pdb_program_new(void)
   PDBProgram *self = g_new0(PDBProgram, 1);
 
   self->rules = r_new_node("", NULL);
+  self->prefilter = literal_prefilter_new();
   self->ref_cnt = 1;
   return self;
 }
@@ -55,6 +56,8 @@ pdb_program_unref(PDBProgram *s)
     {
       if (self->rules)
         r_free_node(self->rules, (void (*)(void *)) pdb_rule_unref);
+      if (self->prefilter)
+        literal_prefilter_free(self->prefilter);
 
       g_free(self->pdb_location);
       g_free(self);
@@ -25,6 +25,7 @@
 
 #include "syslog-ng.h"
 #include "radix.h"
+#include "literal-prefilter.h"
 
 /*
  * This class encapsulates a set of program related rules in the
@@ -37,6 +38,7 @@ typedef struct _PDBProgram
   guint ref_cnt;
   gchar *pdb_location;
   RNode *rules;
+  LiteralPrefilter *prefilter;
 } PDBProgram;
 
 PDBProgram *pdb_program_new(void);
@@ -128,10 +128,14 @@ pdb_ruleset_lookup(PDBRuleSet *rule_set, PDBLookupParams *lookup, GArray *dbg_li
               message_len = lookup->message_len;
             }
 
+          /* NOTE: the prefilter is bypassed while debugging, so that the
+           * debug output shows how far the radix lookup got */
           if (G_UNLIKELY(dbg_list))
             msg_node = r_find_node_dbg(program->rules, (gchar *) message, message_len, matches, dbg_list);
-          else
+          else if (literal_prefilter_match(program->prefilter, message, message_len))
             msg_node = r_find_node(program->rules, (gchar *) message, message_len, matches);
+          else
+            msg_node = NULL;
 
           if (msg_node)
             {
@@ -48,6 +48,7 @@
 #include "mainloop.h"
 #include "msg-format.h"
 #include "str-utils.h"
+#include "timeutils/misc.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -335,6 +336,105 @@ static gchar *template_string = NULL;
 static gchar *filter_string = NULL;
 static gboolean debug_pattern = FALSE;
 static gboolean debug_pattern_parse = FALSE;
+static gboolean match_bench = FALSE;
+static gint match_bench_iterations = 1;
+
+typedef struct _PdbToolBenchRule
+{
+  gchar *rule_id;
+  guint64 count;
+  guint64 total_nsec;
+  guint64 max_nsec;
+} PdbToolBenchRule;
+
+static void
+pdbtool_bench_rule_free(PdbToolBenchRule *self)
+{
+  g_free(self->rule_id);
+  g_free(self);
+}
+
+static void
+pdbtool_bench_record(GHashTable *bench_rules, LogMessage *msg, guint64 elapsed_nsec)
+{
+  const gchar *class = log_msg_get_value_by_name(msg, ".classifier.class", NULL);
+  const gchar *rule_id = log_msg_get_value_by_name(msg, ".classifier.rule_id", NULL);
+  PdbToolBenchRule *rule;
+
+  /* the rule_id of a previous match is not cleared when the message is unknown */
+  if (g_str_equal(class, "unknown") || !rule_id[0])
+    rule_id = "<unknown>";
+
+  rule = g_hash_table_lookup(bench_rules, rule_id);
+  if (!rule)
+    {
+      rule = g_new0(PdbToolBenchRule, 1);
+      rule->rule_id = g_strdup(rule_id);
+      g_hash_table_insert(bench_rules, rule->rule_id, rule);
+    }
+  rule->count++;
+  rule->total_nsec += elapsed_nsec;
+  rule->max_nsec = MAX(rule->max_nsec, elapsed_nsec);
+}
+
+static gint
+pdbtool_bench_rule_cmp(gconstpointer a, gconstpointer b)
+{
+  const PdbToolBenchRule *rule_a = *(PdbToolBenchRule **) a;
+  const PdbToolBenchRule *rule_b = *(PdbToolBenchRule **) b;
+
+  if (rule_a->total_nsec == rule_b->total_nsec)
+    return 0;
+  return rule_a->total_nsec < rule_b->total_nsec ? 1 : -1;
+}
+
+static void
+pdbtool_bench_report(GHashTable *bench_rules)
+{
+  GPtrArray *rules = g_ptr_array_new();
+  GHashTableIter iter;
+  gpointer value;
+  guint64 total_count = 0, total_nsec = 0;
+
+  g_hash_table_iter_init(&iter, bench_rules);
+  while (g_hash_table_iter_next(&iter, NULL, &value))
+    {
+      PdbToolBenchRule *rule = (PdbToolBenchRule *) value;
+
+      g_ptr_array_add(rules, rule);
+      total_count += rule->count;
+      total_nsec += rule->total_nsec;
+    }
+  g_ptr_array_sort(rules, pdbtool_bench_rule_cmp);
+
+  printf("%-40s %10s %12s %10s %10s %7s\n", "rule_id", "count", "total_usec", "avg_nsec", "max_nsec", "share");
+  for (guint i = 0; i < rules->len; i++)
+    {
+      PdbToolBenchRule *rule = g_ptr_array_index(rules, i);
+
+      printf("%-40s %10" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT " %6.2f%%\n",
+             rule->rule_id, rule->count, rule->total_nsec / 1000, rule->total_nsec / rule->count, rule->max_nsec,
+             total_nsec ? 100.0 * rule->total_nsec / total_nsec : 0.0);
+    }
+  if (total_count)
+    printf("\nTotal: %" G_GUINT64_FORMAT " lookups in %" G_GUINT64_FORMAT " usec, %.0f lookups/sec\n",
+           total_count, total_nsec / 1000, total_nsec ? total_count * 1e9 / total_nsec : 0.0);
+  g_ptr_array_free(rules, TRUE);
+}
+
+static void
+pdbtool_bench_process(PatternDB *patterndb, LogMessage *msg, GHashTable *bench_rules)
+{
+  for (gint i = 0; i < match_bench_iterations; i++)
+    {
+      struct timespec start, end;
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      pattern_db_process(patterndb, msg);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      pdbtool_bench_record(bench_rules, msg, timespec_diff_nsec(&end, &start));
+    }
+}
 
 gboolean
 pdbtool_match_values(NVHandle handle, const gchar *name,
@@ -405,6 +505,7 @@ pdbtool_match(int argc, char *argv[])
   LogProtoServerOptions proto_options;
   gboolean may_read = TRUE;
   gpointer args[4];
+  GHashTable *bench_rules = NULL;
 
   memset(&parse_options, 0, sizeof(parse_options));
 
@@ -414,6 +515,18 @@ pdbtool_match(int argc, char *argv[])
       return ret;
     }
 
+  if (match_bench && debug_pattern)
+    {
+      fprintf(stderr, "--bench and --debug-pattern are mutually exclusive\n");
+      return ret;
+    }
+
+  if (match_bench_iterations < 1)
+    {
+      fprintf(stderr, "--bench-iterations must be positive\n");
+      return ret;
+    }
+
   if (template_string)
     {
       GError *error = NULL;
@@ -498,7 +611,11 @@ pdbtool_match(int argc, char *argv[])
       eof = status != (LPS_SUCCESS && status != LPS_AGAIN);
     }
 
-  if (!debug_pattern)
+  if (match_bench)
+    {
+      bench_rules = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) pdbtool_bench_rule_free);
+    }
+  else if (!debug_pattern)
     {
       args[0] = filter;
       args[1] = template;
@@ -604,6 +721,10 @@ pdbtool_match(int argc, char *argv[])
             pdbtool_pdb_emit(msg, nulls);
           }
         }
+      else if (G_UNLIKELY(match_bench))
+        {
+          pdbtool_bench_process(patterndb, msg, bench_rules);
+        }
       else
         {
           pattern_db_process(patterndb, msg);
@@ -622,7 +743,11 @@ pdbtool_match(int argc, char *argv[])
         }
     }
   pattern_db_expire_state(patterndb);
+  if (bench_rules)
+    pdbtool_bench_report(bench_rules);
 error:
+  if (bench_rules)
+    g_hash_table_destroy(bench_rules);
   if (proto)
     log_proto_server_free(proto);
   if (template)
@@ -675,6 +800,14 @@ static GOptionEntry match_options[] =
     "filter", 'F', 0, G_OPTION_ARG_STRING, &filter_string,
     "Only print messages matching the specified syslog-ng filter", "expr"
   },
+  {
+    "bench", 'b', 0, G_OPTION_ARG_NONE, &match_bench,
+    "Measure the lookup time of the messages and report the cost of each rule", NULL
+  },
+  {
+    "bench-iterations", 'n', 0, G_OPTION_ARG_INT, &match_bench_iterations,
+    "Number of times each message is looked up with --bench", "<n>"
+  },
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "correlation.h"
+#include "apphook.h"
+
+#define NUM_CONTEXTS 200
+#define NUM_SHARDS 16
+
+typedef struct _ExpiredContext
+{
+  guint64 now;
+  gchar *session_id;
+} ExpiredContext;
+
+static void
+_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer caller_context)
+{
+  CorrelationContext *context = user_data;
+  CorrelationState *state = timer_wheel_get_associated_data(wheel);
+  GArray *expired = caller_context;
+  ExpiredContext e = { now, g_strdup(context->key.session_id) };
+
+  g_array_append_val(expired, e);
+  context->timer = NULL;
+  correlation_state_tx_remove_context(state, context);
+}
+
+static CorrelationState *
+_create_state_with_contexts(gint num_shards)
+{
+  CorrelationState *state = correlation_state_new(_expire_entry, num_shards);
+  correlation_state_set_associated_data(state, state, NULL);
+
+  for (gint i = 0; i < NUM_CONTEXTS; i++)
+    {
+      CorrelationKey key;
+
+      correlation_key_init(&key, RCS_GLOBAL, NULL, g_strdup_printf("key-%d", i));
+      correlation_state_tx_begin_key(state, &key);
+      cr_assert_null(correlation_state_tx_lookup_context(state, &key));
+      correlation_state_tx_store_context(state, correlation_context_new(&key), (i % 10) + 1);
+      cr_assert_not_null(correlation_state_tx_lookup_context(state, &key));
+      correlation_state_tx_end_key(state, &key);
+    }
+  return state;
+}
+
+static GArray *
+_expire_contexts(CorrelationState *state)
+{
+  GArray *expired = g_array_new(FALSE, FALSE, sizeof(ExpiredContext));
+
+  correlation_state_advance_time(state, 20, expired);
+  return expired;
+}
+
+static void
+_free_expired(GArray *expired)
+{
+  for (gint i = 0; i < expired->len; i++)
+    g_free(g_array_index(expired, ExpiredContext, i).session_id);
+  g_array_free(expired, TRUE);
+}
+
+Test(correlation_state, contexts_are_distributed_among_shards)
+{
+  CorrelationState *state = _create_state_with_contexts(NUM_SHARDS);
+  gint num_used_shards = 0;
+  gint num_contexts = 0;
+
+  for (gint i = 0; i < state->num_shards; i++)
+    {
+      gint size = g_hash_table_size(state->shards[i]->state);
+
+      num_contexts += size;
+      if (size > 0)
+        num_used_shards++;
+    }
+  cr_assert_eq(num_contexts, NUM_CONTEXTS);
+  cr_assert_gt(num_used_shards, 1);
+
+  correlation_state_unref(state);
+}
+
+Test(correlation_state, contexts_expire_in_the_order_of_their_expiration_time)
+{
+  CorrelationState *state = _create_state_with_contexts(NUM_SHARDS);
+  GArray *expired = _expire_contexts(state);
+
+  cr_assert_eq(expired->len, NUM_CONTEXTS);
+  for (gint i = 1; i < expired->len; i++)
+    cr_assert_leq(g_array_index(expired, ExpiredContext, i - 1).now,
+                  g_array_index(expired, ExpiredContext, i).now);
+  cr_assert_eq(correlation_state_get_time(state), 20);
+
+  _free_expired(expired);
+  correlation_state_unref(state);
+}
+
+Test(correlation_state, expiration_order_is_deterministic)
+{
+  CorrelationState *state1 = _create_state_with_contexts(NUM_SHARDS);
+  CorrelationState *state2 = _create_state_with_contexts(NUM_SHARDS);
+  GArray *expired1 = _expire_contexts(state1);
+  GArray *expired2 = _expire_contexts(state2);
+
+  cr_assert_eq(expired1->len, expired2->len);
+  for (gint i = 0; i < expired1->len; i++)
+    {
+      ExpiredContext *e1 = &g_array_index(expired1, ExpiredContext, i);
+      ExpiredContext *e2 = &g_array_index(expired2, ExpiredContext, i);
+
+      cr_assert_eq(e1->now, e2->now);
+      cr_assert_str_eq(e1->session_id, e2->session_id);
+    }
+
+  _free_expired(expired1);
+  _free_expired(expired2);
+  correlation_state_unref(state1);
+  correlation_state_unref(state2);
+}
+
+Test(correlation_state, expire_all_expires_contexts_in_every_shard)
+{
+  CorrelationState *state = _create_state_with_contexts(NUM_SHARDS);
+  GArray *expired = g_array_new(FALSE, FALSE, sizeof(ExpiredContext));
+
+  correlation_state_expire_all(state, expired);
+  cr_assert_eq(expired->len, NUM_CONTEXTS);
+  cr_assert_eq(correlation_state_get_time(state), 0);
+
+  _free_expired(expired);
+  correlation_state_unref(state);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(correlation_state, .init = setup, .fini = teardown);
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/config_parse_lib.h"
+
+#include "groupingby.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "scratch-buffers.h"
+#include "timeutils/misc.h"
+
+#include <iv.h>
+#include <stdio.h>
+
+#define NUM_MESSAGES_PER_THREAD 100000
+#define NUM_KEYS_PER_THREAD 1000
+#define MAX_THREADS 16
+
+typedef struct _PerfThreadArgs
+{
+  LogParser *parser;
+  gint thread_index;
+} PerfThreadArgs;
+
+static GMutex start_lock;
+static GCond start_cond;
+static gboolean start;
+
+static LogParser *
+_compile_grouping_by(const gchar *expr)
+{
+  LogParser *gby;
+  cr_assert(parse_config(expr, LL_CONTEXT_PARSER, NULL, (gpointer *) &gby) == TRUE);
+  return gby;
+}
+
+static void
+_wait_for_start(void)
+{
+  g_mutex_lock(&start_lock);
+  while (!start)
+    g_cond_wait(&start_cond, &start_lock);
+  g_mutex_unlock(&start_lock);
+}
+
+static gpointer
+_feed_messages_thread(gpointer s)
+{
+  PerfThreadArgs *args = (PerfThreadArgs *) s;
+  gchar key[32];
+
+  iv_init();
+  scratch_buffers_allocator_init();
+  _wait_for_start();
+
+  for (gint i = 0; i < NUM_MESSAGES_PER_THREAD; i++)
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = log_msg_new_empty();
+
+      /* every thread works on its own set of keys, just like independent
+       * sources sending unrelated sessions */
+      g_snprintf(key, sizeof(key), "%d-%d", args->thread_index, i % NUM_KEYS_PER_THREAD);
+      log_msg_set_value_by_name(msg, "key", key, -1);
+      log_msg_set_value_by_name(msg, "PROGRAM", "prog", -1);
+      log_pipe_queue(&args->parser->super, msg, &path_options);
+
+      if ((i % 100) == 0)
+        scratch_buffers_explicit_gc();
+    }
+
+  scratch_buffers_explicit_gc();
+  scratch_buffers_allocator_deinit();
+  iv_deinit();
+  return NULL;
+}
+
+static void
+_measure_grouping_by_throughput(gint num_threads)
+{
+  LogParser *parser = _compile_grouping_by(
+                        "grouping-by(key(\"$key\")"
+                        "    aggregate("
+                        "        value(\"aggr\" \"$(context-length)\")"
+                        "    )"
+                        "    timeout(600)"
+                        "    inject-mode(aggregate-only)"
+                        "    trigger(\"$(context-length)\" == \"10\")"
+                        ");");
+  PerfThreadArgs args[MAX_THREADS];
+  GThread *threads[MAX_THREADS];
+  struct timespec start_ts, end_ts;
+
+  cr_assert(log_pipe_init(&parser->super) == TRUE);
+
+  start = FALSE;
+  for (gint i = 0; i < num_threads; i++)
+    {
+      args[i].parser = parser;
+      args[i].thread_index = i;
+      threads[i] = g_thread_new(NULL, _feed_messages_thread, &args[i]);
+    }
+
+  clock_gettime(CLOCK_MONOTONIC, &start_ts);
+  g_mutex_lock(&start_lock);
+  start = TRUE;
+  g_cond_broadcast(&start_cond);
+  g_mutex_unlock(&start_lock);
+
+  for (gint i = 0; i < num_threads; i++)
+    g_thread_join(threads[i]);
+  clock_gettime(CLOCK_MONOTONIC, &end_ts);
+
+  gdouble elapsed_usec = timespec_diff_usec(&end_ts, &start_ts);
+  printf("      grouping-by, threads: %2d, speed: %12.3f msg/sec\n", num_threads,
+         num_threads * NUM_MESSAGES_PER_THREAD * 1e6 / elapsed_usec);
+
+  cr_assert(log_pipe_deinit(&parser->super) == TRUE);
+  log_pipe_unref(&parser->super);
+}
+
+Test(grouping_by_perf, test_grouping_by_throughput_vs_threads)
+{
+  for (gint num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2)
+    _measure_grouping_by_throughput(num_threads);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  cfg_load_module(configuration, "basicfuncs");
+  cfg_load_module(configuration, "correlation");
+}
+
+static void
+teardown(void)
+{
+  scratch_buffers_explicit_gc();
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(grouping_by_perf, .init = setup, .fini = teardown);
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "literal-prefilter.h"
+
+#include <string.h>
+
+static LiteralPrefilter *
+_compile_prefilter(const gchar *patterns[])
+{
+  LiteralPrefilter *prefilter = literal_prefilter_new();
+
+  for (gint i = 0; patterns[i]; i++)
+    literal_prefilter_add_pattern(prefilter, patterns[i]);
+  literal_prefilter_compile(prefilter);
+  return prefilter;
+}
+
+static gboolean
+_match(LiteralPrefilter *prefilter, const gchar *message)
+{
+  return literal_prefilter_match(prefilter, message, strlen(message));
+}
+
+Test(literal_prefilter, test_uncompiled_prefilter_accepts_everything)
+{
+  LiteralPrefilter *prefilter = literal_prefilter_new();
+
+  cr_assert(_match(prefilter, "foo"));
+  literal_prefilter_add_pattern(prefilter, "bar");
+  cr_assert(_match(prefilter, "foo"), "dirty prefilter should not reject anything");
+
+  literal_prefilter_compile(prefilter);
+  cr_assert_not(_match(prefilter, "foo"));
+  cr_assert(_match(prefilter, "bar"));
+  literal_prefilter_free(prefilter);
+}
+
+Test(literal_prefilter, test_longest_literal_is_required)
+{
+  const gchar *patterns[] = { "Accepted password for @ESTRING:usracct.username: @from @IPv4:usracct.device@", NULL };
+  LiteralPrefilter *prefilter = _compile_prefilter(patterns);
+
+  cr_assert(literal_prefilter_is_effective(prefilter));
+  cr_assert(_match(prefilter, "Accepted password for bazsi from 1.2.3.4"));
+  cr_assert(_match(prefilter, "xxx Accepted password for yyy"));
+  cr_assert_not(_match(prefilter, "Accepted publickey for bazsi from 1.2.3.4"));
+  cr_assert_not(_match(prefilter, ""));
+  literal_prefilter_free(prefilter);
+}
+
+Test(literal_prefilter, test_any_of_the_patterns_is_accepted)
+{
+  const gchar *patterns[] = { "session opened for @ANYSTRING:user@", "connection from @IPv4:ip@ refused", "abc", "abcdef", "bcd", NULL };
+  LiteralPrefilter *prefilter = _compile_prefilter(patterns);
+
+  cr_assert(_match(prefilter, "pam: session opened for root"));
+  cr_assert(_match(prefilter, "connection from 10.0.0.1 refused"));
+  cr_assert(_match(prefilter, "xxabxx bc bcd"), "failure links should find overlapping anchors");
+  cr_assert(_match(prefilter, "ababc"));
+  cr_assert_not(_match(prefilter, "session closed for root"));
+  cr_assert_not(_match(prefilter, "ab bc cd"));
+  literal_prefilter_free(prefilter);
+}
+
+Test(literal_prefilter, test_message_length_is_honoured)
+{
+  const gchar *patterns[] = { "needle", NULL };
+  LiteralPrefilter *prefilter = _compile_prefilter(patterns);
+
+  cr_assert(literal_prefilter_match(prefilter, "a needle in the haystack", -1));
+  cr_assert_not(literal_prefilter_match(prefilter, "a needle in the haystack", 6));
+  literal_prefilter_free(prefilter);
+}
+
+Test(literal_prefilter, test_escaped_at_sign_is_a_literal)
+{
+  const gchar *patterns[] = { "user@@example.com logged in", NULL };
+  LiteralPrefilter *prefilter = _compile_prefilter(patterns);
+
+  cr_assert(_match(prefilter, "user@example.com logged in"));
+  cr_assert_not(_match(prefilter, "user@@example.com logged in"));
+  literal_prefilter_free(prefilter);
+}
+
+Test(literal_prefilter, test_newline_splits_literals)
+{
+  const gchar *patterns[] = { "first line\nsecond", NULL };
+  LiteralPrefilter *prefilter = _compile_prefilter(patterns);
+
+  /* the radix skips the CR in front of a LF, so does the prefilter */
+  cr_assert(_match(prefilter, "first line\r\nsecond"));
+  cr_assert(_match(prefilter, "first line\nsecond"));
+  cr_assert_not(_match(prefilter, "second line"));
+  literal_prefilter_free(prefilter);
+}
+
+Test(literal_prefilter, test_pattern_without_literals_disables_the_prefilter)
+{
+  const gchar *patterns[] = { "foobar", "@ANYSTRING:msg@", NULL };
+  LiteralPrefilter *prefilter = _compile_prefilter(patterns);
+
+  cr_assert_not(literal_prefilter_is_effective(prefilter));
+  cr_assert(_match(prefilter, "anything goes"));
+  literal_prefilter_free(prefilter);
+}
+
+Test(literal_prefilter, test_long_literals_are_truncated)
+{
+  const gchar *patterns[] = { "this is a very long literal that goes on and on @NUMBER:n@", NULL };
+  LiteralPrefilter *prefilter = _compile_prefilter(patterns);
+
+  cr_assert(_match(prefilter, "this is a very long literal that goes on and on 42"));
+  cr_assert(_match(prefilter, "this is a very long"), "only a prefix of the literal should be required");
+  cr_assert_not(_match(prefilter, "this is a short literal"));
+  literal_prefilter_free(prefilter);
+}
@@ -31,9 +31,11 @@
 #include "filter/filter-expr.h"
 #include "patterndb.h"
 #include "pdb-file.h"
+#include "pdb-cache.h"
 #include "plugin.h"
 #include "cfg.h"
 #include "timerwheel.h"
+#include "timeutils/misc.h"
 
 #include <stdio.h>
 #include <sys/time.h>
@@ -794,6 +796,151 @@ Test(pattern_db, test_program_template)
   log_template_unref(template);
 }
 
+static gchar *
+_create_pdb_file(const gchar *pdb)
+{
+  gchar *filename;
+
+  g_file_open_tmp("patterndbXXXXXX.xml", &filename, NULL);
+  g_file_set_contents(filename, pdb, strlen(pdb), NULL);
+  return filename;
+}
+
+static void
+_overwrite_file_in_place(const gchar *filename, const gchar *contents, time_t mtime, glong mtime_nsec)
+{
+  struct timespec mtime_ts = { .tv_sec = mtime, .tv_nsec = mtime_nsec };
+  struct timespec times[2] = { mtime_ts, mtime_ts };
+  FILE *f = fopen(filename, "r+");
+
+  cr_assert_not_null(f);
+  cr_assert_eq(fwrite(contents, 1, strlen(contents), f), strlen(contents));
+  fclose(f);
+  cr_assert_eq(utimensat(AT_FDCWD, filename, times, 0), 0);
+}
+
+static void
+_assert_program_and_message_match(PatternDB *patterndb, const gchar *program, const gchar *message,
+                                  const gchar *name, const gchar *expected_value)
+{
+  LogMessage *msg = _construct_message(program, message);
+
+  cr_assert(pattern_db_process(patterndb, msg), "patterndb expected to match but it didn't, message=%s", message);
+  assert_log_message_value(msg, log_msg_get_value_handle(name), expected_value);
+  log_msg_unref(msg);
+}
+
+Test(pattern_db, test_patterndb_is_loaded_from_its_cache_if_the_file_is_unchanged)
+{
+  gchar *filename = _create_pdb_file(pdb_test_match_in_program);
+  gchar *cache_file = g_strdup_printf("%s.cache", filename);
+  gchar *garbage = g_strnfill(strlen(pdb_test_match_in_program), 'x');
+  PatternDB *patterndb = pattern_db_new(NULL);
+  PDBCacheKey key;
+
+  pattern_db_set_cache_file(patterndb, cache_file);
+  cr_assert(pattern_db_reload_ruleset(patterndb, configuration, filename));
+  cr_assert(g_file_test(cache_file, G_FILE_TEST_IS_REGULAR), "cache file was not written");
+
+  /* same inode, size and mtime, only the cache can make this load succeed */
+  cr_assert(pdb_cache_key_stat(&key, filename, NULL));
+  _overwrite_file_in_place(filename, garbage, key.mtime, key.mtime_nsec);
+  cr_assert(pattern_db_reload_ruleset(patterndb, configuration, filename));
+  _assert_program_and_message_match(patterndb, "sshd 5", "almafa", "num", "5");
+
+  /* modified within the same second, the digest of the garbage does not match */
+  _overwrite_file_in_place(filename, garbage, key.mtime, (key.mtime_nsec + 1) % NSEC_PER_SEC);
+  cr_assert_not(pattern_db_reload_ruleset(patterndb, configuration, filename));
+
+  /* the mtime changed, the digest of the garbage does not match */
+  _overwrite_file_in_place(filename, garbage, key.mtime - 10, key.mtime_nsec);
+  cr_assert_not(pattern_db_reload_ruleset(patterndb, configuration, filename));
+
+  /* a changed file is parsed and cached again */
+  g_file_set_contents(filename, pdb_test_program_template, -1, NULL);
+  cr_assert(pattern_db_reload_ruleset(patterndb, configuration, filename));
+  _assert_program_and_message_match(patterndb, "sshd 5", "almafa kortefa", "str", "kortefa");
+  cr_assert(pattern_db_reload_ruleset(patterndb, configuration, filename));
+  _assert_program_and_message_match(patterndb, "sshd 5", "almafa kortefa", "str", "kortefa");
+
+  pattern_db_free(patterndb);
+  g_unlink(filename);
+  g_unlink(cache_file);
+  g_free(garbage);
+  g_free(cache_file);
+  g_free(filename);
+}
+
+Test(pattern_db, test_patterndb_cache_records_the_new_identity_of_an_unchanged_file)
+{
+  gchar *filename = _create_pdb_file(pdb_test_match_in_program);
+  gchar *cache_file = g_strdup_printf("%s.cache", filename);
+  gchar *garbage = g_strnfill(strlen(pdb_test_match_in_program), 'x');
+  PatternDB *patterndb = pattern_db_new(NULL);
+  PDBCacheKey key;
+
+  pattern_db_set_cache_file(patterndb, cache_file);
+  cr_assert(pattern_db_reload_ruleset(patterndb, configuration, filename));
+
+  /* only the mtime changed, the digest matches and the header is refreshed */
+  cr_assert(pdb_cache_key_stat(&key, filename, NULL));
+  _overwrite_file_in_place(filename, pdb_test_match_in_program, key.mtime - 10, key.mtime_nsec);
+  cr_assert(pattern_db_reload_ruleset(patterndb, configuration, filename));
+
+  /* the cache now trusts the new mtime without hashing the file */
+  _overwrite_file_in_place(filename, garbage, key.mtime - 10, key.mtime_nsec);
+  cr_assert(pattern_db_reload_ruleset(patterndb, configuration, filename));
+  _assert_program_and_message_match(patterndb, "sshd 5", "almafa", "num", "5");
+
+  pattern_db_free(patterndb);
+  g_unlink(filename);
+  g_unlink(cache_file);
+  g_free(garbage);
+  g_free(cache_file);
+  g_free(filename);
+}
+
+Test(pattern_db, test_patterndb_with_lots_of_programs_and_rules)
+{
+  const gint num_programs = 8;
+  const gint num_rules = 200;
+  GString *pdb = g_string_new("<patterndb version='5' pub_date='2010-02-22'>");
+
+  for (gint p = 0; p < num_programs; p++)
+    {
+      g_string_append_printf(pdb, "<ruleset name='prog%d' id='prog%d'><patterns><pattern>prog%d</pattern></patterns><rules>",
+                             p, p, p);
+      for (gint r = 0; r < num_rules; r++)
+        g_string_append_printf(pdb, "<rule id='rule-%d-%d' class='system' provider='test'><patterns>"
+                               "<pattern>event %d of prog%d @NUMBER:num@</pattern></patterns></rule>", r, p, r, p);
+      g_string_append(pdb, "</rules></ruleset>");
+    }
+  g_string_append(pdb, "</patterndb>");
+
+  gchar *filename = _create_pdb_file(pdb->str);
+  PatternDB *patterndb = pattern_db_new(NULL);
+
+  cr_assert(pattern_db_reload_ruleset(patterndb, configuration, filename));
+  for (gint p = 0; p < num_programs; p++)
+    {
+      gchar program[16], message[64], rule_id[32];
+
+      g_snprintf(program, sizeof(program), "prog%d", p);
+      g_snprintf(message, sizeof(message), "event %d of prog%d 42", num_rules - 1 - p, p);
+      g_snprintf(rule_id, sizeof(rule_id), "rule-%d-%d", num_rules - 1 - p, p);
+      _assert_program_and_message_match(patterndb, program, message, ".classifier.rule_id", rule_id);
+    }
+
+  LogMessage *msg = _construct_message("prog0", "event 1 of prog1 42");
+  cr_assert_not(pattern_db_process(patterndb, msg));
+  log_msg_unref(msg);
+
+  pattern_db_free(patterndb);
+  g_unlink(filename);
+  g_free(filename);
+  g_string_free(pdb, TRUE);
+}
+
 void setup(void)
 {
   app_startup();
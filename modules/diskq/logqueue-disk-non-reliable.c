@@ -99,15 +99,17 @@ static gboolean
 _serialize_and_write_message_to_disk(LogQueueDiskNonReliable *self, LogMessage *msg)
 {
   ScratchBuffersMarker marker;
-  GString *write_serialized = scratch_buffers_alloc_and_mark(&marker);
-  if (!log_queue_disk_serialize_msg(&self->super, msg, write_serialized))
+  GString *buffer = scratch_buffers_alloc_and_mark(&marker);
+  SerializeArchive *record = log_queue_disk_serialize_msg_vectored(&self->super, msg, buffer);
+  if (!record)
     {
       scratch_buffers_reclaim_marked(marker);
       return FALSE;
     }
 
-  gboolean success = qdisk_push_tail(self->super.qdisk, write_serialized);
+  gboolean success = qdisk_push_tail_vectored(self->super.qdisk, record);
 
+  serialize_archive_free(record);
   scratch_buffers_reclaim_marked(marker);
   return success;
 }
@@ -375,10 +377,10 @@ exit:
 }
 
 static gboolean
-_ensure_serialized_and_write_to_disk(LogQueueDiskNonReliable *self, LogMessage *msg, GString *serialized_msg)
+_ensure_serialized_and_write_to_disk(LogQueueDiskNonReliable *self, LogMessage *msg, SerializeArchive *serialized_msg)
 {
   if (serialized_msg)
-    return qdisk_push_tail(self->super.qdisk, serialized_msg);
+    return qdisk_push_tail_vectored(self->super.qdisk, serialized_msg);
 
   return _serialize_and_write_message_to_disk(self, msg);
 }
@@ -410,7 +412,7 @@ _push_tail_flow_control_window(LogQueueDiskNonReliable *self, LogMessage *msg, c
 
 static inline gboolean
 _push_tail_disk(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOptions *path_options,
-                GString *serialized_msg)
+                SerializeArchive *serialized_msg)
 {
   gboolean result = _ensure_serialized_and_write_to_disk(self, msg, serialized_msg);
   if (result)
@@ -430,12 +432,13 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
   LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
 
   ScratchBuffersMarker marker;
-  GString *serialized_msg = NULL;
+  SerializeArchive *serialized_msg = NULL;
 
   if (_is_msg_serialization_needed_hint(self))
     {
-      serialized_msg = scratch_buffers_alloc_and_mark(&marker);
-      if (!log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
+      GString *buffer = scratch_buffers_alloc_and_mark(&marker);
+      serialized_msg = log_queue_disk_serialize_msg_vectored(&self->super, msg, buffer);
+      if (!serialized_msg)
         {
           msg_error("Failed to serialize message for non-reliable disk-buffer, dropping message",
                     evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
@@ -484,7 +487,10 @@ queued:
 exit:
   g_mutex_unlock(&s->lock);
   if (serialized_msg)
-    scratch_buffers_reclaim_marked(marker);
+    {
+      serialize_archive_free(serialized_msg);
+      scratch_buffers_reclaim_marked(marker);
+    }
 }
 
 static void
@@ -332,8 +332,9 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
   LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
 
   ScratchBuffersMarker marker;
-  GString *serialized_msg = scratch_buffers_alloc_and_mark(&marker);
-  if (!log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
+  GString *buffer = scratch_buffers_alloc_and_mark(&marker);
+  SerializeArchive *serialized_msg = log_queue_disk_serialize_msg_vectored(&self->super, msg, buffer);
+  if (!serialized_msg)
     {
       msg_error("Failed to serialize message for reliable disk-buffer, dropping message",
                 evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
@@ -346,7 +347,9 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
   g_mutex_lock(&s->lock);
 
   gint64 message_position = qdisk_get_next_tail_position(self->super.qdisk);
-  if (!qdisk_push_tail(self->super.qdisk, serialized_msg))
+  gboolean pushed = qdisk_push_tail_vectored(self->super.qdisk, serialized_msg);
+  serialize_archive_free(serialized_msg);
+  if (!pushed)
     {
       EVTTAG *suggestion = NULL;
       if (path_options->flow_control_requested)
@@ -422,6 +422,27 @@ _serialize_msg(SerializeArchive *sa, gpointer user_data)
   return log_msg_serialize(msg, sa, self->compaction ? LMSF_COMPACTION : 0);
 }
 
+/* the NVTable of @msg is referenced by the returned record, which is
+ * written with qdisk_push_tail_vectored() and freed afterwards */
+SerializeArchive *
+log_queue_disk_serialize_msg_vectored(LogQueueDisk *self, LogMessage *msg, GString *buffer)
+{
+  gpointer user_data[] = { self, msg };
+  GError *error = NULL;
+
+  SerializeArchive *record = qdisk_serialize_vectored(buffer, _serialize_msg, user_data, &error);
+  if (!record)
+    {
+      msg_error("Error serializing message for the disk-queue file",
+                evt_tag_str("error", error->message),
+                evt_tag_str("persist-name", self->super.persist_name));
+      g_error_free(error);
+      return NULL;
+    }
+
+  return record;
+}
+
 gboolean
 log_queue_disk_serialize_msg(LogQueueDisk *self, LogMessage *msg, GString *serialized)
 {
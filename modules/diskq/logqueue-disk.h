@@ -75,6 +75,7 @@ LogMessage *log_queue_disk_read_message(LogQueueDisk *self, LogPathOptions *path
 LogMessage *log_queue_disk_peek_message(LogQueueDisk *self);
 void log_queue_disk_drop_message(LogQueueDisk *self, LogMessage *msg, const LogPathOptions *path_options);
 gboolean log_queue_disk_serialize_msg(LogQueueDisk *self, LogMessage *msg, GString *serialized);
+SerializeArchive *log_queue_disk_serialize_msg_vectored(LogQueueDisk *self, LogMessage *msg, GString *buffer);
 gboolean log_queue_disk_deserialize_msg(LogQueueDisk *self, GString *serialized, LogMessage **msg);
 
 #endif
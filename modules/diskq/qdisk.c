@@ -40,6 +40,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/file.h>
+#include <sys/uio.h>
 
 /* MADV_RANDOM not defined on legacy Linux systems. Could be removed in the
  * future, when support for Glibc 2.1.X drops.*/
@@ -138,6 +139,39 @@ pwrite_strict(gint fd, const void *buf, size_t count, off_t offset)
   return result;
 }
 
+static gboolean
+pwritev_strict(gint fd, const struct iovec *iov, gint iovcnt, off_t offset)
+{
+#ifdef SYSLOG_NG_HAVE_PWRITEV
+  size_t count = 0;
+  for (gint i = 0; i < iovcnt; i++)
+    count += iov[i].iov_len;
+
+  ssize_t written = pwritev(fd, iov, iovcnt, offset);
+  gboolean result = TRUE;
+  if (written != count)
+    {
+      if (written != -1)
+        {
+          msg_error("Short write while writing disk buffer",
+                    evt_tag_int("bytes_to_write", count),
+                    evt_tag_int("bytes_written", written));
+          errno = ENOSPC;
+        }
+      result = FALSE;
+    }
+  return result;
+#else
+  for (gint i = 0; i < iovcnt; i++)
+    {
+      if (!pwrite_strict(fd, iov[i].iov_base, iov[i].iov_len, offset))
+        return FALSE;
+      offset += iov[i].iov_len;
+    }
+  return TRUE;
+#endif
+}
+
 
 static inline gboolean
 _has_position_reached_max_size(QDisk *self, gint64 position)
@@ -687,8 +721,8 @@ qdisk_get_next_tail_position(QDisk *self)
   return self->hdr->write_head;
 }
 
-gboolean
-qdisk_push_tail(QDisk *self, GString *record)
+static gboolean
+_push_tail(QDisk *self, const struct iovec *iov, gint iovcnt, gsize record_len)
 {
   if (!qdisk_started(self))
     return FALSE;
@@ -703,17 +737,17 @@ qdisk_push_tail(QDisk *self, GString *record)
       self->hdr->write_head = QDISK_RESERVED_SPACE;
     }
 
-  if (!qdisk_is_space_avail(self, record->len))
+  if (!qdisk_is_space_avail(self, record_len))
     return FALSE;
 
-  if (!pwrite_strict(self->fd, record->str, record->len, self->hdr->write_head))
+  if (!pwritev_strict(self->fd, iov, iovcnt, self->hdr->write_head))
     {
       msg_error("Error writing disk-queue file",
                 evt_tag_error("error"));
       return FALSE;
     }
 
-  self->hdr->write_head = self->hdr->write_head + record->len;
+  self->hdr->write_head = self->hdr->write_head + record_len;
 
 
   /* NOTE: we only wrap around if the read head is before the write,
@@ -768,6 +802,24 @@ qdisk_push_tail(QDisk *self, GString *record)
   return TRUE;
 }
 
+gboolean
+qdisk_push_tail(QDisk *self, GString *record)
+{
+  struct iovec iov = { .iov_base = record->str, .iov_len = record->len };
+
+  return _push_tail(self, &iov, 1, record->len);
+}
+
+/* @record is an archive returned by qdisk_serialize_vectored() */
+gboolean
+qdisk_push_tail_vectored(QDisk *self, SerializeArchive *record)
+{
+  gint iovcnt;
+  const struct iovec *iov = serialize_iovec_archive_get_iovec(record, &iovcnt);
+
+  return _push_tail(self, iov, iovcnt, serialize_iovec_archive_get_length(record));
+}
+
 static inline gssize
 _read_record_length_from_disk(QDisk *self, gint64 position, guint32 *record_length)
 {
@@ -1048,6 +1100,48 @@ exit:
   return *error == NULL;
 }
 
+/*
+ * Same as qdisk_serialize(), but blocks that the serializer writes as
+ * borrowed (e.g. the NVTable of a message) are referenced instead of being
+ * copied into @buffer, they are written to the file straight from their
+ * original location by qdisk_push_tail_vectored().
+ *
+ * Returns the record as an archive that has to be freed once pushed, NULL
+ * on error.
+ */
+SerializeArchive *
+qdisk_serialize_vectored(GString *buffer, QDiskSerializeFunc serialize_func, gpointer user_data, GError **error)
+{
+  SerializeArchive *sa = serialize_iovec_archive_new(buffer);
+  gsize record_length_pos = buffer->len;
+
+  /* Leave space for the real record_length for later */
+  if (!serialize_write_uint32(sa, 0))
+    {
+      g_set_error(error, QDISK_ERROR, QDISK_ERROR_SERIALIZE, "failed to write record length");
+      goto error;
+    }
+
+  if (!serialize_func(sa, user_data))
+    {
+      g_set_error(error, QDISK_ERROR, QDISK_ERROR_SERIALIZE, "failed to serialize data");
+      goto error;
+    }
+
+  guint32 record_length = GUINT32_TO_BE(serialize_iovec_archive_get_length(sa) - sizeof(guint32));
+  if (record_length == 0)
+    {
+      g_set_error(error, QDISK_ERROR, QDISK_ERROR_SERIALIZE, "serializable data is empty");
+      goto error;
+    }
+  g_string_overwrite_len(buffer, record_length_pos, (gchar *) &record_length, sizeof(guint32));
+  return sa;
+
+error:
+  serialize_archive_free(sa);
+  return NULL;
+}
+
 gboolean
 qdisk_deserialize(GString *serialized, QDiskDeSerializeFunc deserialize_func, gpointer user_data, GError **error)
 {
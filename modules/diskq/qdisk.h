@@ -61,6 +61,7 @@ gint64 qdisk_get_max_useful_space(QDisk *self);
 gint64 qdisk_get_empty_space(QDisk *self);
 gint64 qdisk_get_used_useful_space(QDisk *self);
 gboolean qdisk_push_tail(QDisk *self, GString *record);
+gboolean qdisk_push_tail_vectored(QDisk *self, SerializeArchive *record);
 gboolean qdisk_pop_head(QDisk *self, GString *record);
 gboolean qdisk_peek_head(QDisk *self, GString *record);
 gboolean qdisk_remove_head(QDisk *self);
@@ -92,6 +93,8 @@ gboolean qdisk_is_file_a_disk_buffer_file(const gchar *filename);
 gboolean qdisk_is_disk_buffer_file_reliable(const gchar *filename, gboolean *reliable);
 
 gboolean qdisk_serialize(GString *serialized, QDiskSerializeFunc serialize_func, gpointer user_data, GError **error);
+SerializeArchive *qdisk_serialize_vectored(GString *buffer, QDiskSerializeFunc serialize_func, gpointer user_data,
+                                           GError **error);
 gboolean qdisk_deserialize(GString *serialized, QDiskDeSerializeFunc deserialize_func, gpointer user_data,
                            GError **error);
 
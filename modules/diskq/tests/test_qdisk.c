@@ -166,6 +166,54 @@ Test(qdisk, qdisk_basic_push_pop)
   cleanup_qdisk(filename, qdisk);
 }
 
+static void
+_release_nothing(gpointer owner)
+{
+}
+
+static gboolean
+_serialize_borrowed_dummy_payload(SerializeArchive *sa, gpointer user_data)
+{
+  GString *data = (GString *) user_data;
+
+  serialize_archive_write_bytes(sa, data->str, 16);
+  return serialize_write_blob_borrowed(sa, data->str + 16, data->len - 16, NULL, _release_nothing);
+}
+
+Test(qdisk, qdisk_vectored_push_pop)
+{
+  const gchar *filename = "test_qdisk_vectored_push_pop.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint expected_record_len = 128;
+  GString *data = g_string_new(NULL);
+  for (guint i = 0; i < expected_record_len; ++i)
+    g_string_append_c(data, DUMMY_RECORD_PATTERN);
+
+  GString *buffer = g_string_new(NULL);
+  GError *error = NULL;
+  SerializeArchive *record = qdisk_serialize_vectored(buffer, _serialize_borrowed_dummy_payload, data, &error);
+  cr_assert_not_null(record);
+  cr_assert_eq(buffer->len, FRAME_LENGTH + 16, "the borrowed part of the record must not be copied");
+
+  gint64 write_head = qdisk_get_writer_head(qdisk);
+  cr_assert(qdisk_push_tail_vectored(qdisk, record));
+  cr_assert_eq(qdisk_get_writer_head(qdisk), write_head + FRAME_LENGTH + expected_record_len);
+  cr_assert_eq(qdisk_get_length(qdisk), 1);
+  serialize_archive_free(record);
+
+  GString *popped_data = g_string_new(NULL);
+  cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+  assert_dummy_record(popped_data, expected_record_len);
+
+  g_string_free(popped_data, TRUE);
+  g_string_free(buffer, TRUE);
+  g_string_free(data, TRUE);
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
 Test(qdisk, qdisk_is_space_avail)
 {
   const gchar *filename = "test_qdisk_is_space_avail.rqf";
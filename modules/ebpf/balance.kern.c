@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/*
+ * Flow-affine reuseport steering.
+ *
+ * These programs are attached to a SO_REUSEPORT group with
+ * SO_ATTACH_REUSEPORT_EBPF, their return value is the index of the
+ * socket (in bind order) that should receive the packet.  Unlike
+ * random_choice(), the same sender is always steered to the same socket
+ * (and thus the same syslog-ng thread), as long as the number of sockets
+ * does not change.
+ *
+ * By the time the program runs, the transport header has already been
+ * pulled from the skb, so addresses and ports are loaded relative to the
+ * network header.
+ */
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_endian.h>
+
+#define ETH_P_IP    0x0800
+#define ETH_P_IPV6  0x86DD
+#define IPPROTO_TCP 6
+#define IPPROTO_UDP 17
+
+/* keep in sync with EBPF_REUSEPORT_MAX_SOCKETS in ebpf-reuseport.c */
+#define MAX_SOCKETS 64
+
+int number_of_sockets;
+__u64 backlog_threshold;
+
+/* per-socket receive backlog, indexed by position in the reuseport group,
+ * periodically updated by syslog-ng */
+struct
+{
+  __uint(type, BPF_MAP_TYPE_ARRAY);
+  __uint(max_entries, MAX_SOCKETS);
+  __type(key, __u32);
+  __type(value, __u64);
+} socket_backlog SEC(".maps");
+
+/* murmur3 mixing steps */
+static __always_inline __u32
+_hash_mix(__u32 h, __u32 v)
+{
+  v *= 0xcc9e2d51;
+  v = (v << 15) | (v >> 17);
+  v *= 0x1b873593;
+
+  h ^= v;
+  h = (h << 13) | (h >> 19);
+  return h * 5 + 0xe6546b64;
+}
+
+static __always_inline __u32
+_hash_final(__u32 h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+/* hashes the source address, or the full 4-tuple if include_flow is set */
+static __always_inline int
+_hash_packet(struct __sk_buff *skb, int include_flow, __u32 *hash)
+{
+  __u32 ports_offset;
+  __u32 ports;
+  __u32 h = 0;
+
+  if (skb->protocol == bpf_htons(ETH_P_IP))
+    {
+      struct iphdr iph;
+
+      if (bpf_skb_load_bytes_relative(skb, 0, &iph, sizeof(iph), BPF_HDR_START_NET) < 0)
+        return -1;
+
+      h = _hash_mix(h, iph.saddr);
+      if (!include_flow)
+        goto exit;
+
+      h = _hash_mix(h, iph.daddr);
+      h = _hash_mix(h, iph.protocol);
+      ports_offset = iph.ihl * 4;
+    }
+  else if (skb->protocol == bpf_htons(ETH_P_IPV6))
+    {
+      struct ipv6hdr ip6h;
+
+      if (bpf_skb_load_bytes_relative(skb, 0, &ip6h, sizeof(ip6h), BPF_HDR_START_NET) < 0)
+        return -1;
+
+      for (int i = 0; i < 4; i++)
+        h = _hash_mix(h, ip6h.saddr.in6_u.u6_addr32[i]);
+      if (!include_flow)
+        goto exit;
+
+      for (int i = 0; i < 4; i++)
+        h = _hash_mix(h, ip6h.daddr.in6_u.u6_addr32[i]);
+      h = _hash_mix(h, ip6h.nexthdr);
+
+      /* extension headers are not followed, those flows are hashed by address only */
+      if (ip6h.nexthdr != IPPROTO_TCP && ip6h.nexthdr != IPPROTO_UDP)
+        goto exit;
+      ports_offset = sizeof(ip6h);
+    }
+  else
+    {
+      return -1;
+    }
+
+  /* source and destination ports, as a single word */
+  if (bpf_skb_load_bytes_relative(skb, ports_offset, &ports, sizeof(ports), BPF_HDR_START_NET) == 0)
+    h = _hash_mix(h, ports);
+
+exit:
+  *hash = _hash_final(h);
+  return 0;
+}
+
+static __always_inline int
+_choose_by_hash(struct __sk_buff *skb, int include_flow)
+{
+  __u32 hash;
+
+  if (number_of_sockets <= 0)
+    return -1;
+
+  if (_hash_packet(skb, include_flow, &hash) < 0)
+    hash = bpf_get_prandom_u32();
+  return hash % number_of_sockets;
+}
+
+SEC("socket")
+int source_ip_choice(struct __sk_buff *skb)
+{
+  return _choose_by_hash(skb, 0);
+}
+
+SEC("socket")
+int flow_choice(struct __sk_buff *skb)
+{
+  return _choose_by_hash(skb, 1);
+}
+
+/*
+ * Flows stay on the socket chosen by their 4-tuple hash, unless that
+ * socket's backlog is above backlog_threshold, in which case the packet
+ * goes to the least loaded socket.  If backlogs are not updated (e.g. all
+ * zero), this is equivalent to flow_choice().
+ */
+SEC("socket")
+int least_backlog_choice(struct __sk_buff *skb)
+{
+  __u32 preferred;
+  __u64 *backlog;
+  __u64 best_backlog;
+  int best;
+
+  best = _choose_by_hash(skb, 1);
+  if (best < 0)
+    return best;
+
+  preferred = best;
+  backlog = bpf_map_lookup_elem(&socket_backlog, &preferred);
+  if (!backlog || *backlog <= backlog_threshold)
+    return best;
+
+  best_backlog = *backlog;
+  for (__u32 i = 0; i < MAX_SOCKETS; i++)
+    {
+      __u32 index = i;
+
+      if (i >= number_of_sockets)
+        break;
+
+      backlog = bpf_map_lookup_elem(&socket_backlog, &index);
+      if (backlog && *backlog < best_backlog)
+        {
+          best = i;
+          best_backlog = *backlog;
+        }
+    }
+  return best;
+}
+
+char LICENSE[] SEC("license") = "GPL";
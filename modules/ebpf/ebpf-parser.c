@@ -33,6 +33,8 @@ static CfgLexerKeyword ebpf_keywords[] =
   { "ebpf", KW_EBPF },
   { "reuseport", KW_REUSEPORT },
   { "sockets", KW_SOCKETS },
+  { "mode", KW_MODE },
+  { "backlog_threshold", KW_BACKLOG_THRESHOLD },
   { NULL }
 };
 
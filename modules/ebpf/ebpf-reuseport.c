@@ -21,15 +21,53 @@
  */
 #include "ebpf-reuseport.h"
 #include "modules/afsocket/afsocket-signals.h"
+#include "gsockaddr.h"
+#include "messages.h"
+#include "timeutils/misc.h"
+
+#include <bpf/bpf.h>
+#include <linux/sock_diag.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <iv.h>
+
+/* keep in sync with MAX_SOCKETS in balance.kern.c */
+#define EBPF_REUSEPORT_MAX_SOCKETS 64
+#define EBPF_REUSEPORT_BACKLOG_UPDATE_MSEC 100
+
+/*
+ * Sockets bound to the same address form a single reuseport group in the
+ * kernel, even if they belong to different source drivers (and thus
+ * different plugin instances).  The flow-affine programs share one
+ * skeleton per group, so that the backlog map covers all of the group's
+ * sockets.  Our socket array mirrors the kernel's: sockets are appended in
+ * bind order and removal moves the last socket into the freed slot.
+ */
+typedef struct _EBPFReusePortGroup
+{
+  gint ref_cnt;
+  gchar *name;
+  struct balance_kern *balance;
+  GArray *sockets;
+  struct iv_timer backlog_timer;
+} EBPFReusePortGroup;
 
 typedef struct _EBPFReusePort
 {
   LogDriverPlugin super;
   struct random_kern *random;
   gint number_of_sockets;
+  EBPFReusePortMode mode;
+  guint64 backlog_threshold;
+  EBPFReusePortGroup *group;
+  gint sock;
 } EBPFReusePort;
 
 #include "random.skel.c"
+#include "balance.skel.c"
+
+static GHashTable *reuseport_groups;
 
 void
 ebpf_reuseport_set_sockets(LogDriverPlugin *s, gint number_of_sockets)
@@ -38,10 +76,297 @@ ebpf_reuseport_set_sockets(LogDriverPlugin *s, gint number_of_sockets)
   self->number_of_sockets = number_of_sockets;
 }
 
+gboolean
+ebpf_reuseport_set_mode(LogDriverPlugin *s, const gchar *mode)
+{
+  EBPFReusePort *self = (EBPFReusePort *) s;
+
+  if (strcmp(mode, "random") == 0)
+    self->mode = EBPF_REUSEPORT_RANDOM;
+  else if (strcmp(mode, "source-ip") == 0 || strcmp(mode, "source_ip") == 0)
+    self->mode = EBPF_REUSEPORT_SOURCE_IP;
+  else if (strcmp(mode, "flow") == 0)
+    self->mode = EBPF_REUSEPORT_FLOW;
+  else if (strcmp(mode, "least-backlog") == 0 || strcmp(mode, "least_backlog") == 0)
+    self->mode = EBPF_REUSEPORT_LEAST_BACKLOG;
+  else
+    return FALSE;
+  return TRUE;
+}
+
+void
+ebpf_reuseport_set_backlog_threshold(LogDriverPlugin *s, guint64 backlog_threshold)
+{
+  EBPFReusePort *self = (EBPFReusePort *) s;
+  self->backlog_threshold = backlog_threshold;
+}
+
+/* EBPFReusePortGroup */
+
+static guint64
+_query_socket_backlog(gint sock)
+{
+  gint sock_type;
+  socklen_t len = sizeof(sock_type);
+
+  if (getsockopt(sock, SOL_SOCKET, SO_TYPE, &sock_type, &len) < 0)
+    return 0;
+
+  if (sock_type == SOCK_STREAM)
+    {
+      /* for listening sockets, tcpi_unacked is the current length of the accept queue */
+      struct tcp_info info;
+
+      len = sizeof(info);
+      if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &info, &len) < 0)
+        return 0;
+      return info.tcpi_unacked;
+    }
+
+  guint32 meminfo[SK_MEMINFO_VARS];
+
+  len = sizeof(meminfo);
+  if (getsockopt(sock, SOL_SOCKET, SO_MEMINFO, meminfo, &len) < 0)
+    return 0;
+  return meminfo[SK_MEMINFO_RMEM_ALLOC];
+}
+
+static void
+_group_update_backlog_map(EBPFReusePortGroup *self)
+{
+  gint map_fd = bpf_map__fd(self->balance->maps.socket_backlog);
+
+  for (guint32 i = 0; i < self->sockets->len; i++)
+    {
+      guint64 backlog = _query_socket_backlog(g_array_index(self->sockets, gint, i));
+
+      bpf_map_update_elem(map_fd, &i, &backlog, BPF_ANY);
+    }
+}
+
+/* the whole map is cleared: by the time the group is freed, its sockets
+ * have already left it */
+static void
+_group_clear_backlog_map(EBPFReusePortGroup *self)
+{
+  gint map_fd = bpf_map__fd(self->balance->maps.socket_backlog);
+  guint64 backlog = 0;
+
+  for (guint32 i = 0; i < EBPF_REUSEPORT_MAX_SOCKETS; i++)
+    bpf_map_update_elem(map_fd, &i, &backlog, BPF_ANY);
+}
+
+static void
+_group_start_backlog_timer(EBPFReusePortGroup *self)
+{
+  iv_validate_now();
+  self->backlog_timer.expires = iv_now;
+  timespec_add_msec(&self->backlog_timer.expires, EBPF_REUSEPORT_BACKLOG_UPDATE_MSEC);
+  iv_timer_register(&self->backlog_timer);
+}
+
+static void
+_group_backlog_timer_elapsed(gpointer s)
+{
+  EBPFReusePortGroup *self = (EBPFReusePortGroup *) s;
+
+  _group_update_backlog_map(self);
+  _group_start_backlog_timer(self);
+}
+
+static gchar *
+_format_group_name(gint sock)
+{
+  struct sockaddr_storage ss;
+  socklen_t ss_len = sizeof(ss);
+  gint sock_type;
+  socklen_t len = sizeof(sock_type);
+  gchar buf[256];
+
+  if (getsockname(sock, (struct sockaddr *) &ss, &ss_len) < 0 ||
+      getsockopt(sock, SOL_SOCKET, SO_TYPE, &sock_type, &len) < 0)
+    return NULL;
+
+  GSockAddr *addr = g_sockaddr_new((struct sockaddr *) &ss, ss_len);
+  if (!addr)
+    return NULL;
+
+  g_sockaddr_format(addr, buf, sizeof(buf), GSA_FULL);
+  g_sockaddr_unref(addr);
+  return g_strdup_printf("%s,type=%d", buf, sock_type);
+}
+
+static EBPFReusePortGroup *
+_group_new(gchar *name)
+{
+  EBPFReusePortGroup *self = g_new0(EBPFReusePortGroup, 1);
+
+  self->balance = balance_kern__open_and_load();
+  if (!self->balance)
+    {
+      msg_error("ebpf-reuseport(): Unable to load eBPF program to the kernel");
+      g_free(self);
+      return NULL;
+    }
+
+  self->ref_cnt = 1;
+  self->name = name;
+  self->sockets = g_array_new(FALSE, FALSE, sizeof(gint));
+  IV_TIMER_INIT(&self->backlog_timer);
+  self->backlog_timer.cookie = self;
+  self->backlog_timer.handler = _group_backlog_timer_elapsed;
+  return self;
+}
+
+static void
+_group_free(EBPFReusePortGroup *self)
+{
+  if (iv_timer_registered(&self->backlog_timer))
+    iv_timer_unregister(&self->backlog_timer);
+
+  /* sockets kept open across a reload keep the program (and its map)
+   * attached, zero backlogs make it fall back to plain flow hashing */
+  _group_clear_backlog_map(self);
+  balance_kern__destroy(self->balance);
+  g_array_free(self->sockets, TRUE);
+  g_free(self->name);
+  g_free(self);
+}
+
+static EBPFReusePortGroup *
+_group_join(gint sock)
+{
+  gchar *name = _format_group_name(sock);
+  EBPFReusePortGroup *self;
+
+  if (!name)
+    {
+      msg_error("ebpf-reuseport(): Unable to query the address of the reuseport socket",
+                evt_tag_errno("error", errno));
+      return NULL;
+    }
+
+  if (!reuseport_groups)
+    reuseport_groups = g_hash_table_new(g_str_hash, g_str_equal);
+
+  self = g_hash_table_lookup(reuseport_groups, name);
+  if (self)
+    {
+      self->ref_cnt++;
+      g_free(name);
+    }
+  else
+    {
+      self = _group_new(name);
+      if (!self)
+        {
+          g_free(name);
+          return NULL;
+        }
+      g_hash_table_insert(reuseport_groups, self->name, self);
+    }
+
+  if (self->sockets->len >= EBPF_REUSEPORT_MAX_SOCKETS)
+    msg_warning("ebpf-reuseport(): Too many sockets in reuseport group, backlog of the extra sockets is not tracked",
+                evt_tag_str("group", self->name),
+                evt_tag_int("max_sockets", EBPF_REUSEPORT_MAX_SOCKETS));
+  g_array_append_val(self->sockets, sock);
+  return self;
+}
+
+static void
+_group_leave(EBPFReusePortGroup *self, gint sock)
+{
+  for (guint i = 0; i < self->sockets->len; i++)
+    {
+      if (g_array_index(self->sockets, gint, i) == sock)
+        {
+          g_array_remove_index_fast(self->sockets, i);
+          break;
+        }
+    }
+
+  if (--self->ref_cnt > 0)
+    return;
+
+  g_hash_table_remove(reuseport_groups, self->name);
+  if (g_hash_table_size(reuseport_groups) == 0)
+    {
+      g_hash_table_destroy(reuseport_groups);
+      reuseport_groups = NULL;
+    }
+  _group_free(self);
+}
+
+/* EBPFReusePort */
+
+static const gchar *
+_format_mode(EBPFReusePortMode mode)
+{
+  switch (mode)
+    {
+    case EBPF_REUSEPORT_RANDOM:
+      return "random";
+    case EBPF_REUSEPORT_SOURCE_IP:
+      return "source-ip";
+    case EBPF_REUSEPORT_FLOW:
+      return "flow";
+    case EBPF_REUSEPORT_LEAST_BACKLOG:
+      return "least-backlog";
+    default:
+      g_assert_not_reached();
+    }
+}
+
+static gint
+_get_program_fd(EBPFReusePort *self)
+{
+  switch (self->mode)
+    {
+    case EBPF_REUSEPORT_RANDOM:
+      return bpf_program__fd(self->random->progs.random_choice);
+    case EBPF_REUSEPORT_SOURCE_IP:
+      return bpf_program__fd(self->group->balance->progs.source_ip_choice);
+    case EBPF_REUSEPORT_FLOW:
+      return bpf_program__fd(self->group->balance->progs.flow_choice);
+    case EBPF_REUSEPORT_LEAST_BACKLOG:
+      return bpf_program__fd(self->group->balance->progs.least_backlog_choice);
+    default:
+      g_assert_not_reached();
+    }
+}
+
+static gboolean
+_setup_balance_group(EBPFReusePort *self, gint sock)
+{
+  if (self->group)
+    {
+      _group_leave(self->group, self->sock);
+      self->group = NULL;
+    }
+
+  self->group = _group_join(sock);
+  if (!self->group)
+    return FALSE;
+  self->sock = sock;
+
+  /* the program attached last is used by the whole reuseport group, the
+   * same applies to its parameters */
+  self->group->balance->bss->number_of_sockets = self->number_of_sockets;
+  self->group->balance->bss->backlog_threshold = self->backlog_threshold;
+
+  if (self->mode == EBPF_REUSEPORT_LEAST_BACKLOG && !iv_timer_registered(&self->group->backlog_timer))
+    _group_start_backlog_timer(self->group);
+  return TRUE;
+}
+
 static void
 _slot_setup_socket(EBPFReusePort *self, AFSocketSetupSocketSignalData *data)
 {
-  int bpf_fd = bpf_program__fd(self->random->progs.random_choice);
+  if (self->mode != EBPF_REUSEPORT_RANDOM && !_setup_balance_group(self, data->sock))
+    goto error;
+
+  int bpf_fd = _get_program_fd(self);
   if (bpf_fd < 0)
     {
       msg_error("ebpf-reuseport(): setsockopt(SO_ATTACH_REUSEPORT_EBPF) returned error",
@@ -56,8 +381,9 @@ _slot_setup_socket(EBPFReusePort *self, AFSocketSetupSocketSignalData *data)
       goto error;
     }
 
-  msg_debug("ebpf-reuseport(): eBPF reuseport group randomizer applied",
-            evt_tag_int("sock", data->sock));
+  msg_debug("ebpf-reuseport(): eBPF reuseport group steering applied",
+            evt_tag_int("sock", data->sock),
+            evt_tag_str("mode", _format_mode(self->mode)));
   return;
 error:
   data->failure = TRUE;
@@ -68,13 +394,22 @@ _attach(LogDriverPlugin *s, LogDriver *driver)
 {
   EBPFReusePort *self = (EBPFReusePort *)s;
 
-  self->random = random_kern__open_and_load();
-  if (!self->random)
+  if (self->mode == EBPF_REUSEPORT_RANDOM)
     {
-      msg_error("ebpf-reuseport(): Unable to load eBPF program to the kernel");
-      return FALSE;
+      self->random = random_kern__open_and_load();
+      if (!self->random)
+        {
+          msg_error("ebpf-reuseport(): Unable to load eBPF program to the kernel");
+          return FALSE;
+        }
+      self->random->bss->number_of_sockets = self->number_of_sockets;
+    }
+  else if (self->number_of_sockets > EBPF_REUSEPORT_MAX_SOCKETS && self->mode == EBPF_REUSEPORT_LEAST_BACKLOG)
+    {
+      msg_warning("ebpf-reuseport(): sockets() is larger than the number of sockets whose backlog is tracked",
+                  evt_tag_int("sockets", self->number_of_sockets),
+                  evt_tag_int("max_sockets", EBPF_REUSEPORT_MAX_SOCKETS));
     }
-  self->random->bss->number_of_sockets = self->number_of_sockets;
 
   SignalSlotConnector *ssc = driver->super.signal_slot_connector;
   CONNECT(ssc, signal_afsocket_setup_socket, _slot_setup_socket, self);
@@ -89,6 +424,13 @@ _detach(LogDriverPlugin *s, LogDriver *driver)
 
   SignalSlotConnector *ssc = driver->super.signal_slot_connector;
   DISCONNECT(ssc, signal_afsocket_setup_socket, _slot_setup_socket, self);
+
+  if (self->group)
+    {
+      _group_leave(self->group, self->sock);
+      self->group = NULL;
+      self->sock = -1;
+    }
 }
 
 static void
@@ -111,6 +453,8 @@ ebpf_reuseport_new(void)
   self->super.detach = _detach;
   self->super.free_fn = _free;
   self->number_of_sockets = 0;
+  self->mode = EBPF_REUSEPORT_RANDOM;
+  self->sock = -1;
 
   return &self->super;
 }
@@ -25,7 +25,17 @@
 
 #include "driver.h"
 
+typedef enum
+{
+  EBPF_REUSEPORT_RANDOM,
+  EBPF_REUSEPORT_SOURCE_IP,
+  EBPF_REUSEPORT_FLOW,
+  EBPF_REUSEPORT_LEAST_BACKLOG,
+} EBPFReusePortMode;
+
 void ebpf_reuseport_set_sockets(LogDriverPlugin *s, gint number_of_sockets);
+gboolean ebpf_reuseport_set_mode(LogDriverPlugin *s, const gchar *mode);
+void ebpf_reuseport_set_backlog_threshold(LogDriverPlugin *s, guint64 backlog_threshold);
 LogDriverPlugin *ebpf_reuseport_new(void);
 
 #endif
@@ -0,0 +1,169 @@
+#!/bin/sh
+#############################################################################
+# Copyright (c) 2024 Axoflow
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License version 2 as published
+# by the Free Software Foundation, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As an additional exemption you are allowed to compile & link against the
+# OpenSSL libraries as published by the OpenSSL project. See the file
+# COPYING for details.
+#
+#############################################################################
+#
+# Test harness for the ebpf(reuseport()) steering programs.
+#
+# Starts syslog-ng with a number of udp() sources sharing the same port via
+# SO_REUSEPORT, sends messages from several senders and checks that every
+# sender ended up on exactly one socket (flow affinity).
+#
+# By default the receiver and the senders are placed into separate network
+# namespaces connected by a veth pair, each sender using its own source
+# address.  With --loopback everything runs in a single namespace over
+# 127.0.0.1 and senders differ in their source port only (the source-ip
+# mode is meaningless there).
+#
+# Requires root (network namespaces, CAP_BPF), iproute2 and python3.
+#
+# Usage: reuseport-harness.sh [--loopback] [--mode MODE] [--sockets N] [--senders N] [SYSLOG_NG]
+#
+
+set -e
+
+MODE=flow
+SOCKETS=4
+SENDERS=16
+MESSAGES=200
+LOOPBACK=0
+PORT=5514
+
+while [ $# -gt 0 ]; do
+	case "$1" in
+	--loopback) LOOPBACK=1 ;;
+	--mode) MODE="$2"; shift ;;
+	--sockets) SOCKETS="$2"; shift ;;
+	--senders) SENDERS="$2"; shift ;;
+	--messages) MESSAGES="$2"; shift ;;
+	*) break ;;
+	esac
+	shift
+done
+
+SYSLOG_NG="${1:-syslog-ng}"
+NS_RECV="sngebpf-recv-$$"
+NS_SEND="sngebpf-send-$$"
+WORKDIR=$(mktemp -d)
+
+cleanup()
+{
+	[ -f "$WORKDIR/syslog-ng.pid" ] && kill "$(cat "$WORKDIR/syslog-ng.pid")" 2>/dev/null || true
+	ip netns del "$NS_RECV" 2>/dev/null || true
+	ip netns del "$NS_SEND" 2>/dev/null || true
+	rm -rf "$WORKDIR"
+}
+trap cleanup EXIT
+
+if [ "$(id -u)" != "0" ]; then
+	echo "SKIP: the reuseport harness needs root privileges"
+	exit 77
+fi
+
+ip netns add "$NS_RECV"
+ip -n "$NS_RECV" link set lo up
+
+if [ "$LOOPBACK" = "1" ]; then
+	NS_SEND="$NS_RECV"
+	RECV_ADDR=127.0.0.1
+else
+	RECV_ADDR=10.199.0.1
+	ip netns add "$NS_SEND"
+	ip -n "$NS_SEND" link set lo up
+	ip link add veth-sng0 netns "$NS_RECV" type veth peer name veth-sng1 netns "$NS_SEND"
+	ip -n "$NS_RECV" addr add "$RECV_ADDR/16" dev veth-sng0
+	ip -n "$NS_RECV" link set veth-sng0 up
+	i=0
+	while [ $i -lt "$SENDERS" ]; do
+		ip -n "$NS_SEND" addr add "10.199.1.$((i + 1))/16" dev veth-sng1
+		i=$((i + 1))
+	done
+	ip -n "$NS_SEND" link set veth-sng1 up
+fi
+
+# one source per socket in the reuseport group, the source name tells us
+# which socket received the message
+{
+	echo "@version: current"
+	echo "options { stats(level(1)); };"
+	i=0
+	while [ $i -lt "$SOCKETS" ]; do
+		cat <<EOC
+source s_udp$i {
+  udp(ip("$RECV_ADDR") port($PORT) so-reuseport(yes) persist-name("udp$i")
+      ebpf(reuseport(sockets($SOCKETS) mode("$MODE"))));
+};
+destination d_udp$i { file("$WORKDIR/socket$i.log" template("\${PROGRAM}\n")); };
+log { source(s_udp$i); destination(d_udp$i); };
+EOC
+		i=$((i + 1))
+	done
+} > "$WORKDIR/syslog-ng.conf"
+
+ip netns exec "$NS_RECV" "$SYSLOG_NG" -F -f "$WORKDIR/syslog-ng.conf" \
+	--persist-file "$WORKDIR/syslog-ng.persist" --pidfile "$WORKDIR/syslog-ng.pid" --control "$WORKDIR/syslog-ng.ctl" \
+	> "$WORKDIR/syslog-ng.out" 2>&1 &
+sleep 2
+
+ip netns exec "$NS_SEND" python3 - "$LOOPBACK" "$RECV_ADDR" "$PORT" "$SENDERS" "$MESSAGES" <<'EOP'
+import socket
+import sys
+
+loopback, addr, port, senders, messages = sys.argv[1] == "1", sys.argv[2], int(sys.argv[3]), int(sys.argv[4]), int(sys.argv[5])
+socks = []
+for i in range(senders):
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.bind(("127.0.0.1" if loopback else "10.199.1.%d" % (i + 1), 0))
+    socks.append(s)
+
+for n in range(messages):
+    for i, s in enumerate(socks):
+        s.sendto(b"<13>Jan  1 00:00:00 host sender%d: message %d" % (i, n), (addr, port))
+EOP
+sleep 2
+
+
+failed=0
+used_sockets=0
+for f in "$WORKDIR"/socket*.log; do
+	[ -s "$f" ] && used_sockets=$((used_sockets + 1))
+done
+
+i=0
+while [ $i -lt "$SENDERS" ]; do
+	hits=$(grep -l -x "sender$i" "$WORKDIR"/socket*.log 2>/dev/null | wc -l)
+	received=$(cat "$WORKDIR"/socket*.log 2>/dev/null | grep -c -x "sender$i" || true)
+	if [ "$MODE" != "random" ] && [ "$hits" -ne 1 ]; then
+		echo "FAIL: sender$i was spread across $hits sockets"
+		failed=1
+	fi
+	if [ "$received" -ne "$MESSAGES" ]; then
+		echo "WARNING: sender$i: $received of $MESSAGES messages received"
+	fi
+	i=$((i + 1))
+done
+
+echo "mode=$MODE sockets=$SOCKETS senders=$SENDERS used_sockets=$used_sockets"
+if [ "$failed" != "0" ]; then
+	cat "$WORKDIR/syslog-ng.out"
+	exit 1
+fi
+echo "PASS"
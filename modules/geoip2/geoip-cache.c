@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "geoip-cache.h"
+#include "atomic.h"
+
+#include <string.h>
+
+typedef struct _GeoIPResultValue
+{
+  NVHandle handle;
+  gsize value_offset;
+  gsize value_len;
+} GeoIPResultValue;
+
+struct _GeoIPResult
+{
+  GAtomicCounter ref_cnt;
+  GArray *values;
+  GString *buffer;
+};
+
+GeoIPResult *
+geoip_result_new(void)
+{
+  GeoIPResult *self = g_new0(GeoIPResult, 1);
+
+  g_atomic_counter_set(&self->ref_cnt, 1);
+  self->values = g_array_new(FALSE, FALSE, sizeof(GeoIPResultValue));
+  self->buffer = g_string_sized_new(256);
+  return self;
+}
+
+GeoIPResult *
+geoip_result_ref(GeoIPResult *self)
+{
+  g_assert(g_atomic_counter_get(&self->ref_cnt) > 0);
+  g_atomic_counter_inc(&self->ref_cnt);
+  return self;
+}
+
+void
+geoip_result_unref(GeoIPResult *self)
+{
+  g_assert(g_atomic_counter_get(&self->ref_cnt) > 0);
+  if (g_atomic_counter_dec_and_test(&self->ref_cnt))
+    {
+      g_array_free(self->values, TRUE);
+      g_string_free(self->buffer, TRUE);
+      g_free(self);
+    }
+}
+
+void
+geoip_result_add_value(GeoIPResult *self, const gchar *name, const gchar *value, gssize value_len)
+{
+  if (value_len < 0)
+    value_len = strlen(value);
+
+  GeoIPResultValue v =
+  {
+    .handle = log_msg_get_value_handle(name),
+    .value_offset = self->buffer->len,
+    .value_len = value_len,
+  };
+
+  g_string_append_len(self->buffer, value, value_len);
+  g_array_append_val(self->values, v);
+}
+
+void
+geoip_result_apply(GeoIPResult *self, LogMessage *msg)
+{
+  for (guint i = 0; i < self->values->len; i++)
+    {
+      GeoIPResultValue *v = &g_array_index(self->values, GeoIPResultValue, i);
+
+      log_msg_set_value(msg, v->handle, self->buffer->str + v->value_offset, v->value_len);
+    }
+}
+
+guint
+geoip_result_get_number_of_values(GeoIPResult *self)
+{
+  return self->values->len;
+}
+
+typedef struct _GeoIPCacheEntry
+{
+  gchar *key;
+  GeoIPResult *result;
+} GeoIPCacheEntry;
+
+struct _GeoIPCache
+{
+  GMutex lock;
+  guint capacity;
+  /* key -> GList link within lru, the most recently used entry is at the head */
+  GHashTable *entries;
+  GQueue lru;
+};
+
+static void
+_entry_free(GeoIPCacheEntry *entry)
+{
+  geoip_result_unref(entry->result);
+  g_free(entry->key);
+  g_free(entry);
+}
+
+static void
+_evict_least_recently_used(GeoIPCache *self)
+{
+  GList *link = g_queue_pop_tail_link(&self->lru);
+  GeoIPCacheEntry *entry = (GeoIPCacheEntry *) link->data;
+
+  g_hash_table_remove(self->entries, entry->key);
+  _entry_free(entry);
+  g_list_free_1(link);
+}
+
+GeoIPResult *
+geoip_cache_lookup(GeoIPCache *self, const gchar *key)
+{
+  GeoIPResult *result = NULL;
+
+  g_mutex_lock(&self->lock);
+  GList *link = g_hash_table_lookup(self->entries, key);
+  if (link)
+    {
+      g_queue_unlink(&self->lru, link);
+      g_queue_push_head_link(&self->lru, link);
+      result = geoip_result_ref(((GeoIPCacheEntry *) link->data)->result);
+    }
+  g_mutex_unlock(&self->lock);
+  return result;
+}
+
+void
+geoip_cache_store(GeoIPCache *self, const gchar *key, GeoIPResult *result)
+{
+  g_mutex_lock(&self->lock);
+  GList *link = g_hash_table_lookup(self->entries, key);
+  if (link)
+    {
+      /* another thread looked up the same key concurrently */
+      GeoIPCacheEntry *entry = (GeoIPCacheEntry *) link->data;
+
+      geoip_result_unref(entry->result);
+      entry->result = geoip_result_ref(result);
+      g_queue_unlink(&self->lru, link);
+      g_queue_push_head_link(&self->lru, link);
+    }
+  else
+    {
+      GeoIPCacheEntry *entry = g_new(GeoIPCacheEntry, 1);
+
+      entry->key = g_strdup(key);
+      entry->result = geoip_result_ref(result);
+      g_queue_push_head(&self->lru, entry);
+      g_hash_table_insert(self->entries, entry->key, self->lru.head);
+
+      if (self->lru.length > self->capacity)
+        _evict_least_recently_used(self);
+    }
+  g_mutex_unlock(&self->lock);
+}
+
+void
+geoip_cache_clear(GeoIPCache *self)
+{
+  g_mutex_lock(&self->lock);
+  GeoIPCacheEntry *entry;
+
+  g_hash_table_remove_all(self->entries);
+  while ((entry = g_queue_pop_head(&self->lru)))
+    _entry_free(entry);
+  g_mutex_unlock(&self->lock);
+}
+
+guint
+geoip_cache_get_size(GeoIPCache *self)
+{
+  g_mutex_lock(&self->lock);
+  guint size = self->lru.length;
+  g_mutex_unlock(&self->lock);
+  return size;
+}
+
+GeoIPCache *
+geoip_cache_new(guint capacity)
+{
+  GeoIPCache *self = g_new0(GeoIPCache, 1);
+
+  g_assert(capacity > 0);
+  g_mutex_init(&self->lock);
+  self->capacity = capacity;
+  self->entries = g_hash_table_new(g_str_hash, g_str_equal);
+  g_queue_init(&self->lru);
+  return self;
+}
+
+void
+geoip_cache_free(GeoIPCache *self)
+{
+  geoip_cache_clear(self);
+  g_hash_table_unref(self->entries);
+  g_mutex_clear(&self->lock);
+  g_free(self);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef GEOIP_CACHE_H_INCLUDED
+#define GEOIP_CACHE_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "logmsg/logmsg.h"
+
+/*
+ * GeoIPResult is the flattened form of a geoip2 lookup: the list of
+ * name-value pairs that the lookup adds to a message.  Results are
+ * immutable once they are stored in the cache and are reference counted,
+ * so they can be applied to a message without holding the cache lock.
+ */
+typedef struct _GeoIPResult GeoIPResult;
+
+GeoIPResult *geoip_result_new(void);
+GeoIPResult *geoip_result_ref(GeoIPResult *self);
+void geoip_result_unref(GeoIPResult *self);
+void geoip_result_add_value(GeoIPResult *self, const gchar *name, const gchar *value, gssize value_len);
+void geoip_result_apply(GeoIPResult *self, LogMessage *msg);
+guint geoip_result_get_number_of_values(GeoIPResult *self);
+
+/*
+ * LRU cache of GeoIPResult instances keyed by the looked up IP address,
+ * shared between the threads running the same geoip2() parser.
+ */
+typedef struct _GeoIPCache GeoIPCache;
+
+GeoIPResult *geoip_cache_lookup(GeoIPCache *self, const gchar *key);
+void geoip_cache_store(GeoIPCache *self, const gchar *key, GeoIPResult *result);
+void geoip_cache_clear(GeoIPCache *self);
+guint geoip_cache_get_size(GeoIPCache *self);
+
+GeoIPCache *geoip_cache_new(guint capacity);
+void geoip_cache_free(GeoIPCache *self);
+
+#endif
@@ -22,6 +22,11 @@
 
 #include "geoip-parser.h"
 #include "maxminddb-helper.h"
+#include "geoip-cache.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+
+#define GEOIP_PARSER_DEFAULT_CACHE_SIZE 4096
 
 typedef struct _GeoIPParser GeoIPParser;
 
@@ -32,6 +37,11 @@ struct _GeoIPParser
 
   gchar *database_path;
   gchar *prefix;
+
+  gint cache_size;
+  GeoIPCache *cache;
+  StatsCounterItem *cache_hits;
+  StatsCounterItem *cache_misses;
 };
 
 void
@@ -43,6 +53,14 @@ geoip_parser_set_prefix(LogParser *s, const gchar *prefix)
   self->prefix = g_strdup(prefix);
 }
 
+void
+geoip_parser_set_cache_size(LogParser *s, gint cache_size)
+{
+  GeoIPParser *self = (GeoIPParser *) s;
+
+  self->cache_size = cache_size;
+}
+
 void
 geoip_parser_set_database_path(LogParser *s, const gchar *database_path)
 {
@@ -52,8 +70,9 @@ geoip_parser_set_database_path(LogParser *s, const gchar *database_path)
   self->database_path = g_strdup(database_path);
 }
 
-static gboolean
-_mmdb_load_entry_data_list(GeoIPParser *self, const gchar *input, MMDB_entry_data_list_s **entry_data_list)
+/* returns NULL on errors, an empty result if the address is not in the database */
+static GeoIPResult *
+_lookup_geodata(GeoIPParser *self, const gchar *input)
 {
   int _gai_error, mmdb_error;
   MMDB_lookup_result_s result =
@@ -73,17 +92,51 @@ _mmdb_load_entry_data_list(GeoIPParser *self, const gchar *input, MMDB_entry_dat
                   evt_tag_str("ip", input),
                   log_pipe_location_tag(&self->super.super));
 
-      return FALSE;
+      if (_gai_error != 0 || mmdb_error != MMDB_SUCCESS)
+        return NULL;
+      return geoip_result_new();
     }
 
-  mmdb_error = MMDB_get_entry_data_list(&result.entry, entry_data_list);
+  MMDB_entry_data_list_s *entry_data_list;
+  mmdb_error = MMDB_get_entry_data_list(&result.entry, &entry_data_list);
   if (MMDB_SUCCESS != mmdb_error)
     {
       msg_debug("GeoIP2: MMDB_get_entry_data_list",
                 evt_tag_str("error", MMDB_strerror(mmdb_error)));
-      return FALSE;
+      return NULL;
     }
-  return TRUE;
+
+  GeoIPResult *geodata = geoip_result_new();
+  GArray *path = g_array_new(TRUE, FALSE, sizeof(gchar *));
+  g_array_append_val(path, self->prefix);
+
+  gint status;
+  dump_geodata_into_result(geodata, entry_data_list, path, &status);
+
+  MMDB_free_entry_data_list(entry_data_list);
+  g_array_free(path, TRUE);
+
+  return geodata;
+}
+
+static GeoIPResult *
+_lookup_geodata_cached(GeoIPParser *self, const gchar *input)
+{
+  if (!self->cache)
+    return _lookup_geodata(self, input);
+
+  GeoIPResult *geodata = geoip_cache_lookup(self->cache, input);
+  if (geodata)
+    {
+      stats_counter_inc(self->cache_hits);
+      return geodata;
+    }
+
+  stats_counter_inc(self->cache_misses);
+  geodata = _lookup_geodata(self, input);
+  if (geodata)
+    geoip_cache_store(self->cache, input, geodata);
+  return geodata;
 }
 
 static gboolean
@@ -98,18 +151,12 @@ maxminddb_parser_process(LogParser *s, LogMessage **pmsg,
             evt_tag_str("prefix", self->prefix),
             evt_tag_msg_reference(*pmsg));
 
-  MMDB_entry_data_list_s *entry_data_list;
-  if (!_mmdb_load_entry_data_list(self, input, &entry_data_list))
+  GeoIPResult *geodata = _lookup_geodata_cached(self, input);
+  if (!geodata)
     return TRUE;
 
-  GArray *path = g_array_new(TRUE, FALSE, sizeof(gchar *));
-  g_array_append_val(path, self->prefix);
-
-  gint status;
-  dump_geodata_into_msg(msg, entry_data_list, path, &status);
-
-  MMDB_free_entry_data_list(entry_data_list);
-  g_array_free(path, TRUE);
+  geoip_result_apply(geodata, msg);
+  geoip_result_unref(geodata);
 
   return TRUE;
 }
@@ -125,10 +172,22 @@ maxminddb_parser_clone(LogPipe *s)
 
   geoip_parser_set_database_path(&cloned->super, self->database_path);
   geoip_parser_set_prefix(&cloned->super, self->prefix);
+  geoip_parser_set_cache_size(&cloned->super, self->cache_size);
 
   return &cloned->super.super;
 }
 
+static void
+_close_database(GeoIPParser *self)
+{
+  if (self->database)
+    {
+      MMDB_close(self->database);
+      g_free(self->database);
+      self->database = NULL;
+    }
+}
+
 static void
 maxminddb_parser_free(LogPipe *s)
 {
@@ -136,13 +195,64 @@ maxminddb_parser_free(LogPipe *s)
 
   g_free(self->database_path);
   g_free(self->prefix);
-  if (self->database)
+  _close_database(self);
+  if (self->cache)
+    geoip_cache_free(self->cache);
+
+  log_parser_free_method(s);
+}
+
+/* cached results belong to the database they were looked up in, so the
+ * cache is emptied whenever the database is (re)opened */
+static void
+_init_cache(GeoIPParser *self)
+{
+  if (self->cache_size <= 0)
+    return;
+
+  if (self->cache)
     {
-      MMDB_close(self->database);
-      g_free(self->database);
+      msg_debug("geoip2(): database reopened, invalidating cache",
+                evt_tag_str("database", self->database_path),
+                log_pipe_location_tag(&self->super.super));
+      geoip_cache_clear(self->cache);
+      return;
     }
+  self->cache = geoip_cache_new(self->cache_size);
+}
 
-  log_parser_free_method(s);
+static void
+_register_stats(GeoIPParser *self)
+{
+  if (!self->cache)
+    return;
+
+  StatsClusterKey sc_key;
+  StatsClusterLabel labels[] = { stats_cluster_label("id", self->super.name) };
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "geoip2_cache_hits_total", labels, G_N_ELEMENTS(labels));
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &self->cache_hits);
+  stats_cluster_single_key_set(&sc_key, "geoip2_cache_misses_total", labels, G_N_ELEMENTS(labels));
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &self->cache_misses);
+  stats_unlock();
+}
+
+static void
+_unregister_stats(GeoIPParser *self)
+{
+  if (!self->cache)
+    return;
+
+  StatsClusterKey sc_key;
+  StatsClusterLabel labels[] = { stats_cluster_label("id", self->super.name) };
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "geoip2_cache_hits_total", labels, G_N_ELEMENTS(labels));
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->cache_hits);
+  stats_cluster_single_key_set(&sc_key, "geoip2_cache_misses_total", labels, G_N_ELEMENTS(labels));
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->cache_misses);
+  stats_unlock();
 }
 
 static void
@@ -171,6 +281,7 @@ maxminddb_parser_init(LogPipe *s)
   if (!self->database_path)
     return FALSE;
 
+  _close_database(self);
   self->database = g_new0(MMDB_s, 1);
   if (!self->database)
     return FALSE;
@@ -179,8 +290,22 @@ maxminddb_parser_init(LogPipe *s)
     return FALSE;
 
   remove_trailing_dot(self->prefix);
+  _init_cache(self);
+
+  if (!log_parser_init_method(s))
+    return FALSE;
+
+  _register_stats(self);
+  return TRUE;
+}
+
+static gboolean
+maxminddb_parser_deinit(LogPipe *s)
+{
+  GeoIPParser *self = (GeoIPParser *) s;
 
-  return log_parser_init_method(s);
+  _unregister_stats(self);
+  return log_parser_deinit_method(s);
 }
 
 LogParser *
@@ -190,11 +315,13 @@ maxminddb_parser_new(GlobalConfig *cfg)
 
   log_parser_init_instance(&self->super, cfg);
   self->super.super.init = maxminddb_parser_init;
+  self->super.super.deinit = maxminddb_parser_deinit;
   self->super.super.free_fn = maxminddb_parser_free;
   self->super.super.clone = maxminddb_parser_clone;
   self->super.process = maxminddb_parser_process;
 
   geoip_parser_set_prefix(&self->super, ".geoip2");
+  self->cache_size = GEOIP_PARSER_DEFAULT_CACHE_SIZE;
 
   return &self->super;
 }
@@ -31,5 +31,6 @@
 LogParser *maxminddb_parser_new(GlobalConfig *cfg);
 void geoip_parser_set_database_path(LogParser *s, const gchar *database);
 void geoip_parser_set_prefix(LogParser *s, const gchar *prefix);
+void geoip_parser_set_cache_size(LogParser *s, gint cache_size);
 
 #endif
@@ -23,6 +23,7 @@
 #include "libtest/msg_parse_lib.h"
 
 #include "geoip-parser.h"
+#include "geoip-cache.h"
 #include "apphook.h"
 #include "scratch-buffers.h"
 
@@ -134,4 +135,94 @@ Test(geoip2, test_basic)
   log_msg_unref(msg);
 }
 
+static LogMessage *
+_process_with(LogParser *parser, const gchar *input)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value(msg, LM_V_MESSAGE, input, -1);
+  cr_assert(log_parser_process_message(parser, &msg, &path_options));
+  return msg;
+}
+
+static void
+_assert_repeated_lookups_are_consistent(gint cache_size)
+{
+  LogParser *parser = (LogParser *) log_pipe_clone(&geoip_parser->super);
+  LogTemplate *template = log_template_new(NULL, NULL);
+  cr_assert(log_template_compile(template, "$MSG", NULL));
+  log_parser_set_template(parser, template);
+  geoip_parser_set_cache_size(parser, cache_size);
+  cr_assert(log_pipe_init(&parser->super));
+
+  for (gint i = 0; i < 3; i++)
+    {
+      LogMessage *msg = _process_with(parser, "2.125.160.216");
+      assert_log_message_value(msg, log_msg_get_value_handle(".geoip2.country.iso_code"), "GB");
+      assert_log_message_value(msg, log_msg_get_value_handle(".geoip2.location.latitude"), "51.750000");
+      log_msg_unref(msg);
+
+      msg = _process_with(parser, "10.0.0.1");
+      assert_log_message_value_unset(msg, log_msg_get_value_handle(".geoip2.country.iso_code"));
+      log_msg_unref(msg);
+    }
+
+  /* reinitializing reopens the database and starts over with an empty cache */
+  log_pipe_deinit(&parser->super);
+  cr_assert(log_pipe_init(&parser->super));
+  LogMessage *msg = _process_with(parser, "2.125.160.216");
+  assert_log_message_value(msg, log_msg_get_value_handle(".geoip2.country.iso_code"), "GB");
+  log_msg_unref(msg);
+
+  log_pipe_deinit(&parser->super);
+  log_pipe_unref(&parser->super);
+}
+
+Test(geoip2, repeated_lookups_are_served_from_cache)
+{
+  _assert_repeated_lookups_are_consistent(16);
+}
+
+Test(geoip2, cache_can_be_disabled)
+{
+  _assert_repeated_lookups_are_consistent(0);
+}
+
+Test(geoip2, cache_evicts_least_recently_used_entries)
+{
+  GeoIPCache *cache = geoip_cache_new(2);
+  GeoIPResult *a = geoip_result_new();
+  GeoIPResult *b = geoip_result_new();
+  GeoIPResult *c = geoip_result_new();
+
+  geoip_result_add_value(a, ".geoip2.country.iso_code", "GB", -1);
+  geoip_cache_store(cache, "a", a);
+  geoip_cache_store(cache, "b", b);
+
+  /* touch "a" so that "b" becomes the least recently used entry */
+  GeoIPResult *hit = geoip_cache_lookup(cache, "a");
+  cr_assert_eq(hit, a);
+  cr_assert_eq(geoip_result_get_number_of_values(hit), 1);
+  geoip_result_unref(hit);
+
+  geoip_cache_store(cache, "c", c);
+  cr_assert_eq(geoip_cache_get_size(cache), 2);
+  cr_assert_null(geoip_cache_lookup(cache, "b"));
+
+  hit = geoip_cache_lookup(cache, "c");
+  cr_assert_eq(hit, c);
+  cr_assert_eq(geoip_result_get_number_of_values(hit), 0);
+  geoip_result_unref(hit);
+
+  geoip_cache_clear(cache);
+  cr_assert_eq(geoip_cache_get_size(cache), 0);
+  cr_assert_null(geoip_cache_lookup(cache, "a"));
+
+  geoip_result_unref(a);
+  geoip_result_unref(b);
+  geoip_result_unref(c);
+  geoip_cache_free(cache);
+}
+
 TestSuite(geoip2, .init = setup, .fini = teardown);
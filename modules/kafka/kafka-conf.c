@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "kafka-conf.h"
+#include "kafka-props.h"
+#include "messages.h"
+
+#include <string.h>
+
+void
+kafka_log_callback(const rd_kafka_t *rkt, int level, const char *fac, const char *msg)
+{
+  gchar *buf = g_strdup_printf("librdkafka: %s(%d): %s", fac, level, msg);
+  msg_event_send(msg_event_create(level, buf, NULL));
+  g_free(buf);
+}
+
+gboolean
+kafka_conf_set_prop(rd_kafka_conf_t *conf, const gchar *name, const gchar *value)
+{
+  gchar errbuf[1024];
+
+  msg_debug("kafka: setting librdkafka config property",
+            evt_tag_str("name", name),
+            evt_tag_str("value", value));
+  if (rd_kafka_conf_set(conf, name, value, errbuf, sizeof(errbuf)) < 0)
+    {
+      msg_error("kafka: error setting librdkafka config property",
+                evt_tag_str("name", name),
+                evt_tag_str("value", value),
+                evt_tag_str("error", errbuf));
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_is_property_protected(const gchar *property_name)
+{
+  static gchar *protected_properties[] =
+  {
+    "bootstrap.servers",
+    "metadata.broker.list",
+  };
+
+  for (gint i = 0; i < G_N_ELEMENTS(protected_properties); i++)
+    {
+      if (strcmp(property_name, protected_properties[i]) == 0)
+        {
+          msg_warning("kafka: protected config properties cannot be overridden",
+                      evt_tag_str("name", property_name));
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
+gboolean
+kafka_conf_apply_props(rd_kafka_conf_t *conf, GList *props)
+{
+  GList *ll;
+
+  for (ll = props; ll != NULL; ll = g_list_next(ll))
+    {
+      KafkaProperty *kp = ll->data;
+      if (!_is_property_protected(kp->name))
+        if (!kafka_conf_set_prop(conf, kp->name, kp->value))
+          return FALSE;
+    }
+  return TRUE;
+}
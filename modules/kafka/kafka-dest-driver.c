@@ -26,6 +26,7 @@
 
 #include "kafka-dest-driver.h"
 #include "kafka-props.h"
+#include "kafka-conf.h"
 #include "kafka-dest-worker.h"
 
 #include <librdkafka/rdkafka.h>
@@ -163,15 +164,6 @@ _format_persist_name(const LogPipe *d)
   return persist_name;
 }
 
-void
-_kafka_log_callback(const rd_kafka_t *rkt, int level, const char *fac, const char *msg)
-{
-  gchar *buf = g_strdup_printf("librdkafka: %s(%d): %s", fac, level, msg);
-  msg_event_send(msg_event_create(level, buf, NULL));
-  g_free(buf);
-}
-
-
 static gboolean
 _contains_valid_pattern(const gchar *name)
 {
@@ -313,66 +305,11 @@ _kafka_delivery_report_cb(rd_kafka_t *rk,
     }
 }
 
-static gboolean
-_conf_set_prop(rd_kafka_conf_t *conf, const gchar *name, const gchar *value)
-{
-  gchar errbuf[1024];
-
-  msg_debug("kafka: setting librdkafka config property",
-            evt_tag_str("name", name),
-            evt_tag_str("value", value));
-  if (rd_kafka_conf_set(conf, name, value, errbuf, sizeof(errbuf)) < 0)
-    {
-      msg_error("kafka: error setting librdkafka config property",
-                evt_tag_str("name", name),
-                evt_tag_str("value", value),
-                evt_tag_str("error", errbuf));
-      return FALSE;
-    }
-  return TRUE;
-}
-
 /*
  * Main thread
  */
 
 
-static gboolean
-_is_property_protected(const gchar *property_name)
-{
-  static gchar *protected_properties[] =
-  {
-    "bootstrap.servers",
-    "metadata.broker.list",
-  };
-
-  for (gint i = 0; i < G_N_ELEMENTS(protected_properties); i++)
-    {
-      if (strcmp(property_name, protected_properties[i]) == 0)
-        {
-          msg_warning("kafka: protected config properties cannot be overridden",
-                      evt_tag_str("name", property_name));
-          return TRUE;
-        }
-    }
-  return FALSE;
-}
-
-static gboolean
-_apply_config_props(rd_kafka_conf_t *conf, GList *props)
-{
-  GList *ll;
-
-  for (ll = props; ll != NULL; ll = g_list_next(ll))
-    {
-      KafkaProperty *kp = ll->data;
-      if (!_is_property_protected(kp->name))
-        if (!_conf_set_prop(conf, kp->name, kp->value))
-          return FALSE;
-    }
-  return TRUE;
-}
-
 static rd_kafka_t *
 _construct_client(KafkaDestDriver *self)
 {
@@ -381,18 +318,18 @@ _construct_client(KafkaDestDriver *self)
   gchar errbuf[1024];
 
   conf = rd_kafka_conf_new();
-  if (!_conf_set_prop(conf, "metadata.broker.list", self->bootstrap_servers))
+  if (!kafka_conf_set_prop(conf, "metadata.broker.list", self->bootstrap_servers))
     return NULL;
-  if (!_conf_set_prop(conf, "topic.partitioner", "murmur2_random"))
+  if (!kafka_conf_set_prop(conf, "topic.partitioner", "murmur2_random"))
     return NULL;
 
   if (self->transaction_commit)
-    _conf_set_prop(conf, "transactional.id",
-                   log_pipe_get_persist_name(&self->super.super.super.super));
+    kafka_conf_set_prop(conf, "transactional.id",
+                        log_pipe_get_persist_name(&self->super.super.super.super));
 
-  if (!_apply_config_props(conf, self->config))
+  if (!kafka_conf_apply_props(conf, self->config))
     return NULL;
-  rd_kafka_conf_set_log_cb(conf, _kafka_log_callback);
+  rd_kafka_conf_set_log_cb(conf, kafka_log_callback);
   rd_kafka_conf_set_dr_cb(conf, _kafka_delivery_report_cb);
   rd_kafka_conf_set_opaque(conf, self);
   client = rd_kafka_new(RD_KAFKA_PRODUCER, conf, errbuf, sizeof(errbuf));
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "kafka-offset-tracker.h"
+#include "messages.h"
+
+typedef struct _KafkaOffsetRecord
+{
+  gint64 offset;
+  gboolean acked;
+} KafkaOffsetRecord;
+
+struct _KafkaOffsetTracker
+{
+  /* KafkaOffsetRecord instances in ascending offset order */
+  GQueue inflight;
+  /* offset -> GList link in inflight, keys point into the records */
+  GHashTable *index;
+};
+
+KafkaOffsetTracker *
+kafka_offset_tracker_new(void)
+{
+  KafkaOffsetTracker *self = g_new0(KafkaOffsetTracker, 1);
+
+  g_queue_init(&self->inflight);
+  self->index = g_hash_table_new(g_int64_hash, g_int64_equal);
+  return self;
+}
+
+void
+kafka_offset_tracker_free(KafkaOffsetTracker *self)
+{
+  g_hash_table_unref(self->index);
+  g_queue_foreach(&self->inflight, (GFunc) g_free, NULL);
+  g_queue_clear(&self->inflight);
+  g_free(self);
+}
+
+/*
+ * The broker may deliver offsets again (rebalance, auto.offset.reset,
+ * consumer restart): the in-flight records starting at @offset are going
+ * to be delivered again, so they are forgotten, acknowledgements still
+ * arriving for them are ignored.
+ */
+static void
+_rewind(KafkaOffsetTracker *self, gint64 offset)
+{
+  KafkaOffsetRecord *tail;
+  gsize discarded = 0;
+
+  while ((tail = g_queue_peek_tail(&self->inflight)) && tail->offset >= offset)
+    {
+      g_hash_table_remove(self->index, &tail->offset);
+      g_free(g_queue_pop_tail(&self->inflight));
+      discarded++;
+    }
+
+  msg_debug("kafka: offset rewound, discarding in-flight offsets",
+            evt_tag_long("offset", offset),
+            evt_tag_long("discarded", discarded));
+}
+
+void
+kafka_offset_tracker_track(KafkaOffsetTracker *self, gint64 offset)
+{
+  KafkaOffsetRecord *tail = g_queue_peek_tail(&self->inflight);
+  if (tail && tail->offset >= offset)
+    _rewind(self, offset);
+
+  KafkaOffsetRecord *record = g_new0(KafkaOffsetRecord, 1);
+  record->offset = offset;
+
+  g_queue_push_tail(&self->inflight, record);
+  g_hash_table_insert(self->index, &record->offset, g_queue_peek_tail_link(&self->inflight));
+}
+
+/*
+ * Returns TRUE if the acknowledgement moved the commit point forward, in
+ * which case *last_committable is set to the highest offset that was
+ * processed together with all its predecessors.
+ */
+gboolean
+kafka_offset_tracker_ack(KafkaOffsetTracker *self, gint64 offset, gint64 *last_committable)
+{
+  GList *link = g_hash_table_lookup(self->index, &offset);
+
+  if (!link)
+    return FALSE;
+
+  KafkaOffsetRecord *record = link->data;
+  record->acked = TRUE;
+
+  gboolean advanced = FALSE;
+  while ((record = g_queue_peek_head(&self->inflight)) && record->acked)
+    {
+      *last_committable = record->offset;
+      advanced = TRUE;
+
+      g_hash_table_remove(self->index, &record->offset);
+      g_free(g_queue_pop_head(&self->inflight));
+    }
+
+  return advanced;
+}
+
+gsize
+kafka_offset_tracker_get_inflight(KafkaOffsetTracker *self)
+{
+  return self->inflight.length;
+}
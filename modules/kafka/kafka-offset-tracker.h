@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef KAFKA_OFFSET_TRACKER_H_INCLUDED
+#define KAFKA_OFFSET_TRACKER_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Keeps track of the in-flight offsets of a single partition, so that we
+ * only ever store an offset whose predecessors have all been acknowledged.
+ * Offsets are tracked in ascending order (as they come from librdkafka),
+ * except when the broker rewinds the partition: the in-flight offsets
+ * from the rewound one on are discarded then.  Acknowledgements may
+ * arrive in any order.
+ */
+typedef struct _KafkaOffsetTracker KafkaOffsetTracker;
+
+KafkaOffsetTracker *kafka_offset_tracker_new(void);
+void kafka_offset_tracker_free(KafkaOffsetTracker *self);
+
+void kafka_offset_tracker_track(KafkaOffsetTracker *self, gint64 offset);
+gboolean kafka_offset_tracker_ack(KafkaOffsetTracker *self, gint64 offset, gint64 *last_committable);
+gsize kafka_offset_tracker_get_inflight(KafkaOffsetTracker *self);
+
+#endif
@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "kafka-source-driver.h"
+#include "kafka-source-worker.h"
+#include "kafka-dest-driver.h"
+#include "kafka-conf.h"
+#include "kafka-props.h"
+#include "ack-tracker/ack_tracker_factory.h"
+
+/* how often acknowledged offsets are handed over to librdkafka */
+#define KAFKA_SOURCE_OFFSET_STORE_TIMEOUT 1000
+#define KAFKA_SOURCE_OFFSET_STORE_BATCH_SIZE 1024
+
+/*
+ * Configuration
+ */
+
+void
+kafka_sd_set_topic(LogDriver *d, const gchar *topic)
+{
+  KafkaSourceDriver *self = (KafkaSourceDriver *) d;
+
+  g_free(self->topic_name);
+  self->topic_name = g_strdup(topic);
+}
+
+void
+kafka_sd_merge_config(LogDriver *d, GList *props)
+{
+  KafkaSourceDriver *self = (KafkaSourceDriver *) d;
+
+  self->config = g_list_concat(self->config, props);
+}
+
+void
+kafka_sd_set_bootstrap_servers(LogDriver *d, const gchar *bootstrap_servers)
+{
+  KafkaSourceDriver *self = (KafkaSourceDriver *) d;
+
+  g_free(self->bootstrap_servers);
+  self->bootstrap_servers = g_strdup(bootstrap_servers);
+}
+
+void
+kafka_sd_set_poll_timeout(LogDriver *d, gint poll_timeout)
+{
+  KafkaSourceDriver *self = (KafkaSourceDriver *) d;
+
+  self->poll_timeout = poll_timeout;
+}
+
+void
+kafka_sd_set_fetch_limit(LogDriver *d, gint fetch_limit)
+{
+  KafkaSourceDriver *self = (KafkaSourceDriver *) d;
+
+  self->fetch_limit = fetch_limit;
+}
+
+void
+kafka_sd_set_time_reopen(LogDriver *d, gint time_reopen)
+{
+  KafkaSourceDriver *self = (KafkaSourceDriver *) d;
+
+  self->time_reopen = time_reopen;
+}
+
+/* methods */
+
+static void
+_format_stats_key(LogThreadedSourceDriver *s, StatsClusterKeyBuilder *kb)
+{
+  KafkaSourceDriver *self = (KafkaSourceDriver *) s;
+
+  stats_cluster_key_builder_add_legacy_label(kb, stats_cluster_label("driver", "kafka"));
+  stats_cluster_key_builder_add_legacy_label(kb, stats_cluster_label("topic", self->topic_name));
+}
+
+static const gchar *
+_format_persist_name(const LogPipe *s)
+{
+  const KafkaSourceDriver *self = (const KafkaSourceDriver *) s;
+  static gchar persist_name[1024];
+
+  if (s->persist_name)
+    g_snprintf(persist_name, sizeof(persist_name), "kafka-source.%s", s->persist_name);
+  else
+    g_snprintf(persist_name, sizeof(persist_name), "kafka-source(%s)", self->topic_name);
+  return persist_name;
+}
+
+static rd_kafka_t *
+_construct_client(KafkaSourceDriver *self)
+{
+  rd_kafka_t *client;
+  rd_kafka_conf_t *conf;
+  gchar errbuf[1024];
+
+  conf = rd_kafka_conf_new();
+  if (!kafka_conf_set_prop(conf, "metadata.broker.list", self->bootstrap_servers))
+    goto error;
+
+  /* offsets are stored explicitly once the corresponding messages are
+   * acknowledged, which gives us at-least-once delivery */
+  if (!kafka_conf_set_prop(conf, "enable.auto.offset.store", "false"))
+    goto error;
+  if (!kafka_conf_set_prop(conf, "group.id", log_pipe_get_persist_name(&self->super.super.super.super)))
+    goto error;
+
+  if (!kafka_conf_apply_props(conf, self->config))
+    goto error;
+  rd_kafka_conf_set_log_cb(conf, kafka_log_callback);
+  rd_kafka_conf_set_opaque(conf, self);
+
+  client = rd_kafka_new(RD_KAFKA_CONSUMER, conf, errbuf, sizeof(errbuf));
+  if (!client)
+    {
+      msg_error("kafka: error constructing the kafka connection object",
+                evt_tag_str("topic", self->topic_name),
+                evt_tag_str("error", errbuf),
+                evt_tag_str("driver", self->super.super.super.id),
+                log_pipe_location_tag(&self->super.super.super.super));
+      rd_kafka_conf_destroy(conf);
+    }
+  return client;
+
+error:
+  rd_kafka_conf_destroy(conf);
+  return NULL;
+}
+
+static void
+_destroy_kafka(KafkaSourceDriver *self)
+{
+  g_mutex_lock(&self->topic_lock);
+  if (self->topic)
+    {
+      rd_kafka_topic_destroy(self->topic);
+      self->topic = NULL;
+    }
+  g_mutex_unlock(&self->topic_lock);
+
+  if (self->kafka)
+    {
+      rd_kafka_destroy(self->kafka);
+      self->kafka = NULL;
+    }
+}
+
+static gboolean
+_setup_kafka(KafkaSourceDriver *self)
+{
+  GError *error = NULL;
+
+  if (!kafka_dd_validate_topic_name(self->topic_name, &error))
+    {
+      msg_error("kafka: invalid topic name",
+                evt_tag_str("topic", self->topic_name),
+                evt_tag_str("error", error->message),
+                evt_tag_str("driver", self->super.super.super.id),
+                log_pipe_location_tag(&self->super.super.super.super));
+      g_error_free(error);
+      return FALSE;
+    }
+
+  self->kafka = _construct_client(self);
+  if (!self->kafka)
+    return FALSE;
+
+  self->topic = rd_kafka_topic_new(self->kafka, self->topic_name, NULL);
+  if (!self->topic)
+    {
+      msg_error("kafka: error constructing the kafka topic object",
+                evt_tag_str("topic", self->topic_name),
+                evt_tag_str("error", rd_kafka_err2str(rd_kafka_last_error())),
+                evt_tag_str("driver", self->super.super.super.id),
+                log_pipe_location_tag(&self->super.super.super.super));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+_setup_ack_tracker_factory(KafkaSourceDriver *self)
+{
+  ack_tracker_factory_unref(self->super.worker_options.ack_tracker_factory);
+  self->super.worker_options.ack_tracker_factory =
+    batched_ack_tracker_factory_new(KAFKA_SOURCE_OFFSET_STORE_TIMEOUT, KAFKA_SOURCE_OFFSET_STORE_BATCH_SIZE,
+                                    kafka_source_worker_on_batch_acked, self);
+}
+
+static gboolean
+_init(LogPipe *s)
+{
+  KafkaSourceDriver *self = (KafkaSourceDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+
+  if (!self->topic_name)
+    {
+      msg_error("kafka: the topic() argument is required for kafka sources",
+                evt_tag_str("driver", self->super.super.super.id),
+                log_pipe_location_tag(&self->super.super.super.super));
+      return FALSE;
+    }
+  if (!self->bootstrap_servers)
+    {
+      msg_error("kafka: the bootstrap-servers() option is required for kafka sources",
+                evt_tag_str("driver", self->super.super.super.id),
+                log_pipe_location_tag(&self->super.super.super.super));
+      return FALSE;
+    }
+
+  if (self->time_reopen == -1)
+    self->time_reopen = cfg->time_reopen;
+
+  if (!_setup_kafka(self))
+    {
+      _destroy_kafka(self);
+      return FALSE;
+    }
+
+  _setup_ack_tracker_factory(self);
+
+  if (!log_threaded_source_driver_init_method(s))
+    {
+      _destroy_kafka(self);
+      return FALSE;
+    }
+
+  msg_verbose("kafka: Kafka source initialized",
+              evt_tag_str("topic", self->topic_name),
+              evt_tag_int("workers", self->super.num_workers),
+              evt_tag_str("driver", self->super.super.super.id),
+              log_pipe_location_tag(&self->super.super.super.super));
+  return TRUE;
+}
+
+static gboolean
+_deinit(LogPipe *s)
+{
+  KafkaSourceDriver *self = (KafkaSourceDriver *) s;
+
+  /*
+   * Deinitializing the workers flushes the partially filled ack batches,
+   * so every offset acknowledged so far is stored before the topic goes
+   * away.  Messages that are still in flight get acknowledged later and
+   * find the topic gone: those are simply consumed again next time.
+   */
+  gboolean result = log_threaded_source_driver_deinit_method(s);
+  _destroy_kafka(self);
+
+  return result;
+}
+
+static void
+_free(LogPipe *s)
+{
+  KafkaSourceDriver *self = (KafkaSourceDriver *) s;
+
+  _destroy_kafka(self);
+  g_free(self->topic_name);
+  g_free(self->bootstrap_servers);
+  kafka_property_list_free(self->config);
+
+  g_mutex_clear(&self->topic_lock);
+
+  log_threaded_source_driver_free_method(s);
+}
+
+static LogThreadedSourceWorker *
+_construct_worker(LogThreadedSourceDriver *s, gint worker_index)
+{
+  return kafka_source_worker_new(s, worker_index);
+}
+
+LogDriver *
+kafka_sd_new(GlobalConfig *cfg)
+{
+  KafkaSourceDriver *self = g_new0(KafkaSourceDriver, 1);
+
+  log_threaded_source_driver_init_instance(&self->super, cfg);
+  log_threaded_source_driver_set_transport_name(&self->super, "kafka");
+  g_mutex_init(&self->topic_lock);
+
+  self->super.super.super.super.init = _init;
+  self->super.super.super.super.deinit = _deinit;
+  self->super.super.super.super.free_fn = _free;
+  self->super.super.super.super.generate_persist_name = _format_persist_name;
+
+  self->super.format_stats_key = _format_stats_key;
+  self->super.worker_construct = _construct_worker;
+
+  /* batches are closed explicitly after each rd_kafka_consume_batch_queue() call */
+  self->super.auto_close_batches = FALSE;
+
+  self->poll_timeout = 100;
+  self->fetch_limit = 1000;
+  self->time_reopen = -1;
+
+  return &self->super.super.super;
+}
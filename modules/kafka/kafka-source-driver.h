@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef KAFKA_SOURCE_DRIVER_H_INCLUDED
+#define KAFKA_SOURCE_DRIVER_H_INCLUDED
+
+#include "logthrsource/logthrsourcedrv.h"
+#include <librdkafka/rdkafka.h>
+
+typedef struct _KafkaSourceDriver
+{
+  LogThreadedSourceDriver super;
+
+  GList *config;
+  gchar *bootstrap_servers;
+  gchar *topic_name;
+  gint poll_timeout;
+  gint fetch_limit;
+  gint time_reopen;
+
+  rd_kafka_t *kafka;
+
+  /* acknowledgements may still arrive after deinit, from any thread */
+  GMutex topic_lock;
+  rd_kafka_topic_t *topic;
+} KafkaSourceDriver;
+
+void kafka_sd_set_topic(LogDriver *d, const gchar *topic);
+void kafka_sd_merge_config(LogDriver *d, GList *props);
+void kafka_sd_set_bootstrap_servers(LogDriver *d, const gchar *bootstrap_servers);
+void kafka_sd_set_poll_timeout(LogDriver *d, gint poll_timeout);
+void kafka_sd_set_fetch_limit(LogDriver *d, gint fetch_limit);
+void kafka_sd_set_time_reopen(LogDriver *d, gint time_reopen);
+
+LogDriver *kafka_sd_new(GlobalConfig *cfg);
+
+#endif
@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "kafka-source-worker.h"
+#include "kafka-source-driver.h"
+#include "kafka-offset-tracker.h"
+#include "ack-tracker/ack_tracker.h"
+#include "ack-tracker/bookmark.h"
+#include "messages.h"
+
+typedef struct _KafkaBookmarkData
+{
+  gint32 partition;
+  gint64 offset;
+} KafkaBookmarkData;
+
+static NVHandle handle_kafka_topic;
+static NVHandle handle_kafka_partition;
+static NVHandle handle_kafka_offset;
+static NVHandle handle_kafka_key;
+
+static KafkaSourceDriver *
+_owner(KafkaSourceWorker *self)
+{
+  return (KafkaSourceDriver *) self->super.control;
+}
+
+static gboolean
+_is_exit_requested(KafkaSourceWorker *self)
+{
+  return g_atomic_int_get(&self->exit_requested);
+}
+
+static void
+_wait_for_time_reopen(KafkaSourceWorker *self)
+{
+  gint64 end_time = g_get_monotonic_time() + _owner(self)->time_reopen * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock(&self->exit_lock);
+  while (!_is_exit_requested(self))
+    {
+      if (!g_cond_wait_until(&self->exit_cond, &self->exit_lock, end_time))
+        break;
+    }
+  g_mutex_unlock(&self->exit_lock);
+}
+
+static KafkaOffsetTracker *
+_lookup_offset_tracker(KafkaSourceWorker *self, gint32 partition)
+{
+  return g_hash_table_lookup(self->offsets, GINT_TO_POINTER(partition));
+}
+
+static gboolean
+_fetch_partition_count(KafkaSourceWorker *self, gint *partition_count)
+{
+  KafkaSourceDriver *owner = _owner(self);
+  const struct rd_kafka_metadata *metadata;
+
+  rd_kafka_resp_err_t err = rd_kafka_metadata(owner->kafka, 0, owner->topic, &metadata,
+                                              owner->time_reopen * 1000);
+  if (err != RD_KAFKA_RESP_ERR_NO_ERROR)
+    {
+      msg_error("kafka: error querying topic metadata",
+                evt_tag_str("topic", owner->topic_name),
+                evt_tag_str("error", rd_kafka_err2str(err)),
+                evt_tag_int("worker_index", self->super.worker_index),
+                evt_tag_str("driver", owner->super.super.super.id));
+      return FALSE;
+    }
+
+  gboolean result = FALSE;
+  if (metadata->topic_cnt == 1 && metadata->topics[0].err == RD_KAFKA_RESP_ERR_NO_ERROR)
+    {
+      *partition_count = metadata->topics[0].partition_cnt;
+      result = TRUE;
+    }
+  else
+    {
+      msg_error("kafka: topic is not available",
+                evt_tag_str("topic", owner->topic_name),
+                evt_tag_str("error", metadata->topic_cnt ? rd_kafka_err2str(metadata->topics[0].err) : "no such topic"),
+                evt_tag_int("worker_index", self->super.worker_index),
+                evt_tag_str("driver", owner->super.super.super.id));
+    }
+
+  rd_kafka_metadata_destroy(metadata);
+  return result;
+}
+
+static gboolean
+_start_partitions(KafkaSourceWorker *self)
+{
+  KafkaSourceDriver *owner = _owner(self);
+  gint partition_count;
+
+  if (!_fetch_partition_count(self, &partition_count))
+    return FALSE;
+
+  for (gint32 partition = self->super.worker_index; partition < partition_count; partition += owner->super.num_workers)
+    {
+      g_mutex_lock(&self->offsets_lock);
+      if (!_lookup_offset_tracker(self, partition))
+        g_hash_table_insert(self->offsets, GINT_TO_POINTER(partition), kafka_offset_tracker_new());
+      g_mutex_unlock(&self->offsets_lock);
+
+      if (rd_kafka_consume_start_queue(owner->topic, partition, RD_KAFKA_OFFSET_STORED, self->queue) < 0)
+        {
+          msg_error("kafka: error starting to consume partition",
+                    evt_tag_str("topic", owner->topic_name),
+                    evt_tag_int("partition", partition),
+                    evt_tag_str("error", rd_kafka_err2str(rd_kafka_last_error())),
+                    evt_tag_str("driver", owner->super.super.super.id));
+          continue;
+        }
+      g_array_append_val(self->partitions, partition);
+    }
+
+  if (self->partitions->len == 0)
+    {
+      msg_warning("kafka: no partitions are assigned to this worker, consider decreasing the number of workers()",
+                  evt_tag_str("topic", owner->topic_name),
+                  evt_tag_int("partitions", partition_count),
+                  evt_tag_int("worker_index", self->super.worker_index),
+                  evt_tag_str("driver", owner->super.super.super.id));
+    }
+
+  self->partitions_started = TRUE;
+  msg_debug("kafka: started consuming partitions",
+            evt_tag_str("topic", owner->topic_name),
+            evt_tag_int("partitions", self->partitions->len),
+            evt_tag_int("worker_index", self->super.worker_index),
+            evt_tag_str("driver", owner->super.super.super.id));
+  return TRUE;
+}
+
+static void
+_stop_partitions(KafkaSourceWorker *self)
+{
+  KafkaSourceDriver *owner = _owner(self);
+
+  for (guint i = 0; i < self->partitions->len; i++)
+    rd_kafka_consume_stop(owner->topic, g_array_index(self->partitions, gint32, i));
+  g_array_set_size(self->partitions, 0);
+  self->partitions_started = FALSE;
+}
+
+static void
+_fill_bookmark(KafkaSourceWorker *self, const rd_kafka_message_t *rkm)
+{
+  Bookmark *bookmark = ack_tracker_request_bookmark(self->super.super.ack_tracker);
+  KafkaBookmarkData *data = (KafkaBookmarkData *) &bookmark->container;
+
+  data->partition = rkm->partition;
+  data->offset = rkm->offset;
+}
+
+static LogMessage *
+_create_log_message(KafkaSourceWorker *self, const rd_kafka_message_t *rkm)
+{
+  KafkaSourceDriver *owner = _owner(self);
+  LogMessage *msg = log_msg_new_empty();
+  gchar buf[32];
+  gint len;
+
+  log_msg_set_value(msg, LM_V_MESSAGE, (const gchar *) rkm->payload, rkm->payload ? rkm->len : 0);
+  log_msg_set_value(msg, handle_kafka_topic, owner->topic_name, -1);
+
+  len = g_snprintf(buf, sizeof(buf), "%" G_GINT32_FORMAT, rkm->partition);
+  log_msg_set_value_with_type(msg, handle_kafka_partition, buf, len, LM_VT_INTEGER);
+
+  len = g_snprintf(buf, sizeof(buf), "%" G_GINT64_FORMAT, (gint64) rkm->offset);
+  log_msg_set_value_with_type(msg, handle_kafka_offset, buf, len, LM_VT_INTEGER);
+
+  if (rkm->key)
+    log_msg_set_value(msg, handle_kafka_key, (const gchar *) rkm->key, rkm->key_len);
+
+  return msg;
+}
+
+static void
+_process_message(KafkaSourceWorker *self, const rd_kafka_message_t *rkm)
+{
+  KafkaSourceDriver *owner = _owner(self);
+
+  if (rkm->err)
+    {
+      if (rkm->err == RD_KAFKA_RESP_ERR__PARTITION_EOF)
+        return;
+
+      msg_error("kafka: error consuming message",
+                evt_tag_str("topic", owner->topic_name),
+                evt_tag_int("partition", rkm->partition),
+                evt_tag_str("error", rd_kafka_message_errstr(rkm)),
+                evt_tag_str("driver", owner->super.super.super.id));
+      return;
+    }
+
+  g_mutex_lock(&self->offsets_lock);
+  kafka_offset_tracker_track(_lookup_offset_tracker(self, rkm->partition), rkm->offset);
+  g_mutex_unlock(&self->offsets_lock);
+
+  LogMessage *msg = _create_log_message(self, rkm);
+  _fill_bookmark(self, rkm);
+  log_threaded_source_worker_blocking_post(&self->super, msg);
+}
+
+static void
+_consume_batch(KafkaSourceWorker *self)
+{
+  KafkaSourceDriver *owner = _owner(self);
+
+  gssize count = rd_kafka_consume_batch_queue(self->queue, owner->poll_timeout, self->batch, owner->fetch_limit);
+  if (count < 0)
+    {
+      msg_error("kafka: error consuming messages",
+                evt_tag_str("topic", owner->topic_name),
+                evt_tag_str("error", rd_kafka_err2str(rd_kafka_last_error())),
+                evt_tag_str("driver", owner->super.super.super.id));
+      return;
+    }
+
+  for (gssize i = 0; i < count; i++)
+    {
+      _process_message(self, self->batch[i]);
+      rd_kafka_message_destroy(self->batch[i]);
+    }
+
+  if (count > 0)
+    log_threaded_source_worker_close_batch(&self->super);
+}
+
+/* runs in a dedicated thread */
+static void
+_worker_run(LogThreadedSourceWorker *w)
+{
+  KafkaSourceWorker *self = (KafkaSourceWorker *) w;
+
+  while (!_is_exit_requested(self))
+    {
+      if (!self->partitions_started && !_start_partitions(self))
+        {
+          _wait_for_time_reopen(self);
+          continue;
+        }
+
+      _consume_batch(self);
+    }
+
+  _stop_partitions(self);
+}
+
+static gboolean
+_thread_init(LogThreadedSourceWorker *w)
+{
+  KafkaSourceWorker *self = (KafkaSourceWorker *) w;
+  KafkaSourceDriver *owner = _owner(self);
+
+  self->queue = rd_kafka_queue_new(owner->kafka);
+  self->batch = g_new0(rd_kafka_message_t *, owner->fetch_limit);
+  return TRUE;
+}
+
+static void
+_thread_deinit(LogThreadedSourceWorker *w)
+{
+  KafkaSourceWorker *self = (KafkaSourceWorker *) w;
+
+  g_free(self->batch);
+  self->batch = NULL;
+  rd_kafka_queue_destroy(self->queue);
+  self->queue = NULL;
+}
+
+static void
+_request_exit(LogThreadedSourceWorker *w)
+{
+  KafkaSourceWorker *self = (KafkaSourceWorker *) w;
+
+  g_mutex_lock(&self->exit_lock);
+  g_atomic_int_set(&self->exit_requested, TRUE);
+  g_cond_signal(&self->exit_cond);
+  g_mutex_unlock(&self->exit_lock);
+}
+
+/*
+ * Called with the acknowledged records of this worker, from whatever
+ * thread the acknowledgement happened in.  Offsets are only handed over to
+ * librdkafka (and committed from there) once everything before them has
+ * been acknowledged.
+ */
+void
+kafka_source_worker_on_batch_acked(GList *ack_records, gpointer user_data)
+{
+  KafkaSourceDriver *owner = (KafkaSourceDriver *) user_data;
+  GHashTable *committable = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+  for (GList *l = ack_records; l; l = l->next)
+    {
+      AckRecord *ack_record = l->data;
+      KafkaSourceWorker *self = (KafkaSourceWorker *) ack_record->tracker->source;
+      KafkaBookmarkData *data = (KafkaBookmarkData *) &ack_record->bookmark.container;
+      gint64 last_committable;
+
+      g_mutex_lock(&self->offsets_lock);
+      KafkaOffsetTracker *tracker = _lookup_offset_tracker(self, data->partition);
+      gboolean advanced = tracker && kafka_offset_tracker_ack(tracker, data->offset, &last_committable);
+      g_mutex_unlock(&self->offsets_lock);
+
+      if (advanced)
+        {
+          gint64 *offset = g_new(gint64, 1);
+          *offset = last_committable;
+          g_hash_table_insert(committable, GINT_TO_POINTER(data->partition), offset);
+        }
+    }
+
+  GHashTableIter iter;
+  gpointer partition, offset;
+
+  g_mutex_lock(&owner->topic_lock);
+  if (!owner->topic && g_hash_table_size(committable) > 0)
+    msg_debug("kafka: source already deinitialized, not storing acknowledged offsets",
+              evt_tag_str("topic", owner->topic_name),
+              evt_tag_int("partitions", g_hash_table_size(committable)));
+
+  g_hash_table_iter_init(&iter, committable);
+  while (owner->topic && g_hash_table_iter_next(&iter, &partition, &offset))
+    {
+      rd_kafka_resp_err_t err = rd_kafka_offset_store(owner->topic, GPOINTER_TO_INT(partition), *(gint64 *) offset);
+      if (err != RD_KAFKA_RESP_ERR_NO_ERROR)
+        msg_debug("kafka: error storing offset",
+                  evt_tag_str("topic", owner->topic_name),
+                  evt_tag_int("partition", GPOINTER_TO_INT(partition)),
+                  evt_tag_long("offset", *(gint64 *) offset),
+                  evt_tag_str("error", rd_kafka_err2str(err)));
+    }
+  g_mutex_unlock(&owner->topic_lock);
+  g_hash_table_unref(committable);
+}
+
+static void
+_free(LogPipe *s)
+{
+  KafkaSourceWorker *self = (KafkaSourceWorker *) s;
+
+  g_hash_table_unref(self->offsets);
+  g_mutex_clear(&self->offsets_lock);
+  g_array_free(self->partitions, TRUE);
+  g_cond_clear(&self->exit_cond);
+  g_mutex_clear(&self->exit_lock);
+
+  log_threaded_source_worker_free(s);
+}
+
+LogThreadedSourceWorker *
+kafka_source_worker_new(LogThreadedSourceDriver *owner, gint worker_index)
+{
+  KafkaSourceWorker *self = g_new0(KafkaSourceWorker, 1);
+
+  log_threaded_source_worker_init_instance(&self->super, owner, worker_index);
+  self->super.thread_init = _thread_init;
+  self->super.thread_deinit = _thread_deinit;
+  self->super.run = _worker_run;
+  self->super.request_exit = _request_exit;
+  self->super.super.super.free_fn = _free;
+
+  self->partitions = g_array_new(FALSE, FALSE, sizeof(gint32));
+  self->offsets = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                        (GDestroyNotify) kafka_offset_tracker_free);
+  g_mutex_init(&self->offsets_lock);
+  g_mutex_init(&self->exit_lock);
+  g_cond_init(&self->exit_cond);
+
+  handle_kafka_topic = log_msg_get_value_handle(".kafka.topic");
+  handle_kafka_partition = log_msg_get_value_handle(".kafka.partition");
+  handle_kafka_offset = log_msg_get_value_handle(".kafka.offset");
+  handle_kafka_key = log_msg_get_value_handle(".kafka.key");
+
+  return &self->super;
+}
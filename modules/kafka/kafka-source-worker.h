@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef KAFKA_SOURCE_WORKER_H_INCLUDED
+#define KAFKA_SOURCE_WORKER_H_INCLUDED
+
+#include "logthrsource/logthrsourcedrv.h"
+#include <librdkafka/rdkafka.h>
+
+/*
+ * Each worker consumes a group of partitions (those where partition %
+ * num_workers == worker_index) through its own librdkafka queue.
+ */
+typedef struct _KafkaSourceWorker
+{
+  LogThreadedSourceWorker super;
+  rd_kafka_queue_t *queue;
+  rd_kafka_message_t **batch;
+  GArray *partitions;
+  gboolean partitions_started;
+
+  /* partition -> KafkaOffsetTracker, accessed from the ack callbacks as well */
+  GMutex offsets_lock;
+  GHashTable *offsets;
+
+  GMutex exit_lock;
+  GCond exit_cond;
+  gboolean exit_requested;
+} KafkaSourceWorker;
+
+LogThreadedSourceWorker *kafka_source_worker_new(LogThreadedSourceDriver *owner, gint worker_index);
+void kafka_source_worker_on_batch_acked(GList *ack_records, gpointer user_data);
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "kafka-offset-tracker.h"
+
+Test(kafka_offset_tracker, test_in_order_acks_advance_the_commit_point)
+{
+  KafkaOffsetTracker *tracker = kafka_offset_tracker_new();
+  gint64 committable = -1;
+
+  for (gint64 offset = 10; offset < 13; offset++)
+    kafka_offset_tracker_track(tracker, offset);
+
+  cr_assert(kafka_offset_tracker_ack(tracker, 10, &committable));
+  cr_assert_eq(committable, 10);
+  cr_assert(kafka_offset_tracker_ack(tracker, 11, &committable));
+  cr_assert_eq(committable, 11);
+  cr_assert(kafka_offset_tracker_ack(tracker, 12, &committable));
+  cr_assert_eq(committable, 12);
+  cr_assert_eq(kafka_offset_tracker_get_inflight(tracker), 0);
+
+  kafka_offset_tracker_free(tracker);
+}
+
+Test(kafka_offset_tracker, test_out_of_order_acks_wait_for_predecessors)
+{
+  KafkaOffsetTracker *tracker = kafka_offset_tracker_new();
+  gint64 committable = -1;
+
+  for (gint64 offset = 0; offset < 4; offset++)
+    kafka_offset_tracker_track(tracker, offset);
+
+  cr_assert_not(kafka_offset_tracker_ack(tracker, 2, &committable));
+  cr_assert_not(kafka_offset_tracker_ack(tracker, 1, &committable));
+  cr_assert_eq(committable, -1);
+  cr_assert_eq(kafka_offset_tracker_get_inflight(tracker), 4);
+
+  cr_assert(kafka_offset_tracker_ack(tracker, 0, &committable));
+  cr_assert_eq(committable, 2);
+  cr_assert_eq(kafka_offset_tracker_get_inflight(tracker), 1);
+
+  kafka_offset_tracker_free(tracker);
+}
+
+Test(kafka_offset_tracker, test_gaps_in_offsets_do_not_block_the_commit_point)
+{
+  KafkaOffsetTracker *tracker = kafka_offset_tracker_new();
+  gint64 committable = -1;
+
+  /* compacted topics and transaction markers leave holes in the offset space */
+  kafka_offset_tracker_track(tracker, 5);
+  kafka_offset_tracker_track(tracker, 9);
+  kafka_offset_tracker_track(tracker, 42);
+
+  cr_assert_not(kafka_offset_tracker_ack(tracker, 42, &committable));
+  cr_assert(kafka_offset_tracker_ack(tracker, 5, &committable));
+  cr_assert_eq(committable, 5);
+  cr_assert(kafka_offset_tracker_ack(tracker, 9, &committable));
+  cr_assert_eq(committable, 42);
+
+  kafka_offset_tracker_free(tracker);
+}
+
+Test(kafka_offset_tracker, test_unknown_offsets_are_ignored)
+{
+  KafkaOffsetTracker *tracker = kafka_offset_tracker_new();
+  gint64 committable = -1;
+
+  kafka_offset_tracker_track(tracker, 1);
+
+  cr_assert_not(kafka_offset_tracker_ack(tracker, 0, &committable));
+  cr_assert(kafka_offset_tracker_ack(tracker, 1, &committable));
+  cr_assert_not(kafka_offset_tracker_ack(tracker, 1, &committable));
+  cr_assert_eq(committable, 1);
+
+  kafka_offset_tracker_free(tracker);
+}
+
+Test(kafka_offset_tracker, test_rewinding_offsets_discard_the_redelivered_ones)
+{
+  KafkaOffsetTracker *tracker = kafka_offset_tracker_new();
+  gint64 committable = -1;
+
+  for (gint64 offset = 10; offset < 15; offset++)
+    kafka_offset_tracker_track(tracker, offset);
+
+  cr_assert(kafka_offset_tracker_ack(tracker, 10, &committable));
+  cr_assert_not(kafka_offset_tracker_ack(tracker, 13, &committable));
+
+  /* e.g. a rebalance: 12.. are delivered again */
+  kafka_offset_tracker_track(tracker, 12);
+  cr_assert_eq(kafka_offset_tracker_get_inflight(tracker), 2);
+
+  /* the ack of the first delivery of 14 no longer exists */
+  cr_assert_not(kafka_offset_tracker_ack(tracker, 14, &committable));
+  cr_assert(kafka_offset_tracker_ack(tracker, 11, &committable));
+  cr_assert_eq(committable, 11);
+  cr_assert(kafka_offset_tracker_ack(tracker, 12, &committable));
+  cr_assert_eq(committable, 12);
+
+  /* e.g. auto.offset.reset to the beginning, below everything in flight */
+  kafka_offset_tracker_track(tracker, 20);
+  kafka_offset_tracker_track(tracker, 21);
+  kafka_offset_tracker_track(tracker, 0);
+  cr_assert_eq(kafka_offset_tracker_get_inflight(tracker), 1);
+  cr_assert_not(kafka_offset_tracker_ack(tracker, 20, &committable));
+  cr_assert(kafka_offset_tracker_ack(tracker, 0, &committable));
+  cr_assert_eq(committable, 0);
+  cr_assert_eq(kafka_offset_tracker_get_inflight(tracker), 0);
+
+  kafka_offset_tracker_free(tracker);
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "kafka-source-driver.h"
+#include "kafka-props.h"
+#include "apphook.h"
+#include "mainloop.h"
+#include "mainloop-worker.h"
+#include "logsource.h"
+#include "timeutils/misc.h"
+
+#include <librdkafka/rdkafka.h>
+
+#ifdef SYSLOG_NG_HAVE_RD_KAFKA_MOCK_CLUSTER_NEW
+
+#include <librdkafka/rdkafka_mock.h>
+
+#define TEST_TOPIC "syslog-ng-perf"
+#define TEST_PARTITIONS 8
+#define TEST_MESSAGES 200000
+
+MainLoopOptions main_loop_options = {0};
+MainLoop *main_loop;
+
+static GMutex received_lock;
+static GCond received_cond;
+static gint received;
+
+static void
+_source_queue_mock(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  g_mutex_lock(&received_lock);
+  received++;
+  g_cond_signal(&received_cond);
+  g_mutex_unlock(&received_lock);
+
+  log_pipe_forward_msg(s, msg, path_options);
+}
+
+typedef struct _HeldMessage
+{
+  LogMessage *msg;
+  LogPathOptions path_options;
+} HeldMessage;
+
+static GArray *held_messages;
+
+static void
+_source_queue_hold(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  HeldMessage held = { .msg = msg, .path_options = *path_options };
+
+  g_mutex_lock(&received_lock);
+  g_array_append_val(held_messages, held);
+  received++;
+  g_cond_signal(&received_cond);
+  g_mutex_unlock(&received_lock);
+}
+
+static void
+_ack_held_messages(void)
+{
+  for (guint i = 0; i < held_messages->len; i++)
+    {
+      HeldMessage *held = &g_array_index(held_messages, HeldMessage, i);
+
+      log_msg_ack(held->msg, &held->path_options, AT_PROCESSED);
+      log_msg_unref(held->msg);
+    }
+  g_array_set_size(held_messages, 0);
+}
+
+static rd_kafka_t *
+_create_mock_cluster(rd_kafka_mock_cluster_t **mcluster)
+{
+  gchar errbuf[512];
+  rd_kafka_conf_t *conf = rd_kafka_conf_new();
+
+  cr_assert_eq(rd_kafka_conf_set(conf, "test.mock.num.brokers", "1", errbuf, sizeof(errbuf)), RD_KAFKA_CONF_OK);
+  rd_kafka_t *producer = rd_kafka_new(RD_KAFKA_PRODUCER, conf, errbuf, sizeof(errbuf));
+  cr_assert(producer, "%s", errbuf);
+
+  *mcluster = rd_kafka_handle_mock_cluster(producer);
+  cr_assert_eq(rd_kafka_mock_topic_create(*mcluster, TEST_TOPIC, TEST_PARTITIONS, 1), RD_KAFKA_RESP_ERR_NO_ERROR);
+  return producer;
+}
+
+static void
+_produce_messages(rd_kafka_t *producer, gint count)
+{
+  gchar payload[128];
+
+  for (gint i = 0; i < count; i++)
+    {
+      gint len = g_snprintf(payload, sizeof(payload), "test message #%d from the mock cluster", i);
+      rd_kafka_resp_err_t err;
+
+      while ((err = rd_kafka_producev(producer,
+                                      RD_KAFKA_V_TOPIC(TEST_TOPIC),
+                                      RD_KAFKA_V_PARTITION(i % TEST_PARTITIONS),
+                                      RD_KAFKA_V_VALUE(payload, len),
+                                      RD_KAFKA_V_MSGFLAGS(RD_KAFKA_MSG_F_COPY),
+                                      RD_KAFKA_V_END)) == RD_KAFKA_RESP_ERR__QUEUE_FULL)
+        rd_kafka_poll(producer, 10);
+      cr_assert_eq(err, RD_KAFKA_RESP_ERR_NO_ERROR);
+    }
+  cr_assert_eq(rd_kafka_flush(producer, 30000), RD_KAFKA_RESP_ERR_NO_ERROR);
+}
+
+static LogDriver *
+_create_source(rd_kafka_mock_cluster_t *mcluster, gint workers)
+{
+  LogDriver *driver = kafka_sd_new(main_loop_get_current_config(main_loop));
+
+  kafka_sd_set_topic(driver, TEST_TOPIC);
+  kafka_sd_set_bootstrap_servers(driver, rd_kafka_mock_cluster_bootstraps(mcluster));
+  kafka_sd_merge_config(driver, g_list_prepend(NULL, kafka_property_new("auto.offset.reset", "earliest")));
+  log_threaded_source_driver_set_num_workers(driver, workers);
+
+  gchar persist_name[64];
+  g_snprintf(persist_name, sizeof(persist_name), "kafka-perf-%d", workers);
+  log_pipe_set_persist_name(&driver->super, persist_name);
+  return driver;
+}
+
+static void
+_start_source_with_queue(LogDriver *driver, void (*queue)(LogPipe *, LogMessage *, const LogPathOptions *))
+{
+  KafkaSourceDriver *self = (KafkaSourceDriver *) driver;
+
+  cr_assert(log_pipe_init(&driver->super));
+  for (gint i = 0; i < self->super.num_workers; i++)
+    self->super.workers[i]->super.super.queue = queue;
+  cr_assert(log_pipe_post_config_init(&driver->super));
+}
+
+static void
+_start_source(LogDriver *driver)
+{
+  _start_source_with_queue(driver, _source_queue_mock);
+}
+
+static void
+_wait_for_messages(gint count)
+{
+  g_mutex_lock(&received_lock);
+  while (received < count)
+    g_cond_wait(&received_cond, &received_lock);
+  g_mutex_unlock(&received_lock);
+}
+
+static void
+_deinit_source(LogDriver *driver)
+{
+  main_loop_sync_worker_startup_and_teardown();
+  cr_assert(log_pipe_deinit(&driver->super));
+}
+
+static void
+_stop_source(LogDriver *driver)
+{
+  _deinit_source(driver);
+  log_pipe_unref(&driver->super);
+}
+
+static void
+_measure_throughput(gint workers)
+{
+  rd_kafka_mock_cluster_t *mcluster;
+  rd_kafka_t *producer = _create_mock_cluster(&mcluster);
+  struct timespec start, end;
+
+  _produce_messages(producer, TEST_MESSAGES);
+
+  received = 0;
+  LogDriver *driver = _create_source(mcluster, workers);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  _start_source(driver);
+  _wait_for_messages(TEST_MESSAGES);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  _stop_source(driver);
+  cr_assert_eq(received, TEST_MESSAGES);
+
+  printf("kafka() source, %d partitions, %d workers: %12.3f msg/sec\n", TEST_PARTITIONS, workers,
+         TEST_MESSAGES * 1e6 / timespec_diff_usec(&end, &start));
+
+  rd_kafka_destroy(producer);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  main_loop = main_loop_get_instance();
+  main_loop_init(main_loop, &main_loop_options);
+  g_mutex_init(&received_lock);
+  g_cond_init(&received_cond);
+  held_messages = g_array_new(FALSE, FALSE, sizeof(HeldMessage));
+}
+
+static void
+teardown(void)
+{
+  g_array_free(held_messages, TRUE);
+  g_cond_clear(&received_cond);
+  g_mutex_clear(&received_lock);
+  main_loop_deinit(main_loop);
+  app_shutdown();
+}
+
+TestSuite(kafka_source_perf, .init = setup, .fini = teardown, .timeout = 120);
+
+Test(kafka_source_perf, test_single_worker_throughput)
+{
+  _measure_throughput(1);
+}
+
+Test(kafka_source_perf, test_partition_group_workers_throughput)
+{
+  _measure_throughput(4);
+}
+
+/* two full ack batches (the offset store batch size is 1024) */
+#define TEST_HELD_MESSAGES 2048
+
+Test(kafka_source_perf, test_acks_arriving_after_deinit_are_not_stored)
+{
+  rd_kafka_mock_cluster_t *mcluster;
+  rd_kafka_t *producer = _create_mock_cluster(&mcluster);
+
+  _produce_messages(producer, TEST_HELD_MESSAGES);
+
+  received = 0;
+  LogDriver *driver = _create_source(mcluster, 1);
+  KafkaSourceDriver *self = (KafkaSourceDriver *) driver;
+
+  _start_source_with_queue(driver, _source_queue_hold);
+  _wait_for_messages(TEST_HELD_MESSAGES);
+  _deinit_source(driver);
+
+  cr_assert_null(self->topic);
+  cr_assert_null(self->kafka);
+
+  /* completes full batches, which reach the offset store of the deinitialized driver */
+  _ack_held_messages();
+
+  log_pipe_unref(&driver->super);
+  rd_kafka_destroy(producer);
+}
+
+#else
+
+Test(kafka_source_perf, test_mock_cluster_not_available, .disabled = true)
+{
+}
+
+#endif
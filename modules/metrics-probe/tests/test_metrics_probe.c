@@ -26,6 +26,7 @@
 #include "metrics-probe-test.h"
 #include "apphook.h"
 #include "stats/stats-cluster-single.h"
+#include "metrics/dyn-metrics-store.h"
 
 static void
 _add_label(LogParser *s, const gchar *label, const gchar *value_template_str)
@@ -236,11 +237,136 @@ Test(metrics_probe, test_metrics_probe_stats_max_dynamics)
   cr_assert_not(metrics_probe_test_stats_cluster_exists("custom_key", expected_labels_2,
                                                         G_N_ELEMENTS(expected_labels_2)));
 
+  StatsClusterLabel overflow_labels[] =
+  {
+    stats_cluster_label("overflow", "true"),
+  };
+  StatsClusterKey overflow_key;
+  stats_cluster_single_key_set(&overflow_key, "custom_key", overflow_labels, G_N_ELEMENTS(overflow_labels));
+
+  stats_lock();
+  StatsCluster *overflow_cluster = stats_get_cluster(&overflow_key);
+  cr_assert(overflow_cluster, "Refused series are expected to be collected into the overflow series");
+  cr_assert_eq(stats_counter_get(stats_cluster_single_get_counter(overflow_cluster)), 1);
+  stats_unlock();
+
   log_msg_unref(msg);
   log_pipe_deinit(&metrics_probe->super);
   log_pipe_unref(&metrics_probe->super);
 }
 
+Test(metrics_probe, test_metrics_probe_dynamic_metrics_limit)
+{
+  configuration->stats_options.dynamic_metrics_limit = 1;
+  stats_reinit(&configuration->stats_options);
+
+  LogParser *tmp_metrics_probe = metrics_probe_new(configuration);
+  dyn_metrics_template_set_key(metrics_probe_get_metrics_template(tmp_metrics_probe), "custom_key");
+  _add_label(tmp_metrics_probe, "test_label", "${test_field}");
+
+  LogParser *metrics_probe = (LogParser *) log_pipe_clone(&tmp_metrics_probe->super);
+  log_pipe_unref(&tmp_metrics_probe->super);
+  cr_assert(log_pipe_init(&metrics_probe->super), "Failed to init metrics-probe");
+
+  StatsClusterLabel labels_1[] =
+  {
+    stats_cluster_label("test_label", "test_value_1"),
+  };
+  StatsClusterKey key_1;
+  stats_cluster_single_key_set(&key_1, "custom_key", labels_1, G_N_ELEMENTS(labels_1));
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value_by_name(msg, "test_field", "test_value_1", -1);
+  cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+
+  stats_lock();
+  cr_assert_not(stats_cluster_is_orphaned(stats_get_cluster(&key_1)));
+  stats_unlock();
+
+  log_msg_unref(msg);
+  msg = log_msg_new_empty();
+  log_msg_set_value_by_name(msg, "test_field", "test_value_2", -1);
+  cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+
+  /* the least recently used series got evicted, but it is kept until its lifetime expires */
+  stats_lock();
+  cr_assert(stats_cluster_is_orphaned(stats_get_cluster(&key_1)));
+  stats_unlock();
+
+  log_msg_unref(msg);
+  msg = log_msg_new_empty();
+  log_msg_set_value_by_name(msg, "test_field", "test_value_1", -1);
+  cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+
+  metrics_probe_test_assert_counter_value("custom_key", labels_1, G_N_ELEMENTS(labels_1), 2);
+
+  log_msg_unref(msg);
+  log_pipe_deinit(&metrics_probe->super);
+  log_pipe_unref(&metrics_probe->super);
+}
+
+Test(metrics_probe, test_metrics_probe_dynamic_metrics_limit_zero_is_unlimited)
+{
+  configuration->stats_options.dynamic_metrics_limit = 0;
+  stats_reinit(&configuration->stats_options);
+
+  LogParser *tmp_metrics_probe = metrics_probe_new(configuration);
+  dyn_metrics_template_set_key(metrics_probe_get_metrics_template(tmp_metrics_probe), "custom_key");
+  _add_label(tmp_metrics_probe, "test_label", "${test_field}");
+
+  LogParser *metrics_probe = (LogParser *) log_pipe_clone(&tmp_metrics_probe->super);
+  log_pipe_unref(&tmp_metrics_probe->super);
+  cr_assert(log_pipe_init(&metrics_probe->super), "Failed to init metrics-probe");
+
+  StatsClusterLabel labels_1[] =
+  {
+    stats_cluster_label("test_label", "test_value_1"),
+  };
+  StatsClusterKey key_1;
+  stats_cluster_single_key_set(&key_1, "custom_key", labels_1, G_N_ELEMENTS(labels_1));
+
+  const gchar *values[] = { "test_value_1", "test_value_2", "test_value_3" };
+  for (guint i = 0; i < G_N_ELEMENTS(values); i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      log_msg_set_value_by_name(msg, "test_field", values[i], -1);
+      cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+      log_msg_unref(msg);
+    }
+
+  stats_lock();
+  cr_assert_not(stats_cluster_is_orphaned(stats_get_cluster(&key_1)));
+  stats_unlock();
+
+  log_pipe_deinit(&metrics_probe->super);
+  log_pipe_unref(&metrics_probe->super);
+}
+
+Test(metrics_probe, test_dynamic_metrics_limit_does_not_apply_to_internal_stores)
+{
+  configuration->stats_options.dynamic_metrics_limit = 1;
+  stats_reinit(&configuration->stats_options);
+
+  DynMetricsStore *store = dyn_metrics_store_new();
+
+  StatsClusterLabel labels_1[] = { stats_cluster_label("queue", "1") };
+  StatsClusterLabel labels_2[] = { stats_cluster_label("queue", "2") };
+  StatsClusterKey key_1, key_2;
+  stats_cluster_single_key_set(&key_1, "internal_key", labels_1, G_N_ELEMENTS(labels_1));
+  stats_cluster_single_key_set(&key_2, "internal_key", labels_2, G_N_ELEMENTS(labels_2));
+
+  StatsCounterItem *counter_1 = dyn_metrics_store_retrieve_counter(store, &key_1, STATS_LEVEL0);
+  dyn_metrics_store_retrieve_counter(store, &key_2, STATS_LEVEL0);
+  cr_assert_eq(dyn_metrics_store_get_size(store), 2);
+  cr_assert_eq(dyn_metrics_store_retrieve_counter(store, &key_1, STATS_LEVEL0), counter_1);
+
+  stats_lock();
+  cr_assert_not(stats_cluster_is_orphaned(stats_get_cluster(&key_1)));
+  stats_unlock();
+
+  dyn_metrics_store_free(store);
+}
+
 Test(metrics_probe, test_metrics_probe_increment)
 {
   LogParser *tmp_metrics_probe = metrics_probe_new(configuration);
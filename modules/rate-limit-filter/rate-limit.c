@@ -21,99 +21,22 @@
  */
 
 #include "rate-limit.h"
-#include "timeutils/misc.h"
+#include "rate-limiter-map.h"
 #include "scratch-buffers.h"
 #include "str-utils.h"
 #include <iv.h>
 
+/* a limiter whose bucket has been full for this long is dropped */
+#define RATE_LIMIT_IDLE_TIME_NSEC (10 * (gint64) 1000000000)
+
 typedef struct _RateLimit
 {
   FilterExprNode super;
   LogTemplate *key_template;
   gint rate;
-  GMutex map_lock;
-  GHashTable *rate_limits;
+  RateLimiterMap *rate_limits;
 } RateLimit;
 
-typedef struct _RateLimiter
-{
-  gint tokens;
-  gint rate;
-  struct timespec last_check;
-  GMutex lock;
-} RateLimiter;
-
-static RateLimiter *
-rate_limiter_new(gint rate)
-{
-  RateLimiter *self = g_new0(RateLimiter, 1);
-
-  iv_validate_now();
-  self->last_check = iv_now;
-  g_mutex_init(&self->lock);
-  self->rate = rate;
-  self->tokens = rate;
-
-  return self;
-}
-
-static void
-rate_limiter_free(RateLimiter *self)
-{
-  g_mutex_clear(&self->lock);
-  g_free(self);
-}
-
-static void
-rate_limiter_add_new_tokens(RateLimiter *self)
-{
-  glong usec_since_last_fill;
-  gint num_new_tokens;
-  struct timespec now;
-
-  iv_validate_now();
-  now = iv_now;
-  g_mutex_lock(&self->lock);
-  {
-    usec_since_last_fill = timespec_diff_usec(&now, &self->last_check);
-
-    num_new_tokens = (usec_since_last_fill * self->rate) / G_USEC_PER_SEC;
-    if (num_new_tokens)
-      {
-        self->tokens = MIN(self->rate, self->tokens + num_new_tokens);
-        self->last_check = now;
-      }
-  }
-  g_mutex_unlock(&self->lock);
-}
-
-static gboolean
-rate_limiter_try_consume_tokens(RateLimiter *self, gint num_tokens)
-{
-  gboolean within_ratelimit;
-  g_mutex_lock(&self->lock);
-  {
-    if (self->tokens >= num_tokens)
-      {
-        self->tokens -= num_tokens;
-        within_ratelimit = TRUE;
-      }
-    else
-      {
-        within_ratelimit = FALSE;
-      }
-  }
-  g_mutex_unlock(&self->lock);
-  return within_ratelimit;
-}
-
-static gboolean
-rate_limiter_process_new_logs(RateLimiter *self, gint num_new_logs)
-{
-  rate_limiter_add_new_tokens(self);
-  return rate_limiter_try_consume_tokens(self, num_new_logs);
-}
-
 static const gchar *
 rate_limit_generate_key(FilterExprNode *s, LogMessage *msg, LogTemplateEvalOptions *options, gssize *len)
 {
@@ -148,21 +71,8 @@ rate_limit_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateE
   const gchar *key = rate_limit_generate_key(s, msg, options, &len);
   APPEND_ZERO(key, key, len);
 
-  RateLimiter *rl;
-
-  g_mutex_lock(&self->map_lock);
-  {
-    rl = g_hash_table_lookup(self->rate_limits, key);
-
-    if (!rl)
-      {
-        rl = rate_limiter_new(self->rate);
-        g_hash_table_insert(self->rate_limits, g_strdup(key), rl);
-      }
-  }
-  g_mutex_unlock(&self->map_lock);
-
-  return rate_limiter_process_new_logs(rl, num_msg) ^ s->comp;
+  iv_validate_now();
+  return rate_limiter_map_process(self->rate_limits, key, num_msg, rate_limiter_timespec_to_nsec(&iv_now)) ^ s->comp;
 }
 
 static void
@@ -171,8 +81,8 @@ rate_limit_free(FilterExprNode *s)
   RateLimit *self = (RateLimit *) s;
 
   log_template_unref(self->key_template);
-  g_hash_table_destroy(self->rate_limits);
-  g_mutex_clear(&self->map_lock);
+  if (self->rate_limits)
+    rate_limiter_map_free(self->rate_limits);
 }
 
 static gboolean
@@ -186,6 +96,9 @@ rate_limit_init(FilterExprNode *s, GlobalConfig *cfg)
       return FALSE;
     }
 
+  if (!self->rate_limits)
+    self->rate_limits = rate_limiter_map_new(self->rate, RATE_LIMIT_IDLE_TIME_NSEC);
+
   return TRUE;
 }
 
@@ -226,8 +139,6 @@ rate_limit_new(void)
   self->super.eval = rate_limit_eval;
   self->super.free_fn = rate_limit_free;
   self->super.clone = rate_limit_clone;
-  g_mutex_init(&self->map_lock);
-  self->rate_limits = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)rate_limiter_free);
 
   return &self->super;
 }
@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "rate-limiter-map.h"
+
+#include <string.h>
+
+/*
+ * The map is split into stripes by the high bits of the hash, each stripe
+ * is a chained hash table whose bucket array is indexed by the low bits.
+ *
+ * Readers walk the chains without locking, writers (insertion, eviction,
+ * resizing) hold the lock of the stripe.  Memory that readers may still
+ * reference (unlinked nodes, old bucket arrays) is only freed after a
+ * grace period: readers register themselves in one of two counters
+ * selected by the parity of the stripe's epoch, a writer flips the epoch
+ * and waits for the counter of the previous epoch to drop to zero.
+ * Readers entering after the flip cannot see the unlinked memory anymore.
+ *
+ * Resizing relinks existing nodes into a new bucket array, which may make
+ * a concurrent reader miss its key.  A miss always falls back to the
+ * locked lookup, so this is harmless.
+ */
+
+#define RATE_LIMITER_MAP_STRIPE_BITS 6
+#define RATE_LIMITER_MAP_NUM_STRIPES (1 << RATE_LIMITER_MAP_STRIPE_BITS)
+#define RATE_LIMITER_MAP_INITIAL_BUCKETS 64
+#define RATE_LIMITER_MAP_MAX_LOAD_FACTOR 2
+
+typedef struct _RateLimiterMapNode RateLimiterMapNode;
+struct _RateLimiterMapNode
+{
+  RateLimiterMapNode *next;
+  /* list of nodes waiting for the grace period, readers may still follow next */
+  RateLimiterMapNode *retired_next;
+  guint hash;
+  RateLimiter limiter;
+  gchar key[];
+};
+
+typedef struct _RateLimiterMapTable
+{
+  guint mask;
+  RateLimiterMapNode *buckets[];
+} RateLimiterMapTable;
+
+typedef struct _RateLimiterMapStripe
+{
+  GMutex lock;
+  RateLimiterMapTable *table;
+  gsize num_entries;
+  gint epoch;
+  gint readers[2];
+} RateLimiterMapStripe;
+
+struct _RateLimiterMap
+{
+  RateLimiterRate rate;
+  gint64 idle_time;
+  gint next_eviction;
+  gint eviction_cursor;
+  RateLimiterMapStripe *stripes[RATE_LIMITER_MAP_NUM_STRIPES];
+};
+
+static inline guint
+_hash_key(const gchar *key)
+{
+  guint h = g_str_hash(key);
+
+  /* g_str_hash() mixes the high bits poorly for short keys, the stripe
+   * is selected by those */
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+static RateLimiterMapTable *
+_table_new(guint num_buckets)
+{
+  RateLimiterMapTable *self = g_malloc0(sizeof(RateLimiterMapTable) + num_buckets * sizeof(self->buckets[0]));
+
+  self->mask = num_buckets - 1;
+  return self;
+}
+
+static RateLimiterMapNode *
+_node_new(const gchar *key, guint hash, gint64 now)
+{
+  gsize key_len = strlen(key);
+  RateLimiterMapNode *self = g_malloc(sizeof(RateLimiterMapNode) + key_len + 1);
+
+  self->next = NULL;
+  self->retired_next = NULL;
+  self->hash = hash;
+  rate_limiter_init(&self->limiter, now);
+  memcpy(self->key, key, key_len + 1);
+  return self;
+}
+
+static void
+_node_free(RateLimiterMapNode *self)
+{
+  rate_limiter_deinit(&self->limiter);
+  g_free(self);
+}
+
+static RateLimiterMapNode *
+_table_find_node(RateLimiterMapTable *table, const gchar *key, guint hash)
+{
+  RateLimiterMapNode *node = g_atomic_pointer_get(&table->buckets[hash & table->mask]);
+
+  while (node)
+    {
+      if (node->hash == hash && strcmp(node->key, key) == 0)
+        return node;
+      node = g_atomic_pointer_get(&node->next);
+    }
+  return NULL;
+}
+
+static gint
+_stripe_reader_enter(RateLimiterMapStripe *self)
+{
+  while (TRUE)
+    {
+      gint ndx = g_atomic_int_get(&self->epoch) & 1;
+
+      g_atomic_int_inc(&self->readers[ndx]);
+
+      /* if the epoch was flipped in the meantime, the writer may not wait
+       * for us, retry with the new epoch */
+      if ((g_atomic_int_get(&self->epoch) & 1) == ndx)
+        return ndx;
+      g_atomic_int_add(&self->readers[ndx], -1);
+    }
+}
+
+static void
+_stripe_reader_exit(RateLimiterMapStripe *self, gint ndx)
+{
+  g_atomic_int_add(&self->readers[ndx], -1);
+}
+
+/* NOTE: must be called with the stripe lock held */
+static void
+_stripe_wait_for_readers(RateLimiterMapStripe *self)
+{
+  gint epoch = self->epoch;
+
+  g_atomic_int_set(&self->epoch, epoch + 1);
+  while (g_atomic_int_get(&self->readers[epoch & 1]) > 0)
+    g_thread_yield();
+}
+
+/* NOTE: must be called with the stripe lock held */
+static void
+_stripe_resize(RateLimiterMapStripe *self)
+{
+  RateLimiterMapTable *old_table = self->table;
+  RateLimiterMapTable *new_table = _table_new((old_table->mask + 1) * 2);
+
+  for (guint i = 0; i <= old_table->mask; i++)
+    {
+      RateLimiterMapNode *node = old_table->buckets[i];
+
+      while (node)
+        {
+          RateLimiterMapNode *next = node->next;
+          RateLimiterMapNode **new_head = &new_table->buckets[node->hash & new_table->mask];
+
+          g_atomic_pointer_set(&node->next, *new_head);
+          *new_head = node;
+          node = next;
+        }
+    }
+
+  g_atomic_pointer_set(&self->table, new_table);
+  _stripe_wait_for_readers(self);
+  g_free(old_table);
+}
+
+/* NOTE: must be called with the stripe lock held */
+static RateLimiterMapNode *
+_stripe_insert_node(RateLimiterMapStripe *self, const gchar *key, guint hash, gint64 now)
+{
+  RateLimiterMapNode *node = _node_new(key, hash, now);
+  RateLimiterMapNode **head = &self->table->buckets[hash & self->table->mask];
+
+  node->next = *head;
+  /* publishes the fully initialized node to readers */
+  g_atomic_pointer_set(head, node);
+  self->num_entries++;
+
+  if (self->num_entries > (self->table->mask + 1) * RATE_LIMITER_MAP_MAX_LOAD_FACTOR)
+    _stripe_resize(self);
+  return node;
+}
+
+static void
+_stripe_evict_idle(RateLimiterMapStripe *self, gint64 now, gint64 idle_time)
+{
+  RateLimiterMapNode *retired = NULL;
+
+  g_mutex_lock(&self->lock);
+  RateLimiterMapTable *table = self->table;
+  for (guint i = 0; i <= table->mask; i++)
+    {
+      RateLimiterMapNode **prev = &table->buckets[i];
+      RateLimiterMapNode *node = *prev;
+
+      while (node)
+        {
+          if (rate_limiter_try_evict(&node->limiter, now, idle_time))
+            {
+              g_atomic_pointer_set(prev, node->next);
+              node->retired_next = retired;
+              retired = node;
+              self->num_entries--;
+            }
+          else
+            {
+              prev = &node->next;
+            }
+          node = node->next;
+        }
+    }
+
+  if (retired)
+    _stripe_wait_for_readers(self);
+  g_mutex_unlock(&self->lock);
+
+  while (retired)
+    {
+      RateLimiterMapNode *next = retired->retired_next;
+      _node_free(retired);
+      retired = next;
+    }
+}
+
+static RateLimiterMapStripe *
+_stripe_new(void)
+{
+  RateLimiterMapStripe *self = g_new0(RateLimiterMapStripe, 1);
+
+  g_mutex_init(&self->lock);
+  self->table = _table_new(RATE_LIMITER_MAP_INITIAL_BUCKETS);
+  return self;
+}
+
+static void
+_stripe_free(RateLimiterMapStripe *self)
+{
+  for (guint i = 0; i <= self->table->mask; i++)
+    {
+      RateLimiterMapNode *node = self->table->buckets[i];
+
+      while (node)
+        {
+          RateLimiterMapNode *next = node->next;
+          _node_free(node);
+          node = next;
+        }
+    }
+  g_free(self->table);
+  g_mutex_clear(&self->lock);
+  g_free(self);
+}
+
+static gboolean
+_try_consume_without_locking(RateLimiterMap *self, RateLimiterMapStripe *stripe, const gchar *key, guint hash,
+                             gint num_tokens, gint64 now, RateLimiterResult *result)
+{
+  gint reader_ndx = _stripe_reader_enter(stripe);
+  RateLimiterMapNode *node = _table_find_node(g_atomic_pointer_get(&stripe->table), key, hash);
+
+  if (node)
+    *result = rate_limiter_try_consume(&node->limiter, &self->rate, num_tokens, now);
+  _stripe_reader_exit(stripe, reader_ndx);
+
+  return node && *result != RATE_LIMITER_EVICTED;
+}
+
+static RateLimiterResult
+_consume_with_locking(RateLimiterMap *self, RateLimiterMapStripe *stripe, const gchar *key, guint hash,
+                      gint num_tokens, gint64 now)
+{
+  g_mutex_lock(&stripe->lock);
+
+  RateLimiterMapNode *node = _table_find_node(stripe->table, key, hash);
+  if (!node)
+    node = _stripe_insert_node(stripe, key, hash, now);
+
+  /* eviction happens under the stripe lock, nodes found here are alive */
+  RateLimiterResult result = rate_limiter_try_consume(&node->limiter, &self->rate, num_tokens, now);
+  g_assert(result != RATE_LIMITER_EVICTED);
+
+  g_mutex_unlock(&stripe->lock);
+  return result;
+}
+
+/* sweeps one stripe per second, in whichever thread notices first */
+static void
+_evict_idle_periodically(RateLimiterMap *self, gint64 now)
+{
+  gint now_sec = now / 1000000000;
+  gint next_eviction = g_atomic_int_get(&self->next_eviction);
+
+  if (now_sec < next_eviction)
+    return;
+
+  if (!g_atomic_int_compare_and_exchange(&self->next_eviction, next_eviction, now_sec + 1))
+    return;
+
+  guint stripe_ndx = ((guint) g_atomic_int_add(&self->eviction_cursor, 1)) % RATE_LIMITER_MAP_NUM_STRIPES;
+  _stripe_evict_idle(self->stripes[stripe_ndx], now, self->idle_time);
+}
+
+gboolean
+rate_limiter_map_process(RateLimiterMap *self, const gchar *key, gint num_tokens, gint64 now)
+{
+  guint hash = _hash_key(key);
+  RateLimiterMapStripe *stripe = self->stripes[hash >> (32 - RATE_LIMITER_MAP_STRIPE_BITS)];
+  RateLimiterResult result;
+
+  if (!_try_consume_without_locking(self, stripe, key, hash, num_tokens, now, &result))
+    result = _consume_with_locking(self, stripe, key, hash, num_tokens, now);
+
+  _evict_idle_periodically(self, now);
+  return result == RATE_LIMITER_ACCEPTED;
+}
+
+void
+rate_limiter_map_evict_idle(RateLimiterMap *self, gint64 now)
+{
+  for (gint i = 0; i < RATE_LIMITER_MAP_NUM_STRIPES; i++)
+    _stripe_evict_idle(self->stripes[i], now, self->idle_time);
+}
+
+gsize
+rate_limiter_map_get_size(RateLimiterMap *self)
+{
+  gsize size = 0;
+
+  for (gint i = 0; i < RATE_LIMITER_MAP_NUM_STRIPES; i++)
+    {
+      g_mutex_lock(&self->stripes[i]->lock);
+      size += self->stripes[i]->num_entries;
+      g_mutex_unlock(&self->stripes[i]->lock);
+    }
+  return size;
+}
+
+RateLimiterMap *
+rate_limiter_map_new(gint tokens_per_sec, gint64 idle_time)
+{
+  RateLimiterMap *self = g_new0(RateLimiterMap, 1);
+
+  rate_limiter_rate_init(&self->rate, tokens_per_sec);
+  self->idle_time = idle_time;
+  for (gint i = 0; i < RATE_LIMITER_MAP_NUM_STRIPES; i++)
+    self->stripes[i] = _stripe_new();
+  return self;
+}
+
+void
+rate_limiter_map_free(RateLimiterMap *self)
+{
+  for (gint i = 0; i < RATE_LIMITER_MAP_NUM_STRIPES; i++)
+    _stripe_free(self->stripes[i]);
+  g_free(self);
+}
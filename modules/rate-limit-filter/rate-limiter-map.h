@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef RATE_LIMITER_MAP_H_INCLUDED
+#define RATE_LIMITER_MAP_H_INCLUDED
+
+#include "rate-limiter.h"
+
+/*
+ * Concurrent map of RateLimiter instances, keyed by a string.
+ *
+ * Looking up an existing key takes no locks, only creating a new limiter
+ * locks the stripe the key belongs to.  Limiters that were idle for
+ * idle_time are evicted periodically, so that the map does not grow
+ * without bounds with high cardinality keys.
+ */
+typedef struct _RateLimiterMap RateLimiterMap;
+
+gboolean rate_limiter_map_process(RateLimiterMap *self, const gchar *key, gint num_tokens, gint64 now);
+void rate_limiter_map_evict_idle(RateLimiterMap *self, gint64 now);
+gsize rate_limiter_map_get_size(RateLimiterMap *self);
+
+RateLimiterMap *rate_limiter_map_new(gint tokens_per_sec, gint64 idle_time);
+void rate_limiter_map_free(RateLimiterMap *self);
+
+#endif
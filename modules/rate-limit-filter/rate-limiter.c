@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "rate-limiter.h"
+
+/* marks an evicted limiter, it is never accepted again */
+#define RATE_LIMITER_TAT_EVICTED G_MAXINT64
+
+void
+rate_limiter_rate_init(RateLimiterRate *rate, gint tokens_per_sec)
+{
+  g_assert(tokens_per_sec > 0);
+
+  rate->emission_interval = MAX(1000000000 / tokens_per_sec, 1);
+  rate->burst = rate->emission_interval * tokens_per_sec;
+}
+
+#if GLIB_SIZEOF_VOID_P >= 8
+
+static inline gint64
+_get_tat(RateLimiter *self)
+{
+  return atomic_gssize_get(&self->tat);
+}
+
+static inline gboolean
+_compare_and_set_tat(RateLimiter *self, gint64 old_tat, gint64 new_tat)
+{
+  return atomic_gssize_compare_and_exchange(&self->tat, old_tat, new_tat);
+}
+
+void
+rate_limiter_init(RateLimiter *self, gint64 now)
+{
+  atomic_gssize_set(&self->tat, now);
+}
+
+void
+rate_limiter_deinit(RateLimiter *self)
+{
+}
+
+#else
+
+static inline gint64
+_get_tat(RateLimiter *self)
+{
+  g_mutex_lock(&self->lock);
+  gint64 tat = self->tat;
+  g_mutex_unlock(&self->lock);
+  return tat;
+}
+
+static inline gboolean
+_compare_and_set_tat(RateLimiter *self, gint64 old_tat, gint64 new_tat)
+{
+  gboolean success = FALSE;
+
+  g_mutex_lock(&self->lock);
+  if (self->tat == old_tat)
+    {
+      self->tat = new_tat;
+      success = TRUE;
+    }
+  g_mutex_unlock(&self->lock);
+  return success;
+}
+
+void
+rate_limiter_init(RateLimiter *self, gint64 now)
+{
+  g_mutex_init(&self->lock);
+  self->tat = now;
+}
+
+void
+rate_limiter_deinit(RateLimiter *self)
+{
+  g_mutex_clear(&self->lock);
+}
+
+#endif
+
+RateLimiterResult
+rate_limiter_try_consume(RateLimiter *self, const RateLimiterRate *rate, gint num_tokens, gint64 now)
+{
+  gint64 tat, new_tat;
+
+  do
+    {
+      tat = _get_tat(self);
+      if (tat == RATE_LIMITER_TAT_EVICTED)
+        return RATE_LIMITER_EVICTED;
+
+      new_tat = MAX(tat, now) + num_tokens * rate->emission_interval;
+      if (new_tat - now > rate->burst)
+        return RATE_LIMITER_REJECTED;
+    }
+  while (!_compare_and_set_tat(self, tat, new_tat));
+
+  return RATE_LIMITER_ACCEPTED;
+}
+
+/*
+ * A limiter whose bucket has been full for idle_time can be evicted
+ * without any observable difference: a new limiter for the same key
+ * starts with a full bucket too.
+ */
+gboolean
+rate_limiter_try_evict(RateLimiter *self, gint64 now, gint64 idle_time)
+{
+  gint64 tat;
+
+  do
+    {
+      tat = _get_tat(self);
+      if (tat == RATE_LIMITER_TAT_EVICTED)
+        return TRUE;
+      if (now - tat < idle_time)
+        return FALSE;
+    }
+  while (!_compare_and_set_tat(self, tat, RATE_LIMITER_TAT_EVICTED));
+
+  return TRUE;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef RATE_LIMITER_H_INCLUDED
+#define RATE_LIMITER_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "atomic-gssize.h"
+
+/*
+ * Token bucket, implemented as a "generic cell rate algorithm": instead of
+ * the number of tokens and the time of the last refill, only the
+ * theoretical arrival time (TAT) of the next token is stored, which fits
+ * in a single word and can be updated with compare-and-swap.
+ *
+ * The bucket is full when TAT is in the past, consuming N tokens moves TAT
+ * forward by N emission intervals.  Consuming is allowed as long as TAT
+ * does not get further in the future than the burst size (one second's
+ * worth of tokens).
+ */
+
+typedef enum
+{
+  RATE_LIMITER_ACCEPTED,
+  RATE_LIMITER_REJECTED,
+  /* the limiter was evicted concurrently, it must be looked up again */
+  RATE_LIMITER_EVICTED,
+} RateLimiterResult;
+
+typedef struct _RateLimiterRate
+{
+  gint64 emission_interval;
+  gint64 burst;
+} RateLimiterRate;
+
+typedef struct _RateLimiter
+{
+#if GLIB_SIZEOF_VOID_P >= 8
+  atomic_gssize tat;
+#else
+  /* no single word atomics for 64 bit timestamps */
+  GMutex lock;
+  gint64 tat;
+#endif
+} RateLimiter;
+
+void rate_limiter_rate_init(RateLimiterRate *rate, gint tokens_per_sec);
+
+void rate_limiter_init(RateLimiter *self, gint64 now);
+void rate_limiter_deinit(RateLimiter *self);
+RateLimiterResult rate_limiter_try_consume(RateLimiter *self, const RateLimiterRate *rate, gint num_tokens,
+                                           gint64 now);
+gboolean rate_limiter_try_evict(RateLimiter *self, gint64 now, gint64 idle_time);
+
+static inline gint64
+rate_limiter_timespec_to_nsec(const struct timespec *ts)
+{
+  return ((gint64) ts->tv_sec) * 1000000000 + ts->tv_nsec;
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "rate-limiter-map.h"
+#include "apphook.h"
+
+#define NSEC_PER_SEC ((gint64) 1000000000)
+#define START_TIME (1000 * NSEC_PER_SEC)
+#define IDLE_TIME (10 * NSEC_PER_SEC)
+
+static gint
+_count_accepted(RateLimiterMap *map, const gchar *key, gint num_messages, gint64 now)
+{
+  gint accepted = 0;
+
+  for (gint i = 0; i < num_messages; i++)
+    accepted += rate_limiter_map_process(map, key, 1, now);
+  return accepted;
+}
+
+Test(rate_limiter, bucket_starts_full_and_allows_one_second_of_burst)
+{
+  RateLimiterMap *map = rate_limiter_map_new(10, IDLE_TIME);
+
+  cr_assert_eq(_count_accepted(map, "key", 100, START_TIME), 10);
+
+  rate_limiter_map_free(map);
+}
+
+Test(rate_limiter, tokens_are_refilled_according_to_the_rate)
+{
+  RateLimiterMap *map = rate_limiter_map_new(10, IDLE_TIME);
+
+  cr_assert_eq(_count_accepted(map, "key", 100, START_TIME), 10);
+  cr_assert_eq(_count_accepted(map, "key", 100, START_TIME + NSEC_PER_SEC / 2), 5);
+  cr_assert_eq(_count_accepted(map, "key", 100, START_TIME + 10 * NSEC_PER_SEC), 10);
+
+  rate_limiter_map_free(map);
+}
+
+Test(rate_limiter, batches_are_accepted_or_rejected_as_a_whole)
+{
+  RateLimiterMap *map = rate_limiter_map_new(10, IDLE_TIME);
+
+  cr_assert(rate_limiter_map_process(map, "key", 8, START_TIME));
+  cr_assert_not(rate_limiter_map_process(map, "key", 3, START_TIME));
+  cr_assert(rate_limiter_map_process(map, "key", 2, START_TIME));
+  cr_assert_not(rate_limiter_map_process(map, "key", 11, START_TIME + 10 * NSEC_PER_SEC));
+
+  rate_limiter_map_free(map);
+}
+
+Test(rate_limiter, keys_have_independent_buckets)
+{
+  RateLimiterMap *map = rate_limiter_map_new(10, IDLE_TIME);
+  gchar key[32];
+
+  for (gint i = 0; i < 10000; i++)
+    {
+      g_snprintf(key, sizeof(key), "key-%d", i);
+      cr_assert_eq(_count_accepted(map, key, 20, START_TIME), 10);
+    }
+  cr_assert_eq(rate_limiter_map_get_size(map), 10000);
+
+  for (gint i = 0; i < 10000; i++)
+    {
+      g_snprintf(key, sizeof(key), "key-%d", i);
+      cr_assert_eq(_count_accepted(map, key, 1, START_TIME), 0, "key: %s", key);
+    }
+
+  rate_limiter_map_free(map);
+}
+
+Test(rate_limiter, idle_keys_are_evicted)
+{
+  RateLimiterMap *map = rate_limiter_map_new(10, IDLE_TIME);
+
+  cr_assert_eq(_count_accepted(map, "idle", 10, START_TIME), 10);
+  cr_assert_eq(_count_accepted(map, "busy", 10, START_TIME + 10 * NSEC_PER_SEC), 10);
+  cr_assert_eq(rate_limiter_map_get_size(map), 2);
+
+  /* the bucket of "busy" is not full yet */
+  rate_limiter_map_evict_idle(map, START_TIME + 12 * NSEC_PER_SEC);
+  cr_assert_eq(rate_limiter_map_get_size(map), 1);
+
+  /* an evicted key starts over with a full bucket, just as if it was kept */
+  cr_assert_eq(_count_accepted(map, "idle", 20, START_TIME + 12 * NSEC_PER_SEC), 10);
+  cr_assert_eq(_count_accepted(map, "busy", 20, START_TIME + 12 * NSEC_PER_SEC), 10);
+
+  rate_limiter_map_evict_idle(map, START_TIME + 30 * NSEC_PER_SEC);
+  cr_assert_eq(rate_limiter_map_get_size(map), 0);
+
+  rate_limiter_map_free(map);
+}
+
+TestSuite(rate_limiter, .init = app_startup, .fini = app_shutdown);
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "rate-limiter-map.h"
+#include "apphook.h"
+#include "timeutils/misc.h"
+
+#include <stdio.h>
+
+#define NUM_THREADS 32
+#define NUM_KEYS 1000000
+#define NUM_LOOKUPS_PER_THREAD 200000
+#define NSEC_PER_SEC ((gint64) 1000000000)
+
+typedef struct _PerfThreadArgs
+{
+  RateLimiterMap *map;
+  guint32 seed;
+  gint num_keys;
+} PerfThreadArgs;
+
+static GMutex start_lock;
+static GCond start_cond;
+static gboolean start;
+
+static gpointer
+_lookup_keys_thread(gpointer s)
+{
+  PerfThreadArgs *args = (PerfThreadArgs *) s;
+  GRand *rand = g_rand_new_with_seed(args->seed);
+  gchar key[32];
+  struct timespec now;
+
+  g_mutex_lock(&start_lock);
+  while (!start)
+    g_cond_wait(&start_cond, &start_lock);
+  g_mutex_unlock(&start_lock);
+
+  for (gint i = 0; i < NUM_LOOKUPS_PER_THREAD; i++)
+    {
+      g_snprintf(key, sizeof(key), "key-%d", g_rand_int_range(rand, 0, args->num_keys));
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      rate_limiter_map_process(args->map, key, 1, rate_limiter_timespec_to_nsec(&now));
+    }
+
+  g_rand_free(rand);
+  return NULL;
+}
+
+static void
+_measure_contention(gint num_threads, gint num_keys)
+{
+  RateLimiterMap *map = rate_limiter_map_new(1000, 10 * NSEC_PER_SEC);
+  PerfThreadArgs args[NUM_THREADS];
+  GThread *threads[NUM_THREADS];
+  struct timespec start_ts, end_ts;
+
+  start = FALSE;
+  for (gint i = 0; i < num_threads; i++)
+    {
+      args[i].map = map;
+      args[i].seed = i;
+      args[i].num_keys = num_keys;
+      threads[i] = g_thread_new(NULL, _lookup_keys_thread, &args[i]);
+    }
+
+  clock_gettime(CLOCK_MONOTONIC, &start_ts);
+  g_mutex_lock(&start_lock);
+  start = TRUE;
+  g_cond_broadcast(&start_cond);
+  g_mutex_unlock(&start_lock);
+
+  for (gint i = 0; i < num_threads; i++)
+    g_thread_join(threads[i]);
+  clock_gettime(CLOCK_MONOTONIC, &end_ts);
+
+  printf("      rate-limit, threads: %2d, keys: %7d, map size: %7" G_GSIZE_FORMAT ", speed: %12.3f lookups/sec\n",
+         num_threads, num_keys, rate_limiter_map_get_size(map),
+         num_threads * NUM_LOOKUPS_PER_THREAD * 1e6 / timespec_diff_usec(&end_ts, &start_ts));
+
+  rate_limiter_map_free(map);
+}
+
+Test(rate_limiter_perf, test_contention_with_many_threads_and_keys)
+{
+  _measure_contention(1, NUM_KEYS);
+  _measure_contention(NUM_THREADS, NUM_KEYS);
+  /* all threads hammering the same few buckets */
+  _measure_contention(NUM_THREADS, 16);
+}
+
+TestSuite(rate_limiter_perf, .init = app_startup, .fini = app_shutdown);
@@ -253,31 +253,33 @@ _syslog_format_parse_timestamp(LogMessage *msg, UnixTime *stamp,
                                guint parse_flags, glong recv_timezone_ofs)
 {
   gboolean result;
-  WallClockTime wct = WALL_CLOCK_TIME_INIT;
 
-  if ((parse_flags & LP_SYSLOG_PROTOCOL) == 0)
-    result = scan_rfc3164_timestamp(data, length, &wct);
-  else
+  if ((parse_flags & LP_SYSLOG_PROTOCOL) != 0 && G_UNLIKELY(*length >= 1 && (*data)[0] == '-'))
     {
-      if (G_UNLIKELY(*length >= 1 && (*data)[0] == '-'))
-        {
-          log_msg_set_tag_by_id(msg, LM_T_SYSLOG_MISSING_TIMESTAMP);
-          unix_time_set_now(stamp);
-          (*data)++;
-          (*length)--;
-          return TRUE;
-        }
-      result = scan_rfc5424_timestamp(data, length, &wct);
+      log_msg_set_tag_by_id(msg, LM_T_SYSLOG_MISSING_TIMESTAMP);
+      unix_time_set_now(stamp);
+      (*data)++;
+      (*length)--;
+      return TRUE;
     }
 
-  if (result && (parse_flags & LP_NO_PARSE_DATE) == 0)
+  if (parse_flags & LP_NO_PARSE_DATE)
     {
-      convert_and_normalize_wall_clock_time_to_unix_time_with_tz_hint(&wct, stamp, recv_timezone_ofs);
+      WallClockTime wct = WALL_CLOCK_TIME_INIT;
 
-      if ((parse_flags & LP_GUESS_TIMEZONE) != 0)
-        unix_time_fix_timezone_assuming_the_time_matches_real_time(stamp);
+      if ((parse_flags & LP_SYSLOG_PROTOCOL) == 0)
+        return scan_rfc3164_timestamp(data, length, &wct);
+      return scan_rfc5424_timestamp(data, length, &wct);
     }
 
+  if ((parse_flags & LP_SYSLOG_PROTOCOL) == 0)
+    result = scan_rfc3164_timestamp_to_unix_time(data, length, stamp, recv_timezone_ofs);
+  else
+    result = scan_rfc5424_timestamp_to_unix_time(data, length, stamp, recv_timezone_ofs);
+
+  if (result && (parse_flags & LP_GUESS_TIMEZONE) != 0)
+    unix_time_fix_timezone_assuming_the_time_matches_real_time(stamp);
+
   return result;
 }
 
@@ -517,7 +519,7 @@ _syslog_format_parse_hostname(LogMessage *msg, const guchar **data, gint *length
 
 /**
  * _syslog_format_parse:
- * @msg: LogMessage instance to store parsed information into
+ * @msg: LogMessage instance to store parsed information into, NULL to validate only
  * @data: message
  * @length: length of the message pointed to by @data
  * @flags: value affecting how the message is parsed (bits from LP_*)
@@ -611,7 +613,8 @@ _syslog_format_parse_sd(LogMessage *msg, const guchar **data, gint *length, cons
 
           if (left && *src == ']')
             {
-              log_msg_set_value_by_name(msg, sd_value_name, "", 0);
+              if (msg)
+                log_msg_set_value_by_name(msg, sd_value_name, "", 0);
             }
           else
             {
@@ -734,7 +737,8 @@ _syslog_format_parse_sd(LogMessage *msg, const guchar **data, gint *length, cons
                   goto error;
                 }
 
-              log_msg_set_value_by_name(msg, sd_value_name, sd_param_value, sd_param_value_len);
+              if (msg)
+                log_msg_set_value_by_name(msg, sd_value_name, sd_param_value, sd_param_value_len);
             }
 
           if (left && *src == ']')
@@ -773,6 +777,46 @@ error:
   return ret;
 }
 
+/* the options used to parse a lazily stored SD string, see syslog_format_init() */
+static MsgFormatOptions lazy_sdata_options;
+
+static void
+_parse_lazy_sdata(LogMessage *msg, const gchar *sdata, gssize sdata_len)
+{
+  const guchar *src = (const guchar *) sdata;
+  gint left = sdata_len;
+
+  _syslog_format_parse_sd(msg, &src, &left, &lazy_sdata_options);
+}
+
+static inline gboolean
+_is_lazy_sdata_applicable(const MsgFormatOptions *options)
+{
+  /* the SD string is parsed later without the options of the source, so
+   * it can only be deferred if they match the defaults */
+  return (options->flags & LP_LAZY_SDATA) &&
+         options->sdata_param_value_max == lazy_sdata_options.sdata_param_value_max &&
+         strcmp(options->sdata_prefix, lazy_sdata_options.sdata_prefix) == 0;
+}
+
+static gboolean
+_syslog_format_parse_sd_lazily(LogMessage *msg, const guchar **data, gint *length, const MsgFormatOptions *options)
+{
+  const guchar *start = *data;
+  gint start_length = *length;
+
+  if (!_syslog_format_parse_sd(NULL, data, length, options))
+    {
+      /* invalid SD, parse it the usual way to keep the partial results */
+      *data = start;
+      *length = start_length;
+      return _syslog_format_parse_sd(msg, data, length, options);
+    }
+
+  log_msg_set_lazy_sdata(msg, (const gchar *) start, *data - start);
+  return TRUE;
+}
+
 gboolean
 _syslog_format_parse_sd_column(LogMessage *msg, const guchar **data, gint *length, const MsgFormatOptions *options)
 {
@@ -780,6 +824,8 @@ _syslog_format_parse_sd_column(LogMessage *msg, const guchar **data, gint *lengt
     return TRUE;
 
   guchar first_char = (*data)[0];
+  if (first_char == '[' && _is_lazy_sdata_applicable(options))
+    return _syslog_format_parse_sd_lazily(msg, data, length, options);
   if (first_char == '-' || first_char == '[')
     return _syslog_format_parse_sd(msg, data, length, options);
 
@@ -1190,6 +1236,11 @@ syslog_format_init(void)
     {
       handles.is_synced = log_msg_get_value_handle(".SDATA.timeQuality.isSynced");
       handles.cisco_seqid = log_msg_get_value_handle(".SDATA.meta.sequenceId");
+
+      msg_format_options_defaults(&lazy_sdata_options);
+      lazy_sdata_options.sdata_prefix = (gchar *) logmsg_sd_prefix;
+      lazy_sdata_options.sdata_prefix_len = logmsg_sd_prefix_len;
+      log_msg_register_sdata_parser(_parse_lazy_sdata);
       handles.initialized = TRUE;
     }
 
@@ -28,6 +28,9 @@
 #include "cfg.h"
 #include "syslog-format.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-serialize.h"
+#include "logpipe.h"
+#include "serialize.h"
 #include "msg-format.h"
 #include "scratch-buffers.h"
 
@@ -446,3 +449,154 @@ Test(syslog_format, test_framing_not_detected_on_input_starting_with_whitespace)
 
   log_msg_unref(msg);
 }
+
+static const gchar *lazy_sdata_input =
+  "<165>1 2003-10-11T22:14:15.003Z mymachine.example.com evntslog - ID47 "
+  "[exampleSDID@32473 iut=\"3\" eventSource=\"Application\" eventID=\"1011\"][examplePriority@32473 class=\"high\"] "
+  "An application event log entry";
+
+static LogMessage *
+_parse_rfc5424_message(const gchar *data, guint32 extra_flags)
+{
+  gsize data_length = strlen(data);
+  gsize problem_position;
+
+  parse_options.flags |= LP_SYSLOG_PROTOCOL | extra_flags;
+  LogMessage *msg = log_msg_new_empty();
+  cr_assert(syslog_format_handler(&parse_options, msg, (const guchar *) data, data_length, &problem_position));
+  parse_options.flags &= ~(LP_SYSLOG_PROTOCOL | extra_flags);
+  return msg;
+}
+
+static gboolean
+_append_sdata_value(NVHandle handle, const gchar *name, const gchar *value, gssize value_len,
+                    LogMessageValueType type, gpointer user_data)
+{
+  GString *result = (GString *) user_data;
+
+  if (log_msg_is_handle_sdata(handle))
+    g_string_append_printf(result, "%s=%.*s;", name, (gint) value_len, value);
+  return FALSE;
+}
+
+static void
+_assert_sdata_equals(LogMessage *lazy, LogMessage *eager)
+{
+  GString *lazy_result = g_string_new("");
+  GString *eager_result = g_string_new("");
+
+  log_msg_format_sdata(lazy, lazy_result, 0);
+  log_msg_format_sdata(eager, eager_result, 0);
+  cr_assert_str_eq(lazy_result->str, eager_result->str);
+
+  g_string_truncate(lazy_result, 0);
+  g_string_truncate(eager_result, 0);
+  log_msg_values_foreach(lazy, _append_sdata_value, lazy_result);
+  log_msg_values_foreach(eager, _append_sdata_value, eager_result);
+  cr_assert_str_eq(lazy_result->str, eager_result->str);
+
+  g_string_free(lazy_result, TRUE);
+  g_string_free(eager_result, TRUE);
+}
+
+Test(syslog_format, test_lazy_sdata_is_equivalent_to_eager_parsing)
+{
+  LogMessage *eager = _parse_rfc5424_message(lazy_sdata_input, 0);
+  LogMessage *lazy = _parse_rfc5424_message(lazy_sdata_input, LP_LAZY_SDATA);
+
+  cr_assert(lazy->flags & LF_STATE_LAZY_SDATA);
+  cr_assert_not(eager->flags & LF_STATE_LAZY_SDATA);
+
+  _assert_sdata_equals(lazy, eager);
+  assert_log_message_value_by_name(lazy, ".SDATA.exampleSDID@32473.eventSource", "Application");
+  assert_log_message_value_by_name(lazy, ".SDATA.examplePriority@32473.class", "high");
+  assert_log_message_value_by_name(lazy, "MESSAGE", "An application event log entry");
+
+  /* reads do not change the message itself */
+  cr_assert(lazy->flags & LF_STATE_LAZY_SDATA);
+  cr_assert_eq(lazy->num_sdata, 0);
+  cr_assert_eq(log_msg_get_parsed_sdata(lazy)->num_sdata, eager->num_sdata);
+
+  log_msg_unref(lazy);
+  log_msg_unref(eager);
+}
+
+Test(syslog_format, test_lazy_sdata_is_parsed_in_place_when_an_sdata_value_is_changed)
+{
+  LogMessage *eager = _parse_rfc5424_message(lazy_sdata_input, 0);
+  LogMessage *lazy = _parse_rfc5424_message(lazy_sdata_input, LP_LAZY_SDATA);
+
+  log_msg_set_value_by_name(lazy, ".SDATA.examplePriority@32473.class", "low", -1);
+  log_msg_set_value_by_name(eager, ".SDATA.examplePriority@32473.class", "low", -1);
+
+  cr_assert_not(lazy->flags & LF_STATE_LAZY_SDATA);
+  _assert_sdata_equals(lazy, eager);
+  assert_log_message_value_by_name(lazy, ".SDATA.exampleSDID@32473.iut", "3");
+
+  log_msg_unref(lazy);
+  log_msg_unref(eager);
+}
+
+Test(syslog_format, test_lazy_sdata_is_readable_from_write_protected_clones)
+{
+  LogMessage *eager = _parse_rfc5424_message(lazy_sdata_input, 0);
+  LogMessage *lazy = _parse_rfc5424_message(lazy_sdata_input, LP_LAZY_SDATA);
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT_NOACK;
+
+  LogMessage *clone = log_msg_clone_cow(lazy, &path_options);
+  cr_assert(log_msg_is_write_protected(lazy));
+  cr_assert(clone->flags & LF_STATE_LAZY_SDATA);
+
+  _assert_sdata_equals(lazy, eager);
+  _assert_sdata_equals(clone, eager);
+
+  log_msg_set_value_by_name(clone, ".SDATA.meta.sequenceId", "42", -1);
+  log_msg_set_value_by_name(eager, ".SDATA.meta.sequenceId", "42", -1);
+  _assert_sdata_equals(clone, eager);
+  assert_log_message_value_by_name(lazy, ".SDATA.meta.sequenceId", "");
+
+  log_msg_unref(clone);
+  log_msg_unref(lazy);
+  log_msg_unref(eager);
+}
+
+Test(syslog_format, test_lazy_sdata_is_serialized_as_parsed_values)
+{
+  LogMessage *eager = _parse_rfc5424_message(lazy_sdata_input, 0);
+  LogMessage *lazy = _parse_rfc5424_message(lazy_sdata_input, LP_LAZY_SDATA);
+  GString *serialized = g_string_new("");
+
+  log_msg_write_protect(lazy);
+  SerializeArchive *sa = serialize_string_archive_new(serialized);
+  cr_assert(log_msg_serialize(lazy, sa, 0));
+  serialize_archive_free(sa);
+  cr_assert(lazy->flags & LF_STATE_LAZY_SDATA);
+
+  LogMessage *deserialized = log_msg_new_empty();
+  sa = serialize_string_archive_new(serialized);
+  cr_assert(log_msg_deserialize(deserialized, sa));
+  serialize_archive_free(sa);
+
+  cr_assert_not(deserialized->flags & LF_STATE_LAZY_SDATA);
+  _assert_sdata_equals(deserialized, eager);
+
+  log_msg_unref(deserialized);
+  g_string_free(serialized, TRUE);
+  log_msg_unref(lazy);
+  log_msg_unref(eager);
+}
+
+Test(syslog_format, test_invalid_lazy_sdata_is_parsed_eagerly)
+{
+  const gchar *data = "<165>1 2003-10-11T22:14:15.003Z host prog - ID47 [foo bar=\"baz\"][qux";
+  gsize data_length = strlen(data);
+  gsize problem_position;
+
+  parse_options.flags |= LP_SYSLOG_PROTOCOL | LP_LAZY_SDATA;
+  LogMessage *msg = log_msg_new_empty();
+  cr_assert_not(syslog_format_handler(&parse_options, msg, (const guchar *) data, data_length, &problem_position));
+
+  cr_assert_not(msg->flags & LF_STATE_LAZY_SDATA);
+  assert_log_message_value_by_name(msg, ".SDATA.foo.bar", "baz");
+  log_msg_unref(msg);
+}